@@ -27,46 +27,116 @@
 #include <vector>
 #include <memory>
 #include <limits>
+#include <atomic>
 
 BEGIN_YAFARAY
 
 class Bound;
 class ParamMap;
 class Ray;
-class Ray;
+class RayStream;
 class Primitive;
+class RayDump;
 class SurfacePoint;
 class Logger;
 class MaterialData;
+class Matrix4;
 
 struct AcceleratorIntersectData : IntersectData
 {
 	float t_max_ = std::numeric_limits<float>::infinity();
 	const Primitive *hit_primitive_ = nullptr;
+	const Matrix4 *obj_to_world_ = nullptr; //!< transformation matrix of the hit instance, if the hit primitive was found in object space
+	int obj_to_world_time_steps_ = 1; //!< number of motion blur time step matrices pointed by obj_to_world_
 };
 
 struct AcceleratorTsIntersectData : AcceleratorIntersectData
 {
 	Rgb transparent_color_ {1.f};
+	int transparent_depth_ = 0; //!< transparent primitives the shadow ray went through, counted against the max_depth of the query
 };
 
 class Accelerator
 {
 	public:
-		static const Accelerator * factory(Logger &logger, const std::vector<const Primitive *> &primitives_list, const ParamMap &params);
-		explicit Accelerator(Logger &logger) : logger_(logger) { }
+		static Accelerator * factory(Logger &logger, const std::vector<const Primitive *> &primitives_list, const ParamMap &params);
+		explicit Accelerator(Logger &logger);
 		virtual ~Accelerator() = default;
 		virtual AcceleratorIntersectData intersect(const Ray &ray, float t_max) const = 0;
 		virtual AcceleratorIntersectData intersectS(const Ray &ray, float t_max, float shadow_bias) const = 0;
 		virtual AcceleratorTsIntersectData intersectTs(const Ray &ray, int max_depth, float dist, float shadow_bias, const Camera *camera) const = 0;
 		virtual Bound getBound() const = 0;
-		std::pair<std::unique_ptr<const SurfacePoint>, float> intersect(const Ray &ray, const Camera *camera) const;
+		/*! Memory used by the accelerator tree and data, in bytes. 0 if not known */
+		virtual size_t memoryUsed() const { return 0; }
+		/*! Recomputes the tree bounds after the primitives were moved, keeping the tree topology.
+			Returns false if not supported by the accelerator, in that case it must be built again */
+		virtual bool refit(int num_threads) { return false; }
+		/*! Batch versions of the intersect functions, tracing all the rays of a stream together. The results are
+			resized to the number of rays. By default each ray is traced on its own with the single ray functions */
+		virtual void intersect(const RayStream &rays, std::vector<AcceleratorIntersectData> &results) const;
+		virtual void intersectS(const RayStream &rays, float shadow_bias, std::vector<AcceleratorIntersectData> &results) const;
+		virtual void intersectTs(const RayStream &rays, int max_depth, float shadow_bias, const Camera *camera, std::vector<AcceleratorTsIntersectData> &results) const;
+		/*! Closest hit, filling the surface point given by the caller (usually in its stack) if there is a hit.
+			Returns if there was a hit and the distance to it, or the ray tmax if not */
+		std::pair<bool, float> intersect(const Ray &ray, const Camera *camera, SurfacePoint &sp) const;
 		std::pair<bool, const Primitive *> isShadowed(const Ray &ray, float shadow_bias) const;
 		std::tuple<bool, Rgb, const Primitive *> isShadowed(const Ray &ray, int max_depth, float shadow_bias, const Camera *camera) const;
+		/*! Batch versions of isShadowed, for rays added with RayStream::pushShadowRay. The rays are recorded in the ray dump and tested
+			against the last occluder as in the single ray versions, and the rest are traced together with the batch intersect functions */
+		void isShadowed(const RayStream &rays, float shadow_bias, std::vector<AcceleratorIntersectData> &results) const;
+		void isShadowed(const RayStream &rays, int max_depth, float shadow_bias, const Camera *camera, std::vector<AcceleratorTsIntersectData> &results) const;
+		/*! Logs the number of shadow rays traced with the isShadowed functions since the last call, and how many of them were
+			found blocked by the last occluder cache. The counts of each thread are added to the totals in batches, so the
+			last few rays of each thread may not be included */
+		void logShadowRayStats() const;
+		/*! The rays traced with the non batch intersect and isShadowed functions are recorded in the ray dump, if any */
+		void setRayDump(RayDump *ray_dump) { ray_dump_ = ray_dump; }
+		/*! Node and primitive tests done by the calling thread in the single ray traversals, for the accelerator
+			benchmark. They are only counted if built with the YAFARAY_ACCELERATOR_COUNTERS option */
+		struct TraversalCounters
+		{
+			uint64_t node_tests_ = 0;
+			uint64_t primitive_tests_ = 0;
+		};
+		static TraversalCounters &traversalCounters();
+		static void countNodeTests(uint32_t num_node_tests);
+		static void countPrimitiveTest();
 
 	protected:
 		Logger &logger_;
+		const uint64_t id_; //!< unique for every accelerator created, so the per-thread caches never use data of a previous accelerator
+
+	private:
+		struct ShadowRayCache;
+		struct ShadowRayStream;
+		static ShadowRayCache &shadowRayCache(uint64_t accelerator_id);
+		static ShadowRayStream &shadowRayStream();
+		const Primitive *cachedOccluder(const Ray &ray, float t_max, bool transparent_shadows) const;
+		void cacheOccluder(const AcceleratorIntersectData &accelerator_intersect_data) const;
+		mutable std::atomic<uint64_t> num_shadow_rays_ { 0 };
+		mutable std::atomic<uint64_t> num_occluder_cache_hits_ { 0 };
+		RayDump *ray_dump_ = nullptr;
 };
 
+inline Accelerator::TraversalCounters &Accelerator::traversalCounters()
+{
+	static thread_local TraversalCounters traversal_counters;
+	return traversal_counters;
+}
+
+inline void Accelerator::countNodeTests(uint32_t num_node_tests)
+{
+#ifdef ACCELERATOR_COUNTERS
+	traversalCounters().node_tests_ += num_node_tests;
+#endif
+}
+
+inline void Accelerator::countPrimitiveTest()
+{
+#ifdef ACCELERATOR_COUNTERS
+	++traversalCounters().primitive_tests_;
+#endif
+}
+
 END_YAFARAY
 #endif    //YAFARAY_ACCELERATOR_H
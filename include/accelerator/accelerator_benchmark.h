@@ -0,0 +1,68 @@
+#pragma once
+/****************************************************************************
+ *      This is part of the libYafaRay package
+ *
+ *      This library is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU Lesser General Public
+ *      License as published by the Free Software Foundation; either
+ *      version 2.1 of the License, or (at your option) any later version.
+ *
+ *      This library is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *      Lesser General Public License for more details.
+ *
+ *      You should have received a copy of the GNU Lesser General Public
+ *      License along with this library; if not, write to the Free Software
+ *      Foundation,Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#ifndef YAFARAY_ACCELERATOR_BENCHMARK_H
+#define YAFARAY_ACCELERATOR_BENCHMARK_H
+
+#include "accelerator/accelerator.h"
+#include "accelerator/ray_dump.h"
+#include <functional>
+
+BEGIN_YAFARAY
+
+// ============================================================
+/*! Replays the accelerator queries recorded in a ray dump file against
+	several accelerator types built over the same primitives, so they can
+	be compared without rendering. For each accelerator type it logs the
+	build time, the memory used and, for each kind of query, the queries
+	per second traced in a single thread and the number of hits, which
+	should be the same for all the accelerators. When libYafaRay is built
+	with the YAFARAY_ACCELERATOR_COUNTERS option the node and primitive
+	tests per query are logged as well.
+
+	The closest hits are also checked against the way the shadow ray
+	paths test their occluders, intersecting the hit primitive again
+	with the object to world transform at the ray time (interpolated
+	for the moving instances). Any hit found at a different position
+	is reported as an error, as the surface point would not be where
+	the shadow rays see it, and the benchmark returns false.
+*/
+class AcceleratorBenchmark final
+{
+	public:
+		using AcceleratorFactory = std::function<std::unique_ptr<Accelerator>(const std::string &type)>;
+		static bool run(Logger &logger, const std::string &ray_dump_path, const std::vector<std::string> &accelerator_types, const AcceleratorFactory &accelerator_factory, const Camera *camera);
+		static const std::vector<std::string> accelerator_types_; //!< all the accelerator types except the slow "yafaray-simpletest"
+
+	private:
+		struct QueryResults
+		{
+			size_t num_queries_ = 0;
+			size_t num_hits_ = 0;
+			double time_ = 0.0;
+			Accelerator::TraversalCounters counters_;
+		};
+		static QueryResults replay(const Accelerator &accelerator, const std::vector<RayDump::Record> &records, const Camera *camera);
+		static size_t checkClosestHits(const Accelerator &accelerator, const std::vector<RayDump::Record> &records);
+		static std::string queryName(RayDump::Query query);
+};
+
+END_YAFARAY
+
+#endif //YAFARAY_ACCELERATOR_BENCHMARK_H
@@ -0,0 +1,155 @@
+#pragma once
+/****************************************************************************
+ *      This is part of the libYafaRay package
+ *
+ *      This library is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU Lesser General Public
+ *      License as published by the Free Software Foundation; either
+ *      version 2.1 of the License, or (at your option) any later version.
+ *
+ *      This library is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *      Lesser General Public License for more details.
+ *
+ *      You should have received a copy of the GNU Lesser General Public
+ *      License along with this library; if not, write to the Free Software
+ *      Foundation,Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#ifndef YAFARAY_ACCELERATOR_BVH_H
+#define YAFARAY_ACCELERATOR_BVH_H
+
+#include "accelerator/accelerator.h"
+#include "accelerator/bvh_builder.h"
+#include "accelerator/accelerator_cache.h"
+#include "accelerator/triangle_soup.h"
+#include "geometry/ray_stream.h"
+#include <array>
+
+BEGIN_YAFARAY
+
+// ============================================================
+/*! Bounding Volume Hierarchy built with a binned SAH (Surface Area
+	Heuristic) cost function. Subtrees are built in parallel and
+	primitives are never split, so the build is much faster than the
+	kd-tree one, at the cost of some traversal performance in scenes
+	with long/thin primitives. The "yafaray-lbvh" type builds the same
+	tree with the much faster LbvhBuilder, for preview renders, and the
+	"yafaray-sbvh" type with SbvhBuilder spatial splits, for scenes with
+	long/thin primitives.
+*/
+class AcceleratorBvh final : public Accelerator
+{
+	public:
+		static Accelerator * factory(Logger &logger, const std::vector<const Primitive *> &primitives, const ParamMap &params);
+		static BvhBuilder::Parameters getBuildParameters(const ParamMap &params);
+		static Vec3 invDirection(const Vec3 &dir);
+
+	private:
+		using Node = BvhBuilder::Node;
+		struct Stack;
+		struct RayPacket;
+		AcceleratorBvh(Logger &logger, const std::vector<const Primitive *> &primitives, const BvhBuilder::Parameters &parameters, bool precompute_triangles, const std::string &cache_directory);
+		~AcceleratorBvh() override;
+		AcceleratorIntersectData intersect(const Ray &ray, float t_max) const override;
+		AcceleratorIntersectData intersectS(const Ray &ray, float t_max, float shadow_bias) const override;
+		AcceleratorTsIntersectData intersectTs(const Ray &ray, int max_depth, float t_max, float shadow_bias, const Camera *camera) const override;
+		void intersect(const RayStream &rays, std::vector<AcceleratorIntersectData> &results) const override;
+		void intersectS(const RayStream &rays, float shadow_bias, std::vector<AcceleratorIntersectData> &results) const override;
+		void intersectTs(const RayStream &rays, int max_depth, float shadow_bias, const Camera *camera, std::vector<AcceleratorTsIntersectData> &results) const override;
+		template <bool ordered, typename PrimitiveFunction> void traversePacket(RayPacket &packet, const PrimitiveFunction &primitive_function) const;
+		Bound getBound() const override { return tree_bound_; }
+		size_t memoryUsed() const override { return nodes_.size() * sizeof(Node) + primitives_.size() * sizeof(const Primitive *) + triangle_soup_.memoryUsed() + motion_bounds_.memoryUsed(); }
+		bool refit(int num_threads) override;
+		void buildMotionBounds();
+		float intersectNode(uint32_t node_id, const Ray &ray, const Vec3 &inv_dir, float t_max) const;
+		static bool validTree(const CachedArray<Node> &nodes, const CachedArray<uint32_t> &prim_indices, uint32_t num_primitives, uint32_t max_references);
+
+		Bound tree_bound_; 	//!< overall space the tree encloses
+		CachedArray<Node> nodes_; //!< built or used in place from a mapped cache file
+		std::vector<const Primitive *> primitives_; //!< primitives in leaf order, leaves reference ranges of this list
+		bool duplicated_references_ = false; //!< some primitives are referenced by more than one leaf, due to spatial splits
+		TriangleSoup triangle_soup_; //!< optional precomputed triangles, in the same order as the primitives list
+		BvhBuilder::MotionBounds motion_bounds_; //!< node bounds in the motion blur time steps, only if any primitive moves
+		static constexpr int bvh_max_stack_ = BvhBuilder::max_depth_;
+};
+
+/*! Stack elements for the traversal, far children pending to be visited */
+struct AcceleratorBvh::Stack
+{
+	uint32_t node_id_;
+	float t_; //!< the entry signed distance into the node bound
+};
+
+/*! Up to max_size_ rays of a stream traced together, with the data used in
+	the node bound tests stored in SoA layout */
+struct AcceleratorBvh::RayPacket
+{
+	RayPacket(const RayStream &rays, size_t ray_offset, size_t size);
+	float intersect(const Bound &bound, float *t_entry) const;
+	float maxDistance() const;
+	static void intersectSlab(float bound_min, float bound_max, float from, float inv_dir, float &t_near, float &t_far);
+	static constexpr size_t max_size_ = 64;
+	size_t size_;
+	std::array<float, max_size_> from_x_, from_y_, from_z_;
+	std::array<float, max_size_> inv_dir_x_, inv_dir_y_, inv_dir_z_;
+	std::array<float, max_size_> t_max_; //!< current maximum distance of each ray, -infinity once the ray does not need more traversal
+	std::array<Ray, max_size_> rays_; //!< for the primitive intersection tests
+};
+
+/*! Same slabs test as BvhBuilder::intersectBound, but written without branches or early exits
+	so the compiler can vectorize the loop over the packet rays. Gets the entry distance of each
+	ray (infinity if missed) and returns the minimum one */
+inline float AcceleratorBvh::RayPacket::intersect(const Bound &bound, float *t_entry) const
+{
+	float t_entry_min = std::numeric_limits<float>::infinity();
+	for(size_t ray_id = 0; ray_id < size_; ++ray_id)
+	{
+		float t_near = 0.f;
+		float t_far = t_max_[ray_id];
+		intersectSlab(bound.a_.x(), bound.g_.x(), from_x_[ray_id], inv_dir_x_[ray_id], t_near, t_far);
+		intersectSlab(bound.a_.y(), bound.g_.y(), from_y_[ray_id], inv_dir_y_[ray_id], t_near, t_far);
+		intersectSlab(bound.a_.z(), bound.g_.z(), from_z_[ray_id], inv_dir_z_[ray_id], t_near, t_far);
+		t_entry[ray_id] = (t_near <= t_far) ? t_near : std::numeric_limits<float>::infinity();
+		t_entry_min = (t_entry[ray_id] < t_entry_min) ? t_entry[ray_id] : t_entry_min;
+	}
+	return t_entry_min;
+}
+
+inline void AcceleratorBvh::RayPacket::intersectSlab(float bound_min, float bound_max, float from, float inv_dir, float &t_near, float &t_far)
+{
+	const float t_0 = (bound_min - from) * inv_dir;
+	const float t_1 = (bound_max - from) * inv_dir;
+	const float t_slab_near = (t_0 > t_1) ? t_1 : t_0;
+	const float t_slab_far = ((t_0 > t_1) ? t_0 : t_1) * 1.00000024f; //conservative rounding, as in BvhBuilder::intersectBound
+	t_near = (t_slab_near > t_near) ? t_slab_near : t_near;
+	t_far = (t_slab_far < t_far) ? t_slab_far : t_far;
+}
+
+inline float AcceleratorBvh::RayPacket::maxDistance() const
+{
+	float t_max = -std::numeric_limits<float>::infinity();
+	for(size_t ray_id = 0; ray_id < size_; ++ray_id) t_max = (t_max_[ray_id] > t_max) ? t_max_[ray_id] : t_max;
+	return t_max;
+}
+
+inline float AcceleratorBvh::intersectNode(uint32_t node_id, const Ray &ray, const Vec3 &inv_dir, float t_max) const
+{
+	countNodeTests(1);
+	if(motion_bounds_.empty()) return nodes_[node_id].intersect(ray.from_, inv_dir, t_max);
+	else return motion_bounds_.intersect(node_id, ray.from_, inv_dir, t_max, ray.time_);
+}
+
+inline Vec3 AcceleratorBvh::invDirection(const Vec3 &dir)
+{
+	//To avoid division by zero
+	return {
+		dir.x() == 0.f ? std::numeric_limits<float>::max() : 1.f / dir.x(),
+		dir.y() == 0.f ? std::numeric_limits<float>::max() : 1.f / dir.y(),
+		dir.z() == 0.f ? std::numeric_limits<float>::max() : 1.f / dir.z()
+	};
+}
+
+END_YAFARAY
+#endif    //YAFARAY_ACCELERATOR_BVH_H
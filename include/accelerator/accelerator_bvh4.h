@@ -0,0 +1,145 @@
+#pragma once
+/****************************************************************************
+ *      This is part of the libYafaRay package
+ *
+ *      This library is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU Lesser General Public
+ *      License as published by the Free Software Foundation; either
+ *      version 2.1 of the License, or (at your option) any later version.
+ *
+ *      This library is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *      Lesser General Public License for more details.
+ *
+ *      You should have received a copy of the GNU Lesser General Public
+ *      License along with this library; if not, write to the Free Software
+ *      Foundation,Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#ifndef YAFARAY_ACCELERATOR_BVH4_H
+#define YAFARAY_ACCELERATOR_BVH4_H
+
+#include "accelerator/accelerator.h"
+#include "accelerator/bvh_builder.h"
+#include "accelerator/triangle_soup.h"
+#include <array>
+
+BEGIN_YAFARAY
+
+// ============================================================
+/*! 4-wide Bounding Volume Hierarchy. It is built collapsing the binary
+	SAH BVH so each node holds up to 4 children, with their bounds stored
+	in SoA layout to test all of them against a ray at once using SSE
+	when available.
+
+	Optionally the nodes can be compressed, with the children bounds
+	quantized to 8 bits relative to the bound of the node, using less
+	than half the memory of the full precision nodes at the cost of some
+	slower traversal.
+*/
+class AcceleratorBvh4 final : public Accelerator
+{
+	public:
+		static Accelerator * factory(Logger &logger, const std::vector<const Primitive *> &primitives, const ParamMap &params);
+		static constexpr int width_ = 4;
+
+	private:
+		class Node;
+		class CompressedNode;
+		struct RayData;
+		struct Stack;
+		using Bounds = std::array<std::array<std::array<float, width_>, 3>, 2>; //!< [min/max][axis][child]
+		AcceleratorBvh4(Logger &logger, const std::vector<const Primitive *> &primitives, const BvhBuilder::Parameters &parameters, bool precompute_triangles, bool compressed_nodes);
+		~AcceleratorBvh4() override;
+		AcceleratorIntersectData intersect(const Ray &ray, float t_max) const override;
+		AcceleratorIntersectData intersectS(const Ray &ray, float t_max, float shadow_bias) const override;
+		AcceleratorTsIntersectData intersectTs(const Ray &ray, int max_depth, float t_max, float shadow_bias, const Camera *camera) const override;
+		template<typename NodeType> AcceleratorIntersectData intersectNodes(const std::vector<NodeType> &nodes, const Ray &ray, float t_max) const;
+		template<typename NodeType> AcceleratorIntersectData intersectSNodes(const std::vector<NodeType> &nodes, const Ray &ray, float t_max) const;
+		template<typename NodeType> AcceleratorTsIntersectData intersectTsNodes(const std::vector<NodeType> &nodes, const Ray &ray, int max_depth, float t_max, const Camera *camera) const;
+		static int intersectBounds(const Bounds &bounds, const RayData &ray_data, float t_max, std::array<float, width_> &t_near);
+		Bound getBound() const override { return tree_bound_; }
+		size_t memoryUsed() const override;
+		uint32_t collapseTree(const std::vector<BvhBuilder::Node> &binary_nodes, uint32_t binary_node_id);
+		void compressNodes();
+		void setCompressedChild(uint32_t node_id, int child, const Bound &bound, uint32_t offset, uint32_t num_primitives);
+
+		Bound tree_bound_; 	//!< overall space the tree encloses
+		std::vector<Node> nodes_; //!< empty when the nodes are compressed
+		std::vector<CompressedNode> compressed_nodes_;
+		std::vector<const Primitive *> primitives_; //!< primitives in leaf order, leaves reference ranges of this list
+		TriangleSoup triangle_soup_; //!< optional precomputed triangles, in the same order as the primitives list
+		static constexpr int bvh_max_stack_ = width_ * BvhBuilder::max_depth_;
+};
+
+/*! Ray data prepared once per ray, replicated for each child of the node so it can be directly loaded into SIMD registers */
+struct AcceleratorBvh4::RayData
+{
+	explicit RayData(const Ray &ray);
+	alignas(16) std::array<std::array<float, width_>, 3> from_;
+	alignas(16) std::array<std::array<float, width_>, 3> inv_dir_;
+	std::array<int, 3> near_id_; //!< whether the entry plane for each axis is the min (0) or the max (1) of the bounds
+};
+
+// ============================================================
+/*! 4-wide BVH nodes, 128 bytes. Children can be other nodes or leaves,
+	leaves are not stored as separate nodes but directly in the parent */
+
+class AcceleratorBvh4::Node
+{
+	public:
+		Node();
+		void setChild(int child, const Bound &bound, uint32_t offset, uint32_t num_primitives);
+		int intersect(const RayData &ray_data, float t_max, std::array<float, width_> &t_near) const;
+		bool isLeaf(int child) const { return num_primitives_[child] > 0; }
+		bool isEmpty(int child) const { return bounds_[0][0][child] > bounds_[1][0][child]; }
+		Bound getBound(int child) const;
+		uint32_t getOffset(int child) const { return offsets_[child]; }
+		uint32_t nPrimitives(int child) const { return num_primitives_[child]; }
+
+	private:
+		alignas(16) Bounds bounds_; //!< empty children have inverted bounds so they are never hit
+		std::array<uint32_t, width_> offsets_; //!< interior child: node index, leaf child: index of its first primitive
+		std::array<uint32_t, width_> num_primitives_; //!< 0 for interior children
+};
+
+// ============================================================
+/*! Compressed 4-wide BVH nodes, 60 bytes. The children bounds are stored
+	as 8 bit integers in a grid over the bound of the node, with a power of
+	two cell size per axis so they can be decoded exactly. The quantized
+	bounds are always rounded outwards, so they can only be slightly larger
+	than the original ones. Leaves with more primitives than fit in the 8 bit
+	counters are split by the accelerator into several smaller leaves */
+
+class AcceleratorBvh4::CompressedNode
+{
+	public:
+		void setBound(const Bound &bound);
+		void setChild(int child, const Bound &bound, uint32_t offset, uint32_t num_primitives);
+		int intersect(const RayData &ray_data, float t_max, std::array<float, width_> &t_near) const;
+		bool isLeaf(int child) const { return num_primitives_[child] > 0; }
+		uint32_t getOffset(int child) const { return offsets_[child]; }
+		uint32_t nPrimitives(int child) const { return num_primitives_[child]; }
+		static constexpr uint32_t max_leaf_primitives_ = 255;
+
+	private:
+		float cellSize(int axis) const;
+		std::array<float, 3> origin_; //!< minimum corner of the node bound, origin of the quantization grid
+		std::array<int8_t, 3> cell_exponents_; //!< the grid cell size in each axis is 2^exponent
+		uint8_t child_mask_ = 0; //!< bit set for each child in use
+		std::array<std::array<std::array<uint8_t, width_>, 3>, 2> bounds_; //!< [min/max][axis][child] in grid cells from the origin
+		std::array<uint32_t, width_> offsets_; //!< interior child: node index, leaf child: index of its first primitive
+		std::array<uint8_t, width_> num_primitives_; //!< 0 for interior children
+};
+
+/*! Stack elements for the traversal, children pending to be visited */
+struct AcceleratorBvh4::Stack
+{
+	uint32_t offset_;
+	uint32_t num_primitives_;
+	float t_; //!< the entry signed distance into the child bound
+};
+
+END_YAFARAY
+#endif    //YAFARAY_ACCELERATOR_BVH4_H
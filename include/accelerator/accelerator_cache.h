@@ -0,0 +1,185 @@
+#pragma once
+/****************************************************************************
+ *      This is part of the libYafaRay package
+ *
+ *      This library is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU Lesser General Public
+ *      License as published by the Free Software Foundation; either
+ *      version 2.1 of the License, or (at your option) any later version.
+ *
+ *      This library is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *      Lesser General Public License for more details.
+ *
+ *      You should have received a copy of the GNU Lesser General Public
+ *      License along with this library; if not, write to the Free Software
+ *      Foundation,Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#ifndef YAFARAY_ACCELERATOR_CACHE_H
+#define YAFARAY_ACCELERATOR_CACHE_H
+
+#include "common/yafaray_common.h"
+#include "common/file.h"
+#include "geometry/bound.h"
+#include <array>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+BEGIN_YAFARAY
+
+class Logger;
+
+// ============================================================
+/*! Read-only array of plain elements, either owning them or using them
+	in place from a memory mapped accelerator cache file */
+template <typename T>
+class CachedArray final
+{
+	public:
+		CachedArray() = default;
+		explicit CachedArray(std::vector<T> &&elements) : elements_(std::move(elements)), data_(elements_.data()), size_(elements_.size()) { }
+		CachedArray(const std::shared_ptr<const MappedFile> &mapped_file, const T *data, size_t size) : mapped_file_(mapped_file), data_(data), size_(size)
+		{
+			static_assert(std::is_trivially_copyable<T>::value, "T must be trivially copyable to be used from cache files");
+		}
+		CachedArray(CachedArray &&cached_array) = default;
+		CachedArray &operator=(CachedArray &&cached_array) = default;
+		const T &operator[](size_t index) const { return data_[index]; }
+		const T &front() const { return data_[0]; }
+		const T *data() const { return data_; }
+		const T *begin() const { return data_; }
+		const T *end() const { return data_ + size_; }
+		size_t size() const { return size_; }
+		bool empty() const { return size_ == 0; }
+		bool isMapped() const { return mapped_file_ != nullptr; }
+		T *mutableData();
+
+	private:
+		std::vector<T> elements_; //!< elements owned by the array, empty when they are used from a mapped file
+		std::shared_ptr<const MappedFile> mapped_file_; //!< keeps the mapped file alive while the array uses it
+		const T *data_ = nullptr;
+		size_t size_ = 0;
+};
+
+/*! Copies the elements from the mapped file first if needed, so they can be modified */
+template <typename T>
+inline T *CachedArray<T>::mutableData()
+{
+	if(mapped_file_)
+	{
+		elements_.assign(data_, data_ + size_);
+		mapped_file_ = nullptr;
+		data_ = elements_.data();
+	}
+	return elements_.data();
+}
+
+// ============================================================
+/*! Persistent cache of built accelerator trees. Each cache file stores
+	the arrays of a tree (nodes, leaf primitive indices...) together with
+	a key hashing the primitives geometry and the build parameters, so
+	renders of unchanged geometry can skip the tree build entirely.
+
+	The arrays are aligned in the file, which is memory mapped when loaded
+	so the arrays can be used in place by the accelerators. Cache files
+	are not portable between platforms with different endianness.
+*/
+class AcceleratorCache final
+{
+	public:
+		class Key;
+		AcceleratorCache(Logger &logger, const std::string &directory, const std::string &accelerator_name, uint64_t key);
+		bool load();
+		template <typename T> bool getArray(size_t array_id, CachedArray<T> &array) const;
+		template <typename T> void addArray(const T *data, size_t size);
+		template <typename T> void addArray(const CachedArray<T> &array) { addArray(array.data(), array.size()); }
+		template <typename T> void addArray(const std::vector<T> &array) { addArray(array.data(), array.size()); }
+		bool save();
+		std::string getPath() const { return path_; }
+
+	private:
+		struct Header;
+		struct ArrayHeader;
+		bool getArrayData(size_t array_id, size_t element_size, size_t element_alignment, const char *&data, size_t &size) const;
+		void addArrayData(const char *data, size_t size, size_t element_size);
+		static constexpr uint32_t version_ = 1;
+		static constexpr size_t alignment_ = 64;
+
+		Logger &logger_;
+		std::string path_;
+		uint64_t key_;
+		std::shared_ptr<const MappedFile> mapped_file_;
+		std::vector<ArrayHeader> array_headers_; //!< arrays of the loaded file
+		std::vector<ArrayHeader> new_array_headers_; //!< arrays added to be saved
+		std::string new_arrays_data_;
+};
+
+/*! 64 bit FNV-1a hash of all the data a tree build depends on */
+class AcceleratorCache::Key final
+{
+	public:
+		template <typename T> void add(const T &value);
+		void add(const std::string &str) { add(str.data(), str.size()); }
+		void add(const Point3 &point) { add(point.x()); add(point.y()); add(point.z()); }
+		void add(const Bound &bound) { add(bound.a_); add(bound.g_); }
+		uint64_t get() const { return hash_; }
+
+	private:
+		void add(const char *data, size_t size);
+		uint64_t hash_ = 0xcbf29ce484222325ULL;
+};
+
+struct AcceleratorCache::Header
+{
+	std::array<char, 8> signature_;
+	uint32_t version_;
+	uint32_t num_arrays_;
+	uint64_t key_;
+};
+
+struct AcceleratorCache::ArrayHeader
+{
+	uint64_t offset_; //!< from the beginning of the file
+	uint64_t size_; //!< number of elements
+	uint64_t element_size_;
+};
+
+template <typename T>
+inline bool AcceleratorCache::getArray(size_t array_id, CachedArray<T> &array) const
+{
+	const char *data;
+	size_t size;
+	if(!getArrayData(array_id, sizeof(T), alignof(T), data, size)) return false;
+	array = CachedArray<T>(mapped_file_, reinterpret_cast<const T *>(data), size);
+	return true;
+}
+
+template <typename T>
+inline void AcceleratorCache::addArray(const T *data, size_t size)
+{
+	static_assert(std::is_trivially_copyable<T>::value, "T must be trivially copyable to be stored in cache files");
+	addArrayData(reinterpret_cast<const char *>(data), size, sizeof(T));
+}
+
+template <typename T>
+inline void AcceleratorCache::Key::add(const T &value)
+{
+	static_assert(std::is_arithmetic<T>::value, "T must be an arithmetic type, compound types must be added member by member to avoid hashing padding bytes");
+	add(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+inline void AcceleratorCache::Key::add(const char *data, size_t size)
+{
+	for(size_t byte = 0; byte < size; ++byte)
+	{
+		hash_ ^= static_cast<uint8_t>(data[byte]);
+		hash_ *= 0x100000001b3ULL;
+	}
+}
+
+END_YAFARAY
+#endif    //YAFARAY_ACCELERATOR_CACHE_H
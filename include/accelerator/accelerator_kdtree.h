@@ -39,12 +39,14 @@ struct IntersectData;
 class AcceleratorKdTree final : public Accelerator
 {
 	public:
-		static const Accelerator * factory(Logger &logger, const std::vector<const Primitive *> &primitives, const ParamMap &params);
+		static Accelerator * factory(Logger &logger, const std::vector<const Primitive *> &primitives, const ParamMap &params);
 
 	private:
 		struct Stats;
 		class Node;
 		struct Stack;
+		struct Mailbox;
+		struct MailboxStats;
 		class BoundEdge;
 		struct SplitCost;
 		class TreeBin;
@@ -57,15 +59,17 @@ class AcceleratorKdTree final : public Accelerator
 		AcceleratorTsIntersectData intersectTs(const Ray &ray, int max_depth, float t_max, float shadow_bias, const Camera *camera) const override;
 		//	bool IntersectO(const point3d_t &from, const vector3d_t &ray, float dist, Primitive **tr, float &Z) const;
 		Bound getBound() const override { return tree_bound_; }
+		size_t memoryUsed() const override;
 
 		int buildTree(uint32_t n_prims, const std::vector<const Primitive *> &original_primitives, const Bound &node_bound, uint32_t *prim_nums, uint32_t *left_prims, uint32_t *right_prims, const std::array<std::unique_ptr<BoundEdge[]>, 3> &edges, uint32_t right_mem_size, int depth, int bad_refines);
 
 		static SplitCost pigeonMinCost(Logger &logger, float e_bonus, float cost_ratio, uint32_t n_prims, const Bound *all_bounds, const Bound &node_bound, const uint32_t *prim_idx);
 		static SplitCost minimalCost(Logger &logger, float e_bonus, float cost_ratio, uint32_t n_prims, const Bound &node_bound, const uint32_t *prim_idx, const Bound *all_bounds, const Bound *all_bounds_general, const std::array<std::unique_ptr<BoundEdge[]>, 3> &edges, Stats &kd_stats);
 
-		static AcceleratorIntersectData intersect(const Ray &ray, float t_max, const Node *nodes, const Bound &tree_bound);
-		static AcceleratorIntersectData intersectS(const Ray &ray, float t_max, float shadow_bias, const Node *nodes, const Bound &tree_bound);
-		static AcceleratorTsIntersectData intersectTs(const Ray &ray, int max_depth, float t_max, float shadow_bias, const Node *nodes, const Bound &tree_bound, const Camera *camera);
+		static AcceleratorIntersectData intersect(const Ray &ray, float t_max, const Node *nodes, const Bound &tree_bound, Mailbox &mailbox);
+		static AcceleratorIntersectData intersectS(const Ray &ray, float t_max, float shadow_bias, const Node *nodes, const Bound &tree_bound, Mailbox &mailbox);
+		static AcceleratorTsIntersectData intersectTs(const Ray &ray, int max_depth, float t_max, float shadow_bias, const Node *nodes, const Bound &tree_bound, const Camera *camera, Mailbox &mailbox);
+		void addMailboxStats(const Mailbox &mailbox) const;
 
 		float cost_ratio_ = 0.8f; //!< node traversal cost divided by primitive intersection cost
 		float e_bonus_ = 0.33f; //!< empty bonus
@@ -95,10 +99,13 @@ class AcceleratorKdTree final : public Accelerator
 			int depth_limit_reached_ = 0;
 			int num_bad_splits_ = 0;
 		} kd_stats_;
+		mutable std::atomic<uint64_t> num_primitive_tests_ { 0 }; //!< primitive intersection tests done in the traversals
+		mutable std::atomic<uint64_t> num_mailbox_skips_ { 0 }; //!< repeated primitive intersection tests skipped by the mailbox
 
 		static constexpr int prim_clip_thresh_ = 32;
 		static constexpr int pigeonhole_sort_thresh_ = 128;
 		static constexpr int kd_max_stack_ = 64;
+		static constexpr int mailbox_size_ = 8; //!< must be a power of 2
 };
 
 // ============================================================
@@ -136,6 +143,26 @@ struct AcceleratorKdTree::Stack
 	int prev_stack_idx_; //!< the pointer to the previous stack item
 };
 
+/*! Per-ray ring of the last primitives tested. Primitives overlapping several leaves are found
+	again in the next leaves along the ray, where testing them again would give the same result */
+struct AcceleratorKdTree::Mailbox
+{
+	bool tested(const Primitive *primitive);
+	std::array<const Primitive *, mailbox_size_> primitives_ {};
+	int next_ = 0;
+	uint32_t num_tests_ = 0;
+	uint32_t num_skips_ = 0;
+};
+
+/*! Mailbox statistics of each thread, added to the accelerator totals in batches */
+struct AcceleratorKdTree::MailboxStats
+{
+	uint64_t accelerator_id_ = 0;
+	uint32_t num_tests_ = 0;
+	uint32_t num_skips_ = 0;
+	static constexpr uint32_t stats_batch_size_ = 4096;
+};
+
 /*! Serves to store the lower and upper bound edges of the primitives
 	for the cost funtion */
 
@@ -175,6 +202,23 @@ class AcceleratorKdTree::TreeBin
 		float t_ = 0.f;
 };
 
+/*! Returns true if the primitive was already tested for this ray, otherwise adds it to the mailbox */
+inline bool AcceleratorKdTree::Mailbox::tested(const Primitive *primitive)
+{
+	for(const Primitive *tested_primitive : primitives_)
+	{
+		if(tested_primitive == primitive)
+		{
+			++num_skips_;
+			return true;
+		}
+	}
+	primitives_[next_] = primitive;
+	next_ = (next_ + 1) & (mailbox_size_ - 1);
+	++num_tests_;
+	return false;
+}
+
 inline void AcceleratorKdTree::Node::createLeaf(const uint32_t *prim_idx, int np, const std::vector<const Primitive *> &prims, MemoryArena &arena, AcceleratorKdTree::Stats &kd_stats) {
 	primitives_ = nullptr;
 	flags_ = np << 2;
@@ -23,8 +23,10 @@
 #include "accelerator/accelerator.h"
 #include "geometry/bound.h"
 #include "geometry/primitive/primitive.h"
+#include "accelerator/triangle_soup.h"
+#include "accelerator/accelerator_cache.h"
+#include "common/task_pool.h"
 #include <array>
-#include <atomic>
 
 BEGIN_YAFARAY
 
@@ -39,7 +41,7 @@ struct IntersectData;
 class AcceleratorKdTreeMultiThread final : public Accelerator
 {
 	public:
-		static const Accelerator * factory(Logger &logger, const std::vector<const Primitive *> &primitives, const ParamMap &params);
+		static Accelerator * factory(Logger &logger, const std::vector<const Primitive *> &primitives, const ParamMap &params);
 
 	private:
 		struct Parameters;
@@ -56,18 +58,20 @@ class AcceleratorKdTreeMultiThread final : public Accelerator
 		AcceleratorIntersectData intersectS(const Ray &ray, float t_max, float shadow_bias) const override;
 		AcceleratorTsIntersectData intersectTs(const Ray &ray, int max_depth, float t_max, float shadow_bias, const Camera *camera) const override;
 		Bound getBound() const override { return tree_bound_; }
+		size_t memoryUsed() const override;
 
-		AcceleratorKdTreeMultiThread::Result buildTree(const std::vector<const Primitive *> &primitives, const Bound &node_bound, const std::vector<uint32_t> &indices, int depth, uint32_t next_node_id, int bad_refines, const std::vector<Bound> &bounds, const Parameters &parameters, const ClipPlane &clip_plane, const std::vector<PolyDouble> &polygons, const std::vector<uint32_t> &primitive_indices, std::atomic<int> &num_current_threads) const;
-		void buildTreeWorker(const std::vector<const Primitive *> &primitives, const Bound &node_bound, const std::vector<uint32_t> &indices, int depth, uint32_t next_node_id, int bad_refines, const std::vector<Bound> &bounds, const Parameters &parameters, const ClipPlane &clip_plane, const std::vector<PolyDouble> &polygons, const std::vector<uint32_t> &primitive_indices, Result &result, std::atomic<int> &num_current_threads) const;
+		void buildTreeWorker(const std::vector<const Primitive *> &primitives, const Bound &node_bound, const std::vector<uint32_t> &indices, int depth, uint32_t next_node_id, int bad_refines, const std::vector<Bound> &bounds, const Parameters &parameters, const ClipPlane &clip_plane, const std::vector<PolyDouble> &polygons, const std::vector<uint32_t> &primitive_indices, Result &result, TaskPool &task_pool) const;
+		static bool validTree(const CachedArray<Node> &nodes, const CachedArray<uint32_t> &leaf_prim_indices, uint32_t num_primitives);
 		static SplitCost pigeonMinCost(Logger &logger, float e_bonus, float cost_ratio, const std::vector<Bound> &bounds, const Bound &node_bound, const std::vector<uint32_t> &prim_indices);
 		static SplitCost minimalCost(Logger &logger, float e_bonus, float cost_ratio, const Bound &node_bound, const std::vector<uint32_t> &indices, const std::vector<Bound> &bounds);
-		static AcceleratorIntersectData intersect(const Ray &ray, float t_max, const std::vector<Node> &nodes, const Bound &tree_bound);
-		static AcceleratorIntersectData intersectS(const Ray &ray, float t_max, float shadow_bias, const std::vector<Node> &nodes, const Bound &tree_bound);
-		static AcceleratorTsIntersectData intersectTs(const Ray &ray, int max_depth, float t_max, float, const std::vector<Node> &nodes, const Bound &tree_bound, const Camera *camera);
+		static AcceleratorIntersectData intersect(const Ray &ray, float t_max, const CachedArray<Node> &nodes, const std::vector<const Primitive *> &primitives, const TriangleSoup &triangle_soup, const Bound &tree_bound);
+		static AcceleratorIntersectData intersectS(const Ray &ray, float t_max, float shadow_bias, const CachedArray<Node> &nodes, const std::vector<const Primitive *> &primitives, const TriangleSoup &triangle_soup, const Bound &tree_bound);
+		static AcceleratorTsIntersectData intersectTs(const Ray &ray, int max_depth, float t_max, float, const CachedArray<Node> &nodes, const std::vector<const Primitive *> &primitives, const TriangleSoup &triangle_soup, const Bound &tree_bound, const Camera *camera);
 
 		Bound tree_bound_; 	//!< overall space the tree encloses
-		std::vector<Node> nodes_;
-		std::atomic<int> num_current_threads_ { 0 };
+		CachedArray<Node> nodes_; //!< built or used in place from a mapped cache file
+		std::vector<const Primitive *> primitives_; //!< primitives of all the leaves, each leaf references a contiguous range of this list
+		TriangleSoup triangle_soup_; //!< optional precomputed triangles, in the same order as the primitives list
 		static constexpr int kd_max_stack_ = 64;
 };
 
@@ -78,7 +82,9 @@ struct AcceleratorKdTreeMultiThread::Parameters
 	float cost_ratio_ = 0.8f; //!< node traversal cost divided by primitive intersection cost
 	float empty_bonus_ = 0.33f;
 	int num_threads_ = 1;
-	int min_indices_to_spawn_threads_ = 10000; //Only spawn threaded subtree building when the number of indices in the subtree is higher than this value to prevent slowdown due to very small subtree left indices
+	bool precompute_triangles_ = false; //!< store precomputed triangle intersection data, faster but using more memory
+	int min_indices_to_spawn_threads_ = 10000; //Only build subtrees as separate tasks when the number of indices in the subtree is higher than this value to prevent slowdown due to very small subtree left indices
+	std::string cache_directory_; //!< if not empty, built trees are saved to and loaded from cache files in this directory
 };
 
 struct AcceleratorKdTreeMultiThread::Stats
@@ -98,24 +104,31 @@ struct AcceleratorKdTreeMultiThread::Stats
 };
 
 // ============================================================
-/*! kd-tree nodes, kept as small as possible
-    double precision float and/or 64 bit system: 12bytes
-    else 8 bytes */
+/*! kd-tree nodes, kept as small as possible: 8 bytes.
+	Leaves do not own their primitives, they reference a range of
+	the contiguous tree primitives list instead */
 
 class AcceleratorKdTreeMultiThread::Node
 {
 	public:
-		Stats createLeaf(const std::vector<uint32_t> &prim_indices, const std::vector<const Primitive *> &primitives);
+		Stats createLeaf(const std::vector<uint32_t> &prim_indices, const std::vector<const Primitive *> &primitives, std::vector<const Primitive *> &leaf_primitives);
 		Stats createInterior(Axis axis, float d);
 		float splitPos() const { return division_; }
 		int splitAxis() const { return flags_ & 3; }
-		int nPrimitives() const { return primitives_.size(); /*flags_ >> 2; */ }
+		uint32_t nPrimitives() const { return flags_ >> 2; }
 		bool isLeaf() const { return (flags_ & 3) == 3; }
 		uint32_t getRightChild() const { return (flags_ >> 2); }
 		void setRightChild(uint32_t i) { flags_ = (flags_ & 3) | (i << 2); }
-		float division_; //!< interior: division plane position
-		std::vector<const Primitive *> primitives_; //!< leaf: list of primitives
-		uint32_t flags_; //!< 2bits: isLeaf, axis; 30bits: nprims (leaf) or index of right child
+		uint32_t getPrimitivesOffset() const { return primitives_offset_; }
+		void setPrimitivesOffset(uint32_t primitives_offset) { primitives_offset_ = primitives_offset; }
+
+	private:
+		union
+		{
+			float division_; //!< interior: division plane position
+			uint32_t primitives_offset_; //!< leaf: index of the first leaf primitive in the tree primitives list
+		};
+		uint32_t flags_ = 0; //!< 2bits: isLeaf, axis; 30bits: nprims (leaf) or index of right child
 };
 
 /*! Stack elements for the custom stack of the recursive traversal */
@@ -171,20 +184,20 @@ struct AcceleratorKdTreeMultiThread::Result
 {
 	Stats stats_;
 	std::vector<Node> nodes_;
+	std::vector<const Primitive *> primitives_; //!< leaf primitives, with the leaves primitives offsets relative to this list
 };
 
 
-inline AcceleratorKdTreeMultiThread::Stats AcceleratorKdTreeMultiThread::Node::createLeaf(const std::vector<uint32_t> &prim_indices, const std::vector<const Primitive *> &primitives)
+inline AcceleratorKdTreeMultiThread::Stats AcceleratorKdTreeMultiThread::Node::createLeaf(const std::vector<uint32_t> &prim_indices, const std::vector<const Primitive *> &primitives, std::vector<const Primitive *> &leaf_primitives)
 {
 	const uint32_t num_prim_indices = prim_indices.size();
 	AcceleratorKdTreeMultiThread::Stats kd_stats;
-	primitives_.clear();
-	//flags_ = num_prim_indices << 2;
+	primitives_offset_ = static_cast<uint32_t>(leaf_primitives.size());
+	flags_ = num_prim_indices << 2;
 	flags_ |= 3;
 	if(num_prim_indices >= 1)
 	{
-		primitives_.reserve(num_prim_indices);
-		for(const auto &prim_id : prim_indices) primitives_.emplace_back(primitives[prim_id]);
+		for(const auto &prim_id : prim_indices) leaf_primitives.emplace_back(primitives[prim_id]);
 		kd_stats.kd_prims_ += num_prim_indices; //stat
 	}
 	else kd_stats.empty_kd_leaves_++; //stat
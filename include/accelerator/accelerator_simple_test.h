@@ -36,7 +36,7 @@ class AcceleratorSimpleTest final : Accelerator
 			Bound bound_;
 			std::vector<const Primitive *> primitives_;
 		};
-		static const Accelerator * factory(Logger &logger, const std::vector<const Primitive *> &primitives, const ParamMap &params);
+		static Accelerator * factory(Logger &logger, const std::vector<const Primitive *> &primitives, const ParamMap &params);
 
 	private:
 		AcceleratorSimpleTest(Logger &logger, const std::vector<const Primitive *> &primitives);
@@ -44,6 +44,7 @@ class AcceleratorSimpleTest final : Accelerator
 		AcceleratorIntersectData intersectS(const Ray &ray, float t_max, float shadow_bias) const override;
 		AcceleratorTsIntersectData intersectTs(const Ray &ray, int max_depth, float dist, float shadow_bias, const Camera *camera) const override;
 		Bound getBound() const override { return bound_; }
+		size_t memoryUsed() const override;
 		const std::vector<const Primitive *> &primitives_;
 		std::map<const Object *, ObjectData> objects_data_;
 		Bound bound_;
@@ -0,0 +1,104 @@
+#pragma once
+/****************************************************************************
+ *      This is part of the libYafaRay package
+ *
+ *      This library is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU Lesser General Public
+ *      License as published by the Free Software Foundation; either
+ *      version 2.1 of the License, or (at your option) any later version.
+ *
+ *      This library is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *      Lesser General Public License for more details.
+ *
+ *      You should have received a copy of the GNU Lesser General Public
+ *      License along with this library; if not, write to the Free Software
+ *      Foundation,Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#ifndef YAFARAY_ACCELERATOR_TWO_LEVEL_H
+#define YAFARAY_ACCELERATOR_TWO_LEVEL_H
+
+#include "accelerator/accelerator.h"
+#include "accelerator/bvh_builder.h"
+#include "geometry/matrix4.h"
+
+BEGIN_YAFARAY
+
+class Object;
+
+// ============================================================
+/*! Two-level acceleration structure for scenes with instances. Each
+	instanced base object gets its own bottom-level accelerator, built
+	only once over the base object primitives. A top-level BVH over the
+	instances world bounds transforms the rays into the object space of
+	each instance to traverse its base object accelerator. The primitives
+	not belonging to instances are kept in a separate accelerator.
+
+	This way memory and build time scale with the unique geometry and not
+	with the number of instances. Note that the transparent shadows of
+	instances are evaluated by the bottom-level accelerators in object space.
+*/
+class AcceleratorTwoLevel final : public Accelerator
+{
+	public:
+		static Accelerator * factory(Logger &logger, const std::vector<const Primitive *> &primitives, const std::vector<const Object *> &instances, const ParamMap &params);
+
+	private:
+		struct Instance;
+		AcceleratorTwoLevel(Logger &logger, const std::vector<const Primitive *> &primitives, const std::vector<const Object *> &instances, const ParamMap &params);
+		~AcceleratorTwoLevel() override;
+		AcceleratorIntersectData intersect(const Ray &ray, float t_max) const override;
+		AcceleratorIntersectData intersectS(const Ray &ray, float t_max, float shadow_bias) const override;
+		AcceleratorTsIntersectData intersectTs(const Ray &ray, int max_depth, float t_max, float shadow_bias, const Camera *camera) const override;
+		Bound getBound() const override { return tree_bound_; }
+		size_t memoryUsed() const override;
+		bool refit(int num_threads) override;
+		void updateTreeBound();
+		void buildMotionBounds();
+
+		Bound tree_bound_; 	//!< overall space the tree encloses
+		std::unique_ptr<Accelerator> primitives_accelerator_; //!< accelerator for the primitives not belonging to instances, if any
+		std::vector<std::unique_ptr<Accelerator>> base_objects_accelerators_; //!< bottom-level accelerators, one per instanced base object
+		std::vector<BvhBuilder::Node> nodes_; //!< top-level BVH over the instances
+		BvhBuilder::MotionBounds motion_bounds_; //!< top-level node bounds in the motion blur time steps, only if any instance moves
+		std::vector<Instance> instances_; //!< instances in leaf order, leaves reference ranges of this list
+};
+
+struct AcceleratorTwoLevel::Instance
+{
+	Ray objectRay(const Ray &ray, float &distance_scale) const;
+	static Ray objectRay(const Ray &ray, const Matrix4 &world_to_obj, float &distance_scale);
+	Bound worldBound() const;
+	Bound worldBound(int time_step) const;
+	const Accelerator *accelerator_;
+	const Matrix4 *obj_to_world_; //!< one matrix per motion blur time step
+	int num_time_steps_;
+	Matrix4 world_to_obj_; //!< inverse of the first time step matrix
+};
+
+/*! Transforms the ray into the instance object space. The transformation of moving instances
+	is interpolated at the ray time and inverted for each ray */
+inline Ray AcceleratorTwoLevel::Instance::objectRay(const Ray &ray, float &distance_scale) const
+{
+	if(num_time_steps_ > 1)
+	{
+		Matrix4 world_to_obj {Matrix4::interpolate(obj_to_world_, num_time_steps_, ray.time_)};
+		world_to_obj.inverse();
+		return objectRay(ray, world_to_obj, distance_scale);
+	}
+	return objectRay(ray, world_to_obj_, distance_scale);
+}
+
+/*! The direction is normalized again, so the object space distances along the
+	ray are the world space distances multiplied by "distance_scale" */
+inline Ray AcceleratorTwoLevel::Instance::objectRay(const Ray &ray, const Matrix4 &world_to_obj, float &distance_scale)
+{
+	Vec3 dir {world_to_obj * ray.dir_};
+	distance_scale = dir.normLen();
+	return {world_to_obj * ray.from_, dir, ray.tmin_ * distance_scale, (ray.tmax_ >= 0.f) ? ray.tmax_ * distance_scale : ray.tmax_, ray.time_};
+}
+
+END_YAFARAY
+#endif    //YAFARAY_ACCELERATOR_TWO_LEVEL_H
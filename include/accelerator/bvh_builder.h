@@ -0,0 +1,205 @@
+#pragma once
+/****************************************************************************
+ *      This is part of the libYafaRay package
+ *
+ *      This library is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU Lesser General Public
+ *      License as published by the Free Software Foundation; either
+ *      version 2.1 of the License, or (at your option) any later version.
+ *
+ *      This library is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *      Lesser General Public License for more details.
+ *
+ *      You should have received a copy of the GNU Lesser General Public
+ *      License along with this library; if not, write to the Free Software
+ *      Foundation,Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#ifndef YAFARAY_BVH_BUILDER_H
+#define YAFARAY_BVH_BUILDER_H
+
+#include "geometry/bound.h"
+#include "geometry/axis.h"
+#include "math/interpolation.h"
+#include <array>
+#include <atomic>
+#include <functional>
+#include <vector>
+
+BEGIN_YAFARAY
+
+class Logger;
+class TaskPool;
+
+// ============================================================
+/*! Builds a binary Bounding Volume Hierarchy over a list of primitive
+	bounds using a binned SAH (Surface Area Heuristic) cost function.
+	Subtrees are built in parallel as tasks of a work-stealing task pool. The resulting binary tree is used
+	directly by the BVH accelerator or collapsed into wider trees.
+*/
+class BvhBuilder final
+{
+	public:
+		struct Parameters;
+		struct Stats;
+		class Node;
+		class MotionBounds;
+		struct Result;
+		BvhBuilder(const std::vector<Bound> &bounds, const Parameters &parameters);
+		Result build();
+		static float halfArea(const Bound &bound);
+		static float intersectBound(const Bound &bound, const Point3 &from, const Vec3 &inv_dir, float t_max);
+		static void refit(Node *nodes, const std::function<Bound(uint32_t prim_num)> &primitive_bound, int num_threads);
+		static constexpr int max_depth_ = 64;
+		static constexpr int max_bins_ = 32;
+		static constexpr int refit_tasks_max_depth_ = 10; //!< subtrees below this depth are refit in the same task as their parent
+
+	private:
+		struct Bin;
+		struct SplitCost;
+		void buildTreeWorker(uint32_t node_id, uint32_t index_begin, uint32_t index_end, int depth, TaskPool &task_pool, Stats &stats);
+		static Bound refitWorker(Node *nodes, uint32_t node_id, int depth, const std::function<Bound(uint32_t prim_num)> &primitive_bound, TaskPool &task_pool);
+		SplitCost binnedMinCost(const Bound &node_bound, const Bound &centroid_bound, uint32_t index_begin, uint32_t index_end) const;
+
+		const std::vector<Bound> &bounds_;
+		const Parameters &parameters_;
+		std::vector<Point3> centroids_;
+		std::vector<Node> nodes_;
+		std::vector<uint32_t> prim_indices_;
+		std::atomic<uint32_t> num_nodes_ { 0 };
+};
+
+struct BvhBuilder::Parameters
+{
+	enum class Method : unsigned char { BinnedSah, Linear, Spatial };
+	Method method_ = Method::BinnedSah; //!< Linear: Morton codes LBVH built by LbvhBuilder, much faster build but slower traversal. Spatial: SBVH built by SbvhBuilder, slower build but faster traversal
+	int treelet_passes_ = 1; //!< Linear method only: treelet reoptimization passes over the tree, 0 for the fastest build
+	float spatial_split_budget_ = 0.3f; //!< Spatial method only: maximum number of references duplicated by spatial splits, relative to the number of primitives
+	int max_leaf_size_ = 4; //!< leaves are only forced to split above this size, below it the SAH decides
+	int num_bins_ = 16;
+	float cost_ratio_ = 1.f; //!< node traversal cost divided by primitive intersection cost
+	int num_threads_ = 1;
+	int min_indices_to_spawn_threads_ = 10000; //!< both children of a split are built as separate tasks only when each of them has at least this many primitive indices
+};
+
+struct BvhBuilder::Stats
+{
+	void outputLog(Logger &logger, uint32_t num_primitives, size_t num_nodes, size_t memory_bytes) const;
+	Stats operator += (const Stats &bvh_stats);
+	int bvh_inodes_ = 0;
+	int bvh_leaves_ = 0;
+	int bvh_prims_ = 0;
+	int max_depth_ = 0;
+	int depth_limit_reached_ = 0;
+	int num_degenerate_leaves_ = 0; //!< leaves bigger than the max leaf size because all primitive centroids were coincident
+	int spatial_splits_ = 0;
+	int duplicated_references_ = 0; //!< additional primitive references created by the spatial splits
+};
+
+// ============================================================
+/*! Binary BVH nodes, 32 bytes. Both children of an interior node are
+	stored next to each other so only one index is needed */
+
+class BvhBuilder::Node
+{
+	public:
+		void createLeaf(const Bound &bound, uint32_t primitives_offset, uint32_t num_primitives) { bound_ = bound; offset_ = primitives_offset; num_primitives_ = num_primitives; }
+		void createInterior(const Bound &bound, uint32_t left_child) { bound_ = bound; offset_ = left_child; num_primitives_ = 0; }
+		bool isLeaf() const { return num_primitives_ > 0; }
+		uint32_t getLeftChild() const { return offset_; }
+		uint32_t getRightChild() const { return offset_ + 1; }
+		uint32_t getPrimitivesOffset() const { return offset_; }
+		uint32_t nPrimitives() const { return num_primitives_; }
+		const Bound &getBound() const { return bound_; }
+		void setBound(const Bound &bound) { bound_ = bound; }
+		float intersect(const Point3 &from, const Vec3 &inv_dir, float t_max) const;
+
+	private:
+		Bound bound_;
+		uint32_t offset_; //!< interior: index of left child (right child follows it), leaf: index of first primitive
+		uint32_t num_primitives_; //!< 0 for interior nodes
+};
+
+// ============================================================
+/*! Bounds of the nodes in each motion blur time step, uniformly distributed in
+	the frame time [0;1]. The nodes are tested against their bounds interpolated
+	between the two time steps enclosing the ray time, which still enclose the
+	primitives as long as they move linearly between time steps. The tree itself
+	is built over the bounds enclosing the primitives during the whole frame time */
+class BvhBuilder::MotionBounds
+{
+	public:
+		MotionBounds() = default;
+		MotionBounds(const Node *nodes, size_t num_nodes, int num_time_steps, const std::function<Bound(uint32_t prim_num, int time_step)> &primitive_bound);
+		bool empty() const { return bounds_.empty(); }
+		int numTimeSteps() const { return num_time_steps_; }
+		size_t memoryUsed() const { return bounds_.size() * sizeof(Bound); }
+		float intersect(uint32_t node_id, const Point3 &from, const Vec3 &inv_dir, float t_max, float time) const;
+
+	private:
+		int num_time_steps_ = 1;
+		std::vector<Bound> bounds_; //!< bounds of each node in all the time steps, consecutively
+};
+
+struct BvhBuilder::Result
+{
+	Stats stats_;
+	std::vector<Node> nodes_; //!< the root is the first node
+	std::vector<uint32_t> prim_indices_; //!< primitive indices in leaf order, leaves reference ranges of this list
+};
+
+struct BvhBuilder::Bin
+{
+	Bound bound_ {{std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max()}, {std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest()}};
+	uint32_t num_primitives_ = 0;
+};
+
+struct BvhBuilder::SplitCost
+{
+	int axis_ = Axis::None;
+	int bin_ = -1; //!< primitives with centroids in bins below this one go to the left child
+	float cost_ = std::numeric_limits<float>::infinity();
+};
+
+inline float BvhBuilder::Node::intersect(const Point3 &from, const Vec3 &inv_dir, float t_max) const
+{
+	return intersectBound(bound_, from, inv_dir, t_max);
+}
+
+inline float BvhBuilder::MotionBounds::intersect(uint32_t node_id, const Point3 &from, const Vec3 &inv_dir, float t_max, float time) const
+{
+	float segment_time;
+	const int time_step = math::uniformSegment(time, num_time_steps_, segment_time);
+	const Bound *time_step_bounds = &bounds_[node_id * num_time_steps_ + time_step];
+	const Bound bound {math::lerp(time_step_bounds[0].a_, time_step_bounds[1].a_, segment_time), math::lerp(time_step_bounds[0].g_, time_step_bounds[1].g_, segment_time)};
+	return intersectBound(bound, from, inv_dir, t_max);
+}
+
+/*! Slabs test against a node bound, returns the entry distance or infinity if the node is missed */
+inline float BvhBuilder::intersectBound(const Bound &bound, const Point3 &from, const Vec3 &inv_dir, float t_max)
+{
+	float t_near = 0.f;
+	float t_far = t_max;
+	for(int axis = 0; axis < 3; ++axis)
+	{
+		float t_0 = (bound.a_[axis] - from[axis]) * inv_dir[axis];
+		float t_1 = (bound.g_[axis] - from[axis]) * inv_dir[axis];
+		if(t_0 > t_1) std::swap(t_0, t_1);
+		t_1 *= 1.00000024f; //conservative rounding so rays grazing shared faces of adjacent bounds are not lost
+		if(t_0 > t_near) t_near = t_0;
+		if(t_1 < t_far) t_far = t_1;
+		if(t_near > t_far) return std::numeric_limits<float>::infinity();
+	}
+	return t_near;
+}
+
+inline float BvhBuilder::halfArea(const Bound &bound)
+{
+	const float x = bound.longX(), y = bound.longY(), z = bound.longZ();
+	return x * y + y * z + z * x;
+}
+
+END_YAFARAY
+#endif    //YAFARAY_BVH_BUILDER_H
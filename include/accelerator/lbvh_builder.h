@@ -0,0 +1,94 @@
+#pragma once
+/****************************************************************************
+ *      This is part of the libYafaRay package
+ *
+ *      This library is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU Lesser General Public
+ *      License as published by the Free Software Foundation; either
+ *      version 2.1 of the License, or (at your option) any later version.
+ *
+ *      This library is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *      Lesser General Public License for more details.
+ *
+ *      You should have received a copy of the GNU Lesser General Public
+ *      License along with this library; if not, write to the Free Software
+ *      Foundation,Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#ifndef YAFARAY_LBVH_BUILDER_H
+#define YAFARAY_LBVH_BUILDER_H
+
+#include "accelerator/bvh_builder.h"
+#include <algorithm>
+
+BEGIN_YAFARAY
+
+// ============================================================
+/*! Builds a Linear BVH (LBVH) for fast preview renders: the primitives
+	are sorted along a Morton (Z-order) curve of their centroids with a
+	parallel radix sort, and the tree is made of the splits between the
+	sorted Morton codes, without evaluating any cost function. The tree
+	quality can then be improved by optimizing the topology of small
+	treelets with the SAH, as in Karras and Aila "Fast Parallel
+	Construction of High-Quality Bounding Volume Hierarchies" (2013).
+	The resulting tree uses the same nodes as BvhBuilder.
+*/
+class LbvhBuilder final
+{
+	public:
+		LbvhBuilder(const std::vector<Bound> &bounds, const BvhBuilder::Parameters &parameters);
+		BvhBuilder::Result build();
+		static uint32_t mortonCode(const Point3 &point, const Bound &bound);
+		static constexpr int morton_bits_ = 30; //!< 10 bits per axis
+		static constexpr int radix_bits_ = 8;
+		static constexpr int treelet_max_leaves_ = 7;
+
+	private:
+		using Node = BvhBuilder::Node;
+		void computeMortonCodes(TaskPool &task_pool);
+		void radixSort(TaskPool &task_pool);
+		Bound buildTreeWorker(uint32_t node_id, uint32_t index_begin, uint32_t index_end, int bit, int depth, TaskPool &task_pool, BvhBuilder::Stats &stats);
+		void optimizeTreeletsWorker(uint32_t node_id, int depth, TaskPool &task_pool);
+		void optimizeTreelet(uint32_t node_id, int depth);
+		void compactTree(BvhBuilder::Result &result) const;
+		int numChunks(const TaskPool &task_pool, uint32_t size) const;
+		static uint32_t expandBits(uint32_t value);
+		static void parallelFor(TaskPool &task_pool, uint32_t size, int num_chunks, const std::function<void(uint32_t begin, uint32_t end, int chunk)> &function);
+
+		const std::vector<Bound> &bounds_;
+		const BvhBuilder::Parameters &parameters_;
+		std::vector<uint32_t> morton_codes_;
+		std::vector<uint32_t> prim_indices_;
+		std::vector<Node> nodes_;
+		std::vector<uint8_t> heights_; //!< height of the subtree of each node, to keep the tree depth within the traversal stacks size
+		std::atomic<uint32_t> num_nodes_ { 0 };
+};
+
+/*! Inserts two zero bits after each of the 10 lowest bits of the value */
+inline uint32_t LbvhBuilder::expandBits(uint32_t value)
+{
+	value = (value * 0x00010001u) & 0xFF0000FFu;
+	value = (value * 0x00000101u) & 0x0F00F00Fu;
+	value = (value * 0x00000011u) & 0xC30C30C3u;
+	value = (value * 0x00000005u) & 0x49249249u;
+	return value;
+}
+
+/*! 30 bits Morton code of a point, with its coordinates quantized to 10 bits within the bound */
+inline uint32_t LbvhBuilder::mortonCode(const Point3 &point, const Bound &bound)
+{
+	uint32_t code = 0;
+	for(int axis = 0; axis < 3; ++axis)
+	{
+		const float extent = bound.g_[axis] - bound.a_[axis];
+		const float relative = extent > 0.f ? (point[axis] - bound.a_[axis]) / extent : 0.f;
+		const auto quantized = static_cast<uint32_t>(std::min(std::max(relative * 1024.f, 0.f), 1023.f));
+		code |= expandBits(quantized) << (2 - axis);
+	}
+	return code;
+}
+
+END_YAFARAY
+#endif    //YAFARAY_LBVH_BUILDER_H
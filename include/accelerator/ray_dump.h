@@ -0,0 +1,92 @@
+#pragma once
+/****************************************************************************
+ *      This is part of the libYafaRay package
+ *
+ *      This library is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU Lesser General Public
+ *      License as published by the Free Software Foundation; either
+ *      version 2.1 of the License, or (at your option) any later version.
+ *
+ *      This library is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *      Lesser General Public License for more details.
+ *
+ *      You should have received a copy of the GNU Lesser General Public
+ *      License along with this library; if not, write to the Free Software
+ *      Foundation,Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#ifndef YAFARAY_RAY_DUMP_H
+#define YAFARAY_RAY_DUMP_H
+
+#include "common/yafaray_common.h"
+#include "geometry/ray.h"
+#include <array>
+#include <atomic>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+BEGIN_YAFARAY
+
+class Logger;
+
+// ============================================================
+/*! Records the accelerator queries of a render into a binary file, so
+	they can be replayed later against the different accelerators with
+	the AcceleratorBenchmark, measuring them in isolation.
+
+	The file has a small header followed by the query records, as they
+	are in memory (so it is only portable between systems with the same
+	endianness). Each thread collects its records in its own buffer,
+	which is written to the file when full and when the dump is flushed.
+*/
+class RayDump final
+{
+	public:
+		enum class Query : uint32_t { ClosestHit, Shadow, TransparentShadow };
+		struct Record;
+		static std::unique_ptr<RayDump> create(Logger &logger, const std::string &file_path);
+		static bool load(Logger &logger, const std::string &file_path, std::vector<Record> &records);
+		~RayDump();
+		void record(Query query, const Ray &ray, float t_max, float shadow_bias = 0.f, int max_depth = 0);
+		/*! Writes the records of all the threads. The other threads must not be recording meanwhile */
+		void flush();
+		static constexpr uint32_t version_ = 1;
+		static constexpr size_t buffer_size_ = 4096; //!< records kept by each thread before writing them to the file
+
+	private:
+		struct Header;
+		RayDump(Logger &logger, const std::string &file_path);
+		std::vector<Record> &threadBuffer();
+		void write(std::vector<Record> &records);
+
+		Logger &logger_;
+		const std::string file_path_;
+		const uint64_t id_; //!< unique for every ray dump created, so the per-thread buffers of a previous dump are never used
+		std::ofstream file_;
+		std::mutex mutex_;
+		std::vector<std::unique_ptr<std::vector<Record>>> thread_buffers_;
+		uint64_t num_records_ = 0;
+};
+
+struct RayDump::Record
+{
+	Ray ray() const { return {{from_[0], from_[1], from_[2]}, {dir_[0], dir_[1], dir_[2]}, tmin_, tmax_, time_}; }
+	Query query_;
+	int32_t max_depth_; //!< transparent shadow queries only
+	std::array<float, 3> from_;
+	std::array<float, 3> dir_;
+	float tmin_;
+	float tmax_;
+	float time_;
+	float t_max_; //!< maximum distance given to the accelerator query
+	float shadow_bias_;
+};
+
+END_YAFARAY
+
+#endif //YAFARAY_RAY_DUMP_H
@@ -0,0 +1,109 @@
+#pragma once
+/****************************************************************************
+ *      This is part of the libYafaRay package
+ *
+ *      This library is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU Lesser General Public
+ *      License as published by the Free Software Foundation; either
+ *      version 2.1 of the License, or (at your option) any later version.
+ *
+ *      This library is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *      Lesser General Public License for more details.
+ *
+ *      You should have received a copy of the GNU Lesser General Public
+ *      License along with this library; if not, write to the Free Software
+ *      Foundation,Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#ifndef YAFARAY_SBVH_BUILDER_H
+#define YAFARAY_SBVH_BUILDER_H
+
+#include "accelerator/bvh_builder.h"
+
+BEGIN_YAFARAY
+
+// ============================================================
+/*! Builds a Spatial split BVH (SBVH), as in Stich et al. "Spatial Splits
+	in Bounding Volume Hierarchies" (2009). Besides the binned SAH object
+	splits of BvhBuilder, nodes where the children bounds of the best
+	object split overlap can be split by a plane, like in the kd-tree,
+	with the primitives crossing the plane referenced from both children.
+	Each reference keeps the bound of the part of its primitive inside
+	the node, calculated with the clip function, so long thin primitives
+	do not make the node bounds much bigger than needed. As the spatial
+	split search clips the references to every bin, it is only done in
+	nodes bigger than a leaf whose object split children really overlap,
+	with an overlap area above overlap_threshold_ of the root area.
+
+	The number of duplicated references is limited by a budget relative
+	to the number of primitives, once exhausted only object splits are
+	done. The resulting tree uses the same nodes as BvhBuilder, with the
+	duplicated references repeated in the primitive indices list.
+*/
+class SbvhBuilder final
+{
+	public:
+		/*! Gets the bound of the part of a primitive inside a bound. Returns false if the primitive does not overlap it */
+		using ClipFunction = std::function<bool(uint32_t prim_id, const Bound &bound, Bound &clipped_bound)>;
+		SbvhBuilder(const std::vector<Bound> &bounds, const ClipFunction &clip_function, const BvhBuilder::Parameters &parameters);
+		BvhBuilder::Result build();
+		static uint32_t maxReferences(uint32_t num_primitives, const BvhBuilder::Parameters &parameters);
+		static bool validBound(const Bound &bound);
+		static constexpr float overlap_threshold_ = 1e-5f; //!< spatial splits are only tried if the object split children overlap area relative to the root area is above this value
+
+	private:
+		using Node = BvhBuilder::Node;
+		struct Reference;
+		struct Bin;
+		struct Split;
+		void buildTreeWorker(uint32_t node_id, std::vector<Reference> &references, int depth, TaskPool &task_pool, BvhBuilder::Stats &stats);
+		Split findObjectSplit(const std::vector<Reference> &references, const Bound &node_bound, const Bound &centroid_bound) const;
+		Split findSpatialSplit(const std::vector<Reference> &references, const Bound &node_bound) const;
+		void partitionObjects(std::vector<Reference> &references, const Split &split, const Bound &centroid_bound, std::vector<Reference> &left_references, std::vector<Reference> &right_references) const;
+		int partitionSpatial(const std::vector<Reference> &references, const Split &split, const Bound &node_bound, std::vector<Reference> &left_references, std::vector<Reference> &right_references) const;
+		bool clipReference(uint32_t prim_id, const Bound &bound, Bound &clipped_bound) const;
+		bool reserveDuplicates(int num_duplicates);
+
+		const std::vector<Bound> &bounds_;
+		const ClipFunction &clip_function_;
+		const BvhBuilder::Parameters &parameters_;
+		float root_half_area_ = 0.f;
+		std::vector<Node> nodes_;
+		std::vector<uint32_t> prim_indices_;
+		std::atomic<uint32_t> num_nodes_ { 0 };
+		std::atomic<uint32_t> num_prim_indices_ { 0 };
+		std::atomic<int> remaining_duplicates_ { 0 }; //!< duplicated references budget still available
+};
+
+struct SbvhBuilder::Reference
+{
+	Bound bound_; //!< bound of the part of the primitive referenced
+	uint32_t prim_id_;
+};
+
+/*! Object split bins only use the entries count */
+struct SbvhBuilder::Bin
+{
+	Bound bound_ {{std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max()}, {std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest()}};
+	uint32_t num_entries_ = 0; //!< references starting in this bin
+	uint32_t num_exits_ = 0; //!< references ending in this bin
+};
+
+struct SbvhBuilder::Split
+{
+	int axis_ = Axis::None;
+	int bin_ = -1; //!< object splits: references with centroids in bins below this one go to the left child. Spatial splits: the split plane is at the start of this bin
+	float cost_ = std::numeric_limits<float>::infinity();
+	Bound left_bound_, right_bound_;
+	uint32_t num_left_ = 0, num_right_ = 0;
+};
+
+inline bool SbvhBuilder::validBound(const Bound &bound)
+{
+	return bound.a_.x() <= bound.g_.x() && bound.a_.y() <= bound.g_.y() && bound.a_.z() <= bound.g_.z();
+}
+
+END_YAFARAY
+#endif    //YAFARAY_SBVH_BUILDER_H
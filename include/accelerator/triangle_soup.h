@@ -0,0 +1,72 @@
+#pragma once
+/****************************************************************************
+ *      This is part of the libYafaRay package
+ *
+ *      This library is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU Lesser General Public
+ *      License as published by the Free Software Foundation; either
+ *      version 2.1 of the License, or (at your option) any later version.
+ *
+ *      This library is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *      Lesser General Public License for more details.
+ *
+ *      You should have received a copy of the GNU Lesser General Public
+ *      License along with this library; if not, write to the Free Software
+ *      Foundation,Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#ifndef YAFARAY_TRIANGLE_SOUP_H
+#define YAFARAY_TRIANGLE_SOUP_H
+
+#include "accelerator/accelerator.h"
+#include "geometry/primitive/primitive_triangle.h"
+#include <vector>
+
+BEGIN_YAFARAY
+
+// ============================================================
+/*! Triangle intersection data precomputed by the accelerators, stored
+	contiguously in the same order as the accelerator leaf primitives list.
+	Triangles are intersected directly from here, without virtual calls and
+	without fetching (and possibly transforming) the mesh vertices for each
+	ray. Other primitives fall back to their own intersect function.
+
+	It uses 40 bytes per primitive, so it is optional in the accelerators
+	("precompute_triangles" parameter), trading memory for speed.
+*/
+class TriangleSoup final
+{
+	public:
+		TriangleSoup() = default;
+		explicit TriangleSoup(const std::vector<const Primitive *> &primitives);
+		bool empty() const { return triangles_.empty(); }
+		size_t numTriangles() const { return num_triangles_; }
+		size_t memoryUsed() const { return triangles_.size() * sizeof(Triangle); }
+		IntersectData intersect(uint32_t index, const Primitive *primitive, const Ray &ray) const;
+
+	private:
+		struct Triangle
+		{
+			Point3 vertex_0_;
+			Vec3 edge_1_;
+			Vec3 edge_2_;
+			float epsilon_ = -1.f; //!< negative for primitives which are not triangles
+		};
+		std::vector<Triangle> triangles_;
+		size_t num_triangles_ = 0;
+};
+
+/*! "index" is the position of the primitive in the list used to build the triangle soup */
+inline IntersectData TriangleSoup::intersect(uint32_t index, const Primitive *primitive, const Ray &ray) const
+{
+	Accelerator::countPrimitiveTest();
+	if(triangles_.empty()) return primitive->intersect(ray);
+	const Triangle &triangle = triangles_[index];
+	if(triangle.epsilon_ < 0.f) return primitive->intersect(ray);
+	return TrianglePrimitive::intersect(ray, triangle.vertex_0_, triangle.edge_1_, triangle.edge_2_, triangle.epsilon_);
+}
+
+END_YAFARAY
+#endif    //YAFARAY_TRIANGLE_SOUP_H
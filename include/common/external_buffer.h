@@ -0,0 +1,56 @@
+#pragma once
+/****************************************************************************
+ *      This is part of the libYafaRay package
+ *
+ *      This library is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU Lesser General Public
+ *      License as published by the Free Software Foundation; either
+ *      version 2.1 of the License, or (at your option) any later version.
+ *
+ *      This library is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *      Lesser General Public License for more details.
+ *
+ *      You should have received a copy of the GNU Lesser General Public
+ *      License along with this library; if not, write to the Free Software
+ *      Foundation,Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#ifndef YAFARAY_EXTERNAL_BUFFER_H
+#define YAFARAY_EXTERNAL_BUFFER_H
+
+#include "common/yafaray_common.h"
+#include "public_api/yafaray_c_api.h"
+#include <cstdint>
+#include <cstddef>
+
+BEGIN_YAFARAY
+
+/*! Array owned by the client application, read in place instead of being copied into libYafaRay.
+	Consecutive elements are "stride" bytes apart, so they can be interleaved with other client data.
+	The client must keep the array unchanged until the release callback, if any, is called when the
+	buffer is destroyed, which happens once in any case, also when the buffer could not be used */
+class ExternalBuffer final
+{
+	public:
+		ExternalBuffer(const void *data, size_t stride, size_t size, yafaray_BufferReleaseCallback_t release_callback, void *callback_data) : data_(static_cast<const uint8_t *>(data)), stride_(stride), size_(size), release_callback_(release_callback), callback_data_(callback_data) { }
+		ExternalBuffer(const ExternalBuffer &external_buffer) = delete;
+		ExternalBuffer &operator=(const ExternalBuffer &external_buffer) = delete;
+		~ExternalBuffer() { if(release_callback_) release_callback_(data_, callback_data_); }
+		/*! The elements are read with get<T>, so the data address and the stride must be aligned for T */
+		template <typename T> bool isValid(size_t num_components) const { return data_ && stride_ >= num_components * sizeof(T) && stride_ % alignof(T) == 0 && reinterpret_cast<uintptr_t>(data_) % alignof(T) == 0; }
+		size_t size() const { return size_; }
+		template <typename T> const T *get(size_t index) const { return reinterpret_cast<const T *>(data_ + index * stride_); }
+
+	private:
+		const uint8_t *data_ = nullptr;
+		size_t stride_ = 0; //!< distance in bytes between the start of consecutive elements
+		size_t size_ = 0; //!< number of elements
+		yafaray_BufferReleaseCallback_t release_callback_ = nullptr;
+		void *callback_data_ = nullptr;
+};
+
+END_YAFARAY
+
+#endif //YAFARAY_EXTERNAL_BUFFER_H
@@ -81,6 +81,26 @@ class File final
 		std::FILE *fp_ = nullptr;
 };
 
+/*! Read-only memory mapping of a whole file, so its contents can be used in place without reading them */
+class MappedFile final
+{
+	public:
+		explicit MappedFile(const std::string &path);
+		MappedFile(const MappedFile &mapped_file) = delete;
+		~MappedFile();
+		bool isMapped() const { return data_ != nullptr; }
+		const char *data() const { return data_; }
+		size_t size() const { return size_; }
+
+	private:
+		const char *data_ = nullptr;
+		size_t size_ = 0;
+#if defined(_WIN32)
+		void *file_handle_ = nullptr;
+		void *mapping_handle_ = nullptr;
+#endif //defined(_WIN32)
+};
+
 template <typename T> bool File::read(T &value) const
 {
 	static_assert(std::is_pod<T>::value, "T must be a plain old data (POD) type like char, int32_t, float, etc");
@@ -0,0 +1,77 @@
+#pragma once
+/****************************************************************************
+ *      This is part of the libYafaRay package
+ *
+ *      This library is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU Lesser General Public
+ *      License as published by the Free Software Foundation; either
+ *      version 2.1 of the License, or (at your option) any later version.
+ *
+ *      This library is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *      Lesser General Public License for more details.
+ *
+ *      You should have received a copy of the GNU Lesser General Public
+ *      License along with this library; if not, write to the Free Software
+ *      Foundation,Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#ifndef YAFARAY_MEMORY_POOL_H
+#define YAFARAY_MEMORY_POOL_H
+
+#include "yafaray_common.h"
+#include <array>
+#include <cstddef>
+
+BEGIN_YAFARAY
+
+/*! Per thread cache of small memory blocks, for objects created and destroyed at a high rate during the render,
+	like the material data of each ray hit. The block sizes are rounded up to a size class, and freed blocks are
+	kept in a free list of the thread freeing them, to be reused by the next allocation of the same size class in
+	that thread instead of going through malloc/free and its locks each time. Blocks bigger than the largest size
+	class, and blocks beyond the maximum number kept per size class, go directly to the global allocator */
+class MemoryPool final
+{
+	public:
+		static void *allocate(size_t size);
+		static void deallocate(void *block, size_t size);
+
+	private:
+		struct FreeBlock { FreeBlock *next_; };
+		struct FreeList
+		{
+			FreeBlock *first_ = nullptr;
+			size_t size_ = 0;
+		};
+		MemoryPool() = default;
+		~MemoryPool();
+		static MemoryPool &threadPool();
+		static size_t sizeClass(size_t size) { return (size + granularity_ - 1) / granularity_; }
+		static constexpr size_t granularity_ = 16; //!< bytes between size classes, also the alignment of the blocks
+		static constexpr size_t num_size_classes_ = 32; //!< blocks up to 512 bytes are kept in the free lists
+		static constexpr size_t max_free_blocks_ = 1024; //!< per size class, so a thread does not keep too much memory after a burst of allocations
+		std::array<FreeList, num_size_classes_ + 1> free_lists_;
+};
+
+/*! Standard allocator using the thread memory pool, for example for the short lived containers of the material data */
+template <typename T>
+class MemoryPoolAllocator
+{
+	public:
+		using value_type = T;
+		MemoryPoolAllocator() = default;
+		template <typename U> MemoryPoolAllocator(const MemoryPoolAllocator<U> &) { } // NOLINT(google-explicit-constructor)
+		T *allocate(size_t n) { return static_cast<T *>(MemoryPool::allocate(n * sizeof(T))); }
+		void deallocate(T *block, size_t n) { MemoryPool::deallocate(block, n * sizeof(T)); }
+};
+
+template <typename T, typename U>
+inline bool operator==(const MemoryPoolAllocator<T> &, const MemoryPoolAllocator<U> &) { return true; }
+
+template <typename T, typename U>
+inline bool operator!=(const MemoryPoolAllocator<T> &, const MemoryPoolAllocator<U> &) { return false; }
+
+END_YAFARAY
+
+#endif //YAFARAY_MEMORY_POOL_H
@@ -0,0 +1,95 @@
+#pragma once
+/****************************************************************************
+ *      This is part of the libYafaRay package
+ *
+ *      This library is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU Lesser General Public
+ *      License as published by the Free Software Foundation; either
+ *      version 2.1 of the License, or (at your option) any later version.
+ *
+ *      This library is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *      Lesser General Public License for more details.
+ *
+ *      You should have received a copy of the GNU Lesser General Public
+ *      License along with this library; if not, write to the Free Software
+ *      Foundation,Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#ifndef YAFARAY_TASK_POOL_H
+#define YAFARAY_TASK_POOL_H
+
+#include "yafaray_common.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+BEGIN_YAFARAY
+
+// ============================================================
+/*! Pool of threads executing tasks with work stealing. Each thread
+	has its own queue, new tasks are added to the queue of the thread
+	creating them and run from there in LIFO order, while idle threads
+	steal the oldest tasks (usually the biggest ones in recursive
+	algorithms) from the other queues.
+
+	Tasks are run in fork-join fashion through TaskGroup: the thread
+	waiting for a group keeps running pending tasks meanwhile, so it
+	is safe for tasks to create and wait for their own groups, and
+	tasks can safely use references to data owned by the waiting
+	thread instead of copies.
+*/
+class TaskPool final
+{
+	public:
+		class TaskGroup;
+		explicit TaskPool(int num_threads);
+		~TaskPool();
+		int numThreads() const { return static_cast<int>(queues_.size()); }
+		void parallelFor(size_t begin, size_t end, const std::function<void(size_t range_begin, size_t range_end)> &function, size_t min_range_size = 4096);
+
+	private:
+		struct Queue
+		{
+			std::mutex mutex_;
+			std::deque<std::function<void()>> tasks_;
+		};
+		void push(std::function<void()> &&task);
+		bool runPendingTask();
+		void workerLoop(int queue_id);
+		int currentQueueId() const;
+
+		std::vector<std::unique_ptr<Queue>> queues_; //!< one per thread, the first one is used by the thread owning the pool
+		std::vector<std::thread> workers_;
+		std::atomic<int> num_pending_tasks_ { 0 };
+		bool finish_ = false;
+		std::mutex sleep_mutex_;
+		std::condition_variable sleep_condition_;
+		static thread_local const TaskPool *current_pool_;
+		static thread_local int current_queue_id_;
+};
+
+/*! Set of tasks to be waited for together. The destructor waits for any tasks still running */
+class TaskPool::TaskGroup final
+{
+	public:
+		explicit TaskGroup(TaskPool &task_pool) : task_pool_(task_pool) { }
+		TaskGroup(const TaskGroup &task_group) = delete;
+		~TaskGroup() { wait(); }
+		void run(std::function<void()> &&task);
+		void wait();
+
+	private:
+		TaskPool &task_pool_;
+		std::atomic<int> num_pending_tasks_ { 0 };
+};
+
+END_YAFARAY
+
+#endif //YAFARAY_TASK_POOL_H
@@ -32,7 +32,7 @@ struct IntersectData
 	float barycentric_u_;
 	float barycentric_v_;
 	float barycentric_w_;
-	float time_;
+	float time_ = 0.f;
 };
 
 inline void IntersectData::setIntersectData(const IntersectData &intersect_data)
@@ -25,6 +25,7 @@
 
 #include "common/yafaray_common.h"
 #include "vector.h"
+#include "math/interpolation.h"
 #include <iostream>
 
 BEGIN_YAFARAY
@@ -47,6 +48,8 @@ class Matrix4
 		void rotateY(float degrees);
 		void rotateZ(float degrees);
 		void scale(float sx, float sy, float sz);
+		/*! Linear interpolation at the given frame time of matrices sampled in time steps uniformly distributed in the frame time [0;1] */
+		static Matrix4 interpolate(const Matrix4 *time_steps, int num_time_steps, float time);
 		bool invalid() const { return invalid_; }
 		const float *operator [](int i) const { return matrix_[i]; }
 		float *operator [](int i) { return matrix_[i]; }
@@ -75,6 +78,24 @@ inline Matrix4 operator * (const Matrix4 &a, const Matrix4 &b)
 	return aux;
 }
 
+inline Matrix4 operator * (const Matrix4 &a, float f)
+{
+	Matrix4 aux;
+	for(int i = 0; i < 4; i++)
+		for(int k = 0; k < 4; k++)
+			aux[i][k] = a[i][k] * f;
+	return aux;
+}
+
+inline Matrix4 operator + (const Matrix4 &a, const Matrix4 &b)
+{
+	Matrix4 aux;
+	for(int i = 0; i < 4; i++)
+		for(int k = 0; k < 4; k++)
+			aux[i][k] = a[i][k] + b[i][k];
+	return aux;
+}
+
 inline Vec3 operator * (const Matrix4 &a, const Vec3 &b)
 {
 	return { a[0][0] * b.x() + a[0][1] * b.y() + a[0][2] * b.z(),
@@ -89,6 +110,14 @@ inline Point3 operator * (const Matrix4 &a, const Point3 &b)
 	                  a[2][0] * b.x() + a[2][1] * b.y() + a[2][2] * b.z() + a[2][3] };
 }
 
+inline Matrix4 Matrix4::interpolate(const Matrix4 *time_steps, int num_time_steps, float time)
+{
+	if(num_time_steps < 2) return time_steps[0];
+	float segment_time;
+	const int time_step = math::uniformSegment(time, num_time_steps, segment_time);
+	return math::lerp(time_steps[time_step], time_steps[time_step + 1], segment_time);
+}
+
 //matrix4x4_t rayToZ(const point3d_t &from,const vector3d_t & ray);
 std::ostream &operator << (std::ostream &out, const Matrix4 &m);
 
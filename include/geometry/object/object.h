@@ -23,6 +23,7 @@
 #include "common/yafaray_common.h"
 #include "color/color.h"
 #include "common/visibility.h"
+#include "common/external_buffer.h"
 #include <vector>
 #include <memory>
 #include <common/logger.h>
@@ -76,19 +77,39 @@ class Object
 		virtual void setLight(const Light *light) = 0;
 		virtual bool calculateObject(const std::unique_ptr<const Material> *material) = 0;
 		bool calculateObject() { return calculateObject(nullptr); }
+		/*! Returns the instanced base object, only for instance objects */
+		virtual const Object *getInstanceBaseObject() const { return nullptr; }
+		/*! Returns the object to world transformation matrix, only for instance objects. For moving
+			instances it is the first one of numTimeSteps() consecutive matrices, one per time step */
+		virtual const Matrix4 *getObjToWorldMatrix() const { return nullptr; }
+		/*! Returns the number of motion blur time steps, uniformly distributed in the frame time [0;1]. 1 if the object does not move */
+		virtual int numTimeSteps() const { return 1; }
 
 		/* Mesh-related interface functions below, only for Mesh objects */
 		virtual int lastVertexId() const { return -1; }
 		virtual void addPoint(const Point3 &p) { }
+		/*! Adds a point position in the given motion blur time step, returns its index in the time step or -1 if not supported */
+		virtual int addPoint(const Point3 &p, int time_step) { return -1; }
 		virtual void addOrcoPoint(const Point3 &p) { }
 		virtual void addNormal(const Vec3 &n) { }
 		virtual void addFace(const std::vector<int> &vertices, const std::vector<int> &vertices_uv, const std::unique_ptr<const Material> *material) { }
 		virtual int addUvValue(const Uv &uv) { return -1; }
+		/*! Bulk versions of the functions above, for arrays of elements. The arrays are moved into the object when it does not have any element of that kind yet, otherwise they are appended. The functions adding points and uv values return the index of the first element added or -1 if not supported */
+		virtual int addPoints(std::vector<Point3> &&points) { return -1; }
+		virtual void addOrcoPoints(std::vector<Point3> &&orco_points) { }
+		virtual void addNormals(std::vector<Vec3> &&normals) { }
+		virtual bool addFaces(Logger &logger, std::vector<uint32_t> &&vertex_indices, std::vector<uint32_t> &&uv_indices, const std::unique_ptr<const Material> *material) { return false; }
+		virtual int addUvValues(std::vector<Uv> &&uv_values) { return -1; }
+		/*! Uses arrays owned by the client for the points (three floats per point) or for the faces (three int vertex indices per face, all the faces with the given material) instead of the object's own arrays */
+		virtual bool setExternalPoints(Logger &logger, std::unique_ptr<const ExternalBuffer> points) { return false; }
+		virtual bool setExternalFaces(Logger &logger, std::unique_ptr<const ExternalBuffer> vertex_indices, const std::unique_ptr<const Material> *material) { return false; }
 		virtual bool hasNormalsExported() const { return false; }
 		virtual int numNormals() const { return 0; }
 		virtual int numVertices() const { return 0; }
 		virtual void setSmooth(bool smooth) { }
-		virtual bool smoothNormals(Logger &logger, float angle) { return false; }
+		virtual bool smoothNormals(Logger &logger, float angle, int num_threads) { return false; }
+		/*! Replaces the positions of the existing points, keeping the mesh topology */
+		virtual bool updatePoints(Logger &logger, const std::vector<Point3> &points, int num_threads) { return false; }
 };
 
 END_YAFARAY
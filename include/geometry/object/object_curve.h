@@ -22,24 +22,46 @@
 
 #include "common/logger.h"
 #include "object_mesh.h"
+#include "geometry/primitive/primitive_curve.h"
 
 BEGIN_YAFARAY
 
 struct Uv;
-class FacePrimitive;
 class Material;
 
+/*! Strand (hair) defined by its points. With the "triangles" strand geometry the strand is extruded into
+	triangle faces, otherwise each segment between two points is a CurvePrimitive, intersected directly.
+	The segments can go straight from point to point or follow a uniform cubic B-spline through the points */
 class CurveObject final : public MeshObject
 {
 	public:
+		enum class StrandGeometry : unsigned char { Triangles, Ribbon, Round };
+		enum class StrandBasis : unsigned char { Linear, BSpline };
 		static Object *factory(Logger &logger, const Scene &scene, const std::string &name, const ParamMap &params);
-		CurveObject(int num_vertices, float strand_start, float strand_end, float strand_shape, bool has_uv = false, bool has_orco = false);
+		CurveObject(int num_vertices, float strand_start, float strand_end, float strand_shape, StrandGeometry strand_geometry = StrandGeometry::Triangles, StrandBasis strand_basis = StrandBasis::Linear, bool has_uv = false, bool has_orco = false);
+		int numPrimitives() const override;
+		const std::vector<const Primitive *> getPrimitives() const override;
 		bool calculateObject(const std::unique_ptr<const Material> *material) override;
+		bool setExternalPoints(Logger &logger, std::unique_ptr<const ExternalBuffer> points) override;
+		bool setExternalFaces(Logger &logger, std::unique_ptr<const ExternalBuffer> vertex_indices, const std::unique_ptr<const Material> *material) override;
+		StrandGeometry getStrandGeometry() const { return strand_geometry_; }
+		int numSegments() const { return static_cast<int>(points_.size()) - 1; }
+		/*! control points of the cubic Bezier curve of the segment, in object coordinates */
+		std::array<Point3, 4> getSegmentControlPoints(int segment) const;
+		std::array<float, 2> getSegmentWidths(int segment) const { return {{2.f * radii_[segment], 2.f * radii_[segment + 1]}}; }
+		const Material *getMaterial() const { return material_ ? material_->get() : nullptr; }
 
 	private:
+		float strandRadius(int point, int num_points) const;
+		void calculateTriangles(const std::unique_ptr<const Material> *material);
 		float strand_start_ = 0.01f;
 		float strand_end_ = 0.01f;
 		float strand_shape_ = 0.f;
+		StrandGeometry strand_geometry_ = StrandGeometry::Triangles;
+		StrandBasis strand_basis_ = StrandBasis::Linear;
+		std::vector<float> radii_; //!< radius at each strand point, for the curve primitives
+		std::vector<CurvePrimitive> segments_;
+		const std::unique_ptr<const Material> *material_ = nullptr;
 };
 
 END_YAFARAY
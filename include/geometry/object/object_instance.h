@@ -21,15 +21,14 @@
 #define YAFARAY_OBJECT_INSTANCE_H
 
 #include "object.h"
+#include "geometry/matrix4.h"
 
 BEGIN_YAFARAY
 
-class Matrix4;
-
 class ObjectInstance : public Object
 {
 	public:
-		ObjectInstance(const Object &base_object, const Matrix4 &obj_to_world);
+		ObjectInstance(const Object &base_object, const std::vector<Matrix4> &obj_to_world_time_steps);
 		int numPrimitives() const override { return primitive_instances_.size(); }
 		const std::vector<const Primitive *> getPrimitives() const override;
 		std::string getName() const override { return base_object_.getName(); }
@@ -55,12 +54,16 @@ class ObjectInstance : public Object
 		const Light *getLight() const override { return base_object_.getLight(); }
 		/*! set a light source to be associated with this object */
 		void setLight(const Light *light) override { }
-		const Matrix4 *getObjToWorldMatrix() const { return obj_to_world_.get(); }
-		bool calculateObject(const std::unique_ptr<const Material> *material) override { return true; }
+		const Object *getInstanceBaseObject() const override { return &base_object_; }
+		const Matrix4 *getObjToWorldMatrix() const override { return obj_to_world_.data(); }
+		int numTimeSteps() const override { return static_cast<int>(obj_to_world_.size()); }
+		Matrix4 getObjToWorldMatrixAtTime(float time) const { return Matrix4::interpolate(obj_to_world_.data(), numTimeSteps(), time); }
+		/*! Creates the primitive instances, only needed when the instance primitives are added individually to the accelerator */
+		bool calculateObject(const std::unique_ptr<const Material> *material) override;
 
 	protected:
 		const Object &base_object_;
-		std::unique_ptr<const Matrix4> obj_to_world_;
+		const std::vector<Matrix4> obj_to_world_; //!< one matrix per motion blur time step
 		std::vector<std::unique_ptr<const Primitive>> primitive_instances_;
 };
 
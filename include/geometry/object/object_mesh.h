@@ -23,59 +23,145 @@
 #include "object_basic.h"
 #include "geometry/vector.h"
 #include "geometry/uv.h"
+#include "geometry/vector_packed.h"
+#include "geometry/primitive/primitive_triangle.h"
+#include "geometry/primitive/primitive_triangle_motion.h"
 #include <vector>
+#include <limits>
 #include "common/logger.h"
 
 BEGIN_YAFARAY
 
 struct Uv;
-class FacePrimitive;
 class Material;
+class TaskPool;
 
+/*! Triangle mesh. The faces are stored in flat arrays, three indices per face for the points, normals and
+	uv values, with an index per face in the table of materials of the mesh. The face primitives given to the
+	accelerators are lightweight handles with the mesh and the face index, kept in a contiguous array.
+	The points and the face vertex indices can be read in place from arrays owned by the client application
+	instead, when they are set with setExternalPoints / setExternalFaces before any point or face is added.
+	With the "compact_attributes" parameter the normals, uv values and orco points are packed when the mesh is
+	calculated (the normals again each time they are smoothed) and unpacked on demand by the face primitives */
 class MeshObject : public ObjectBasic
 {
 	public:
 		static Object *factory(Logger &logger, const Scene &scene, const std::string &name, const ParamMap &params);
-		MeshObject(int num_vertices, int num_faces, bool has_uv = false, bool has_orco = false);
+		MeshObject(int num_vertices, int num_faces, bool has_uv = false, bool has_orco = false, int num_time_steps = 1, bool compact_attributes = false);
 		~MeshObject() override;
 		/*! the number of primitives the object holds. Primitive is an element
 			that by definition can perform ray-triangle intersection */
-		int numPrimitives() const override { return faces_.size(); }
+		int numPrimitives() const override { return numFaces(); }
+		int numFaces() const { return static_cast<int>(face_materials_.size()); }
 		const std::vector<const Primitive *> getPrimitives() const override;
-		int lastVertexId() const override { return points_.size() - 1; }
-		Vec3 getVertexNormal(int index) const { return normals_[index]; }
-		Point3 getVertex(int index) const { return points_[index]; }
-		Point3 getOrcoVertex(int index) const { return orco_points_[index]; }
-		int numVertices() const override { return points_.size(); }
-		int numNormals() const override { return normals_.size(); }
-		void addFace(std::unique_ptr<FacePrimitive> face);
+		int lastVertexId() const override { return numVertices() - 1; }
+		Vec3 getVertexNormal(int index) const { return packed_normals_.empty() ? normals_[index] : packed_normals_[index].unpack(); }
+		Point3 getVertex(int index) const;
+		Point3 getVertexTimeStep(int index, int time_step) const { return time_step == 0 ? getVertex(index) : motion_points_[time_step - 1][index]; }
+		Point3 getVertexAtTime(int index, float time) const;
+		Point3 getOrcoVertex(int index) const;
+		Uv getUvValue(int index) const;
+		int numVertices() const override { return external_points_ ? static_cast<int>(external_points_->size()) : static_cast<int>(points_.size()); }
+		int numNormals() const override { return packed_normals_.empty() ? static_cast<int>(normals_.size()) : static_cast<int>(packed_normals_.size()); }
+		int numTimeSteps() const override { return 1 + static_cast<int>(motion_points_.size()); }
 		void addFace(const std::vector<int> &vertices, const std::vector<int> &vertices_uv, const std::unique_ptr<const Material> *material) override;
-		void calculateNormals();
+		void calculateNormals(int num_threads);
+		uint32_t getFaceVertexIndex(size_t face_index, size_t vertex_number) const;
+		uint32_t getFaceNormalIndex(size_t face_index, size_t vertex_number) const;
+		uint32_t getFaceUvIndex(size_t face_index, size_t vertex_number) const;
+		const Material *getFaceMaterial(size_t face_index) const { return materials_[face_materials_[face_index]]->get(); }
+		const Vec3 &getFaceNormal(size_t face_index) const { return face_normals_[face_index]; }
 		const std::vector<Point3> &getPoints() const { return points_; }
-		const std::vector<Uv> &getUvValues() const { return uv_values_; }
-		bool hasOrco() const { return !orco_points_.empty(); }
-		bool hasUv() const { return !uv_values_.empty(); }
+		bool hasOrco() const { return !orco_points_.empty() || !packed_orco_points_.empty(); }
+		bool hasUv() const { return !uv_values_.empty() || !packed_uv_values_.empty(); }
 		bool isSmooth() const { return is_smooth_; }
-		bool hasNormalsExported() const override { return !normals_.empty(); }
-		void addPoint(const Point3 &p) override { points_.push_back(p); }
+		bool hasNormalsExported() const override { return !normals_.empty() || !packed_normals_.empty(); }
+		void addPoint(const Point3 &p) override { if(!external_points_) points_.push_back(p); }
+		int addPoint(const Point3 &p, int time_step) override;
 		void addOrcoPoint(const Point3 &p) override { orco_points_.push_back(p); }
 		void addNormal(const Vec3 &n) override;
 		int addUvValue(const Uv &uv) override { uv_values_.push_back(uv); return static_cast<int>(uv_values_.size()) - 1; }
+		int addPoints(std::vector<Point3> &&points) override { return external_points_ ? -1 : static_cast<int>(appendOrMove(points_, std::move(points))); }
+		void addOrcoPoints(std::vector<Point3> &&orco_points) override { appendOrMove(orco_points_, std::move(orco_points)); }
+		void addNormals(std::vector<Vec3> &&normals) override { appendOrMove(normals_, std::move(normals)); }
+		bool addFaces(Logger &logger, std::vector<uint32_t> &&vertex_indices, std::vector<uint32_t> &&uv_indices, const std::unique_ptr<const Material> *material) override;
+		int addUvValues(std::vector<Uv> &&uv_values) override { return static_cast<int>(appendOrMove(uv_values_, std::move(uv_values))); }
+		bool setExternalPoints(Logger &logger, std::unique_ptr<const ExternalBuffer> points) override;
+		bool setExternalFaces(Logger &logger, std::unique_ptr<const ExternalBuffer> vertex_indices, const std::unique_ptr<const Material> *material) override;
 		void setSmooth(bool smooth) override { is_smooth_ = smooth; }
-		bool smoothNormals(Logger &logger, float angle) override;
+		bool smoothNormals(Logger &logger, float angle, int num_threads) override;
+		bool updatePoints(Logger &logger, const std::vector<Point3> &points, int num_threads) override;
 		//int convertToBezierControlPoints();
 		bool calculateObject(const std::unique_ptr<const Material> *material) override;
+		static constexpr uint32_t no_index_ = std::numeric_limits<uint32_t>::max(); //!< face vertex without normal
 
 	protected:
-		static float getAngleSine(const std::array<int, 3> &triangle_indices, const std::vector<Point3> &vertices);
-		std::vector<std::unique_ptr<FacePrimitive>> faces_;
+		/*! Face corners (3 * face index + vertex number) using each point, in CSR layout: the corners of a point are in corners_, from offsets_[point] to offsets_[point + 1], in face order */
+		struct PointCorners
+		{
+			std::vector<uint32_t> offsets_;
+			std::vector<uint32_t> corners_;
+		};
+		PointCorners getPointCorners(TaskPool &task_pool) const;
+		float getCornerAngleSine(uint32_t corner) const;
+		template <typename T> static size_t appendOrMove(std::vector<T> &destination, std::vector<T> &&source);
+		float getAngleSine(const std::array<uint32_t, 3> &triangle_indices) const;
+		void addFaceHandles(size_t first_face, size_t num_faces);
+		Vec3 calculateFaceNormal(size_t face_index) const;
+		void packNormals();
+		void unpackNormals();
+		void packUvValues();
+		void packOrcoPoints();
+		uint32_t getMaterialId(const std::unique_ptr<const Material> *material);
+		std::vector<uint32_t> vertex_indices_; //!< indices in the points array, three per face
+		std::vector<uint32_t> normal_indices_; //!< indices in the normals array, three per face. Empty when they are the same as the points indices
+		std::vector<uint32_t> uv_indices_; //!< indices in the uv values array, three per face, if the mesh has explicit uv
+		std::vector<uint32_t> face_materials_; //!< index in the materials table of each face
+		std::vector<const std::unique_ptr<const Material> *> materials_; //!< materials used by the faces
+		std::vector<Vec3> face_normals_; //!< geometric normal of each face at the first time step, in object coordinates
+		std::vector<TrianglePrimitive> triangles_;
+		std::vector<MotionTrianglePrimitive> motion_triangles_; //!< used instead of triangles_ when the mesh has motion blur time steps
 		std::vector<Point3> points_;
+		std::unique_ptr<const ExternalBuffer> external_points_; //!< client array used instead of points_, if set
+		std::unique_ptr<const ExternalBuffer> external_vertex_indices_; //!< client array used instead of vertex_indices_, if set
+		std::vector<std::vector<Point3>> motion_points_; //!< points in the motion blur time steps after the first one, which is stored in points_
 		std::vector<Point3> orco_points_;
 		std::vector<Vec3> normals_;
 		std::vector<Uv> uv_values_;
+		bool compact_attributes_ = false; //!< if true, the normals, uv values and orco points are stored packed instead of in the arrays above
+		std::vector<PackedNormal> packed_normals_;
+		std::vector<std::array<uint16_t, 2>> packed_uv_values_;
+		std::array<PackedRange, 2> uv_ranges_; //!< ranges of the u and v packed values
+		std::vector<std::array<uint16_t, 3>> packed_orco_points_;
+		std::array<PackedRange, 3> orco_ranges_; //!< ranges of the x, y and z packed orco coordinates
 		bool is_smooth_ = false;
+		float smooth_angle_ = -1.f; //!< angle used to calculate the smooth normals, negative if they were not calculated
 };
 
+/*! Appends the source array to the destination, taking the source storage instead of copying it when the destination is empty. Returns the index of the first element appended */
+template <typename T>
+inline size_t MeshObject::appendOrMove(std::vector<T> &destination, std::vector<T> &&source)
+{
+	const size_t first_index = destination.size();
+	if(destination.empty()) destination = std::move(source);
+	else destination.insert(destination.end(), source.begin(), source.end());
+	return first_index;
+}
+
+inline Point3 MeshObject::getOrcoVertex(int index) const
+{
+	if(packed_orco_points_.empty()) return orco_points_[index];
+	const std::array<uint16_t, 3> &packed_orco_point = packed_orco_points_[index];
+	return {orco_ranges_[0].unpack(packed_orco_point[0]), orco_ranges_[1].unpack(packed_orco_point[1]), orco_ranges_[2].unpack(packed_orco_point[2])};
+}
+
+inline Uv MeshObject::getUvValue(int index) const
+{
+	if(packed_uv_values_.empty()) return uv_values_[index];
+	const std::array<uint16_t, 2> &packed_uv_value = packed_uv_values_[index];
+	return {uv_ranges_[0].unpack(packed_uv_value[0]), uv_ranges_[1].unpack(packed_uv_value[1])};
+}
+
 END_YAFARAY
 
 #endif //YAFARAY_OBJECT_MESH_H
@@ -27,6 +27,7 @@
 #include "geometry/ray.h"
 #include "geometry/intersect_data.h"
 #include "geometry/bound.h"
+#include "color/color.h"
 #include <vector>
 #include <array>
 
@@ -51,6 +52,11 @@ class Primitive
 		/*! return the object bound in global ("world") coordinates */
 		virtual Bound getBound(const Matrix4 *obj_to_world) const = 0;
 		Bound getBound() const { return getBound(nullptr); }
+		/*! number of motion blur time steps, uniformly distributed in the frame time [0;1]. The bound returned
+			by getBound() encloses the primitive during the whole frame time. 1 if the primitive does not move */
+		virtual int numTimeSteps() const { return 1; }
+		/*! return the bound in global ("world") coordinates at the given time step */
+		virtual Bound getTimeStepBound(int time_step, const Matrix4 *obj_to_world) const { return getBound(obj_to_world); }
 		/*! a possibly more precise check to find out if the primitve really
 			intersects the bound of interest, given that the primitive's bound does.
 			used e.g. for optimized kd-tree construction */
@@ -64,8 +70,12 @@ class Primitive
 			\param t set this to raydepth where hit occurs */
 		virtual IntersectData intersect(const Ray &ray, const Matrix4 *obj_to_world) const;
 		IntersectData intersect(const Ray &ray) const { return intersect(ray, nullptr); }
-		/* fill in surfacePoint_t */
-		virtual std::unique_ptr<const SurfacePoint> getSurface(const RayDifferentials *ray_differentials, const Point3 &hit, const IntersectData &data, const Matrix4 *obj_to_world, const Camera *camera) const;
+		/*! fills the surface point given by the caller, usually in its stack, with the surface data and the material data at the hit point.
+			\return false if the primitive does not provide surface data */
+		virtual bool getSurface(SurfacePoint &sp, const RayDifferentials *ray_differentials, const Point3 &hit, const IntersectData &data, const Matrix4 *obj_to_world, const Camera *camera) const;
+		/*! transparency of the material at the hit point, for transparent shadows. By default a full surface point is
+			calculated, primitives can instead fill a surface point in the stack for the lighter Material::getShadowTransparency */
+		virtual Rgb getShadowTransparency(const Point3 &hit, const IntersectData &data, const Vec3 &wo, const Matrix4 *obj_to_world, const Camera *camera) const;
 		/* return the material */
 		virtual const Material *getMaterial() const { return nullptr; }
 		/* calculate surface area */
@@ -80,6 +90,11 @@ class Primitive
 		std::pair<Point3, Vec3> sample(float s_1, float s_2) const { return sample(s_1, s_2, nullptr); }
 		virtual const Object *getObject() const = 0;
 		virtual Visibility getVisibility() const = 0;
+		/*! if the primitive is a triangle, get its vertices in global ("world") coordinates, so
+			accelerators can store precomputed triangle intersection data.
+			\return: false:=not a triangle, vertices not modified */
+		virtual bool getTriangleVertices(std::array<Point3, 3> &vertices, const Matrix4 *obj_to_world) const { return false; }
+		bool getTriangleVertices(std::array<Point3, 3> &vertices) const { return getTriangleVertices(vertices, nullptr); }
 		/*! calculate the overlapping box of given bound and primitive
 			\return: false:=doesn't overlap bound; true:=valid clip exists */
 		virtual PolyDouble::ClipResultWithBound clipToBound(Logger &logger, const std::array<Vec3Double, 2> &bound, const ClipPlane &clip_plane, const PolyDouble &poly, const Matrix4 *obj_to_world) const;
@@ -0,0 +1,74 @@
+#pragma once
+/****************************************************************************
+ *      This is part of the libYafaRay package
+ *
+ *      This library is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU Lesser General Public
+ *      License as published by the Free Software Foundation; either
+ *      version 2.1 of the License, or (at your option) any later version.
+ *
+ *      This library is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *      Lesser General Public License for more details.
+ *
+ *      You should have received a copy of the GNU Lesser General Public
+ *      License along with this library; if not, write to the Free Software
+ *      Foundation,Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#ifndef YAFARAY_PRIMITIVE_CURVE_H
+#define YAFARAY_PRIMITIVE_CURVE_H
+
+#include "primitive.h"
+#include "geometry/vector.h"
+
+BEGIN_YAFARAY
+
+class CurveObject;
+class SurfacePoint;
+
+/*! One segment of a strand of a CurveObject, between two consecutive strand points, intersected directly
+	as a cubic Bezier curve with a width varying along it instead of being triangulated. The curve is a ribbon
+	which always faces the incoming ray, with the "round" strand geometry the shading normal is bent across
+	the width so the strand is shaded as a cylinder.
+	The intersection recursively subdivides the curve in the coordinate system of the ray, culling the curve
+	pieces with their bound in that coordinate system, as in "Ray tracing for curves primitive" (K. Nakamaru
+	and Y. Ohno, 2002) and in "Physically Based Rendering" (3rd edition, section 3.7). Each primitive only
+	keeps a reference to its object and its segment index, the geometry is read from the object points.
+	The intersect data keeps the parameter along the segment in barycentric_u_, the position across the
+	width in barycentric_v_ (0 to 1) and the angle of the ribbon around the curve tangent in barycentric_w_ */
+class CurvePrimitive final : public Primitive
+{
+	public:
+		CurvePrimitive(const CurveObject &curve_object, int segment) : curve_object_(curve_object), segment_(segment) { }
+
+	private:
+		using ControlPoints = std::array<Vec3, 4>;
+		Bound getBound(const Matrix4 *obj_to_world) const override;
+		IntersectData intersect(const Ray &ray, const Matrix4 *obj_to_world) const override;
+		bool getSurface(SurfacePoint &sp, const RayDifferentials *ray_differentials, const Point3 &hit, const IntersectData &intersect_data, const Matrix4 *obj_to_world, const Camera *camera) const override;
+		Rgb getShadowTransparency(const Point3 &hit, const IntersectData &intersect_data, const Vec3 &wo, const Matrix4 *obj_to_world, const Camera *camera) const override;
+		const Material *getMaterial() const override;
+		float surfaceArea(const Matrix4 *obj_to_world) const override;
+		Vec3 getGeometricNormal(const Matrix4 *obj_to_world, float u, float v) const override;
+		std::pair<Point3, Vec3> sample(float s_1, float s_2, const Matrix4 *obj_to_world) const override;
+		const Object *getObject() const override;
+		Visibility getVisibility() const override;
+		void fillSurface(SurfacePoint &sp, const RayDifferentials *ray_differentials, const Point3 &hit, const IntersectData &intersect_data, const Matrix4 *obj_to_world) const;
+		ControlPoints getControlPoints(const Matrix4 *obj_to_world) const;
+		std::array<float, 2> getWidths(const Matrix4 *obj_to_world) const;
+		static Vec3 evalBezier(const ControlPoints &control_points, float u, Vec3 *derivative);
+		static std::array<Vec3, 7> splitBezier(const ControlPoints &control_points);
+		static bool outsideRay(const ControlPoints &control_points, float half_width, float z_max);
+		static bool intersectRecursive(const ControlPoints &control_points, const std::array<float, 2> &widths, float u_start, float u_end, int depth, float &z_hit, float &u_hit);
+		static std::pair<Vec3, Vec3> ribbonFrame(const Vec3 &tangent, float ribbon_angle);
+
+		static constexpr int max_subdivisions_ = 10;
+		const CurveObject &curve_object_;
+		int segment_; //!< index of the first of the two strand points of the segment
+};
+
+END_YAFARAY
+
+#endif //YAFARAY_PRIMITIVE_CURVE_H
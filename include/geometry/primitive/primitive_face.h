@@ -22,50 +22,41 @@
 
 #include "primitive.h"
 #include "geometry/vector.h"
-#include "geometry/object/object_mesh.h"
 #include <vector>
 
 BEGIN_YAFARAY
 
 struct Uv;
+class MeshObject;
 
+/*! A face of a MeshObject. It is only a lightweight handle with the mesh and the face index, the face data
+	(vertex, normal and uv indices, material and geometric normal) is stored in the flat arrays of the mesh */
 class FacePrimitive: public Primitive
 {
 	public:
-		FacePrimitive(const std::vector<int> &vertices_indices, const std::vector<int> &vertices_uv_indices, const MeshObject &mesh_object);
+		FacePrimitive(const MeshObject &mesh_object, size_t face_index) : base_mesh_object_(mesh_object), face_index_(static_cast<uint32_t>(face_index)) { }
 		//In the following functions "vertex_number" is the vertex number in the face: 0, 1, 2 in triangles, 0, 1, 2, 3 in quads, etc
 		Vec3 getGeometricNormal(const Matrix4 *obj_to_world, float u, float v) const override;
-		const Material *getMaterial() const override { return material_->get(); }
+		const Material *getMaterial() const override;
 		Bound getBound(const Matrix4 *obj_to_world) const override;
-		virtual void calculateGeometricNormal() = 0;
 		Point3 getVertex(size_t vertex_number, const Matrix4 *obj_to_world = nullptr) const; //!< Get face vertex
 		Point3 getOrcoVertex(size_t vertex_number) const; //!< Get face original coordinates (orco) vertex in instance objects
 		Vec3 getVertexNormal(size_t vertex_number, const Vec3 &surface_normal_world, const Matrix4 *obj_to_world) const; //!< Get face vertex normal
 		Uv getVertexUv(size_t vertex_number) const; //!< Get face vertex Uv
-		void setNormalsIndices(const std::vector<int> &normals_indices) { vertex_normals_ = normals_indices; }
-		void setUvIndices(const std::vector<int> &uv_indices) { vertex_uvs_ = uv_indices; }
-		const std::vector<int> getVerticesIndices() const { return vertices_; }
-		const std::vector<int> getNormalsIndices() const { return vertex_normals_; }
-		const std::vector<int> getUvIndices() const { return vertex_uvs_; }
 		std::vector<Point3> getVertices(const Matrix4 *obj_to_world = nullptr) const;
 		std::vector<Point3> getOrcoVertices() const;
 		std::vector<Vec3> getVerticesNormals(const Vec3 &surface_normal, const Matrix4 *obj_to_world = nullptr) const;
 		std::vector<Uv> getVerticesUvs() const;
-		void setMaterial(const std::unique_ptr<const Material> *material) { material_ = material; }
-		size_t getSelfIndex() const { return self_index_; }
-		void setSelfIndex(size_t index) { self_index_ = index; }
+		size_t getSelfIndex() const { return face_index_; }
 		static Bound getBound(const std::vector<Point3> &vertices);
-		const Object *getObject() const override { return &base_mesh_object_; }
-		Visibility getVisibility() const override { return base_mesh_object_.getVisibility(); }
+		const Object *getObject() const override;
+		const MeshObject &getMeshObject() const { return base_mesh_object_; }
+		Visibility getVisibility() const override;
+		static constexpr size_t num_vertices_ = 3; //!< only triangles are supported by the meshes
 
 	protected:
-		size_t self_index_ = 0;
-		Vec3 normal_geometric_;
 		const MeshObject &base_mesh_object_;
-		const std::unique_ptr<const Material> *material_ = nullptr;
-		std::vector<int> vertices_; //!< indices in point array, referenced in mesh.
-		std::vector<int> vertex_normals_; //!< indices in normal array, if mesh is smoothed.
-		std::vector<int> vertex_uvs_; //!< indices in uv array, if mesh has explicit uv.
+		uint32_t face_index_; //!< index of the face in the mesh arrays
 };
 
 std::ostream &operator<<(std::ostream &out, const FacePrimitive &face);
@@ -42,11 +42,15 @@ class PrimitiveInstance : public Primitive
 		//static PrimitiveInstance *factory(ParamMap &params, const Scene &scene);
 		PrimitiveInstance(const Primitive *base_primitive, const ObjectInstance &base_instance) : base_instance_(base_instance), base_primitive_(base_primitive) { }
 		Bound getBound(const Matrix4 *) const override;
+		int numTimeSteps() const override;
+		Bound getTimeStepBound(int time_step, const Matrix4 *) const override;
 		bool intersectsBound(const ExBound &b, const Matrix4 *) const override;
-		bool clippingSupport() const override { return base_primitive_->clippingSupport(); }
+		bool clippingSupport() const override { return !hasMotion() && base_primitive_->clippingSupport(); }
 		PolyDouble::ClipResultWithBound clipToBound(Logger &logger, const std::array<Vec3Double, 2> &bound, const ClipPlane &clip_plane, const PolyDouble &poly, const Matrix4 *obj_to_world) const override;
 		IntersectData intersect(const Ray &ray, const Matrix4 *) const override;
-		std::unique_ptr<const SurfacePoint> getSurface(const RayDifferentials *ray_differentials, const Point3 &hit_point, const IntersectData &intersect_data, const Matrix4 *, const Camera *camera) const override;
+		bool getTriangleVertices(std::array<Point3, 3> &vertices, const Matrix4 *) const override;
+		bool getSurface(SurfacePoint &sp, const RayDifferentials *ray_differentials, const Point3 &hit_point, const IntersectData &intersect_data, const Matrix4 *, const Camera *camera) const override;
+		Rgb getShadowTransparency(const Point3 &hit_point, const IntersectData &intersect_data, const Vec3 &wo, const Matrix4 *, const Camera *camera) const override;
 		const Material *getMaterial() const override { return base_primitive_->getMaterial(); }
 		float surfaceArea(const Matrix4 *) const override;
 		Vec3 getGeometricNormal(const Matrix4 *, float u, float v) const override;
@@ -55,6 +59,7 @@ class PrimitiveInstance : public Primitive
 		Visibility getVisibility() const override { return base_primitive_->getVisibility(); }
 
 	private:
+		bool hasMotion() const { return base_instance_.numTimeSteps() > 1; }
 		const ObjectInstance &base_instance_;
 		const Primitive *base_primitive_ = nullptr;
 };
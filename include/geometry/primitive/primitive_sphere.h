@@ -44,7 +44,7 @@ class SpherePrimitive final : public Primitive
 		Bound getBound(const Matrix4 *obj_to_world) const override;
 		bool intersectsBound(const ExBound &b, const Matrix4 *obj_to_world) const override { return true; };
 		IntersectData intersect(const Ray &ray, const Matrix4 *obj_to_world) const override;
-		std::unique_ptr<const SurfacePoint> getSurface(const RayDifferentials *ray_differentials, const Point3 &hit, const IntersectData &intersect_data, const Matrix4 *obj_to_world, const Camera *camera) const override;
+		bool getSurface(SurfacePoint &sp, const RayDifferentials *ray_differentials, const Point3 &hit, const IntersectData &intersect_data, const Matrix4 *obj_to_world, const Camera *camera) const override;
 		const Material *getMaterial() const override { return material_->get(); }
 		float surfaceArea(const Matrix4 *obj_to_world) const override;
 		Vec3 getGeometricNormal(const Matrix4 *obj_to_world, float u, float v) const override;
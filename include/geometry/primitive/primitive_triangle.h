@@ -29,28 +29,63 @@ BEGIN_YAFARAY
 class TrianglePrimitive final : public FacePrimitive
 {
 	public:
-		TrianglePrimitive(const std::vector<int> &vertices_indices, const std::vector<int> &vertices_uv_indices, const MeshObject &mesh_object);
+		TrianglePrimitive(const MeshObject &mesh_object, size_t face_index) : FacePrimitive(mesh_object, face_index) { }
+		//! Ray intersection with the triangle edges and epsilon already calculated, so they can be precomputed by accelerators
+		static IntersectData intersect(const Ray &ray, const Point3 &vertex_0, const Vec3 &edge_1, const Vec3 &edge_2, float epsilon);
+		static float intersectEpsilon(const Vec3 &edge_1, const Vec3 &edge_2) { return 0.1f * min_raydist_global * std::max(edge_1.length(), edge_2.length()); }
+		//! Surface point of a triangle face given its vertices and geometric normal in global ("world") coordinates, so it can be shared by other triangle primitives
+		static bool getSurface(SurfacePoint &sp, const FacePrimitive &face, const std::array<Point3, 3> &vertices, const Vec3 &normal_geometric, const RayDifferentials *ray_differentials, const Point3 &hit_point, const IntersectData &intersect_data, const Matrix4 *obj_to_world, const Camera *camera);
+		//! Same as getSurface, but only the geometry data is filled in the given surface point, without initializing the material BSDF
+		static void fillSurface(SurfacePoint &sp, const FacePrimitive &face, const std::array<Point3, 3> &vertices, const Vec3 &normal_geometric, const RayDifferentials *ray_differentials, const Point3 &hit_point, const IntersectData &intersect_data, const Matrix4 *obj_to_world);
+		//! Transparent shadows of a triangle face, with its surface point in the stack
+		static Rgb getShadowTransparency(const FacePrimitive &face, const std::array<Point3, 3> &vertices, const Vec3 &normal_geometric, const Point3 &hit_point, const IntersectData &intersect_data, const Vec3 &wo, const Matrix4 *obj_to_world, const Camera *camera);
 
 	private:
 		IntersectData intersect(const Ray &ray, const Matrix4 *obj_to_world) const override;
 		bool intersectsBound(const ExBound &eb, const Matrix4 *obj_to_world) const override;
 		bool clippingSupport() const override { return true; }
+		bool getTriangleVertices(std::array<Point3, 3> &vertices, const Matrix4 *obj_to_world) const override;
 		// return: false:=doesn't overlap bound; true:=valid clip exists
 		PolyDouble::ClipResultWithBound clipToBound(Logger &logger, const std::array<Vec3Double, 2> &bound, const ClipPlane &clip_plane, const PolyDouble &poly, const Matrix4 *obj_to_world) const override;
-		std::unique_ptr<const SurfacePoint> getSurface(const RayDifferentials *ray_differentials, const Point3 &hit_point, const IntersectData &intersect_data, const Matrix4 *obj_to_world, const Camera *camera) const override;
+		bool getSurface(SurfacePoint &sp, const RayDifferentials *ray_differentials, const Point3 &hit_point, const IntersectData &intersect_data, const Matrix4 *obj_to_world, const Camera *camera) const override;
+		Rgb getShadowTransparency(const Point3 &hit_point, const IntersectData &intersect_data, const Vec3 &wo, const Matrix4 *obj_to_world, const Camera *camera) const override;
 		float surfaceArea(const Matrix4 *obj_to_world) const override;
 		std::pair<Point3, Vec3> sample(float s_1, float s_2, const Matrix4 *obj_to_world) const override;
-		void calculateGeometricNormal() override;
 		static void calculateShadingSpace(SurfacePoint &sp);
 		static IntersectData intersect(const Ray &ray, const std::array<Point3, 3> &vertices);
 		static bool intersectsBound(const ExBound &ex_bound, const std::array<Point3, 3> &vertices);
-		static Vec3 calculateNormal(const std::array<Point3, 3> &vertices);
 		static float surfaceArea(const std::array<Point3, 3> &vertices);
 		static Point3 sample(float s_1, float s_2, const std::array<Point3, 3> &vertices);
 		//! triBoxOverlap and related functions are based on "AABB-triangle overlap test code" by Tomas Akenine-Möller
 		static bool triBoxOverlap(const Vec3Double &boxcenter, const Vec3Double &boxhalfsize, const std::array<Vec3Double, 3> &triverts);
 };
 
+inline IntersectData TrianglePrimitive::intersect(const Ray &ray, const Point3 &vertex_0, const Vec3 &edge_1, const Vec3 &edge_2, float epsilon)
+{
+	//Tomas Moller and Ben Trumbore ray intersection scheme
+	const Vec3 pvec{ray.dir_ ^ edge_2};
+	const float det = edge_1 * pvec;
+	if(det > -epsilon && det < epsilon) return {};
+	const float inv_det = 1.f / det;
+	const Vec3 tvec{ray.from_ - vertex_0};
+	const float u = (tvec * pvec) * inv_det;
+	if(u < 0.f || u > 1.f) return {};
+	const Vec3 qvec{tvec ^ edge_1};
+	const float v = (ray.dir_ * qvec) * inv_det;
+	if((v < 0.f) || ((u + v) > 1.f)) return {};
+	const float t = edge_2 * qvec * inv_det;
+	if(t < epsilon) return {};
+	IntersectData intersect_data;
+	intersect_data.hit_ = true;
+	intersect_data.t_hit_ = t;
+	//UV <-> Barycentric UVW relationship is not obvious, interesting explanation in: https://www.scratchapixel.com/lessons/3d-basic-rendering/ray-tracing-rendering-a-triangle/barycentric-coordinates
+	intersect_data.barycentric_u_ = 1.f - u - v;
+	intersect_data.barycentric_v_ = u;
+	intersect_data.barycentric_w_ = v;
+	intersect_data.time_ = ray.time_;
+	return intersect_data;
+}
+
 END_YAFARAY
 
 #endif //YAFARAY_PRIMITIVE_TRIANGLE_H
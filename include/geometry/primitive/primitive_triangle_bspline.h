@@ -28,12 +28,12 @@ BEGIN_YAFARAY
 class BsTrianglePrimitive final : public FacePrimitive
 {
 	public:
-		BsTrianglePrimitive(const std::vector<int> &vertices_indices, const std::vector<int> &vertices_uv_indices, const MeshObject &mesh_object);
+		BsTrianglePrimitive(const MeshObject &mesh_object, size_t face_index) : FacePrimitive(mesh_object, face_index) { }
 
 	private:
 		IntersectData intersect(const Ray &ray, const Matrix4 *obj_to_world) const override;
 		Bound getBound(const Matrix4 *obj_to_world) const override;
-		std::unique_ptr<const SurfacePoint> getSurface(const RayDifferentials *ray_differentials, const Point3 &hit, const IntersectData &intersect_data, const Matrix4 *obj_to_world, const Camera *camera) const override;
+		bool getSurface(SurfacePoint &sp, const RayDifferentials *ray_differentials, const Point3 &hit, const IntersectData &intersect_data, const Matrix4 *obj_to_world, const Camera *camera) const override;
 };
 
 END_YAFARAY
@@ -0,0 +1,50 @@
+#pragma once
+/****************************************************************************
+ *      This is part of the libYafaRay package
+ *
+ *      This library is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU Lesser General Public
+ *      License as published by the Free Software Foundation; either
+ *      version 2.1 of the License, or (at your option) any later version.
+ *
+ *      This library is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *      Lesser General Public License for more details.
+ *
+ *      You should have received a copy of the GNU Lesser General Public
+ *      License along with this library; if not, write to the Free Software
+ *      Foundation,Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#ifndef YAFARAY_PRIMITIVE_TRIANGLE_MOTION_H
+#define YAFARAY_PRIMITIVE_TRIANGLE_MOTION_H
+
+#include "primitive_face.h"
+#include <array>
+
+BEGIN_YAFARAY
+
+/*! a triangle of a mesh with motion blur time steps, its vertices move linearly
+	between the mesh points of consecutive time steps during the frame time */
+class MotionTrianglePrimitive final : public FacePrimitive
+{
+	public:
+		MotionTrianglePrimitive(const MeshObject &mesh_object, size_t face_index) : FacePrimitive(mesh_object, face_index) { }
+
+	private:
+		IntersectData intersect(const Ray &ray, const Matrix4 *obj_to_world) const override;
+		Bound getBound(const Matrix4 *obj_to_world) const override;
+		int numTimeSteps() const override;
+		Bound getTimeStepBound(int time_step, const Matrix4 *obj_to_world) const override;
+		bool getSurface(SurfacePoint &sp, const RayDifferentials *ray_differentials, const Point3 &hit_point, const IntersectData &intersect_data, const Matrix4 *obj_to_world, const Camera *camera) const override;
+		Rgb getShadowTransparency(const Point3 &hit_point, const IntersectData &intersect_data, const Vec3 &wo, const Matrix4 *obj_to_world, const Camera *camera) const override;
+		float surfaceArea(const Matrix4 *obj_to_world) const override;
+		std::pair<Point3, Vec3> sample(float s_1, float s_2, const Matrix4 *obj_to_world) const override;
+		std::array<Point3, 3> getVerticesTimeStep(int time_step, const Matrix4 *obj_to_world) const;
+		std::array<Point3, 3> getVerticesAtTime(float time, const Matrix4 *obj_to_world) const;
+};
+
+END_YAFARAY
+
+#endif //YAFARAY_PRIMITIVE_TRIANGLE_MOTION_H
@@ -44,19 +44,25 @@ class Ray
 		Ray(const Point3 &f, const Vec3 &d, float start = 0.f, float end = -1.f, float ftime = 0.f):
 				from_(f), dir_(d), tmin_(start), tmax_(end), time_(ftime) { }
 		Ray& operator=(Ray&& ray) = default;
+		//! the ray differentials, or nullptr if the ray does not have them
+		const RayDifferentials *getDifferentials() const { return has_differentials_ ? &differentials_ : nullptr; }
+		bool hasDifferentials() const { return has_differentials_; }
+		void setDifferentials(const RayDifferentials &differentials) { differentials_ = differentials; has_differentials_ = true; }
+		void clearDifferentials() { has_differentials_ = false; }
 		Point3 from_;
 		Vec3 dir_;
 		float tmin_ = 0.f, tmax_ = -1.f;
 		float time_ = 0.f; //!< relative frame time (values between [0;1]) at which ray was generated
-		std::unique_ptr<RayDifferentials> differentials_;
+
+	private:
+		//! Stored in the ray itself instead of allocated separately, as they are set for each camera ray and each specular bounce when the textures use mipmaps
+		RayDifferentials differentials_;
+		bool has_differentials_ = false;
 };
 
 inline Ray::Ray(const Ray &ray, DifferentialsCopy differentials_copy) : Ray{ray.from_, ray.dir_, ray.tmin_, ray.tmax_, ray.time_}
 {
-	if(differentials_copy == DifferentialsCopy::FullCopy && ray.differentials_)
-	{
-		differentials_ = std::unique_ptr<RayDifferentials>(new RayDifferentials(*ray.differentials_));
-	}
+	if(differentials_copy == DifferentialsCopy::FullCopy && ray.has_differentials_) setDifferentials(ray.differentials_);
 }
 
 END_YAFARAY
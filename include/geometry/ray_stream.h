@@ -0,0 +1,91 @@
+#pragma once
+/****************************************************************************
+ *      This is part of the libYafaRay package
+ *
+ *      This library is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU Lesser General Public
+ *      License as published by the Free Software Foundation; either
+ *      version 2.1 of the License, or (at your option) any later version.
+ *
+ *      This library is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *      Lesser General Public License for more details.
+ *
+ *      You should have received a copy of the GNU Lesser General Public
+ *      License along with this library; if not, write to the Free Software
+ *      Foundation,Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#ifndef YAFARAY_RAY_STREAM_H
+#define YAFARAY_RAY_STREAM_H
+
+#include "common/yafaray_common.h"
+#include "geometry/ray.h"
+#include <limits>
+#include <vector>
+
+BEGIN_YAFARAY
+
+/*! Batch of rays in SoA (structure of arrays) layout, to be traced together
+	by the accelerators. Each coordinate is stored in its own array so the
+	accelerators can test many rays against the same node bound in
+	vectorizable loops. Ray differentials are not stored. */
+class RayStream final
+{
+	public:
+		void reserve(size_t num_rays);
+		void clear();
+		void push(const Ray &ray, float t_max);
+		void pushShadowRay(const Ray &ray);
+		size_t size() const { return t_max_.size(); }
+		bool empty() const { return t_max_.empty(); }
+		Ray getRay(size_t ray_id) const;
+
+		std::vector<float> from_x_, from_y_, from_z_;
+		std::vector<float> dir_x_, dir_y_, dir_z_;
+		std::vector<float> t_min_;
+		std::vector<float> t_max_; //!< maximum hit distance, infinity if unlimited
+		std::vector<float> time_;
+};
+
+inline void RayStream::reserve(size_t num_rays)
+{
+	for(auto array : {&from_x_, &from_y_, &from_z_, &dir_x_, &dir_y_, &dir_z_, &t_min_, &t_max_, &time_}) array->reserve(num_rays);
+}
+
+inline void RayStream::clear()
+{
+	for(auto array : {&from_x_, &from_y_, &from_z_, &dir_x_, &dir_y_, &dir_z_, &t_min_, &t_max_, &time_}) array->clear();
+}
+
+inline void RayStream::push(const Ray &ray, float t_max)
+{
+	from_x_.push_back(ray.from_.x());
+	from_y_.push_back(ray.from_.y());
+	from_z_.push_back(ray.from_.z());
+	dir_x_.push_back(ray.dir_.x());
+	dir_y_.push_back(ray.dir_.y());
+	dir_z_.push_back(ray.dir_.z());
+	t_min_.push_back(ray.tmin_);
+	t_max_.push_back(t_max);
+	time_.push_back(ray.time_);
+}
+
+/*! Adds the ray moved to its minimum distance, the same way the Accelerator::isShadowed functions do for single rays */
+inline void RayStream::pushShadowRay(const Ray &ray)
+{
+	Ray shadow_ray(ray, Ray::DifferentialsCopy::No);
+	shadow_ray.from_ += shadow_ray.dir_ * shadow_ray.tmin_;
+	push(shadow_ray, (ray.tmax_ >= 0.f) ? shadow_ray.tmax_ - 2 * shadow_ray.tmin_ : std::numeric_limits<float>::infinity());
+}
+
+inline Ray RayStream::getRay(size_t ray_id) const
+{
+	const float t_max = t_max_[ray_id];
+	return {{from_x_[ray_id], from_y_[ray_id], from_z_[ray_id]}, {dir_x_[ray_id], dir_y_[ray_id], dir_z_[ray_id]}, t_min_[ray_id], (t_max == std::numeric_limits<float>::infinity()) ? -1.f : t_max, time_[ray_id]};
+}
+
+END_YAFARAY
+
+#endif //YAFARAY_RAY_STREAM_H
@@ -62,13 +62,15 @@ class SurfacePoint final
 		static Vec3 normalFaceForward(const Vec3 &normal_geometry, const Vec3 &normal, const Vec3 &incoming_vector);
 		static SurfacePoint blendSurfacePoints(SurfacePoint const &sp_1, SurfacePoint const &sp_2, float alpha);
 		float getDistToNearestEdge() const;
-		//! compute differentials for a scattered ray
-		std::unique_ptr<RayDifferentials> reflectedRay(const RayDifferentials *in_differentials, const Vec3 &in_dir, const Vec3 &out_dir) const;
-		//! compute differentials for a refracted ray
-		std::unique_ptr<RayDifferentials> refractedRay(const RayDifferentials *in_differentials, const Vec3 &in_dir, const Vec3 &out_dir, float ior) const;
+		//! compute differentials for a scattered ray, from the incoming ray and the scattered ray direction
+		void reflectedRay(const Ray &in_ray, Ray &out_ray) const;
+		//! compute differentials for a refracted ray, from the incoming ray and the refracted ray direction
+		void refractedRay(const Ray &in_ray, Ray &out_ray, float ior) const;
 		float projectedPixelArea();
 		void getUVdifferentials(float &du_dx, float &dv_dx, float &du_dy, float &dv_dy) const;
 		void setRayDifferentials(const RayDifferentials *ray_differentials);
+		//! the surface differentials, or nullptr if the ray hitting the surface did not have differentials
+		const SurfaceDifferentials *getDifferentials() const { return has_differentials_ ? &differentials_ : nullptr; }
 
 		const MaterialData * initBsdf(const Camera *camera);
 		Rgb eval(const Vec3 &wo, const Vec3 &wl, const BsdfFlags &types, bool force_eval = false) const;
@@ -84,7 +86,7 @@ class SurfacePoint final
 
 		//int object; //!< the object owner of the point.
 		const Material *material_; //!< the surface material
-		std::shared_ptr<const MaterialData> mat_data_;
+		MaterialDataPtr mat_data_;
 		const Light *light_; //!< light source if surface point is on a light
 		const Object *object_; //!< object the prim belongs to
 		//	point2d_t screenpos; // only used with 'win' texture coord. mode
@@ -116,10 +118,11 @@ class SurfacePoint final
 		//float dudNV;
 		//float dvdNU;
 		//float dvdNV;
-		// Surface Differentials for mipmaps calculations
-		std::shared_ptr<const SurfaceDifferentials> differentials_;
 
 	private:
+		// Surface Differentials for mipmaps calculations, stored in the surface point instead of allocated separately
+		SurfaceDifferentials differentials_;
+		bool has_differentials_ = false;
 		static void dUdvFromDpdPdUdPdV(float &du, float &dv, const Point3 &dp, const Vec3 &dp_du, const Vec3 &dp_dv);
 };
 
@@ -0,0 +1,101 @@
+#pragma once
+/****************************************************************************
+ *      This is part of the libYafaRay package
+ *
+ *      This library is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU Lesser General Public
+ *      License as published by the Free Software Foundation; either
+ *      version 2.1 of the License, or (at your option) any later version.
+ *
+ *      This library is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *      Lesser General Public License for more details.
+ *
+ *      You should have received a copy of the GNU Lesser General Public
+ *      License along with this library; if not, write to the Free Software
+ *      Foundation,Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#ifndef YAFARAY_VECTOR_PACKED_H
+#define YAFARAY_VECTOR_PACKED_H
+
+#include "geometry/vector.h"
+#include <array>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+BEGIN_YAFARAY
+
+/*! Unit vector packed in 2 x 16 bit (4 bytes instead of 12) with the octahedral mapping: the vector is projected
+	onto the octahedron |x| + |y| + |z| = 1 and the lower half of the octahedron is folded over the upper half,
+	so the whole sphere maps to the [-1, 1] square. The maximum angular error is about 0.005 degrees */
+class PackedNormal final
+{
+	public:
+		PackedNormal() = default;
+		explicit PackedNormal(const Vec3 &normal);
+		Vec3 unpack() const;
+
+	private:
+		static float signNotZero(float value) { return value >= 0.f ? 1.f : -1.f; }
+		static int16_t toSnorm16(float value) { return static_cast<int16_t>(std::lround(std::min(std::max(value, -1.f), 1.f) * 32767.f)); }
+		std::array<int16_t, 2> xy_ {{0, 0}};
+};
+
+inline PackedNormal::PackedNormal(const Vec3 &normal)
+{
+	const float l_1_norm = std::abs(normal.x()) + std::abs(normal.y()) + std::abs(normal.z());
+	if(l_1_norm <= 0.f) return;
+	float x = normal.x() / l_1_norm;
+	float y = normal.y() / l_1_norm;
+	if(normal.z() < 0.f)
+	{
+		const float folded_x = (1.f - std::abs(y)) * signNotZero(x);
+		y = (1.f - std::abs(x)) * signNotZero(y);
+		x = folded_x;
+	}
+	xy_ = {{toSnorm16(x), toSnorm16(y)}};
+}
+
+inline Vec3 PackedNormal::unpack() const
+{
+	float x = xy_[0] * (1.f / 32767.f);
+	float y = xy_[1] * (1.f / 32767.f);
+	const float z = 1.f - std::abs(x) - std::abs(y);
+	if(z < 0.f)
+	{
+		//Unfolding the lower half of the octahedron
+		x += x >= 0.f ? z : -z;
+		y += y >= 0.f ? z : -z;
+	}
+	return Vec3{x, y, z}.normalize();
+}
+
+/*! Range of values packed in 16 bit fixed point, with 65536 evenly spaced steps between its minimum and its maximum.
+	It is shared by all the values of an array, for example the u coordinates of all the uv values of a mesh */
+class PackedRange final
+{
+	public:
+		PackedRange() = default;
+		PackedRange(float min, float max) : min_(min), step_(max > min ? (max - min) / 65535.f : 0.f) { }
+		uint16_t pack(float value) const;
+		float unpack(uint16_t value) const { return min_ + value * step_; }
+
+	private:
+		float min_ = 0.f;
+		float step_ = 0.f; //!< difference between consecutive packed values, 0 when all the values are the same
+};
+
+inline uint16_t PackedRange::pack(float value) const
+{
+	if(step_ <= 0.f) return 0;
+	const float steps = (value - min_) / step_;
+	if(!(steps > 0.f)) return 0; //Also for NaN values
+	return static_cast<uint16_t>(std::lround(std::min(steps, 65535.f)));
+}
+
+END_YAFARAY
+
+#endif //YAFARAY_VECTOR_PACKED_H
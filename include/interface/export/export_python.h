@@ -42,13 +42,22 @@ class ExportPython: public Interface
 		unsigned int getNextFreeId() noexcept override;
 		bool endObject() noexcept override;
 		bool addInstance(const char *base_object_name, const Matrix4 &obj_to_world) noexcept override;
+		bool addInstanceTimeSteps(const char *base_object_name, const std::vector<Matrix4> &obj_to_world_time_steps) noexcept override;
 		int  addVertex(double x, double y, double z) noexcept override; //!< add vertex to mesh; returns index to be used for addTriangle
 		int  addVertex(double x, double y, double z, double ox, double oy, double oz) noexcept override; //!< add vertex with Orco to mesh; returns index to be used for addTriangle
+		int  addVertexTimeStep(double x, double y, double z, int time_step) noexcept override;
 		void addNormal(double nx, double ny, double nz) noexcept override; //!< add vertex normal to mesh; the vertex that will be attached to is the last one inserted by addVertex method
 		bool addFace(int a, int b, int c) noexcept override;
 		bool addFace(int a, int b, int c, int uv_a, int uv_b, int uv_c) noexcept override;
 		int  addUv(float u, float v) noexcept override;
+		int  addVertices(const float *points, const float *orco_points, int num_points) noexcept override { return addVerticesOneByOne(points, orco_points, num_points); }
+		bool addNormals(const float *normals, int num_normals) noexcept override { return addNormalsOneByOne(normals, num_normals); }
+		bool addFaces(const int *vertex_indices, const int *uv_indices, int num_faces) noexcept override { return addFacesOneByOne(vertex_indices, uv_indices, num_faces); }
+		int  addUvs(const float *uvs, int num_uvs) noexcept override { return addUvsOneByOne(uvs, num_uvs); }
+		bool setExternalVertices(const float *points, int stride, int num_points, yafaray_BufferReleaseCallback_t release_callback, void *callback_data) noexcept override { return setExternalVerticesOneByOne(points, stride, num_points, release_callback, callback_data); }
+		bool setExternalTriangles(const int *vertex_indices, int stride, int num_triangles, yafaray_BufferReleaseCallback_t release_callback, void *callback_data) noexcept override { return setExternalTrianglesOneByOne(vertex_indices, stride, num_triangles, release_callback, callback_data); }
 		bool smoothMesh(const char *name, double angle) noexcept override;
+		bool updateObjectPoints(const char *name, const float *points, int num_points) noexcept override;
 		void setCurrentMaterial(const char *name) noexcept override;
 		Object *createObject(const char *name) noexcept override;
 		Light *createLight(const char *name) noexcept override;
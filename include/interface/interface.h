@@ -66,12 +66,21 @@ class Interface
 		virtual bool endObject() noexcept; //!< end current mesh and return to geometry state
 		virtual int  addVertex(double x, double y, double z) noexcept; //!< add vertex to mesh; returns index to be used for addTriangle
 		virtual int  addVertex(double x, double y, double z, double ox, double oy, double oz) noexcept; //!< add vertex with Orco to mesh; returns index to be used for addTriangle
+		virtual int  addVertexTimeStep(double x, double y, double z, int time_step) noexcept; //!< add the position of an already added vertex in a motion blur time step >= 1 of a mesh created with "time_steps" > 1; returns its index within the time step
 		virtual void addNormal(double nx, double ny, double nz) noexcept; //!< add vertex normal to mesh; the vertex that will be attached to is the last one inserted by addVertex method
 		virtual bool addFace(int a, int b, int c) noexcept; //!< add a triangle given vertex indices and material pointer
 		virtual bool addFace(int a, int b, int c, int uv_a, int uv_b, int uv_c) noexcept; //!< add a triangle given vertex and uv indices and material pointer
 		virtual int  addUv(float u, float v) noexcept; //!< add a UV coordinate pair; returns index to be used for addTriangle
+		virtual int  addVertices(const float *points, const float *orco_points, int num_points) noexcept; //!< add an array of vertices to mesh, given as consecutive x, y, z coordinates, and optionally their orco points (or nullptr); returns the index of the first vertex added
+		virtual bool addNormals(const float *normals, int num_normals) noexcept; //!< add an array of vertex normals to mesh, given as consecutive x, y, z coordinates, one per vertex in the same order as the vertices
+		virtual bool addFaces(const int *vertex_indices, const int *uv_indices, int num_faces) noexcept; //!< add an array of triangles given three vertex indices per triangle and optionally three uv indices per triangle (or nullptr)
+		virtual int  addUvs(const float *uvs, int num_uvs) noexcept; //!< add an array of UV coordinate pairs given as consecutive u, v values; returns the index of the first one added
+		virtual bool setExternalVertices(const float *points, int stride, int num_points, yafaray_BufferReleaseCallback_t release_callback, void *callback_data) noexcept; //!< use the client array of x, y, z coordinates as the vertices of the mesh without copying it, with "stride" bytes between vertices (0 if packed); the release callback is called when it is not needed any more
+		virtual bool setExternalTriangles(const int *vertex_indices, int stride, int num_triangles, yafaray_BufferReleaseCallback_t release_callback, void *callback_data) noexcept; //!< use the client array of three vertex indices per triangle as the triangles of the mesh without copying it, with "stride" bytes between triangles (0 if packed); the release callback is called when it is not needed any more
 		virtual bool smoothMesh(const char *name, double angle) noexcept; //!< smooth vertex normals of mesh with given ID and angle (in degrees)
+		virtual bool updateObjectPoints(const char *name, const float *points, int num_points) noexcept; //!< move all the points of an existing mesh, given as consecutive x, y, z coordinates, keeping its faces
 		virtual bool addInstance(const char *base_object_name, const Matrix4 &obj_to_world) noexcept;
+		virtual bool addInstanceTimeSteps(const char *base_object_name, const std::vector<Matrix4> &obj_to_world_time_steps) noexcept; //!< add an instance moving linearly between the matrices of the motion blur time steps, uniformly distributed in the frame time
 		virtual void paramsSetVector(const char *name, double x, double y, double z) noexcept;
 		virtual void paramsSetString(const char *name, const char *s) noexcept;
 		virtual void paramsSetBool(const char *name, bool b) noexcept;
@@ -108,6 +117,7 @@ class Interface
 		virtual void clearAll() noexcept;
 		virtual void setupRender() noexcept;
 		virtual void render(std::shared_ptr<ProgressBar> progress_bar) noexcept; //!< render the scene...
+		virtual bool benchmarkAccelerators(const char *ray_dump_path) noexcept; //!< replay the accelerator queries recorded in a ray dump file against all the accelerator types
 		virtual void defineLayer() noexcept;
 		virtual void cancel() noexcept;
 
@@ -125,6 +135,12 @@ class Interface
 
 	protected:
 		virtual void setCurrentMaterial(const std::unique_ptr<const Material> *material) noexcept;
+		int addVerticesOneByOne(const float *points, const float *orco_points, int num_points) noexcept;
+		bool addNormalsOneByOne(const float *normals, int num_normals) noexcept;
+		bool addFacesOneByOne(const int *vertex_indices, const int *uv_indices, int num_faces) noexcept;
+		int addUvsOneByOne(const float *uvs, int num_uvs) noexcept;
+		bool setExternalVerticesOneByOne(const float *points, int stride, int num_points, yafaray_BufferReleaseCallback_t release_callback, void *callback_data) noexcept;
+		bool setExternalTrianglesOneByOne(const int *vertex_indices, int stride, int num_triangles, yafaray_BufferReleaseCallback_t release_callback, void *callback_data) noexcept;
 		std::unique_ptr<Logger> logger_;
 		std::unique_ptr<ParamMap> params_;
 		std::list<ParamMap> nodes_params_; //! for materials that need to define a whole shader tree etc.
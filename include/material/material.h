@@ -24,6 +24,7 @@
 #include "common/flags.h"
 #include "common/visibility.h"
 #include "shader/shader_node.h"
+#include "common/memory_pool.h"
 #include <list>
 
 BEGIN_YAFARAY
@@ -63,13 +64,41 @@ struct BsdfFlags : public Flags
 	};
 };
 
+/*! Material data calculated by Material::initBsdf for a surface point. It is created for each ray hit, so it is
+	allocated from the memory pool of the thread instead of the global allocator */
 class MaterialData
 {
 	public:
 		MaterialData(BsdfFlags bsdf_flags, size_t number_of_nodes) : bsdf_flags_(bsdf_flags), node_tree_data_(number_of_nodes) { }
 		virtual ~MaterialData() = default;
+		static void *operator new(size_t size) { return MemoryPool::allocate(size); }
+		static void operator delete(void *block, size_t size) { MemoryPool::deallocate(block, size); }
 		BsdfFlags bsdf_flags_;
 		NodeTreeData node_tree_data_;
+
+	private:
+		friend class MaterialDataPtr;
+		mutable unsigned int num_references_ = 0; //!< number of MaterialDataPtr pointing to this material data
+};
+
+/*! Shared ownership of a MaterialData, used by a surface point and its copies. The surface points are created and
+	used by a single thread, so unlike std::shared_ptr the reference count is neither atomic nor allocated separately */
+class MaterialDataPtr final
+{
+	public:
+		MaterialDataPtr() = default;
+		explicit MaterialDataPtr(const MaterialData *mat_data) : mat_data_(mat_data) { addReference(); }
+		MaterialDataPtr(const MaterialDataPtr &mat_data_ptr) : mat_data_(mat_data_ptr.mat_data_) { addReference(); }
+		MaterialDataPtr(MaterialDataPtr &&mat_data_ptr) noexcept : mat_data_(mat_data_ptr.mat_data_) { mat_data_ptr.mat_data_ = nullptr; }
+		MaterialDataPtr &operator=(MaterialDataPtr mat_data_ptr) noexcept { std::swap(mat_data_, mat_data_ptr.mat_data_); return *this; }
+		~MaterialDataPtr() { if(mat_data_ && --mat_data_->num_references_ == 0) delete mat_data_; }
+		const MaterialData *get() const { return mat_data_; }
+		const MaterialData *operator->() const { return mat_data_; }
+		explicit operator bool() const { return mat_data_ != nullptr; }
+
+	private:
+		void addReference() const { if(mat_data_) ++mat_data_->num_references_; }
+		const MaterialData *mat_data_ = nullptr;
 };
 
 struct DirectionColor
@@ -123,6 +152,10 @@ class Material
 		/*!	used for computing transparent shadows.	Default implementation returns black (i.e. solid shadow).
 			This is only used for shadow calculations and may only be called when isTransparent returned true.	*/
 		virtual Rgb getTransparency(const MaterialData *mat_data, const SurfacePoint &sp, const Vec3 &wo, const Camera *camera) const { return Rgb{0.f}; }
+		/*!	lighter getTransparency used by the accelerators for transparent shadows. Note that in this case initBSDF was NOT
+			called before, the surface point only has the geometry data and it can be modified (i.e. by bump mapping). The
+			default implementation calls initBSDF anyway, materials can instead evaluate only the data needed for the transparency */
+		virtual Rgb getShadowTransparency(SurfacePoint &sp, const Vec3 &wo, const Camera *camera) const;
 		/*! evaluate the specular components for given direction. Somewhat a specialization of sample(),
 			because neither sample values nor pdf values are necessary for this.
 			Typical use: recursive raytracing of integrators. */
@@ -47,11 +47,15 @@ class NodeMaterial: public Material
 		static std::set<const ShaderNode *> recursiveFinder(const ShaderNode *node);
 		static std::vector<const ShaderNode *> solveNodesOrder(const std::vector<const ShaderNode *> &roots, const std::map<std::string, std::unique_ptr<ShaderNode>> &shaders_table, Logger &logger);
 		static std::vector<const ShaderNode *> getNodeList(const ShaderNode *root, const std::vector<const ShaderNode *> &nodes_sorted);
+		static std::vector<const ShaderNode *> getNodeList(const std::vector<const ShaderNode *> &roots, const std::vector<const ShaderNode *> &nodes_sorted);
+		/*! evaluates the bump mapping, if any, and the nodes needed by getShadowTransparency */
+		NodeTreeData evalTransparencyNodes(SurfacePoint &sp, const ShaderNode *bump_shader_node, const Camera *camera) const;
 		/*! load nodes from parameter map list */
 		static std::map<std::string, std::unique_ptr<ShaderNode>> loadNodes(const std::list<ParamMap> &params_list, const Scene &scene, Logger &logger);
 
 		std::map<std::string, std::unique_ptr<ShaderNode>> nodes_map_;
 		std::vector<const ShaderNode *> color_nodes_, bump_nodes_;
+		std::vector<const ShaderNode *> transparency_nodes_; //!< nodes needed by getShadowTransparency, in evaluation order
 };
 
 END_YAFARAY
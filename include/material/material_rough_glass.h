@@ -45,6 +45,8 @@ class RoughGlassMaterial final : public NodeMaterial
 		float pdf(const MaterialData *mat_data, const SurfacePoint &sp, const Vec3 &wo, const Vec3 &wi, const BsdfFlags &bsdfs) const override { return 0.f; }
 		bool isTransparent() const override { return fake_shadow_; }
 		Rgb getTransparency(const MaterialData *mat_data, const SurfacePoint &sp, const Vec3 &wo, const Camera *camera) const override;
+		Rgb getShadowTransparency(SurfacePoint &sp, const Vec3 &wo, const Camera *camera) const override;
+		Rgb getTransparency(const NodeTreeData &node_tree_data, const SurfacePoint &sp, const Vec3 &wo) const;
 		float getAlpha(const MaterialData *mat_data, const SurfacePoint &sp, const Vec3 &wo, const Camera *camera) const override;
 		float getMatIor() const override;
 		Rgb getGlossyColor(const NodeTreeData &node_tree_data) const override;
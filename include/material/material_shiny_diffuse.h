@@ -59,6 +59,7 @@ class ShinyDiffuseMaterial final : public NodeMaterial
 		float pdf(const MaterialData *mat_data, const SurfacePoint &sp, const Vec3 &wo, const Vec3 &wi, const BsdfFlags &bsdfs) const override;
 		bool isTransparent() const override { return is_transparent_; }
 		Rgb getTransparency(const MaterialData *mat_data, const SurfacePoint &sp, const Vec3 &wo, const Camera *camera) const override;
+		Rgb getShadowTransparency(SurfacePoint &sp, const Vec3 &wo, const Camera *camera) const override;
 		Rgb emit(const MaterialData *mat_data, const SurfacePoint &sp, const Vec3 &wo) const override; // { return emitCol; }
 		Specular getSpecular(int ray_level, const MaterialData *mat_data, const SurfacePoint &sp, const Vec3 &wo, bool chromatic, float wavelength) const override;
 		float getAlpha(const MaterialData *mat_data, const SurfacePoint &sp, const Vec3 &wo, const Camera *camera) const override;
@@ -71,6 +72,7 @@ class ShinyDiffuseMaterial final : public NodeMaterial
 		void config();
 		std::array<float, 4> getComponents(const std::array<bool, 4> &use_nodes, const NodeTreeData &node_tree_data) const;
 		float getFresnelKr(const Vec3 &wo, const Vec3 &n, float current_ior_squared) const;
+		Rgb getTransparency(const NodeTreeData &node_tree_data, const SurfacePoint &sp, const Vec3 &wo) const;
 		void initOrenNayar(double sigma);
 		float orenNayar(const Vec3 &wi, const Vec3 &wo, const Vec3 &n, bool use_texture_sigma, double texture_sigma) const;
 		static std::array<float, 4> accumulate(const std::array<float, 4> &components, float kr);
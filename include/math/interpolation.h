@@ -59,6 +59,16 @@ inline Y lerpSegment(const X &x, const Y &y_1, const X &x_1, const Y &y_2, const
 	return y_1 + ((diff_alpha_x1 / diff_x2_x1) * diff_y2_y1);
 }
 
+/*! For samples uniformly distributed in [0;1], returns the index of the first sample of
+	the segment containing x and sets the relative position of x in that segment in [0;1] */
+inline int uniformSegment(float x, int num_samples, float &segment_x)
+{
+	const float position = std::max(0.f, std::min(x, 1.f)) * static_cast<float>(num_samples - 1);
+	const int segment = std::min(static_cast<int>(position), num_samples - 2);
+	segment_x = position - static_cast<float>(segment);
+	return segment;
+}
+
 template<typename Y, typename X>
 inline Y cosineInterpolate(const Y &y_1, const Y &y_2, const X &x)
 {
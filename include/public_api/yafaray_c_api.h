@@ -47,6 +47,7 @@ extern "C" {
 	typedef void (*yafaray_RenderHighlightPixelCallback_t)(const char *view_name, int x, int y, float r, float g, float b, float a, void *callback_data);
 	typedef void (*yafaray_ProgressBarCallback_t)(int steps_total, int steps_done, const char *tag, void *callback_data);
 	typedef void (*yafaray_LoggerCallback_t)(yafaray_LogLevel_t log_level, long datetime, const char *time_of_day, const char *description, void *callback_data);
+	typedef void (*yafaray_BufferReleaseCallback_t)(const void *buffer, void *callback_data);
 
 	/* C API Public functions.
 	 * In the source code the YafaRay developers *MUST* ensure that each of them appears in the Exported Symbols Map file with the correct annotated version */
@@ -62,13 +63,24 @@ extern "C" {
 	YAFARAY_C_API_EXPORT yafaray_bool_t yafaray_endObject(yafaray_Interface_t *interface);
 	YAFARAY_C_API_EXPORT int yafaray_addVertex(yafaray_Interface_t *interface, double x, double y, double z);
 	YAFARAY_C_API_EXPORT int yafaray_addVertexWithOrco(yafaray_Interface_t *interface, double x, double y, double z, double ox, double oy, double oz);
+	YAFARAY_C_API_EXPORT int yafaray_addVertexTimeStep(yafaray_Interface_t *interface, double x, double y, double z, int time_step);
 	YAFARAY_C_API_EXPORT void yafaray_addNormal(yafaray_Interface_t *interface, double nx, double ny, double nz);
 	YAFARAY_C_API_EXPORT yafaray_bool_t yafaray_addTriangle(yafaray_Interface_t *interface, int a, int b, int c);
 	YAFARAY_C_API_EXPORT yafaray_bool_t yafaray_addTriangleWithUv(yafaray_Interface_t *interface, int a, int b, int c, int uv_a, int uv_b, int uv_c);
 	YAFARAY_C_API_EXPORT int yafaray_addUv(yafaray_Interface_t *interface, float u, float v);
+	YAFARAY_C_API_EXPORT int yafaray_addVertices(yafaray_Interface_t *interface, const float *points, int num_points);
+	YAFARAY_C_API_EXPORT int yafaray_addVerticesWithOrco(yafaray_Interface_t *interface, const float *points, const float *orco_points, int num_points);
+	YAFARAY_C_API_EXPORT yafaray_bool_t yafaray_addNormals(yafaray_Interface_t *interface, const float *normals, int num_normals);
+	YAFARAY_C_API_EXPORT yafaray_bool_t yafaray_addTriangles(yafaray_Interface_t *interface, const int *vertex_indices, int num_triangles);
+	YAFARAY_C_API_EXPORT yafaray_bool_t yafaray_addTrianglesWithUv(yafaray_Interface_t *interface, const int *vertex_indices, const int *uv_indices, int num_triangles);
+	YAFARAY_C_API_EXPORT int yafaray_addUvs(yafaray_Interface_t *interface, const float *uvs, int num_uvs);
+	YAFARAY_C_API_EXPORT yafaray_bool_t yafaray_setExternalVertices(yafaray_Interface_t *interface, const float *points, int stride, int num_points, yafaray_BufferReleaseCallback_t release_callback, void *callback_data);
+	YAFARAY_C_API_EXPORT yafaray_bool_t yafaray_setExternalTriangles(yafaray_Interface_t *interface, const int *vertex_indices, int stride, int num_triangles, yafaray_BufferReleaseCallback_t release_callback, void *callback_data);
 	YAFARAY_C_API_EXPORT yafaray_bool_t yafaray_smoothMesh(yafaray_Interface_t *interface, const char *name, double angle);
+	YAFARAY_C_API_EXPORT yafaray_bool_t yafaray_updateObjectPoints(yafaray_Interface_t *interface, const char *name, const float *points, int num_points);
 	YAFARAY_C_API_EXPORT yafaray_bool_t yafaray_addInstance(yafaray_Interface_t *interface, const char *base_object_name, float m_00, float m_01, float m_02, float m_03, float m_10, float m_11, float m_12, float m_13, float m_20, float m_21, float m_22, float m_23, float m_30, float m_31, float m_32, float m_33);
 	YAFARAY_C_API_EXPORT yafaray_bool_t yafaray_addInstanceArray(yafaray_Interface_t *interface, const char *base_object_name, const float obj_to_world[4][4]);
+	YAFARAY_C_API_EXPORT yafaray_bool_t yafaray_addInstanceTimeSteps(yafaray_Interface_t *interface, const char *base_object_name, const float obj_to_world_time_steps[][4][4], int num_time_steps);
 	YAFARAY_C_API_EXPORT void yafaray_paramsSetVector(yafaray_Interface_t *interface, const char *name, double x, double y, double z);
 	YAFARAY_C_API_EXPORT void yafaray_paramsSetString(yafaray_Interface_t *interface, const char *name, const char *s);
 	YAFARAY_C_API_EXPORT void yafaray_paramsSetBool(yafaray_Interface_t *interface, const char *name, yafaray_bool_t b);
@@ -103,6 +115,7 @@ extern "C" {
 	YAFARAY_C_API_EXPORT void yafaray_clearAll(yafaray_Interface_t *interface);
 	YAFARAY_C_API_EXPORT void yafaray_setupRender(yafaray_Interface_t *interface);
 	YAFARAY_C_API_EXPORT void yafaray_render(yafaray_Interface_t *interface, yafaray_ProgressBarCallback_t monitor_callback, void *callback_data, yafaray_DisplayConsole_t progress_bar_display_console);
+	YAFARAY_C_API_EXPORT yafaray_bool_t yafaray_benchmarkAccelerators(yafaray_Interface_t *interface, const char *ray_dump_path);
 	YAFARAY_C_API_EXPORT void yafaray_defineLayer(yafaray_Interface_t *interface);
 	YAFARAY_C_API_EXPORT void yafaray_enablePrintDateTime(yafaray_Interface_t *interface, yafaray_bool_t value);
 	YAFARAY_C_API_EXPORT void yafaray_setConsoleVerbosityLevel(yafaray_Interface_t *interface, yafaray_LogLevel_t log_level);
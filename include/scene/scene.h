@@ -57,6 +57,10 @@ class SurfacePoint;
 class Matrix4;
 class Rgb;
 class Accelerator;
+class Primitive;
+class RayDump;
+struct Uv;
+class ExternalBuffer;
 enum class DarkDetectionType : int;
 
 typedef unsigned int ObjId_t;
@@ -69,14 +73,25 @@ class Scene final
 		~Scene();
 		int addVertex(const Point3 &p);
 		int addVertex(const Point3 &p, const Point3 &orco);
+		int addVertexTimeStep(const Point3 &p, int time_step);
 		void addNormal(const Vec3 &n);
 		bool addFace(const std::vector<int> &vert_indices, const std::vector<int> &uv_indices = {});
 		int addUv(float u, float v);
+		int addVertices(std::vector<Point3> &&points, std::vector<Point3> &&orco_points = {});
+		bool addNormals(std::vector<Vec3> &&normals);
+		bool addFaces(std::vector<uint32_t> &&vertex_indices, std::vector<uint32_t> &&uv_indices = {});
+		int addUvs(std::vector<Uv> &&uv_values);
+		bool setExternalPoints(std::unique_ptr<const ExternalBuffer> points);
+		bool setExternalFaces(std::unique_ptr<const ExternalBuffer> vertex_indices);
 		bool smoothNormals(const std::string &name, float angle);
 		Object *createObject(const std::string &name, const ParamMap &params);
 		bool endObject();
 		bool addInstance(const std::string &base_object_name, const Matrix4 &obj_to_world);
+		bool addInstance(const std::string &base_object_name, const std::vector<Matrix4> &obj_to_world_time_steps);
+		bool updateObjectPoints(const std::string &name, const std::vector<Point3> &points);
 		bool updateObjects();
+		bool refitObjects();
+		bool benchmarkAccelerators(const std::string &ray_dump_path);
 		Object *getObject(const std::string &name) const;
 		const Accelerator *getAccelerator() const { return accelerator_.get(); }
 
@@ -169,13 +184,15 @@ class Scene final
 		void setEdgeToonParams(const ParamMap &params);
 		template <typename T> static T *createMapItem(Logger &logger, const std::string &name, const std::string &class_name, const ParamMap &params, std::map<std::string, std::unique_ptr<T>> &map, Scene *scene, bool check_type_exists = true);
 		template <typename T> static std::shared_ptr<T> createMapItem(Logger &logger, const std::string &name, const std::string &class_name, const ParamMap &params, std::map<std::string, std::shared_ptr<T>> &map, Scene *scene, bool check_type_exists = true);
+		void getAcceleratorPrimitives(std::vector<const Primitive *> &primitives, std::vector<const Object *> &instances);
+		std::unique_ptr<Accelerator> createAccelerator(const std::string &type, const std::vector<const Primitive *> &primitives, const std::vector<const Object *> &instances, bool use_cache) const;
 		void defineBasicLayers();
 		void defineDependentLayers(); //!< This function generates the basic/auxiliary layers. Must be called *after* defining all render layers with the defineLayer function.
 
 		struct CreationState
 		{
 			enum State { Ready, Geometry, Object };
-			enum Flags { CNone = 0, CGeom = 1, CLight = 1 << 1, CMaterial = 1 << 2, COther = 1 << 3, CAll = CGeom | CLight | CMaterial | COther };
+			enum Flags { CNone = 0, CGeom = 1, CLight = 1 << 1, CMaterial = 1 << 2, COther = 1 << 3, CGeomPoints = 1 << 4, CAll = CGeom | CLight | CMaterial | COther }; //CGeomPoints: only mesh points moved, refitting the accelerator is enough
 			std::list<State> stack_;
 			unsigned int changes_;
 			ObjId_t next_free_id_;
@@ -183,7 +200,15 @@ class Scene final
 		} creation_state_;
 		Bound scene_bound_; //!< bounding box of all (finite) scene geometry
 		std::string scene_accelerator_;
-		std::unique_ptr<const Accelerator> accelerator_;
+		bool accelerator_precompute_triangles_ = false;
+		bool accelerator_compressed_nodes_ = false; //!< quantized node bounds in the "yafaray-bvh4" accelerator, using less memory but slower
+		bool accelerator_two_level_instances_ = true;
+		int accelerator_treelet_passes_ = 1; //!< quality/speed of the "yafaray-lbvh" accelerator build, 0 for the fastest build
+		float accelerator_spatial_split_budget_ = 0.3f; //!< maximum duplicated primitive references of the "yafaray-sbvh" accelerator, relative to the number of primitives
+		std::string accelerator_cache_dir_; //!< if not empty, directory to save and load the built accelerator trees
+		std::string accelerator_ray_dump_path_; //!< if not empty, the accelerator queries of the renders are recorded into this file
+		std::unique_ptr<Accelerator> accelerator_;
+		std::unique_ptr<RayDump> ray_dump_;
 		Object *current_object_ = nullptr;
 		std::map<std::string, std::unique_ptr<Object>> objects_;
 		std::map<std::string, std::unique_ptr<Light>> lights_;
@@ -24,6 +24,7 @@
 #include "scene/scene.h"
 #include "color/color.h"
 #include "common/collection.h"
+#include "common/memory_pool.h"
 #include <list>
 #include <map>
 
@@ -48,7 +49,7 @@ class NodeTreeData final
 		const NodeResult &operator()(unsigned int id) const { return node_results_[id]; }
 		NodeResult &operator[](unsigned int id) { return node_results_[id]; }
 	private:
-		std::vector<NodeResult> node_results_;
+		std::vector<NodeResult, MemoryPoolAllocator<NodeResult>> node_results_; //!< created for each ray hit, so they use the thread memory pool
 };
 
 class NodeFinder final : public Collection<std::string, const ShaderNode *>
@@ -17,19 +17,60 @@
  */
 
 #include "accelerator/accelerator.h"
+#include "accelerator/accelerator_bvh.h"
+#include "accelerator/accelerator_bvh4.h"
 #include "accelerator/accelerator_kdtree.h"
 #include "accelerator/accelerator_kdtree_multi_thread.h"
 #include "accelerator/accelerator_simple_test.h"
+#include "accelerator/ray_dump.h"
 #include "common/logger.h"
 #include "common/param.h"
 #include "geometry/surface.h"
+#include "geometry/matrix4.h"
+#include "geometry/ray_stream.h"
 #include "render/render_data.h"
 #include "geometry/primitive/primitive_face.h"
 #include "integrator/integrator.h"
+#include "material/material.h"
 
 BEGIN_YAFARAY
 
-const Accelerator * Accelerator::factory(Logger &logger, const std::vector<const Primitive *> &primitives_list, const ParamMap &params)
+/*! Last primitive found blocking a shadow ray in each thread. Consecutive shadow rays from a shading point
+	to an area light are usually blocked by the same primitive, so it is tested before the full traversal */
+struct Accelerator::ShadowRayCache
+{
+	uint64_t accelerator_id_ = 0;
+	const Primitive *occluder_ = nullptr;
+	const Matrix4 *obj_to_world_ = nullptr; //!< transformation matrix of the occluder instance, if the occluder was found in object space
+	int obj_to_world_time_steps_ = 1;
+	uint32_t num_shadow_rays_ = 0; //!< statistics not added yet to the accelerator totals
+	uint32_t num_occluder_cache_hits_ = 0;
+	static constexpr uint32_t stats_batch_size_ = 1024; //!< shadow rays counted in each thread before adding them to the accelerator totals, to avoid contention in the atomic counters
+};
+
+constexpr uint32_t Accelerator::ShadowRayCache::stats_batch_size_;
+
+/*! Rays of a batch not blocked by the last occluder, traced together. Kept by each thread and reused, so the batches do not allocate memory */
+struct Accelerator::ShadowRayStream
+{
+	void clear() { rays_.clear(); ray_ids_.clear(); }
+	RayStream rays_;
+	std::vector<size_t> ray_ids_; //!< position of each ray in the batch
+	std::vector<AcceleratorIntersectData> results_;
+	std::vector<AcceleratorTsIntersectData> transparent_results_;
+};
+
+static uint64_t newAcceleratorId()
+{
+	static std::atomic<uint64_t> last_accelerator_id { 0 };
+	return ++last_accelerator_id;
+}
+
+Accelerator::Accelerator(Logger &logger) : logger_(logger), id_(newAcceleratorId())
+{
+}
+
+Accelerator * Accelerator::factory(Logger &logger, const std::vector<const Primitive *> &primitives_list, const ParamMap &params)
 {
 	if(logger.isDebug())
 	{
@@ -38,9 +79,11 @@ const Accelerator * Accelerator::factory(Logger &logger, const std::vector<const
 	}
 	std::string type;
 	params.getParam("type", type);
-	const Accelerator *accelerator = nullptr;
+	Accelerator *accelerator = nullptr;
 	if(type == "yafaray-kdtree-original") accelerator = AcceleratorKdTree::factory(logger, primitives_list, params);
 	else if(type == "yafaray-kdtree-multi-thread") accelerator = AcceleratorKdTreeMultiThread::factory(logger, primitives_list, params);
+	else if(type == "yafaray-bvh" || type == "yafaray-lbvh" || type == "yafaray-sbvh") accelerator = AcceleratorBvh::factory(logger, primitives_list, params);
+	else if(type == "yafaray-bvh4") accelerator = AcceleratorBvh4::factory(logger, primitives_list, params);
 	else if(type == "yafaray-simpletest") accelerator = AcceleratorSimpleTest::factory(logger, primitives_list, params);
 
 	if(accelerator) logger.logInfo("Accelerator type '", type, "' created.");
@@ -52,27 +95,124 @@ const Accelerator * Accelerator::factory(Logger &logger, const std::vector<const
 	return accelerator;
 }
 
-std::pair<std::unique_ptr<const SurfacePoint>, float> Accelerator::intersect(const Ray &ray, const Camera *camera) const
+std::pair<bool, float> Accelerator::intersect(const Ray &ray, const Camera *camera, SurfacePoint &sp) const
 {
 	const float t_max = (ray.tmax_ >= 0.f) ? ray.tmax_ : std::numeric_limits<float>::infinity();
+	if(ray_dump_) ray_dump_->record(RayDump::Query::ClosestHit, ray, t_max);
 	// intersect with tree:
 	const AcceleratorIntersectData accelerator_intersect_data = intersect(ray, t_max);
 	if(accelerator_intersect_data.hit_ && accelerator_intersect_data.hit_primitive_)
 	{
 		const Point3 hit_point{ray.from_ + accelerator_intersect_data.t_max_ * ray.dir_};
-		auto sp = accelerator_intersect_data.hit_primitive_->getSurface(ray.differentials_.get(), hit_point, accelerator_intersect_data, nullptr, camera);
-		return {std::move(sp), accelerator_intersect_data.t_max_};
+		if(accelerator_intersect_data.obj_to_world_time_steps_ > 1)
+		{
+			const Matrix4 obj_to_world {Matrix4::interpolate(accelerator_intersect_data.obj_to_world_, accelerator_intersect_data.obj_to_world_time_steps_, accelerator_intersect_data.time_)};
+			const bool hit = accelerator_intersect_data.hit_primitive_->getSurface(sp, ray.getDifferentials(), hit_point, accelerator_intersect_data, &obj_to_world, camera);
+			return {hit, accelerator_intersect_data.t_max_};
+		}
+		const bool hit = accelerator_intersect_data.hit_primitive_->getSurface(sp, ray.getDifferentials(), hit_point, accelerator_intersect_data, accelerator_intersect_data.obj_to_world_, camera);
+		return {hit, accelerator_intersect_data.t_max_};
+	}
+	return {false, ray.tmax_};
+}
+
+void Accelerator::intersect(const RayStream &rays, std::vector<AcceleratorIntersectData> &results) const
+{
+	results.resize(rays.size());
+	for(size_t ray_id = 0; ray_id < rays.size(); ++ray_id) results[ray_id] = intersect(rays.getRay(ray_id), rays.t_max_[ray_id]);
+}
+
+void Accelerator::intersectS(const RayStream &rays, float shadow_bias, std::vector<AcceleratorIntersectData> &results) const
+{
+	results.resize(rays.size());
+	for(size_t ray_id = 0; ray_id < rays.size(); ++ray_id) results[ray_id] = intersectS(rays.getRay(ray_id), rays.t_max_[ray_id], shadow_bias);
+}
+
+void Accelerator::intersectTs(const RayStream &rays, int max_depth, float shadow_bias, const Camera *camera, std::vector<AcceleratorTsIntersectData> &results) const
+{
+	results.resize(rays.size());
+	for(size_t ray_id = 0; ray_id < rays.size(); ++ray_id) results[ray_id] = intersectTs(rays.getRay(ray_id), max_depth, rays.t_max_[ray_id], shadow_bias, camera);
+}
+
+/*! The cache of the calling thread is reset when used with a different accelerator. The statistics
+	pending in the cache are then discarded, as the previous accelerator could have been deleted already */
+Accelerator::ShadowRayCache &Accelerator::shadowRayCache(uint64_t accelerator_id)
+{
+	static thread_local ShadowRayCache shadow_ray_cache;
+	if(shadow_ray_cache.accelerator_id_ != accelerator_id)
+	{
+		shadow_ray_cache = ShadowRayCache();
+		shadow_ray_cache.accelerator_id_ = accelerator_id;
 	}
-	return {nullptr, ray.tmax_};
+	return shadow_ray_cache;
+}
+
+Accelerator::ShadowRayStream &Accelerator::shadowRayStream()
+{
+	static thread_local ShadowRayStream shadow_ray_stream;
+	shadow_ray_stream.clear();
+	return shadow_ray_stream;
+}
+
+/*! Any hit test of the shadow ray against the last occluder found by the calling thread. Returns the
+	occluder if it blocks the ray, nullptr otherwise. Transparent shadows only accept opaque occluders.
+	The hits are limited to the same distances accepted by the intersectS and intersectTs traversals */
+const Primitive *Accelerator::cachedOccluder(const Ray &ray, float t_max, bool transparent_shadows) const
+{
+	ShadowRayCache &cache = shadowRayCache(id_);
+	const Primitive *occluder = nullptr;
+	if(cache.occluder_ && !(transparent_shadows && cache.occluder_->getMaterial()->isTransparent()))
+	{
+		IntersectData intersect_data;
+		if(cache.obj_to_world_time_steps_ > 1)
+		{
+			const Matrix4 obj_to_world {Matrix4::interpolate(cache.obj_to_world_, cache.obj_to_world_time_steps_, ray.time_)};
+			intersect_data = cache.occluder_->intersect(ray, &obj_to_world);
+		}
+		else intersect_data = cache.occluder_->intersect(ray, cache.obj_to_world_);
+		const float t_min = transparent_shadows ? ray.tmin_ : 0.f;
+		if(intersect_data.hit_ && intersect_data.t_hit_ < t_max && intersect_data.t_hit_ >= t_min) occluder = cache.occluder_;
+	}
+	++cache.num_shadow_rays_;
+	if(occluder) ++cache.num_occluder_cache_hits_;
+	if(cache.num_shadow_rays_ >= ShadowRayCache::stats_batch_size_)
+	{
+		num_shadow_rays_ += cache.num_shadow_rays_;
+		num_occluder_cache_hits_ += cache.num_occluder_cache_hits_;
+		cache.num_shadow_rays_ = 0;
+		cache.num_occluder_cache_hits_ = 0;
+	}
+	return occluder;
+}
+
+/*! Rays not blocked by anything keep the previous occluder, which could still block the next rays */
+void Accelerator::cacheOccluder(const AcceleratorIntersectData &accelerator_intersect_data) const
+{
+	if(!accelerator_intersect_data.hit_ || !accelerator_intersect_data.hit_primitive_) return;
+	ShadowRayCache &cache = shadowRayCache(id_);
+	cache.occluder_ = accelerator_intersect_data.hit_primitive_;
+	cache.obj_to_world_ = accelerator_intersect_data.obj_to_world_;
+	cache.obj_to_world_time_steps_ = accelerator_intersect_data.obj_to_world_time_steps_;
+}
+
+void Accelerator::logShadowRayStats() const
+{
+	const uint64_t num_shadow_rays = num_shadow_rays_.exchange(0);
+	const uint64_t num_occluder_cache_hits = num_occluder_cache_hits_.exchange(0);
+	if(num_shadow_rays == 0) return;
+	logger_.logInfo("Accelerator: Shadow rays: ", num_shadow_rays, ", blocked by the last occluder cache: ", num_occluder_cache_hits, " (", 100.0 * static_cast<double>(num_occluder_cache_hits) / static_cast<double>(num_shadow_rays), "%)");
 }
 
 std::pair<bool, const Primitive *> Accelerator::isShadowed(const Ray &ray, float shadow_bias) const
 {
 	Ray sray(ray, Ray::DifferentialsCopy::No);
 	sray.from_ += sray.dir_ * sray.tmin_;
-	sray.time_ = ray.time_;
 	const float t_max = (ray.tmax_ >= 0.f) ? sray.tmax_ - 2 * sray.tmin_ : std::numeric_limits<float>::infinity();
+	if(ray_dump_) ray_dump_->record(RayDump::Query::Shadow, sray, t_max, shadow_bias);
+	const Primitive *cached_occluder = cachedOccluder(sray, t_max, false);
+	if(cached_occluder) return {true, cached_occluder};
 	const AcceleratorIntersectData accelerator_intersect_data = intersectS(sray, t_max, shadow_bias);
+	cacheOccluder(accelerator_intersect_data);
 	if(accelerator_intersect_data.hit_) return {true, accelerator_intersect_data.hit_primitive_};
 	else return {false, nullptr};
 }
@@ -82,7 +222,12 @@ std::tuple<bool, Rgb, const Primitive *> Accelerator::isShadowed(const Ray &ray,
 	Ray sray(ray, Ray::DifferentialsCopy::No); //Should this function use Ray::DifferentialsAssignment::Copy ? If using copy it would be slower but would take into account texture mipmaps, although that's probably irrelevant for transparent shadows?
 	sray.from_ += sray.dir_ * sray.tmin_;
 	const float t_max = (ray.tmax_ >= 0.f) ? sray.tmax_ - 2 * sray.tmin_ : std::numeric_limits<float>::infinity();
+	if(ray_dump_) ray_dump_->record(RayDump::Query::TransparentShadow, sray, t_max, shadow_bias, max_depth);
+	const Primitive *cached_occluder = cachedOccluder(sray, t_max, true);
+	if(cached_occluder) return std::tuple<bool, Rgb, const Primitive *>{true, Rgb{0.f}, cached_occluder};
 	const AcceleratorTsIntersectData accelerator_intersect_data = intersectTs(sray, max_depth, t_max, shadow_bias, camera);
+	//Only opaque occluders are useful for the next transparent shadow rays
+	if(!accelerator_intersect_data.hit_primitive_ || !accelerator_intersect_data.hit_primitive_->getMaterial()->isTransparent()) cacheOccluder(accelerator_intersect_data);
 	std::tuple<bool, Rgb, const Primitive *> result {false, Rgb{0.f}, nullptr};
 	std::get<1>(result) = accelerator_intersect_data.transparent_color_;
 	if(accelerator_intersect_data.hit_)
@@ -93,4 +238,68 @@ std::tuple<bool, Rgb, const Primitive *> Accelerator::isShadowed(const Ray &ray,
 	return result;
 }
 
+void Accelerator::isShadowed(const RayStream &rays, float shadow_bias, std::vector<AcceleratorIntersectData> &results) const
+{
+	results.resize(rays.size());
+	ShadowRayStream &shadow_ray_stream = shadowRayStream();
+	for(size_t ray_id = 0; ray_id < rays.size(); ++ray_id)
+	{
+		const Ray sray = rays.getRay(ray_id);
+		const float t_max = rays.t_max_[ray_id];
+		if(ray_dump_) ray_dump_->record(RayDump::Query::Shadow, sray, t_max, shadow_bias);
+		results[ray_id] = {};
+		if(const Primitive *cached_occluder = cachedOccluder(sray, t_max, false))
+		{
+			results[ray_id].hit_ = true;
+			results[ray_id].hit_primitive_ = cached_occluder;
+		}
+		else
+		{
+			shadow_ray_stream.rays_.push(sray, t_max);
+			shadow_ray_stream.ray_ids_.push_back(ray_id);
+		}
+	}
+	if(shadow_ray_stream.rays_.empty()) return;
+	intersectS(shadow_ray_stream.rays_, shadow_bias, shadow_ray_stream.results_);
+	for(size_t stream_ray_id = 0; stream_ray_id < shadow_ray_stream.ray_ids_.size(); ++stream_ray_id)
+	{
+		const AcceleratorIntersectData &accelerator_intersect_data = shadow_ray_stream.results_[stream_ray_id];
+		cacheOccluder(accelerator_intersect_data);
+		results[shadow_ray_stream.ray_ids_[stream_ray_id]] = accelerator_intersect_data;
+	}
+}
+
+void Accelerator::isShadowed(const RayStream &rays, int max_depth, float shadow_bias, const Camera *camera, std::vector<AcceleratorTsIntersectData> &results) const
+{
+	results.resize(rays.size());
+	ShadowRayStream &shadow_ray_stream = shadowRayStream();
+	for(size_t ray_id = 0; ray_id < rays.size(); ++ray_id)
+	{
+		const Ray sray = rays.getRay(ray_id);
+		const float t_max = rays.t_max_[ray_id];
+		if(ray_dump_) ray_dump_->record(RayDump::Query::TransparentShadow, sray, t_max, shadow_bias, max_depth);
+		results[ray_id] = {};
+		if(const Primitive *cached_occluder = cachedOccluder(sray, t_max, true))
+		{
+			results[ray_id].hit_ = true;
+			results[ray_id].hit_primitive_ = cached_occluder;
+			results[ray_id].transparent_color_ = Rgb{0.f};
+		}
+		else
+		{
+			shadow_ray_stream.rays_.push(sray, t_max);
+			shadow_ray_stream.ray_ids_.push_back(ray_id);
+		}
+	}
+	if(shadow_ray_stream.rays_.empty()) return;
+	intersectTs(shadow_ray_stream.rays_, max_depth, shadow_bias, camera, shadow_ray_stream.transparent_results_);
+	for(size_t stream_ray_id = 0; stream_ray_id < shadow_ray_stream.ray_ids_.size(); ++stream_ray_id)
+	{
+		const AcceleratorTsIntersectData &accelerator_intersect_data = shadow_ray_stream.transparent_results_[stream_ray_id];
+		//Only opaque occluders are useful for the next transparent shadow rays
+		if(!accelerator_intersect_data.hit_primitive_ || !accelerator_intersect_data.hit_primitive_->getMaterial()->isTransparent()) cacheOccluder(accelerator_intersect_data);
+		results[shadow_ray_stream.ray_ids_[stream_ray_id]] = accelerator_intersect_data;
+	}
+}
+
 END_YAFARAY
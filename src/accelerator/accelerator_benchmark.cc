@@ -0,0 +1,145 @@
+/****************************************************************************
+ *      This is part of the libYafaRay package
+ *
+ *      This library is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU Lesser General Public
+ *      License as published by the Free Software Foundation; either
+ *      version 2.1 of the License, or (at your option) any later version.
+ *
+ *      This library is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *      Lesser General Public License for more details.
+ *
+ *      You should have received a copy of the GNU Lesser General Public
+ *      License along with this library; if not, write to the Free Software
+ *      Foundation,Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include "accelerator/accelerator_benchmark.h"
+#include "common/logger.h"
+#include "common/timer.h"
+#include "geometry/primitive/primitive.h"
+#include "geometry/matrix4.h"
+#include <sstream>
+
+BEGIN_YAFARAY
+
+const std::vector<std::string> AcceleratorBenchmark::accelerator_types_ {"yafaray-kdtree-original", "yafaray-kdtree-multi-thread", "yafaray-bvh", "yafaray-lbvh", "yafaray-sbvh", "yafaray-bvh4"};
+
+bool AcceleratorBenchmark::run(Logger &logger, const std::string &ray_dump_path, const std::vector<std::string> &accelerator_types, const AcceleratorFactory &accelerator_factory, const Camera *camera)
+{
+	std::vector<RayDump::Record> all_records;
+	if(!RayDump::load(logger, ray_dump_path, all_records)) return false;
+	//The queries of each kind are replayed separately, keeping their recorded order
+	std::array<std::vector<RayDump::Record>, 3> records;
+	for(const auto &record : all_records)
+	{
+		const auto query_id = static_cast<size_t>(record.query_);
+		if(query_id < records.size()) records[query_id].push_back(record);
+	}
+	all_records.clear();
+	bool closest_hits_consistent = true;
+	logger.logInfo("AcceleratorBenchmark: replaying ", records[0].size(), " closest hit, ", records[1].size(), " shadow and ", records[2].size(), " transparent shadow queries from '", ray_dump_path, "'");
+#ifndef ACCELERATOR_COUNTERS
+	logger.logInfo("AcceleratorBenchmark: node and primitive tests are not counted, libYafaRay was built without the YAFARAY_ACCELERATOR_COUNTERS option");
+#endif
+	for(const auto &accelerator_type : accelerator_types)
+	{
+		Timer timer;
+		timer.addEvent("build");
+		timer.start("build");
+		const std::unique_ptr<Accelerator> accelerator = accelerator_factory(accelerator_type);
+		timer.stop("build");
+		if(!accelerator)
+		{
+			logger.logWarning("AcceleratorBenchmark: accelerator '", accelerator_type, "' could not be created");
+			continue;
+		}
+		logger.logInfo("AcceleratorBenchmark: '", accelerator_type, "': build time: ", timer.getTime("build"), "s, memory: ", static_cast<double>(accelerator->memoryUsed()) / (1024.0 * 1024.0), "MB");
+		for(size_t query_id = 0; query_id < records.size(); ++query_id)
+		{
+			if(records[query_id].empty()) continue;
+			const QueryResults results = replay(*accelerator, records[query_id], camera);
+			const double num_queries = static_cast<double>(results.num_queries_);
+			std::stringstream ss;
+			ss << "AcceleratorBenchmark: '" << accelerator_type << "': " << queryName(static_cast<RayDump::Query>(query_id)) << ": " << (results.time_ > 0.0 ? num_queries / results.time_ / 1000000.0 : 0.0) << " Mrays/s, hits: " << results.num_hits_;
+#ifdef ACCELERATOR_COUNTERS
+			ss << ", node tests/query: " << static_cast<double>(results.counters_.node_tests_) / num_queries << ", primitive tests/query: " << static_cast<double>(results.counters_.primitive_tests_) / num_queries;
+#endif
+			logger.logInfo(ss.str());
+		}
+		const size_t num_mismatches = checkClosestHits(*accelerator, records[static_cast<size_t>(RayDump::Query::ClosestHit)]);
+		if(num_mismatches > 0)
+		{
+			logger.logError("AcceleratorBenchmark: '", accelerator_type, "': ", num_mismatches, " closest hits are not at the position where the shadow rays find the hit primitive");
+			closest_hits_consistent = false;
+		}
+	}
+	return closest_hits_consistent;
+}
+
+/*! Traces the queries in the calling thread, so the traversal counters of the thread only count these queries */
+AcceleratorBenchmark::QueryResults AcceleratorBenchmark::replay(const Accelerator &accelerator, const std::vector<RayDump::Record> &records, const Camera *camera)
+{
+	QueryResults results;
+	results.num_queries_ = records.size();
+	const Accelerator::TraversalCounters counters_start = Accelerator::traversalCounters();
+	Timer timer;
+	timer.addEvent("replay");
+	timer.start("replay");
+	for(const auto &record : records)
+	{
+		const Ray ray = record.ray();
+		bool hit = false;
+		switch(record.query_)
+		{
+			case RayDump::Query::ClosestHit: hit = accelerator.intersect(ray, record.t_max_).hit_; break;
+			case RayDump::Query::Shadow: hit = accelerator.intersectS(ray, record.t_max_, record.shadow_bias_).hit_; break;
+			case RayDump::Query::TransparentShadow: hit = accelerator.intersectTs(ray, record.max_depth_, record.t_max_, record.shadow_bias_, camera).hit_; break;
+		}
+		if(hit) ++results.num_hits_;
+	}
+	timer.stop("replay");
+	results.time_ = timer.getTime("replay");
+	const Accelerator::TraversalCounters &counters_end = Accelerator::traversalCounters();
+	results.counters_.node_tests_ = counters_end.node_tests_ - counters_start.node_tests_;
+	results.counters_.primitive_tests_ = counters_end.primitive_tests_ - counters_start.primitive_tests_;
+	return results;
+}
+
+/*! Returns the number of closest hits whose primitive, intersected as the shadow ray paths intersect the occluders, is not hit at the same position */
+size_t AcceleratorBenchmark::checkClosestHits(const Accelerator &accelerator, const std::vector<RayDump::Record> &records)
+{
+	size_t num_mismatches = 0;
+	for(const auto &record : records)
+	{
+		const Ray ray = record.ray();
+		const AcceleratorIntersectData accelerator_intersect_data = accelerator.intersect(ray, record.t_max_);
+		if(!accelerator_intersect_data.hit_ || !accelerator_intersect_data.hit_primitive_) continue;
+		IntersectData intersect_data;
+		if(accelerator_intersect_data.obj_to_world_time_steps_ > 1)
+		{
+			const Matrix4 obj_to_world {Matrix4::interpolate(accelerator_intersect_data.obj_to_world_, accelerator_intersect_data.obj_to_world_time_steps_, ray.time_)};
+			intersect_data = accelerator_intersect_data.hit_primitive_->intersect(ray, &obj_to_world);
+		}
+		else intersect_data = accelerator_intersect_data.hit_primitive_->intersect(ray, accelerator_intersect_data.obj_to_world_);
+		const Point3 hit_point {ray.from_ + accelerator_intersect_data.t_max_ * ray.dir_};
+		const float tolerance = 1.0e-3f * std::max(1.f, accelerator_intersect_data.t_max_);
+		if(!intersect_data.hit_ || (ray.from_ + intersect_data.t_hit_ * ray.dir_ - hit_point).length() > tolerance) ++num_mismatches;
+	}
+	return num_mismatches;
+}
+
+std::string AcceleratorBenchmark::queryName(RayDump::Query query)
+{
+	switch(query)
+	{
+		case RayDump::Query::ClosestHit: return "closest hit";
+		case RayDump::Query::Shadow: return "shadow";
+		case RayDump::Query::TransparentShadow: return "transparent shadow";
+		default: return "unknown";
+	}
+}
+
+END_YAFARAY
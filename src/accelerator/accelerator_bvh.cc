@@ -0,0 +1,628 @@
+/****************************************************************************
+ *      This is part of the libYafaRay package
+ *
+ *      This library is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU Lesser General Public
+ *      License as published by the Free Software Foundation; either
+ *      version 2.1 of the License, or (at your option) any later version.
+ *
+ *      This library is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *      Lesser General Public License for more details.
+ *
+ *      You should have received a copy of the GNU Lesser General Public
+ *      License along with this library; if not, write to the Free Software
+ *      Foundation,Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include "accelerator/accelerator_bvh.h"
+#include "accelerator/lbvh_builder.h"
+#include "accelerator/sbvh_builder.h"
+#include "material/material.h"
+#include "common/logger.h"
+#include "common/param.h"
+#include "common/timer.h"
+#include "geometry/surface.h"
+#include "geometry/primitive/primitive.h"
+#include "geometry/poly_double.h"
+#include "geometry/axis.h"
+#include <set>
+
+BEGIN_YAFARAY
+
+constexpr size_t AcceleratorBvh::RayPacket::max_size_;
+
+Accelerator * AcceleratorBvh::factory(Logger &logger, const std::vector<const Primitive *> &primitives, const ParamMap &params)
+{
+	bool precompute_triangles = false;
+	std::string cache_directory;
+	params.getParam("precompute_triangles", precompute_triangles);
+	params.getParam("cache_dir", cache_directory);
+	return new AcceleratorBvh(logger, primitives, getBuildParameters(params), precompute_triangles, cache_directory);
+}
+
+BvhBuilder::Parameters AcceleratorBvh::getBuildParameters(const ParamMap &params)
+{
+	BvhBuilder::Parameters parameters;
+	std::string type;
+	params.getParam("type", type);
+	if(type == "yafaray-lbvh") parameters.method_ = BvhBuilder::Parameters::Method::Linear;
+	else if(type == "yafaray-sbvh") parameters.method_ = BvhBuilder::Parameters::Method::Spatial;
+	params.getParam("treelet_passes", parameters.treelet_passes_);
+	params.getParam("spatial_split_budget", parameters.spatial_split_budget_);
+	params.getParam("leaf_size", parameters.max_leaf_size_);
+	params.getParam("bins", parameters.num_bins_);
+	params.getParam("cost_ratio", parameters.cost_ratio_);
+	params.getParam("accelerator_threads", parameters.num_threads_);
+	params.getParam("accelerator_min_indices_threads", parameters.min_indices_to_spawn_threads_);
+	if(parameters.max_leaf_size_ < 1) parameters.max_leaf_size_ = 1;
+	parameters.num_bins_ = std::max(2, std::min(parameters.num_bins_, BvhBuilder::max_bins_));
+	if(parameters.num_threads_ < 1) parameters.num_threads_ = 1;
+	if(parameters.treelet_passes_ < 0) parameters.treelet_passes_ = 0;
+	if(parameters.spatial_split_budget_ < 0.f) parameters.spatial_split_budget_ = 0.f;
+	return parameters;
+}
+
+AcceleratorBvh::AcceleratorBvh(Logger &logger, const std::vector<const Primitive *> &primitives, const BvhBuilder::Parameters &parameters, bool precompute_triangles, const std::string &cache_directory) : Accelerator(logger)
+{
+	const auto num_primitives = static_cast<uint32_t>(primitives.size());
+	const bool linear = (parameters.method_ == BvhBuilder::Parameters::Method::Linear);
+	const bool spatial = (parameters.method_ == BvhBuilder::Parameters::Method::Spatial);
+	if(spatial) logger_.logInfo("BVH: Starting spatial splits build (", num_primitives, " prims, bins:", parameters.num_bins_, " leaf_size:", parameters.max_leaf_size_, " cost_ratio:", parameters.cost_ratio_, " spatial_split_budget:", parameters.spatial_split_budget_, ") [using ", parameters.num_threads_, " threads, min indices to spawn threads: ", parameters.min_indices_to_spawn_threads_, "]");
+	else if(linear) logger_.logInfo("BVH: Starting linear build (", num_primitives, " prims, leaf_size:", parameters.max_leaf_size_, " treelet_passes:", parameters.treelet_passes_, ") [using ", parameters.num_threads_, " threads, min indices to spawn threads: ", parameters.min_indices_to_spawn_threads_, "]");
+	else logger_.logInfo("BVH: Starting build (", num_primitives, " prims, bins:", parameters.num_bins_, " leaf_size:", parameters.max_leaf_size_, " cost_ratio:", parameters.cost_ratio_, ") [using ", parameters.num_threads_, " threads, min indices to spawn threads: ", parameters.min_indices_to_spawn_threads_, "]");
+	Timer timer;
+	timer.addEvent("bvh_build");
+	timer.start("bvh_build");
+
+	std::vector<Bound> bounds;
+	bounds.reserve(num_primitives);
+	if(num_primitives > 0) tree_bound_ = primitives.front()->getBound();
+	else tree_bound_ = {{0.f, 0.f, 0.f}, {0.f, 0.f, 0.f}};
+	if(logger_.isVerbose()) logger_.logVerbose("BVH: Getting primitive bounds...");
+	for(const auto &primitive : primitives)
+	{
+		bounds.emplace_back(primitive->getBound());
+		tree_bound_ = Bound(tree_bound_, bounds.back());
+	}
+	if(logger_.isVerbose()) logger_.logVerbose("BVH: Done.");
+	if(num_primitives == 0)
+	{
+		logger_.logWarning("BVH: No primitives, empty tree built");
+		return;
+	}
+
+	//Besides the primitive bounds and the build parameters, the spatial splits tree depends on the triangles geometry, as they are clipped
+	std::unique_ptr<AcceleratorCache> cache;
+	if(!cache_directory.empty())
+	{
+		AcceleratorCache::Key key;
+		key.add(std::string(spatial ? "yafaray-sbvh" : (linear ? "yafaray-lbvh" : "yafaray-bvh")));
+		if(linear) key.add(parameters.treelet_passes_);
+		if(spatial) key.add(parameters.spatial_split_budget_);
+		key.add(parameters.max_leaf_size_);
+		key.add(parameters.num_bins_);
+		key.add(parameters.cost_ratio_);
+		std::array<Point3, 3> vertices;
+		for(uint32_t prim_num = 0; prim_num < num_primitives; prim_num++)
+		{
+			key.add(bounds[prim_num]);
+			if(spatial && primitives[prim_num]->getTriangleVertices(vertices)) for(const auto &vertex : vertices) key.add(vertex);
+		}
+		cache = std::unique_ptr<AcceleratorCache>(new AcceleratorCache(logger, cache_directory, "bvh", key.get()));
+	}
+	CachedArray<uint32_t> prim_indices;
+	BvhBuilder::Stats build_stats;
+	if(cache && cache->load() && cache->getArray(0, nodes_) && cache->getArray(1, prim_indices) && validTree(nodes_, prim_indices, num_primitives, spatial ? SbvhBuilder::maxReferences(num_primitives, parameters) : num_primitives))
+	{
+		logger_.logInfo("BVH: Tree loaded from cache file '", cache->getPath(), "'");
+	}
+	else
+	{
+		if(logger_.isVerbose()) logger_.logVerbose("BVH: Starting recursive build...");
+		BvhBuilder::Result bvh_result;
+		if(spatial)
+		{
+			//The clip function gets the bound of the part of a primitive inside a node bound, slightly enlarged for the clipping precision as in the kd-tree
+			const SbvhBuilder::ClipFunction clip_function = [&](uint32_t prim_id, const Bound &bound, Bound &clipped_bound) -> bool
+			{
+				const Primitive *primitive = primitives[prim_id];
+				if(primitive->clippingSupport())
+				{
+					std::array<Vec3Double, 2> clip_bound;
+					for(int axis = 0; axis < 3; ++axis)
+					{
+						const double margin = 0.001 * (static_cast<double>(bound.g_[axis]) - static_cast<double>(bound.a_[axis])) + 0.00001 * (static_cast<double>(tree_bound_.g_[axis]) - static_cast<double>(tree_bound_.a_[axis]));
+						clip_bound[0][axis] = bound.a_[axis] - margin;
+						clip_bound[1][axis] = bound.g_[axis] + margin;
+					}
+					const PolyDouble::ClipResultWithBound clip_result = primitive->clipToBound(logger_, clip_bound, ClipPlane(ClipPlane::Pos::None), PolyDouble(), nullptr);
+					if(clip_result.clip_result_code_ == PolyDouble::ClipResultWithBound::Correct)
+					{
+						clipped_bound = *clip_result.box_;
+						return true;
+					}
+					else if(clip_result.clip_result_code_ == PolyDouble::ClipResultWithBound::NoOverlapDisappeared) return false;
+				}
+				clipped_bound = bounds[prim_id];
+				return true;
+			};
+			bvh_result = SbvhBuilder(bounds, clip_function, parameters).build();
+		}
+		else if(linear) bvh_result = LbvhBuilder(bounds, parameters).build();
+		else bvh_result = BvhBuilder(bounds, parameters).build();
+		nodes_ = CachedArray<Node>(std::move(bvh_result.nodes_));
+		prim_indices = CachedArray<uint32_t>(std::move(bvh_result.prim_indices_));
+		build_stats = bvh_result.stats_;
+		if(!validTree(nodes_, prim_indices, num_primitives, spatial ? SbvhBuilder::maxReferences(num_primitives, parameters) : num_primitives))
+		{
+			logger_.logError("BVH: The built tree is not valid or deeper than ", BvhBuilder::max_depth_, " levels, building it again with the binned SAH builder");
+			bvh_result = BvhBuilder(bounds, parameters).build();
+			nodes_ = CachedArray<Node>(std::move(bvh_result.nodes_));
+			prim_indices = CachedArray<uint32_t>(std::move(bvh_result.prim_indices_));
+			build_stats = bvh_result.stats_;
+		}
+		if(cache)
+		{
+			cache->addArray(nodes_);
+			cache->addArray(prim_indices);
+			cache->save();
+		}
+	}
+	primitives_.reserve(prim_indices.size());
+	for(const auto &prim_id : prim_indices) primitives_.emplace_back(primitives[prim_id]);
+	duplicated_references_ = (primitives_.size() > num_primitives);
+	if(precompute_triangles) triangle_soup_ = TriangleSoup(primitives_);
+	buildMotionBounds();
+
+	timer.stop("bvh_build");
+	logger_.logInfo("BVH: Build time: ", timer.getTime("bvh_build"), "s");
+	if(!nodes_.isMapped()) build_stats.outputLog(logger, num_primitives, nodes_.size(), nodes_.size() * sizeof(Node) + primitives_.size() * sizeof(const Primitive *) + triangle_soup_.memoryUsed() + motion_bounds_.memoryUsed());
+	if(precompute_triangles) logger_.logInfo("BVH: Precomputed triangles: ", triangle_soup_.numTriangles(), " (", triangle_soup_.memoryUsed() / 1024, "KB)");
+}
+
+bool AcceleratorBvh::refit(int num_threads)
+{
+	if(nodes_.empty()) return true;
+	Timer timer;
+	timer.addEvent("bvh_refit");
+	timer.start("bvh_refit");
+	BvhBuilder::refit(nodes_.mutableData(), [this](uint32_t prim_num) { return primitives_[prim_num]->getBound(); }, num_threads);
+	tree_bound_ = nodes_.front().getBound();
+	if(!triangle_soup_.empty()) triangle_soup_ = TriangleSoup(primitives_);
+	buildMotionBounds();
+	timer.stop("bvh_refit");
+	logger_.logInfo("BVH: Refit time: ", timer.getTime("bvh_refit"), "s");
+	return true;
+}
+
+/*! Calculates the node bounds in the motion blur time steps, if any primitive moves. The primitives
+	with a different number of time steps are enclosed in all of them by their whole frame time bound */
+void AcceleratorBvh::buildMotionBounds()
+{
+	int num_time_steps = 1;
+	for(const auto &primitive : primitives_) num_time_steps = std::max(num_time_steps, primitive->numTimeSteps());
+	if(num_time_steps == 1)
+	{
+		motion_bounds_ = {};
+		return;
+	}
+	motion_bounds_ = BvhBuilder::MotionBounds(nodes_.data(), nodes_.size(), num_time_steps, [this, num_time_steps](uint32_t prim_num, int time_step)
+	{
+		const Primitive *primitive = primitives_[prim_num];
+		if(primitive->numTimeSteps() == num_time_steps) return primitive->getTimeStepBound(time_step, nullptr);
+		else return primitive->getBound();
+	});
+	logger_.logInfo("BVH: Motion blur node bounds for ", num_time_steps, " time steps (", motion_bounds_.memoryUsed() / 1024, "KB)");
+}
+
+/*! Checks that all the node references of a tree are within bounds and that the tree fits in the traversal stack. The children are always stored after their parent, so the node depths are computed in a single pass */
+bool AcceleratorBvh::validTree(const CachedArray<Node> &nodes, const CachedArray<uint32_t> &prim_indices, uint32_t num_primitives, uint32_t max_references)
+{
+	if(nodes.empty() || prim_indices.size() < num_primitives || prim_indices.size() > max_references) return false;
+	std::vector<uint8_t> depths(nodes.size(), 0);
+	for(size_t node_id = 0; node_id < nodes.size(); ++node_id)
+	{
+		const Node &node = nodes[node_id];
+		if(node.isLeaf())
+		{
+			if(node.getPrimitivesOffset() + node.nPrimitives() > prim_indices.size()) return false;
+		}
+		else
+		{
+			if(node.getLeftChild() <= node_id || node.getRightChild() >= nodes.size() || depths[node_id] >= bvh_max_stack_) return false;
+			depths[node.getLeftChild()] = depths[node.getRightChild()] = static_cast<uint8_t>(depths[node_id] + 1);
+		}
+	}
+	for(const auto &prim_id : prim_indices) if(prim_id >= num_primitives) return false;
+	return true;
+}
+
+AcceleratorBvh::~AcceleratorBvh()
+{
+	if(logger_.isVerbose()) logger_.logVerbose("BVH: Done");
+}
+
+/*! Primitive tests shared by the single ray and the ray packet traversals */
+static inline void closestHitIntersection(AcceleratorIntersectData &accelerator_intersect_data, const TriangleSoup &triangle_soup, uint32_t prim_num, const Primitive *primitive, const Ray &ray)
+{
+	const IntersectData intersect_data = triangle_soup.intersect(prim_num, primitive, ray);
+	if(intersect_data.hit_)
+	{
+		if(intersect_data.t_hit_ < accelerator_intersect_data.t_max_ && intersect_data.t_hit_ >= ray.tmin_)
+		{
+			const Visibility prim_visibility = primitive->getVisibility();
+			if(prim_visibility == Visibility::NormalVisible || prim_visibility == Visibility::VisibleNoShadows)
+			{
+				const Visibility mat_visibility = primitive->getMaterial()->getVisibility();
+				if(mat_visibility == Visibility::NormalVisible || mat_visibility == Visibility::VisibleNoShadows)
+				{
+					accelerator_intersect_data.setIntersectData(intersect_data);
+					accelerator_intersect_data.t_max_ = intersect_data.t_hit_;
+					accelerator_intersect_data.hit_primitive_ = primitive;
+				}
+			}
+		}
+	}
+}
+
+static inline bool shadowIntersection(AcceleratorIntersectData &accelerator_intersect_data, const TriangleSoup &triangle_soup, uint32_t prim_num, const Primitive *primitive, const Ray &ray, float t_max)
+{
+	const IntersectData intersect_data = triangle_soup.intersect(prim_num, primitive, ray);
+	if(intersect_data.hit_)
+	{
+		if(intersect_data.t_hit_ < t_max && intersect_data.t_hit_ >= 0.f)
+		{
+			const Visibility prim_visibility = primitive->getVisibility();
+			if(prim_visibility == Visibility::NormalVisible || prim_visibility == Visibility::InvisibleShadowsOnly)
+			{
+				const Visibility mat_visibility = primitive->getMaterial()->getVisibility();
+				if(mat_visibility == Visibility::NormalVisible || mat_visibility == Visibility::InvisibleShadowsOnly)
+				{
+					accelerator_intersect_data.setIntersectData(intersect_data);
+					accelerator_intersect_data.hit_primitive_ = primitive;
+					return true;
+				}
+			}
+		}
+	}
+	return false;
+}
+
+/*! Unless spatial splits were used each primitive is only referenced once in the BVH so, unlike in the kd-tree, the transparent primitives
+	already found are only filtered if a set of filtered primitives is given */
+static inline bool transparentShadowIntersection(AcceleratorTsIntersectData &accelerator_intersect_data, std::set<const Primitive *> *filtered, int max_depth, const TriangleSoup &triangle_soup, uint32_t prim_num, const Primitive *primitive, const Ray &ray, float t_max, const Camera *camera)
+{
+	const IntersectData intersect_data = triangle_soup.intersect(prim_num, primitive, ray);
+	if(intersect_data.hit_)
+	{
+		if(intersect_data.t_hit_ < t_max && intersect_data.t_hit_ >= ray.tmin_)
+		{
+			const Material *mat = primitive->getMaterial();
+			if(mat->getVisibility() == Visibility::NormalVisible || mat->getVisibility() == Visibility::InvisibleShadowsOnly)
+			{
+				accelerator_intersect_data.setIntersectData(intersect_data);
+				accelerator_intersect_data.hit_primitive_ = primitive;
+				if(!mat->isTransparent()) return true;
+				if(filtered && !filtered->insert(primitive).second) return false;
+				if(accelerator_intersect_data.transparent_depth_ >= max_depth) return true;
+				const Point3 hit_point{ray.from_ + accelerator_intersect_data.t_hit_ * ray.dir_};
+				accelerator_intersect_data.transparent_color_ *= primitive->getShadowTransparency(hit_point, accelerator_intersect_data, ray.dir_, nullptr, camera);
+				++accelerator_intersect_data.transparent_depth_;
+			}
+		}
+	}
+	return false;
+}
+
+//============================
+/*! The standard intersect function,
+	returns the closest hit within dist
+*/
+AcceleratorIntersectData AcceleratorBvh::intersect(const Ray &ray, float t_max) const
+{
+	if(nodes_.empty()) return {};
+	const Vec3 inv_dir = invDirection(ray.dir_);
+	if(intersectNode(0, ray, inv_dir, t_max) == std::numeric_limits<float>::infinity()) return {};
+	AcceleratorIntersectData accelerator_intersect_data;
+	accelerator_intersect_data.t_max_ = t_max;
+
+	std::array<Stack, bvh_max_stack_> stack;
+	int stack_id = 0;
+	uint32_t node_id = 0;
+	while(true)
+	{
+		const Node &node = nodes_[node_id];
+		if(node.isLeaf())
+		{
+			const uint32_t prims_end = node.getPrimitivesOffset() + node.nPrimitives();
+			for(uint32_t prim_num = node.getPrimitivesOffset(); prim_num < prims_end; ++prim_num)
+			{
+				closestHitIntersection(accelerator_intersect_data, triangle_soup_, prim_num, primitives_[prim_num], ray);
+			}
+		}
+		else
+		{
+			// visit the nearest child first, so the following hits can cull the farthest one
+			uint32_t near_child = node.getLeftChild();
+			uint32_t far_child = node.getRightChild();
+			float t_near = intersectNode(near_child, ray, inv_dir, accelerator_intersect_data.t_max_);
+			float t_far = intersectNode(far_child, ray, inv_dir, accelerator_intersect_data.t_max_);
+			if(t_far < t_near)
+			{
+				std::swap(near_child, far_child);
+				std::swap(t_near, t_far);
+			}
+			if(t_near != std::numeric_limits<float>::infinity())
+			{
+				if(t_far != std::numeric_limits<float>::infinity())
+				{
+					stack[stack_id].node_id_ = far_child;
+					stack[stack_id].t_ = t_far;
+					++stack_id;
+				}
+				node_id = near_child;
+				continue;
+			}
+		}
+		// pop the next node still closer than the current hit, if any
+		do
+		{
+			if(stack_id == 0) return accelerator_intersect_data;
+			--stack_id;
+		}
+		while(stack[stack_id].t_ > accelerator_intersect_data.t_max_);
+		node_id = stack[stack_id].node_id_;
+	}
+}
+
+AcceleratorIntersectData AcceleratorBvh::intersectS(const Ray &ray, float t_max, float) const
+{
+	if(nodes_.empty()) return {};
+	const Vec3 inv_dir = invDirection(ray.dir_);
+	if(intersectNode(0, ray, inv_dir, t_max) == std::numeric_limits<float>::infinity()) return {};
+	AcceleratorIntersectData accelerator_intersect_data;
+
+	std::array<uint32_t, bvh_max_stack_> stack;
+	int stack_id = 0;
+	uint32_t node_id = 0;
+	while(true)
+	{
+		const Node &node = nodes_[node_id];
+		if(node.isLeaf())
+		{
+			const uint32_t prims_end = node.getPrimitivesOffset() + node.nPrimitives();
+			for(uint32_t prim_num = node.getPrimitivesOffset(); prim_num < prims_end; ++prim_num)
+			{
+				if(shadowIntersection(accelerator_intersect_data, triangle_soup_, prim_num, primitives_[prim_num], ray, t_max)) return accelerator_intersect_data;
+			}
+		}
+		else
+		{
+			// any hit is enough, so there is no need to order the children
+			const uint32_t left_child = node.getLeftChild();
+			const uint32_t right_child = node.getRightChild();
+			const bool hit_left = intersectNode(left_child, ray, inv_dir, t_max) != std::numeric_limits<float>::infinity();
+			const bool hit_right = intersectNode(right_child, ray, inv_dir, t_max) != std::numeric_limits<float>::infinity();
+			if(hit_left)
+			{
+				if(hit_right) stack[stack_id++] = right_child;
+				node_id = left_child;
+				continue;
+			}
+			else if(hit_right)
+			{
+				node_id = right_child;
+				continue;
+			}
+		}
+		if(stack_id == 0) return {};
+		node_id = stack[--stack_id];
+	}
+}
+
+/*=============================================================
+	allow for transparent shadows.
+=============================================================*/
+
+AcceleratorTsIntersectData AcceleratorBvh::intersectTs(const Ray &ray, int max_depth, float t_max, float, const Camera *camera) const
+{
+	if(nodes_.empty()) return {};
+	const Vec3 inv_dir = invDirection(ray.dir_);
+	if(intersectNode(0, ray, inv_dir, t_max) == std::numeric_limits<float>::infinity()) return {};
+	AcceleratorTsIntersectData accelerator_intersect_data;
+	std::set<const Primitive *> filtered;
+
+	std::array<uint32_t, bvh_max_stack_> stack;
+	int stack_id = 0;
+	uint32_t node_id = 0;
+	while(true)
+	{
+		const Node &node = nodes_[node_id];
+		if(node.isLeaf())
+		{
+			const uint32_t prims_end = node.getPrimitivesOffset() + node.nPrimitives();
+			for(uint32_t prim_num = node.getPrimitivesOffset(); prim_num < prims_end; ++prim_num)
+			{
+				if(transparentShadowIntersection(accelerator_intersect_data, duplicated_references_ ? &filtered : nullptr, max_depth, triangle_soup_, prim_num, primitives_[prim_num], ray, t_max, camera)) return accelerator_intersect_data;
+			}
+		}
+		else
+		{
+			const uint32_t left_child = node.getLeftChild();
+			const uint32_t right_child = node.getRightChild();
+			const bool hit_left = intersectNode(left_child, ray, inv_dir, t_max) != std::numeric_limits<float>::infinity();
+			const bool hit_right = intersectNode(right_child, ray, inv_dir, t_max) != std::numeric_limits<float>::infinity();
+			if(hit_left)
+			{
+				if(hit_right) stack[stack_id++] = right_child;
+				node_id = left_child;
+				continue;
+			}
+			else if(hit_right)
+			{
+				node_id = right_child;
+				continue;
+			}
+		}
+		if(stack_id == 0) break;
+		node_id = stack[--stack_id];
+	}
+	accelerator_intersect_data.hit_ = false;
+	return accelerator_intersect_data;
+}
+
+/*=============================================================
+	ray packets: the rays of a stream are traced in packets which
+	traverse the tree together, so each node is fetched once for
+	all the rays and its bound tested against all of them at once.
+=============================================================*/
+
+AcceleratorBvh::RayPacket::RayPacket(const RayStream &rays, size_t ray_offset, size_t size) : size_(size)
+{
+	for(size_t ray_id = 0; ray_id < size_; ++ray_id)
+	{
+		rays_[ray_id] = rays.getRay(ray_offset + ray_id);
+		const Vec3 inv_dir = invDirection(rays_[ray_id].dir_);
+		from_x_[ray_id] = rays_[ray_id].from_.x();
+		from_y_[ray_id] = rays_[ray_id].from_.y();
+		from_z_[ray_id] = rays_[ray_id].from_.z();
+		inv_dir_x_[ray_id] = inv_dir.x();
+		inv_dir_y_[ray_id] = inv_dir.y();
+		inv_dir_z_[ray_id] = inv_dir.z();
+		t_max_[ray_id] = rays.t_max_[ray_offset + ray_id];
+	}
+}
+
+/*! Depth first traversal visiting every node hit by any of the packet rays. The primitive function
+	tests a primitive against one ray, updating the ray maximum distance in the packet, and returns
+	true when the ray does not need more primitive tests. If "ordered" the child closest to the rays
+	is visited first, otherwise the left child is visited first as in the single ray traversals */
+template <bool ordered, typename PrimitiveFunction>
+void AcceleratorBvh::traversePacket(RayPacket &packet, const PrimitiveFunction &primitive_function) const
+{
+	std::array<float, RayPacket::max_size_> t_entry, t_entry_far;
+	if(packet.intersect(nodes_[0].getBound(), t_entry.data()) == std::numeric_limits<float>::infinity()) return;
+	std::array<Stack, bvh_max_stack_> stack;
+	int stack_id = 0;
+	uint32_t node_id = 0;
+	while(true)
+	{
+		const Node &node = nodes_[node_id];
+		if(node.isLeaf())
+		{
+			// the leaf bound is tested again to skip the rays that only hit other parts of the parent bound
+			packet.intersect(node.getBound(), t_entry.data());
+			const uint32_t prims_end = node.getPrimitivesOffset() + node.nPrimitives();
+			for(size_t ray_id = 0; ray_id < packet.size_; ++ray_id)
+			{
+				if(t_entry[ray_id] == std::numeric_limits<float>::infinity()) continue;
+				for(uint32_t prim_num = node.getPrimitivesOffset(); prim_num < prims_end; ++prim_num)
+				{
+					if(primitive_function(ray_id, prim_num)) break;
+				}
+			}
+		}
+		else
+		{
+			uint32_t near_child = node.getLeftChild();
+			uint32_t far_child = node.getRightChild();
+			float t_near = packet.intersect(nodes_[near_child].getBound(), t_entry.data());
+			float t_far = packet.intersect(nodes_[far_child].getBound(), t_entry_far.data());
+			if(ordered && t_far < t_near)
+			{
+				std::swap(near_child, far_child);
+				std::swap(t_near, t_far);
+			}
+			if(t_near != std::numeric_limits<float>::infinity())
+			{
+				if(t_far != std::numeric_limits<float>::infinity())
+				{
+					stack[stack_id].node_id_ = far_child;
+					stack[stack_id].t_ = t_far;
+					++stack_id;
+				}
+				node_id = near_child;
+				continue;
+			}
+			else if(t_far != std::numeric_limits<float>::infinity())
+			{
+				node_id = far_child;
+				continue;
+			}
+		}
+		// pop the next node still closer than the farthest current ray distance, if any
+		const float max_distance = packet.maxDistance();
+		do
+		{
+			if(stack_id == 0) return;
+			--stack_id;
+		}
+		while(stack[stack_id].t_ > max_distance);
+		node_id = stack[stack_id].node_id_;
+	}
+}
+
+void AcceleratorBvh::intersect(const RayStream &rays, std::vector<AcceleratorIntersectData> &results) const
+{
+	//The node bounds of moving primitives are interpolated at each ray time, so those rays are traced on their own
+	if(nodes_.empty() || !motion_bounds_.empty()) return Accelerator::intersect(rays, results);
+	results.assign(rays.size(), {});
+	for(size_t ray_offset = 0; ray_offset < rays.size(); ray_offset += RayPacket::max_size_)
+	{
+		RayPacket packet(rays, ray_offset, std::min(RayPacket::max_size_, rays.size() - ray_offset));
+		AcceleratorIntersectData *packet_results = &results[ray_offset];
+		for(size_t ray_id = 0; ray_id < packet.size_; ++ray_id) packet_results[ray_id].t_max_ = packet.t_max_[ray_id];
+		traversePacket<true>(packet, [&](size_t ray_id, uint32_t prim_num) -> bool
+		{
+			closestHitIntersection(packet_results[ray_id], triangle_soup_, prim_num, primitives_[prim_num], packet.rays_[ray_id]);
+			packet.t_max_[ray_id] = packet_results[ray_id].t_max_;
+			return false;
+		});
+	}
+}
+
+void AcceleratorBvh::intersectS(const RayStream &rays, float shadow_bias, std::vector<AcceleratorIntersectData> &results) const
+{
+	if(nodes_.empty() || !motion_bounds_.empty()) return Accelerator::intersectS(rays, shadow_bias, results);
+	results.assign(rays.size(), {});
+	for(size_t ray_offset = 0; ray_offset < rays.size(); ray_offset += RayPacket::max_size_)
+	{
+		RayPacket packet(rays, ray_offset, std::min(RayPacket::max_size_, rays.size() - ray_offset));
+		AcceleratorIntersectData *packet_results = &results[ray_offset];
+		traversePacket<false>(packet, [&](size_t ray_id, uint32_t prim_num) -> bool
+		{
+			if(!shadowIntersection(packet_results[ray_id], triangle_soup_, prim_num, primitives_[prim_num], packet.rays_[ray_id], packet.t_max_[ray_id])) return false;
+			packet.t_max_[ray_id] = -std::numeric_limits<float>::infinity();
+			return true;
+		});
+	}
+}
+
+void AcceleratorBvh::intersectTs(const RayStream &rays, int max_depth, float shadow_bias, const Camera *camera, std::vector<AcceleratorTsIntersectData> &results) const
+{
+	//The transparent primitives referenced more than once by spatial splits need filtering, so those rays are traced on their own too
+	if(nodes_.empty() || !motion_bounds_.empty() || duplicated_references_) return Accelerator::intersectTs(rays, max_depth, shadow_bias, camera, results);
+	results.assign(rays.size(), {});
+	for(size_t ray_offset = 0; ray_offset < rays.size(); ray_offset += RayPacket::max_size_)
+	{
+		RayPacket packet(rays, ray_offset, std::min(RayPacket::max_size_, rays.size() - ray_offset));
+		AcceleratorTsIntersectData *packet_results = &results[ray_offset];
+		std::array<bool, RayPacket::max_size_> finished;
+		finished.fill(false);
+		traversePacket<false>(packet, [&](size_t ray_id, uint32_t prim_num) -> bool
+		{
+			if(!transparentShadowIntersection(packet_results[ray_id], nullptr, max_depth, triangle_soup_, prim_num, primitives_[prim_num], packet.rays_[ray_id], packet.t_max_[ray_id], camera)) return false;
+			packet.t_max_[ray_id] = -std::numeric_limits<float>::infinity();
+			finished[ray_id] = true;
+			return true;
+		});
+		for(size_t ray_id = 0; ray_id < packet.size_; ++ray_id)
+		{
+			if(!finished[ray_id]) packet_results[ray_id].hit_ = false;
+		}
+	}
+}
+
+END_YAFARAY
@@ -0,0 +1,561 @@
+/****************************************************************************
+ *      This is part of the libYafaRay package
+ *
+ *      This library is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU Lesser General Public
+ *      License as published by the Free Software Foundation; either
+ *      version 2.1 of the License, or (at your option) any later version.
+ *
+ *      This library is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *      Lesser General Public License for more details.
+ *
+ *      You should have received a copy of the GNU Lesser General Public
+ *      License along with this library; if not, write to the Free Software
+ *      Foundation,Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include "accelerator/accelerator_bvh4.h"
+#include "accelerator/accelerator_bvh.h"
+#include "material/material.h"
+#include "common/logger.h"
+#include "common/param.h"
+#include "common/timer.h"
+#include "geometry/surface.h"
+#include "geometry/primitive/primitive.h"
+#include <cmath>
+#include <cstring>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define YAFARAY_BVH4_SSE 1
+#include <emmintrin.h>
+#endif
+
+BEGIN_YAFARAY
+
+Accelerator * AcceleratorBvh4::factory(Logger &logger, const std::vector<const Primitive *> &primitives, const ParamMap &params)
+{
+	bool precompute_triangles = false;
+	bool compressed_nodes = false;
+	params.getParam("precompute_triangles", precompute_triangles);
+	params.getParam("compressed_nodes", compressed_nodes);
+	return new AcceleratorBvh4(logger, primitives, AcceleratorBvh::getBuildParameters(params), precompute_triangles, compressed_nodes);
+}
+
+AcceleratorBvh4::AcceleratorBvh4(Logger &logger, const std::vector<const Primitive *> &primitives, const BvhBuilder::Parameters &parameters, bool precompute_triangles, bool compressed_nodes) : Accelerator(logger)
+{
+	const auto num_primitives = static_cast<uint32_t>(primitives.size());
+#ifdef YAFARAY_BVH4_SSE
+	logger_.logInfo("BVH4: Starting build (", num_primitives, " prims, bins:", parameters.num_bins_, " leaf_size:", parameters.max_leaf_size_, " cost_ratio:", parameters.cost_ratio_, ", SSE traversal) [using ", parameters.num_threads_, " threads, min indices to spawn threads: ", parameters.min_indices_to_spawn_threads_, "]");
+#else
+	logger_.logInfo("BVH4: Starting build (", num_primitives, " prims, bins:", parameters.num_bins_, " leaf_size:", parameters.max_leaf_size_, " cost_ratio:", parameters.cost_ratio_, ", scalar traversal) [using ", parameters.num_threads_, " threads, min indices to spawn threads: ", parameters.min_indices_to_spawn_threads_, "]");
+#endif
+	Timer timer;
+	timer.addEvent("bvh_build");
+	timer.start("bvh_build");
+
+	std::vector<Bound> bounds;
+	bounds.reserve(num_primitives);
+	if(num_primitives > 0) tree_bound_ = primitives.front()->getBound();
+	else tree_bound_ = {{0.f, 0.f, 0.f}, {0.f, 0.f, 0.f}};
+	for(const auto &primitive : primitives)
+	{
+		bounds.emplace_back(primitive->getBound());
+		tree_bound_ = Bound(tree_bound_, bounds.back());
+	}
+	if(num_primitives == 0)
+	{
+		logger_.logWarning("BVH4: No primitives, empty tree built");
+		return;
+	}
+
+	BvhBuilder::Result bvh_result = BvhBuilder(bounds, parameters).build();
+	nodes_.reserve(bvh_result.nodes_.size() / (width_ - 1) + 1);
+	collapseTree(bvh_result.nodes_, 0);
+	nodes_.shrink_to_fit();
+	if(compressed_nodes) compressNodes();
+	primitives_.reserve(num_primitives);
+	for(const auto &prim_id : bvh_result.prim_indices_) primitives_.emplace_back(primitives[prim_id]);
+	if(precompute_triangles) triangle_soup_ = TriangleSoup(primitives_);
+
+	timer.stop("bvh_build");
+	logger_.logInfo("BVH4: Build time: ", timer.getTime("bvh_build"), "s");
+	if(precompute_triangles) logger_.logInfo("BVH4: Precomputed triangles: ", triangle_soup_.numTriangles(), " (", triangle_soup_.memoryUsed() / 1024, "KB)");
+	const size_t num_nodes = compressed_nodes ? compressed_nodes_.size() : nodes_.size();
+	const size_t node_bytes = compressed_nodes ? sizeof(CompressedNode) : sizeof(Node);
+	//The interior/leaf statistics are the ones of the binary tree, but its nodes are freed after the collapse, so the memory reported is the one of the wide nodes kept for the traversal
+	bvh_result.stats_.outputLog(logger, num_primitives, bvh_result.nodes_.size(), num_nodes * node_bytes + primitives_.size() * sizeof(const Primitive *));
+	if(logger_.isVerbose())
+	{
+		logger_.logVerbose("BVH4: Wide nodes: ", num_nodes, " (", static_cast<float>(bvh_result.stats_.bvh_inodes_ + bvh_result.stats_.bvh_leaves_ - 1) / num_nodes, " children per node)");
+		logger_.logVerbose("BVH4: Node format: ", compressed_nodes ? "compressed" : "full precision", " (", node_bytes, " bytes per node, ", static_cast<float>(num_nodes * node_bytes) / num_primitives, " bytes per primitive)");
+	}
+}
+
+AcceleratorBvh4::~AcceleratorBvh4()
+{
+	if(logger_.isVerbose()) logger_.logVerbose("BVH4: Done");
+}
+
+/*! Creates a wide node from a binary node, pulling up the grandchildren with the largest
+	surface area until the node is full, and recursively does the same for its children */
+uint32_t AcceleratorBvh4::collapseTree(const std::vector<BvhBuilder::Node> &binary_nodes, uint32_t binary_node_id)
+{
+	const auto node_id = static_cast<uint32_t>(nodes_.size());
+	nodes_.emplace_back();
+	std::array<uint32_t, width_> children;
+	int num_children = 0;
+	const BvhBuilder::Node &binary_node = binary_nodes[binary_node_id];
+	if(binary_node.isLeaf()) children[num_children++] = binary_node_id;
+	else
+	{
+		children[num_children++] = binary_node.getLeftChild();
+		children[num_children++] = binary_node.getRightChild();
+	}
+	while(num_children < width_)
+	{
+		int largest_child = -1;
+		float largest_area = -1.f;
+		for(int child = 0; child < num_children; ++child)
+		{
+			const BvhBuilder::Node &binary_child = binary_nodes[children[child]];
+			if(binary_child.isLeaf()) continue;
+			const float area = BvhBuilder::halfArea(binary_child.getBound());
+			if(area > largest_area)
+			{
+				largest_area = area;
+				largest_child = child;
+			}
+		}
+		if(largest_child < 0) break;
+		const BvhBuilder::Node &binary_child = binary_nodes[children[largest_child]];
+		children[largest_child] = binary_child.getLeftChild();
+		children[num_children++] = binary_child.getRightChild();
+	}
+	for(int child = 0; child < num_children; ++child)
+	{
+		const BvhBuilder::Node &binary_child = binary_nodes[children[child]];
+		if(binary_child.isLeaf()) nodes_[node_id].setChild(child, binary_child.getBound(), binary_child.getPrimitivesOffset(), binary_child.nPrimitives());
+		else
+		{
+			const uint32_t child_node_id = collapseTree(binary_nodes, children[child]);
+			nodes_[node_id].setChild(child, binary_child.getBound(), child_node_id, 0);
+		}
+	}
+	return node_id;
+}
+
+/*! Replaces the full precision nodes with compressed nodes, keeping the same node indices */
+void AcceleratorBvh4::compressNodes()
+{
+	compressed_nodes_.resize(nodes_.size());
+	for(uint32_t node_id = 0; node_id < nodes_.size(); ++node_id)
+	{
+		const Node &node = nodes_[node_id];
+		Bound node_bound = node.getBound(0);
+		for(int child = 1; child < width_; ++child)
+		{
+			if(!node.isEmpty(child)) node_bound = Bound(node_bound, node.getBound(child));
+		}
+		compressed_nodes_[node_id].setBound(node_bound);
+		for(int child = 0; child < width_; ++child)
+		{
+			if(!node.isEmpty(child)) setCompressedChild(node_id, child, node.getBound(child), node.getOffset(child), node.nPrimitives(child));
+		}
+	}
+	compressed_nodes_.shrink_to_fit();
+	std::vector<Node>().swap(nodes_);
+}
+
+/*! Leaves with more primitives than fit in the compressed node counters are replaced by an extra node
+	with up to 4 smaller leaves over the same primitives, all of them with the bound of the original leaf */
+void AcceleratorBvh4::setCompressedChild(uint32_t node_id, int child, const Bound &bound, uint32_t offset, uint32_t num_primitives)
+{
+	if(num_primitives <= CompressedNode::max_leaf_primitives_)
+	{
+		compressed_nodes_[node_id].setChild(child, bound, offset, num_primitives);
+		return;
+	}
+	const auto split_node_id = static_cast<uint32_t>(compressed_nodes_.size());
+	compressed_nodes_.emplace_back();
+	compressed_nodes_[split_node_id].setBound(bound);
+	compressed_nodes_[node_id].setChild(child, bound, split_node_id, 0);
+	const uint32_t prims_end = offset + num_primitives;
+	const uint32_t split_num_primitives = (num_primitives + width_ - 1) / width_;
+	for(int split_child = 0; split_child < width_ && offset < prims_end; ++split_child)
+	{
+		setCompressedChild(split_node_id, split_child, bound, offset, std::min(split_num_primitives, prims_end - offset));
+		offset += split_num_primitives;
+	}
+}
+
+AcceleratorBvh4::RayData::RayData(const Ray &ray)
+{
+	const Vec3 inv_dir = AcceleratorBvh::invDirection(ray.dir_);
+	for(int axis = 0; axis < 3; ++axis)
+	{
+		from_[axis].fill(ray.from_[axis]);
+		inv_dir_[axis].fill(inv_dir[axis]);
+		near_id_[axis] = inv_dir[axis] >= 0.f ? 0 : 1;
+	}
+}
+
+AcceleratorBvh4::Node::Node()
+{
+	for(int axis = 0; axis < 3; ++axis)
+	{
+		bounds_[0][axis].fill(std::numeric_limits<float>::infinity());
+		bounds_[1][axis].fill(-std::numeric_limits<float>::infinity());
+	}
+	offsets_.fill(0);
+	num_primitives_.fill(0);
+}
+
+void AcceleratorBvh4::Node::setChild(int child, const Bound &bound, uint32_t offset, uint32_t num_primitives)
+{
+	for(int axis = 0; axis < 3; ++axis)
+	{
+		bounds_[0][axis][child] = bound.a_[axis];
+		bounds_[1][axis][child] = bound.g_[axis];
+	}
+	offsets_[child] = offset;
+	num_primitives_[child] = num_primitives;
+}
+
+Bound AcceleratorBvh4::Node::getBound(int child) const
+{
+	return {{bounds_[0][0][child], bounds_[0][1][child], bounds_[0][2][child]}, {bounds_[1][0][child], bounds_[1][1][child], bounds_[1][2][child]}};
+}
+
+int AcceleratorBvh4::Node::intersect(const RayData &ray_data, float t_max, std::array<float, width_> &t_near) const
+{
+	return intersectBounds(bounds_, ray_data, t_max, t_near);
+}
+
+constexpr uint32_t AcceleratorBvh4::CompressedNode::max_leaf_primitives_;
+
+/*! Sets up the quantization grid over the node bound, with the smallest power of two cell
+	size in each axis so 255 cells cover the whole bound. Must be called before adding children */
+void AcceleratorBvh4::CompressedNode::setBound(const Bound &bound)
+{
+	for(int axis = 0; axis < 3; ++axis)
+	{
+		origin_[axis] = bound.a_[axis];
+		int exponent = -126;
+		const float extent = bound.g_[axis] - bound.a_[axis];
+		if(extent > 0.f)
+		{
+			std::frexp(extent / 255.f, &exponent); //2^exponent >= extent / 255
+			exponent = std::max(exponent, -126);
+		}
+		cell_exponents_[axis] = static_cast<int8_t>(exponent);
+		//the decoded grid end can be rounded below the bound maximum when the origin is far from 0
+		while(cell_exponents_[axis] < 127 && origin_[axis] + 255.f * cellSize(axis) < bound.g_[axis]) ++cell_exponents_[axis];
+	}
+}
+
+/*! The bound is quantized rounding outwards, so the decoded bound always encloses it */
+void AcceleratorBvh4::CompressedNode::setChild(int child, const Bound &bound, uint32_t offset, uint32_t num_primitives)
+{
+	for(int axis = 0; axis < 3; ++axis)
+	{
+		const float cell_size = cellSize(axis);
+		int cell_min = std::max(0, std::min(static_cast<int>(std::floor((bound.a_[axis] - origin_[axis]) / cell_size)), 255));
+		int cell_max = std::max(0, std::min(static_cast<int>(std::ceil((bound.g_[axis] - origin_[axis]) / cell_size)), 255));
+		while(cell_min > 0 && origin_[axis] + static_cast<float>(cell_min) * cell_size > bound.a_[axis]) --cell_min;
+		while(cell_max < 255 && origin_[axis] + static_cast<float>(cell_max) * cell_size < bound.g_[axis]) ++cell_max;
+		bounds_[0][axis][child] = static_cast<uint8_t>(cell_min);
+		bounds_[1][axis][child] = static_cast<uint8_t>(cell_max);
+	}
+	offsets_[child] = offset;
+	num_primitives_[child] = static_cast<uint8_t>(num_primitives);
+	child_mask_ |= (1 << child);
+}
+
+float AcceleratorBvh4::CompressedNode::cellSize(int axis) const
+{
+	//builds the float 2^exponent directly from its bits
+	const uint32_t bits = static_cast<uint32_t>(cell_exponents_[axis] + 127) << 23;
+	float cell_size;
+	std::memcpy(&cell_size, &bits, sizeof(float));
+	return cell_size;
+}
+
+/*! Decodes the children bounds and tests them like the full precision nodes, masking out the unused children */
+int AcceleratorBvh4::CompressedNode::intersect(const RayData &ray_data, float t_max, std::array<float, width_> &t_near) const
+{
+	alignas(16) Bounds bounds;
+	for(int axis = 0; axis < 3; ++axis)
+	{
+		const float cell_size = cellSize(axis);
+#ifdef YAFARAY_BVH4_SSE
+		const __m128 origin = _mm_set1_ps(origin_[axis]);
+		const __m128 cell_size_4 = _mm_set1_ps(cell_size);
+		for(int min_max = 0; min_max < 2; ++min_max)
+		{
+			int32_t cells_packed;
+			std::memcpy(&cells_packed, bounds_[min_max][axis].data(), sizeof(int32_t));
+			const __m128i cells = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(cells_packed), _mm_setzero_si128()), _mm_setzero_si128());
+			_mm_store_ps(bounds[min_max][axis].data(), _mm_add_ps(origin, _mm_mul_ps(_mm_cvtepi32_ps(cells), cell_size_4)));
+		}
+#else
+		for(int min_max = 0; min_max < 2; ++min_max)
+		{
+			for(int child = 0; child < width_; ++child) bounds[min_max][axis][child] = origin_[axis] + static_cast<float>(bounds_[min_max][axis][child]) * cell_size;
+		}
+#endif
+	}
+	return intersectBounds(bounds, ray_data, t_max, t_near) & child_mask_;
+}
+
+/*! Slabs test against the bounds of all the children at once. Returns a bit mask with
+	the children hit and stores their entry distances in t_near */
+int AcceleratorBvh4::intersectBounds(const Bounds &bounds, const RayData &ray_data, float t_max, std::array<float, width_> &t_near)
+{
+	countNodeTests(width_);
+#ifdef YAFARAY_BVH4_SSE
+	__m128 t_entry_axes[3], t_exit_axes[3];
+	for(int axis = 0; axis < 3; ++axis)
+	{
+		const __m128 from = _mm_load_ps(ray_data.from_[axis].data());
+		const __m128 inv_dir = _mm_load_ps(ray_data.inv_dir_[axis].data());
+		t_entry_axes[axis] = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(bounds[ray_data.near_id_[axis]][axis].data()), from), inv_dir);
+		t_exit_axes[axis] = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(bounds[1 - ray_data.near_id_[axis]][axis].data()), from), inv_dir);
+	}
+	const __m128 t_entry = _mm_max_ps(_mm_max_ps(t_entry_axes[0], t_entry_axes[1]), _mm_max_ps(t_entry_axes[2], _mm_setzero_ps()));
+	//conservative rounding so rays grazing shared faces of adjacent bounds are not lost
+	const __m128 t_exit = _mm_min_ps(_mm_mul_ps(_mm_min_ps(_mm_min_ps(t_exit_axes[0], t_exit_axes[1]), t_exit_axes[2]), _mm_set1_ps(1.00000024f)), _mm_set1_ps(t_max));
+	_mm_storeu_ps(t_near.data(), t_entry);
+	return _mm_movemask_ps(_mm_cmple_ps(t_entry, t_exit));
+#else
+	int mask = 0;
+	for(int child = 0; child < width_; ++child)
+	{
+		float t_entry = 0.f;
+		float t_exit = std::numeric_limits<float>::infinity();
+		for(int axis = 0; axis < 3; ++axis)
+		{
+			t_entry = std::max(t_entry, (bounds[ray_data.near_id_[axis]][axis][child] - ray_data.from_[axis][child]) * ray_data.inv_dir_[axis][child]);
+			t_exit = std::min(t_exit, (bounds[1 - ray_data.near_id_[axis]][axis][child] - ray_data.from_[axis][child]) * ray_data.inv_dir_[axis][child]);
+		}
+		t_exit = std::min(t_exit * 1.00000024f, t_max);
+		t_near[child] = t_entry;
+		if(t_entry <= t_exit) mask |= (1 << child);
+	}
+	return mask;
+#endif
+}
+
+//============================
+/*! The standard intersect function,
+	returns the closest hit within dist
+*/
+AcceleratorIntersectData AcceleratorBvh4::intersect(const Ray &ray, float t_max) const
+{
+	if(compressed_nodes_.empty()) return intersectNodes(nodes_, ray, t_max);
+	else return intersectNodes(compressed_nodes_, ray, t_max);
+}
+
+AcceleratorIntersectData AcceleratorBvh4::intersectS(const Ray &ray, float t_max, float) const
+{
+	if(compressed_nodes_.empty()) return intersectSNodes(nodes_, ray, t_max);
+	else return intersectSNodes(compressed_nodes_, ray, t_max);
+}
+
+AcceleratorTsIntersectData AcceleratorBvh4::intersectTs(const Ray &ray, int max_depth, float t_max, float, const Camera *camera) const
+{
+	if(compressed_nodes_.empty()) return intersectTsNodes(nodes_, ray, max_depth, t_max, camera);
+	else return intersectTsNodes(compressed_nodes_, ray, max_depth, t_max, camera);
+}
+
+template<typename NodeType>
+AcceleratorIntersectData AcceleratorBvh4::intersectNodes(const std::vector<NodeType> &nodes, const Ray &ray, float t_max) const
+{
+	if(nodes.empty()) return {};
+	AcceleratorIntersectData accelerator_intersect_data;
+	accelerator_intersect_data.t_max_ = t_max;
+	const RayData ray_data(ray);
+
+	const auto &primitive_intersection = [](AcceleratorIntersectData &accelerator_intersect_data, const TriangleSoup &triangle_soup, uint32_t prim_num, const Primitive *primitive, const Ray &ray) -> void
+	{
+		const IntersectData intersect_data = triangle_soup.intersect(prim_num, primitive, ray);
+		if(intersect_data.hit_)
+		{
+			if(intersect_data.t_hit_ < accelerator_intersect_data.t_max_ && intersect_data.t_hit_ >= ray.tmin_)
+			{
+				const Visibility prim_visibility = primitive->getVisibility();
+				if(prim_visibility == Visibility::NormalVisible || prim_visibility == Visibility::VisibleNoShadows)
+				{
+					const Visibility mat_visibility = primitive->getMaterial()->getVisibility();
+					if(mat_visibility == Visibility::NormalVisible || mat_visibility == Visibility::VisibleNoShadows)
+					{
+						accelerator_intersect_data.setIntersectData(intersect_data);
+						accelerator_intersect_data.t_max_ = intersect_data.t_hit_;
+						accelerator_intersect_data.hit_primitive_ = primitive;
+					}
+				}
+			}
+		}
+	};
+
+	std::array<Stack, bvh_max_stack_> stack;
+	int stack_id = 0;
+	stack[stack_id++] = {0, 0, 0.f};
+	while(stack_id > 0)
+	{
+		const Stack entry = stack[--stack_id];
+		if(entry.t_ > accelerator_intersect_data.t_max_) continue;
+		if(entry.num_primitives_ > 0)
+		{
+			const uint32_t prims_end = entry.offset_ + entry.num_primitives_;
+			for(uint32_t prim_num = entry.offset_; prim_num < prims_end; ++prim_num)
+			{
+				primitive_intersection(accelerator_intersect_data, triangle_soup_, prim_num, primitives_[prim_num], ray);
+			}
+			continue;
+		}
+		const NodeType &node = nodes[entry.offset_];
+		std::array<float, width_> t_near;
+		const int hit_mask = node.intersect(ray_data, accelerator_intersect_data.t_max_, t_near);
+		// push the children hit from farthest to nearest, so the nearest is visited first
+		const int stack_id_first = stack_id;
+		for(int child = 0; child < width_; ++child)
+		{
+			if(!(hit_mask & (1 << child))) continue;
+			int stack_id_sorted = stack_id++;
+			while(stack_id_sorted > stack_id_first && stack[stack_id_sorted - 1].t_ < t_near[child])
+			{
+				stack[stack_id_sorted] = stack[stack_id_sorted - 1];
+				--stack_id_sorted;
+			}
+			stack[stack_id_sorted] = {node.getOffset(child), node.nPrimitives(child), t_near[child]};
+		}
+	}
+	return accelerator_intersect_data;
+}
+
+template<typename NodeType>
+AcceleratorIntersectData AcceleratorBvh4::intersectSNodes(const std::vector<NodeType> &nodes, const Ray &ray, float t_max) const
+{
+	if(nodes.empty()) return {};
+	AcceleratorIntersectData accelerator_intersect_data;
+	const RayData ray_data(ray);
+
+	const auto &primitive_intersection = [](AcceleratorIntersectData &accelerator_intersect_data, const TriangleSoup &triangle_soup, uint32_t prim_num, const Primitive *primitive, const Ray &ray, float t_max) -> bool
+	{
+		const IntersectData intersect_data = triangle_soup.intersect(prim_num, primitive, ray);
+		if(intersect_data.hit_)
+		{
+			if(intersect_data.t_hit_ < t_max && intersect_data.t_hit_ >= 0.f)
+			{
+				const Visibility prim_visibility = primitive->getVisibility();
+				if(prim_visibility == Visibility::NormalVisible || prim_visibility == Visibility::InvisibleShadowsOnly)
+				{
+					const Visibility mat_visibility = primitive->getMaterial()->getVisibility();
+					if(mat_visibility == Visibility::NormalVisible || mat_visibility == Visibility::InvisibleShadowsOnly)
+					{
+						accelerator_intersect_data.setIntersectData(intersect_data);
+						accelerator_intersect_data.hit_primitive_ = primitive;
+						return true;
+					}
+				}
+			}
+		}
+		return false;
+	};
+
+	std::array<Stack, bvh_max_stack_> stack;
+	int stack_id = 0;
+	stack[stack_id++] = {0, 0, 0.f};
+	while(stack_id > 0)
+	{
+		const Stack entry = stack[--stack_id];
+		if(entry.num_primitives_ > 0)
+		{
+			const uint32_t prims_end = entry.offset_ + entry.num_primitives_;
+			for(uint32_t prim_num = entry.offset_; prim_num < prims_end; ++prim_num)
+			{
+				if(primitive_intersection(accelerator_intersect_data, triangle_soup_, prim_num, primitives_[prim_num], ray, t_max)) return accelerator_intersect_data;
+			}
+			continue;
+		}
+		const NodeType &node = nodes[entry.offset_];
+		std::array<float, width_> t_near;
+		const int hit_mask = node.intersect(ray_data, t_max, t_near);
+		// any hit is enough, so there is no need to order the children
+		for(int child = 0; child < width_; ++child)
+		{
+			if(hit_mask & (1 << child)) stack[stack_id++] = {node.getOffset(child), node.nPrimitives(child), t_near[child]};
+		}
+	}
+	return {};
+}
+
+/*=============================================================
+	allow for transparent shadows.
+=============================================================*/
+
+template<typename NodeType>
+AcceleratorTsIntersectData AcceleratorBvh4::intersectTsNodes(const std::vector<NodeType> &nodes, const Ray &ray, int max_depth, float t_max, const Camera *camera) const
+{
+	if(nodes.empty()) return {};
+	AcceleratorTsIntersectData accelerator_intersect_data;
+	const RayData ray_data(ray);
+
+	//Each primitive is only referenced once in the BVH so, unlike in the kd-tree, there is no need to filter the transparent primitives already found
+	const auto &primitive_intersection = [](AcceleratorTsIntersectData &accelerator_intersect_data, int max_depth, const TriangleSoup &triangle_soup, uint32_t prim_num, const Primitive *primitive, const Ray &ray, float t_max, const Camera *camera) -> bool
+	{
+		const IntersectData intersect_data = triangle_soup.intersect(prim_num, primitive, ray);
+		if(intersect_data.hit_)
+		{
+			if(intersect_data.t_hit_ < t_max && intersect_data.t_hit_ >= ray.tmin_)
+			{
+				const Material *mat = primitive->getMaterial();
+				if(mat->getVisibility() == Visibility::NormalVisible || mat->getVisibility() == Visibility::InvisibleShadowsOnly)
+				{
+					accelerator_intersect_data.setIntersectData(intersect_data);
+					accelerator_intersect_data.hit_primitive_ = primitive;
+					if(!mat->isTransparent()) return true;
+					if(accelerator_intersect_data.transparent_depth_ >= max_depth) return true;
+					const Point3 hit_point{ray.from_ + accelerator_intersect_data.t_hit_ * ray.dir_};
+					accelerator_intersect_data.transparent_color_ *= primitive->getShadowTransparency(hit_point, accelerator_intersect_data, ray.dir_, nullptr, camera);
+					++accelerator_intersect_data.transparent_depth_;
+				}
+			}
+		}
+		return false;
+	};
+
+	std::array<Stack, bvh_max_stack_> stack;
+	int stack_id = 0;
+	stack[stack_id++] = {0, 0, 0.f};
+	while(stack_id > 0)
+	{
+		const Stack entry = stack[--stack_id];
+		if(entry.num_primitives_ > 0)
+		{
+			const uint32_t prims_end = entry.offset_ + entry.num_primitives_;
+			for(uint32_t prim_num = entry.offset_; prim_num < prims_end; ++prim_num)
+			{
+				if(primitive_intersection(accelerator_intersect_data, max_depth, triangle_soup_, prim_num, primitives_[prim_num], ray, t_max, camera)) return accelerator_intersect_data;
+			}
+			continue;
+		}
+		const NodeType &node = nodes[entry.offset_];
+		std::array<float, width_> t_near;
+		const int hit_mask = node.intersect(ray_data, t_max, t_near);
+		for(int child = 0; child < width_; ++child)
+		{
+			if(hit_mask & (1 << child)) stack[stack_id++] = {node.getOffset(child), node.nPrimitives(child), t_near[child]};
+		}
+	}
+	accelerator_intersect_data.hit_ = false;
+	return accelerator_intersect_data;
+}
+
+size_t AcceleratorBvh4::memoryUsed() const
+{
+	return nodes_.size() * sizeof(Node) + compressed_nodes_.size() * sizeof(CompressedNode) + primitives_.size() * sizeof(const Primitive *) + triangle_soup_.memoryUsed();
+}
+
+END_YAFARAY
@@ -0,0 +1,106 @@
+/****************************************************************************
+ *      This is part of the libYafaRay package
+ *
+ *      This library is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU Lesser General Public
+ *      License as published by the Free Software Foundation; either
+ *      version 2.1 of the License, or (at your option) any later version.
+ *
+ *      This library is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *      Lesser General Public License for more details.
+ *
+ *      You should have received a copy of the GNU Lesser General Public
+ *      License along with this library; if not, write to the Free Software
+ *      Foundation,Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include "accelerator/accelerator_cache.h"
+#include "common/logger.h"
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+
+BEGIN_YAFARAY
+
+static constexpr std::array<char, 8> cache_signature {{'Y', 'A', 'F', 'A', 'C', 'C', 'E', 'L'}};
+
+AcceleratorCache::AcceleratorCache(Logger &logger, const std::string &directory, const std::string &accelerator_name, uint64_t key) : logger_(logger), key_(key)
+{
+	std::stringstream file_name;
+	file_name << accelerator_name << "_" << std::hex << std::setw(16) << std::setfill('0') << key << ".yafacc";
+	path_ = Path(directory, file_name.str(), "").getFullPath();
+}
+
+/*! Maps the cache file for the key, returns false if it does not exist or it is not valid */
+bool AcceleratorCache::load()
+{
+	if(!File::exists(path_, true)) return false;
+	mapped_file_ = std::make_shared<const MappedFile>(path_);
+	Header header;
+	if(!mapped_file_->isMapped() || mapped_file_->size() < sizeof(Header))
+	{
+		logger_.logWarning("Accelerator cache: could not map cache file '", path_, "'");
+		mapped_file_ = nullptr;
+		return false;
+	}
+	std::memcpy(&header, mapped_file_->data(), sizeof(Header));
+	if(header.signature_ != cache_signature || header.version_ != version_ || header.key_ != key_ || mapped_file_->size() < sizeof(Header) + header.num_arrays_ * sizeof(ArrayHeader))
+	{
+		logger_.logWarning("Accelerator cache: cache file '", path_, "' is not valid or belongs to a different version, it will be overwritten");
+		mapped_file_ = nullptr;
+		return false;
+	}
+	array_headers_.resize(header.num_arrays_);
+	if(header.num_arrays_ > 0) std::memcpy(array_headers_.data(), mapped_file_->data() + sizeof(Header), header.num_arrays_ * sizeof(ArrayHeader));
+	return true;
+}
+
+bool AcceleratorCache::getArrayData(size_t array_id, size_t element_size, size_t element_alignment, const char *&data, size_t &size) const
+{
+	if(!mapped_file_ || array_id >= array_headers_.size()) return false;
+	const ArrayHeader &array_header = array_headers_[array_id];
+	if(array_header.element_size_ != element_size || array_header.offset_ % element_alignment != 0) return false;
+	if(array_header.offset_ > mapped_file_->size() || array_header.size_ > (mapped_file_->size() - array_header.offset_) / element_size) return false;
+	data = mapped_file_->data() + array_header.offset_;
+	size = static_cast<size_t>(array_header.size_);
+	return true;
+}
+
+void AcceleratorCache::addArrayData(const char *data, size_t size, size_t element_size)
+{
+	//Offsets are relative to the arrays data until the file is saved
+	const size_t offset = (new_arrays_data_.size() + alignment_ - 1) / alignment_ * alignment_;
+	new_array_headers_.push_back({offset, size, element_size});
+	new_arrays_data_.resize(offset);
+	new_arrays_data_.append(data, size * element_size);
+}
+
+/*! Saves the added arrays to the cache file, through a temporary file so the files mapped by other renders are not modified */
+bool AcceleratorCache::save()
+{
+	Header header;
+	header.signature_ = cache_signature;
+	header.version_ = version_;
+	header.num_arrays_ = static_cast<uint32_t>(new_array_headers_.size());
+	header.key_ = key_;
+	const size_t arrays_offset = (sizeof(Header) + new_array_headers_.size() * sizeof(ArrayHeader) + alignment_ - 1) / alignment_ * alignment_;
+	for(auto &array_header : new_array_headers_) array_header.offset_ += arrays_offset;
+	std::string buffer(arrays_offset, '\0');
+	std::memcpy(&buffer[0], &header, sizeof(Header));
+	if(!new_array_headers_.empty()) std::memcpy(&buffer[sizeof(Header)], new_array_headers_.data(), new_array_headers_.size() * sizeof(ArrayHeader));
+	buffer.append(new_arrays_data_);
+	new_arrays_data_.clear();
+	new_array_headers_.clear();
+	File file(path_);
+	if(!file.save(buffer, true))
+	{
+		logger_.logWarning("Accelerator cache: could not save cache file '", path_, "'");
+		return false;
+	}
+	logger_.logInfo("Accelerator cache: saved cache file '", path_, "' (", buffer.size() / 1024, "KB)");
+	return true;
+}
+
+END_YAFARAY
@@ -28,7 +28,7 @@
 
 BEGIN_YAFARAY
 
-const Accelerator * AcceleratorKdTree::factory(Logger &logger, const std::vector<const Primitive *> &primitives, const ParamMap &params)
+Accelerator * AcceleratorKdTree::factory(Logger &logger, const std::vector<const Primitive *> &primitives, const ParamMap &params)
 {
 	int depth = 0;
 	int leaf_size = 1;
@@ -124,7 +124,34 @@ AcceleratorKdTree::AcceleratorKdTree(Logger &logger, const std::vector<const Pri
 
 AcceleratorKdTree::~AcceleratorKdTree()
 {
-	if(logger_.isVerbose()) logger_.logVerbose("Kd-Tree: Done");
+	if(logger_.isVerbose())
+	{
+		const uint64_t num_primitive_tests = num_primitive_tests_;
+		const uint64_t num_mailbox_skips = num_mailbox_skips_;
+		if(num_primitive_tests + num_mailbox_skips > 0) logger_.logVerbose("Kd-Tree: Primitive intersection tests: ", num_primitive_tests, ", repeated tests skipped by the mailbox: ", num_mailbox_skips, " (", 100.0 * static_cast<double>(num_mailbox_skips) / static_cast<double>(num_primitive_tests + num_mailbox_skips), "%)");
+		logger_.logVerbose("Kd-Tree: Done");
+	}
+}
+
+/*! The statistics pending in the calling thread are discarded when used with a different accelerator,
+	as the previous accelerator could have been deleted already. The last few rays of each thread may not be included */
+void AcceleratorKdTree::addMailboxStats(const Mailbox &mailbox) const
+{
+	static thread_local MailboxStats mailbox_stats;
+	if(mailbox_stats.accelerator_id_ != id_)
+	{
+		mailbox_stats = MailboxStats();
+		mailbox_stats.accelerator_id_ = id_;
+	}
+	mailbox_stats.num_tests_ += mailbox.num_tests_;
+	mailbox_stats.num_skips_ += mailbox.num_skips_;
+	if(mailbox_stats.num_tests_ >= MailboxStats::stats_batch_size_)
+	{
+		num_primitive_tests_ += mailbox_stats.num_tests_;
+		num_mailbox_skips_ += mailbox_stats.num_skips_;
+		mailbox_stats.num_tests_ = 0;
+		mailbox_stats.num_skips_ = 0;
+	}
 }
 
 // ============================================================
@@ -633,10 +660,13 @@ int AcceleratorKdTree::buildTree(uint32_t n_prims, const std::vector<const Primi
 */
 AcceleratorIntersectData AcceleratorKdTree::intersect(const Ray &ray, float t_max) const
 {
-	return intersect(ray, t_max, nodes_.get(), tree_bound_);
+	Mailbox mailbox;
+	const AcceleratorIntersectData accelerator_intersect_data = intersect(ray, t_max, nodes_.get(), tree_bound_, mailbox);
+	addMailboxStats(mailbox);
+	return accelerator_intersect_data;
 }
 
-AcceleratorIntersectData AcceleratorKdTree::intersect(const Ray &ray, float t_max, const Node *nodes, const Bound &tree_bound)
+AcceleratorIntersectData AcceleratorKdTree::intersect(const Ray &ray, float t_max, const Node *nodes, const Bound &tree_bound, Mailbox &mailbox)
 {
 	AcceleratorIntersectData accelerator_intersect_data;
 	accelerator_intersect_data.t_max_ = t_max;
@@ -671,6 +701,7 @@ AcceleratorIntersectData AcceleratorKdTree::intersect(const Ray &ray, float t_ma
 		// loop until leaf is found
 		while(!curr_node->isLeaf())
 		{
+			countNodeTests(1);
 			const int axis = curr_node->splitAxis();
 			const float split_val = curr_node->splitPos();
 
@@ -725,6 +756,7 @@ AcceleratorIntersectData AcceleratorKdTree::intersect(const Ray &ray, float t_ma
 		// Check for intersections inside leaf node
 		const auto &primitive_intersection = [](AcceleratorIntersectData &accelerator_intersect_data, const Primitive *primitive, const Ray &ray) -> void
 		{
+			countPrimitiveTest();
 			const IntersectData intersect_data = primitive->intersect(ray);
 			if(intersect_data.hit_)
 			{
@@ -748,7 +780,7 @@ AcceleratorIntersectData AcceleratorKdTree::intersect(const Ray &ray, float t_ma
 		if(n_primitives == 1)
 		{
 			const Primitive *primitive = curr_node->one_primitive_;
-			primitive_intersection(accelerator_intersect_data, primitive, ray);
+			if(!mailbox.tested(primitive)) primitive_intersection(accelerator_intersect_data, primitive, ray);
 		}
 		else
 		{
@@ -756,7 +788,7 @@ AcceleratorIntersectData AcceleratorKdTree::intersect(const Ray &ray, float t_ma
 			for(uint32_t i = 0; i < n_primitives; ++i)
 			{
 				const Primitive *primitive = prims[i];
-				primitive_intersection(accelerator_intersect_data, primitive, ray);
+				if(!mailbox.tested(primitive)) primitive_intersection(accelerator_intersect_data, primitive, ray);
 			}
 		}
 
@@ -774,10 +806,13 @@ AcceleratorIntersectData AcceleratorKdTree::intersect(const Ray &ray, float t_ma
 
 AcceleratorIntersectData AcceleratorKdTree::intersectS(const Ray &ray, float t_max, float shadow_bias) const
 {
-	return intersectS(ray, t_max, shadow_bias, nodes_.get(), tree_bound_);
+	Mailbox mailbox;
+	const AcceleratorIntersectData accelerator_intersect_data = intersectS(ray, t_max, shadow_bias, nodes_.get(), tree_bound_, mailbox);
+	addMailboxStats(mailbox);
+	return accelerator_intersect_data;
 }
 
-AcceleratorIntersectData AcceleratorKdTree::intersectS(const Ray &ray, float t_max, float shadow_bias, const Node *nodes, const Bound &tree_bound)
+AcceleratorIntersectData AcceleratorKdTree::intersectS(const Ray &ray, float t_max, float shadow_bias, const Node *nodes, const Bound &tree_bound, Mailbox &mailbox)
 {
 	AcceleratorIntersectData accelerator_intersect_data;
 	const Bound::Cross cross = tree_bound.cross(ray, t_max);
@@ -808,6 +843,7 @@ AcceleratorIntersectData AcceleratorKdTree::intersectS(const Ray &ray, float t_m
 		// loop until leaf is found
 		while(!curr_node->isLeaf())
 		{
+			countNodeTests(1);
 			const int axis = curr_node->splitAxis();
 			const float split_val = curr_node->splitPos();
 			if(stack[entry_idx].point_[axis] <= split_val)
@@ -861,6 +897,7 @@ AcceleratorIntersectData AcceleratorKdTree::intersectS(const Ray &ray, float t_m
 		// Check for intersections inside leaf node
 		const auto &primitive_intersection = [](AcceleratorIntersectData &accelerator_intersect_data, const Primitive *primitive, const Ray &ray, float t_max) -> bool
 				{
+					countPrimitiveTest();
 					const IntersectData intersect_data = primitive->intersect(ray);
 					if(intersect_data.hit_)
 					{
@@ -885,7 +922,7 @@ AcceleratorIntersectData AcceleratorKdTree::intersectS(const Ray &ray, float t_m
 		if(n_primitives == 1)
 		{
 			const Primitive *primitive = curr_node->one_primitive_;
-			if(primitive_intersection(accelerator_intersect_data, primitive, ray, t_max)) return accelerator_intersect_data;
+			if(!mailbox.tested(primitive) && primitive_intersection(accelerator_intersect_data, primitive, ray, t_max)) return accelerator_intersect_data;
 		}
 		else
 		{
@@ -893,7 +930,7 @@ AcceleratorIntersectData AcceleratorKdTree::intersectS(const Ray &ray, float t_m
 			for(uint32_t i = 0; i < n_primitives; ++i)
 			{
 				const Primitive *primitive = prims[i];
-				if(primitive_intersection(accelerator_intersect_data, primitive, ray, t_max)) return accelerator_intersect_data;
+				if(!mailbox.tested(primitive) && primitive_intersection(accelerator_intersect_data, primitive, ray, t_max)) return accelerator_intersect_data;
 			}
 		}
 		entry_idx = exit_idx;
@@ -910,10 +947,13 @@ AcceleratorIntersectData AcceleratorKdTree::intersectS(const Ray &ray, float t_m
 
 AcceleratorTsIntersectData AcceleratorKdTree::intersectTs(const Ray &ray, int max_depth, float t_max, float shadow_bias, const Camera *camera) const
 {
-	return intersectTs(ray, max_depth, t_max, shadow_bias, nodes_.get(), tree_bound_, camera);
+	Mailbox mailbox;
+	const AcceleratorTsIntersectData accelerator_intersect_data = intersectTs(ray, max_depth, t_max, shadow_bias, nodes_.get(), tree_bound_, camera, mailbox);
+	addMailboxStats(mailbox);
+	return accelerator_intersect_data;
 }
 
-AcceleratorTsIntersectData AcceleratorKdTree::intersectTs(const Ray &ray, int max_depth, float t_max, float shadow_bias, const Node *nodes, const Bound &tree_bound, const Camera *camera)
+AcceleratorTsIntersectData AcceleratorKdTree::intersectTs(const Ray &ray, int max_depth, float t_max, float shadow_bias, const Node *nodes, const Bound &tree_bound, const Camera *camera, Mailbox &mailbox)
 {
 	AcceleratorTsIntersectData accelerator_intersect_data;
 	const Bound::Cross cross = tree_bound.cross(ray, t_max);
@@ -932,7 +972,6 @@ AcceleratorTsIntersectData AcceleratorKdTree::intersectTs(const Ray &ray, int ma
 	else inv_dir_z = 1.f / ray.dir_.z();
 
 	Vec3 inv_dir(inv_dir_x, inv_dir_y, inv_dir_z);
-	int depth = 0;
 
 	std::set<const Primitive *> filtered;
 	std::array<Stack, kd_max_stack_> stack;
@@ -961,6 +1000,7 @@ AcceleratorTsIntersectData AcceleratorKdTree::intersectTs(const Ray &ray, int ma
 		// loop until leaf is found
 		while(!curr_node->isLeaf())
 		{
+			countNodeTests(1);
 			const int axis = curr_node->splitAxis();
 			const float split_val = curr_node->splitPos();
 			if(stack[entry_idx].point_[axis] <= split_val)
@@ -1011,8 +1051,9 @@ AcceleratorTsIntersectData AcceleratorKdTree::intersectTs(const Ray &ray, int ma
 		}
 
 		// Check for intersections inside leaf node
-		const auto &primitive_intersection = [](AcceleratorTsIntersectData &accelerator_intersect_data, std::set<const Primitive *> &filtered, int &depth, int max_depth, const Primitive *primitive, const Ray &ray, float t_max, const Camera *camera) -> bool
+		const auto &primitive_intersection = [](AcceleratorTsIntersectData &accelerator_intersect_data, std::set<const Primitive *> &filtered, int max_depth, const Primitive *primitive, const Ray &ray, float t_max, const Camera *camera) -> bool
 		{
+			countPrimitiveTest();
 			const IntersectData intersect_data = primitive->intersect(ray);
 			if(intersect_data.hit_)
 			{
@@ -1026,11 +1067,10 @@ AcceleratorTsIntersectData AcceleratorKdTree::intersectTs(const Ray &ray, int ma
 						if(!mat->isTransparent()) return true;
 						if(filtered.insert(primitive).second)
 						{
-							if(depth >= max_depth) return true;
+							if(accelerator_intersect_data.transparent_depth_ >= max_depth) return true;
 							const Point3 hit_point{ray.from_ + accelerator_intersect_data.t_hit_ * ray.dir_};
-							const auto sp = primitive->getSurface(ray.differentials_.get(), hit_point, accelerator_intersect_data, nullptr, camera);
-							accelerator_intersect_data.transparent_color_ *= sp->getTransparency(ray.dir_, camera);
-							++depth;
+							accelerator_intersect_data.transparent_color_ *= primitive->getShadowTransparency(hit_point, accelerator_intersect_data, ray.dir_, nullptr, camera);
+							++accelerator_intersect_data.transparent_depth_;
 						}
 					}
 				}
@@ -1041,7 +1081,7 @@ AcceleratorTsIntersectData AcceleratorKdTree::intersectTs(const Ray &ray, int ma
 		if(n_primitives == 1)
 		{
 			const Primitive *primitive = curr_node->one_primitive_;
-			if(primitive_intersection(accelerator_intersect_data, filtered, depth, max_depth, primitive, ray, t_max, camera)) return accelerator_intersect_data;
+			if(!mailbox.tested(primitive) && primitive_intersection(accelerator_intersect_data, filtered, max_depth, primitive, ray, t_max, camera)) return accelerator_intersect_data;
 		}
 		else
 		{
@@ -1049,7 +1089,7 @@ AcceleratorTsIntersectData AcceleratorKdTree::intersectTs(const Ray &ray, int ma
 			for(uint32_t i = 0; i < n_primitives; ++i)
 			{
 				const Primitive *primitive = prims[i];
-				if(primitive_intersection(accelerator_intersect_data, filtered, depth, max_depth, primitive, ray, t_max, camera)) return accelerator_intersect_data;
+				if(!mailbox.tested(primitive) && primitive_intersection(accelerator_intersect_data, filtered, max_depth, primitive, ray, t_max, camera)) return accelerator_intersect_data;
 			}
 		}
 		entry_idx = exit_idx;
@@ -1060,4 +1100,9 @@ AcceleratorTsIntersectData AcceleratorKdTree::intersectTs(const Ray &ray, int ma
 	return accelerator_intersect_data;
 }
 
+size_t AcceleratorKdTree::memoryUsed() const
+{
+	return allocated_nodes_count_ * sizeof(Node) + kd_stats_.kd_prims_ * sizeof(const Primitive *);
+}
+
 END_YAFARAY
\ No newline at end of file
@@ -24,11 +24,12 @@
 #include "geometry/axis.h"
 #include "common/param.h"
 #include "image/image_output.h"
-#include <thread>
+#include "common/timer.h"
+#include <unordered_map>
 
 BEGIN_YAFARAY
 
-const Accelerator * AcceleratorKdTreeMultiThread::factory(Logger &logger, const std::vector<const Primitive *> &primitives, const ParamMap &params)
+Accelerator * AcceleratorKdTreeMultiThread::factory(Logger &logger, const std::vector<const Primitive *> &primitives, const ParamMap &params)
 {
 	AcceleratorKdTreeMultiThread::Parameters parameters;
 
@@ -38,6 +39,8 @@ const Accelerator * AcceleratorKdTreeMultiThread::factory(Logger &logger, const
 	params.getParam("empty_bonus", parameters.empty_bonus_);
 	params.getParam("accelerator_threads", parameters.num_threads_);
 	params.getParam("accelerator_min_indices_threads", parameters.min_indices_to_spawn_threads_);
+	params.getParam("precompute_triangles", parameters.precompute_triangles_);
+	params.getParam("cache_dir", parameters.cache_directory_);
 
 	return new AcceleratorKdTreeMultiThread(logger, primitives, parameters);
 }
@@ -49,6 +52,9 @@ AcceleratorKdTreeMultiThread::AcceleratorKdTreeMultiThread(Logger &logger, const
 	const auto num_primitives = static_cast<uint32_t>(primitives.size());
 	logger_.logInfo("Kd-Tree MultiThread: Starting build (", num_primitives, " prims, cost_ratio:", parameters.cost_ratio_, " empty_bonus:", parameters.empty_bonus_, ") [using ", tree_build_parameters.num_threads_, " threads, min indices to spawn threads: ", tree_build_parameters.min_indices_to_spawn_threads_, "]");
 	clock_t clock_start = clock();
+	Timer timer;
+	timer.addEvent("kdtree_build");
+	timer.start("kdtree_build");
 	if(tree_build_parameters.max_depth_ <= 0) tree_build_parameters.max_depth_ = static_cast<int>(7.0f + 1.66f * log(static_cast<float>(num_primitives)));
 	const double log_leaves = 1.442695f * log(static_cast<double >(num_primitives)); // = base2 log
 	if(tree_build_parameters.max_leaf_size_ <= 0)
@@ -79,20 +85,87 @@ AcceleratorKdTreeMultiThread::AcceleratorKdTreeMultiThread(Logger &logger, const
 		tree_bound_.a_[axis] -= foo, tree_bound_.g_[axis] += foo;
 	}
 	if(logger_.isVerbose()) logger_.logVerbose("Kd-Tree MultiThread: Done.");
-	std::vector<uint32_t> prim_indices(num_primitives);
-	for(uint32_t prim_num = 0; prim_num < num_primitives; prim_num++) prim_indices[prim_num] = prim_num;
-	if(logger_.isVerbose()) logger_.logVerbose("Kd-Tree MultiThread: Starting recursive build...");
-	const Result kd_tree_result = buildTree(primitives, tree_bound_, prim_indices, 0, 0, 0, bounds, tree_build_parameters, ClipPlane(ClipPlane::Pos::None), {}, {}, num_current_threads_);
-	nodes_ = std::move(kd_tree_result.nodes_);
+	//Besides the bounds, the tree depends on the triangles geometry when they are clipped
+	std::unique_ptr<AcceleratorCache> cache;
+	if(!tree_build_parameters.cache_directory_.empty())
+	{
+		AcceleratorCache::Key key;
+		key.add(std::string("yafaray-kdtree-multi-thread"));
+		key.add(tree_build_parameters.max_depth_);
+		key.add(tree_build_parameters.max_leaf_size_);
+		key.add(tree_build_parameters.cost_ratio_);
+		key.add(tree_build_parameters.empty_bonus_);
+		std::array<Point3, 3> vertices;
+		for(uint32_t prim_num = 0; prim_num < num_primitives; prim_num++)
+		{
+			key.add(bounds[prim_num]);
+			if(primitives[prim_num]->getTriangleVertices(vertices)) for(const auto &vertex : vertices) key.add(vertex);
+		}
+		cache = std::unique_ptr<AcceleratorCache>(new AcceleratorCache(logger, tree_build_parameters.cache_directory_, "kdtree", key.get()));
+	}
+	CachedArray<uint32_t> leaf_prim_indices;
+	Stats build_stats;
+	size_t allocated_nodes = 0;
+	if(cache && cache->load() && cache->getArray(0, nodes_) && cache->getArray(1, leaf_prim_indices) && validTree(nodes_, leaf_prim_indices, num_primitives))
+	{
+		logger_.logInfo("Kd-Tree MultiThread: Tree loaded from cache file '", cache->getPath(), "'");
+		primitives_.reserve(leaf_prim_indices.size());
+		for(const auto &prim_id : leaf_prim_indices) primitives_.emplace_back(primitives[prim_id]);
+	}
+	else
+	{
+		std::vector<uint32_t> prim_indices(num_primitives);
+		for(uint32_t prim_num = 0; prim_num < num_primitives; prim_num++) prim_indices[prim_num] = prim_num;
+		if(logger_.isVerbose()) logger_.logVerbose("Kd-Tree MultiThread: Starting recursive build...");
+		Result kd_tree_result;
+		{
+			TaskPool task_pool(tree_build_parameters.num_threads_);
+			buildTreeWorker(primitives, tree_bound_, prim_indices, 0, 0, 0, bounds, tree_build_parameters, ClipPlane(ClipPlane::Pos::None), {}, {}, kd_tree_result, task_pool);
+		}
+		allocated_nodes = kd_tree_result.nodes_.capacity();
+		nodes_ = CachedArray<Node>(std::move(kd_tree_result.nodes_));
+		primitives_ = std::move(kd_tree_result.primitives_);
+		build_stats = kd_tree_result.stats_;
+		if(cache)
+		{
+			//The leaves primitives are saved as indices of the primitives list
+			std::unordered_map<const Primitive *, uint32_t> primitives_ids;
+			for(uint32_t prim_num = 0; prim_num < num_primitives; prim_num++) primitives_ids[primitives[prim_num]] = prim_num;
+			std::vector<uint32_t> leaf_prim_ids;
+			leaf_prim_ids.reserve(primitives_.size());
+			for(const auto &primitive : primitives_) leaf_prim_ids.emplace_back(primitives_ids[primitive]);
+			cache->addArray(nodes_);
+			cache->addArray(leaf_prim_ids);
+			cache->save();
+		}
+	}
+	if(tree_build_parameters.precompute_triangles_) triangle_soup_ = TriangleSoup(primitives_);
 	//print some stats:
 	const clock_t clock_elapsed = clock() - clock_start;
-	if(logger_.isVerbose())
+	timer.stop("kdtree_build");
+	logger_.logInfo("Kd-Tree MultiThread: Build time: ", timer.getTime("kdtree_build"), "s");
+	if(tree_build_parameters.precompute_triangles_) logger_.logInfo("Kd-Tree MultiThread: Precomputed triangles: ", triangle_soup_.numTriangles(), " (", triangle_soup_.memoryUsed() / 1024, "KB)");
+	if(logger_.isVerbose() && !nodes_.isMapped())
 	{
 		logger_.logVerbose("Kd-Tree MultiThread: CPU total clocks (in seconds): ", static_cast<float>(clock_elapsed) / static_cast<float>(CLOCKS_PER_SEC), "s (actual CPU work, including the work done by all threads added together)");
-		logger_.logVerbose("Kd-Tree MultiThread: used/allocated nodes: ", nodes_.size(), "/", nodes_.capacity()
-				 , " (", 100.f * static_cast<float>(nodes_.size()) / nodes_.capacity(), "%)");
+		logger_.logVerbose("Kd-Tree MultiThread: used/allocated nodes: ", nodes_.size(), "/", allocated_nodes
+				 , " (", 100.f * static_cast<float>(nodes_.size()) / allocated_nodes, "%)");
+		logger_.logVerbose("Kd-Tree MultiThread: memory used by nodes and leaf primitives: ", (nodes_.size() * sizeof(Node) + primitives_.size() * sizeof(const Primitive *) + triangle_soup_.memoryUsed()) / 1024, "KB");
+		build_stats.outputLog(logger, num_primitives, tree_build_parameters.max_leaf_size_);
 	}
-	kd_tree_result.stats_.outputLog(logger, num_primitives, tree_build_parameters.max_leaf_size_);
+}
+
+/*! Checks that all the node references of a tree loaded from a cache file are within bounds */
+bool AcceleratorKdTreeMultiThread::validTree(const CachedArray<Node> &nodes, const CachedArray<uint32_t> &leaf_prim_indices, uint32_t num_primitives)
+{
+	if(nodes.empty()) return false;
+	for(const auto &node : nodes)
+	{
+		if(node.isLeaf() && node.getPrimitivesOffset() + node.nPrimitives() > leaf_prim_indices.size()) return false;
+		if(!node.isLeaf() && node.getRightChild() >= nodes.size()) return false;
+	}
+	for(const auto &prim_id : leaf_prim_indices) if(prim_id >= num_primitives) return false;
+	return true;
 }
 
 void AcceleratorKdTreeMultiThread::Stats::outputLog(Logger &logger, uint32_t num_primitives, int max_leaf_size) const
@@ -394,16 +467,11 @@ AcceleratorKdTreeMultiThread::SplitCost AcceleratorKdTreeMultiThread::minimalCos
 
 // ============================================================
 /*!
-	recursively build the Kd-tree
+	recursively build the Kd-tree. The nodes and leaf primitives of the subtree
+	are appended to the result lists, where "next_node_id" is the index the first
+	node in the result lists will have in the final tree
 */
-AcceleratorKdTreeMultiThread::Result AcceleratorKdTreeMultiThread::buildTree(const std::vector<const Primitive *> &primitives, const Bound &node_bound, const std::vector<uint32_t> &indices, int depth, uint32_t next_node_id, int bad_refines, const std::vector<Bound> &bounds, const Parameters &parameters, const ClipPlane &clip_plane, const std::vector<PolyDouble> &polygons, const std::vector<uint32_t> &primitive_indices, std::atomic<int> &num_current_threads) const
-{
-	Result kd_tree_result;
-	buildTreeWorker(primitives, node_bound, indices, depth, next_node_id, bad_refines, bounds, parameters, clip_plane, polygons, primitive_indices, kd_tree_result, num_current_threads);
-	return kd_tree_result;
-}
-
-void AcceleratorKdTreeMultiThread::buildTreeWorker(const std::vector<const Primitive *> &primitives, const Bound &node_bound, const std::vector<uint32_t> &indices, int depth, uint32_t next_node_id, int bad_refines, const std::vector<Bound> &bounds, const Parameters &parameters, const ClipPlane &clip_plane, const std::vector<PolyDouble> &polygons, const std::vector<uint32_t> &primitive_indices, Result &result, std::atomic<int> &num_current_threads) const
+void AcceleratorKdTreeMultiThread::buildTreeWorker(const std::vector<const Primitive *> &primitives, const Bound &node_bound, const std::vector<uint32_t> &indices, int depth, uint32_t next_node_id, int bad_refines, const std::vector<Bound> &bounds, const Parameters &parameters, const ClipPlane &clip_plane, const std::vector<PolyDouble> &polygons, const std::vector<uint32_t> &primitive_indices, Result &result, TaskPool &task_pool) const
 {
 	//Note: "indices" are:
 	// * primitive indices when not clipping primitives as polygons. In that case all primitive bounds are present using the same indexing as the complete primitive list
@@ -414,7 +482,6 @@ void AcceleratorKdTreeMultiThread::buildTreeWorker(const std::vector<const Primi
 	auto new_primitive_indices = std::ref(primitive_indices);
 	auto new_bounds = std::ref(bounds);
 	std::vector<PolyDouble> new_polygons;
-	result = {};
 
 #if POLY_CLIPPING_MULTITHREAD > 0
 	static constexpr int poly_clipping_threshold = 32;
@@ -478,7 +545,7 @@ void AcceleratorKdTreeMultiThread::buildTreeWorker(const std::vector<const Primi
 	if(num_new_indices <= static_cast<uint32_t>(parameters.max_leaf_size_) || depth >= parameters.max_depth_)
 	{
 		Node node;
-		const Stats leaf_stats = node.createLeaf(new_primitive_indices, primitives);
+		const Stats leaf_stats = node.createLeaf(new_primitive_indices, primitives, result.primitives_);
 		result.stats_ += leaf_stats;
 		result.nodes_.emplace_back(node);
 		if(depth >= parameters.max_depth_) result.stats_.depth_limit_reached_++;
@@ -497,7 +564,7 @@ void AcceleratorKdTreeMultiThread::buildTreeWorker(const std::vector<const Primi
 	   split.axis_ == Axis::None || bad_refines == 2)
 	{
 		Node node;
-		const Stats leaf_stats = node.createLeaf(new_primitive_indices, primitives);
+		const Stats leaf_stats = node.createLeaf(new_primitive_indices, primitives, result.primitives_);
 		result.stats_ += leaf_stats;
 		result.nodes_.emplace_back(node);
 		if(bad_refines == 2) ++result.stats_.num_bad_splits_;
@@ -508,8 +575,13 @@ void AcceleratorKdTreeMultiThread::buildTreeWorker(const std::vector<const Primi
 	float split_pos;
 	std::vector<uint32_t> left_indices;
 	std::vector<uint32_t> right_indices;
-	std::vector<uint32_t> left_primitive_indices;
-	std::vector<uint32_t> right_primitive_indices;
+	//Unless clipping, the primitive indices are the same as the indices, so they are just views of the indices lists
+	auto left_primitive_indices = std::cref(left_indices);
+	auto right_primitive_indices = std::cref(right_indices);
+#if POLY_CLIPPING_MULTITHREAD > 0
+	std::vector<uint32_t> left_poly_primitive_indices;
+	std::vector<uint32_t> right_poly_primitive_indices;
+#endif //POLY_CLIPPING_MULTITHREAD > 0
 	if(num_new_indices > pigeon_sort_threshold) // we did pigeonhole
 	{
 		for(uint32_t prim_num = 0; prim_num < num_new_indices; prim_num++)
@@ -529,8 +601,6 @@ void AcceleratorKdTreeMultiThread::buildTreeWorker(const std::vector<const Primi
 			}
 		}
 		split_pos = split.t_;
-		left_primitive_indices = left_indices;
-		right_primitive_indices = right_indices;
 	}
 #if POLY_CLIPPING_MULTITHREAD > 0
 	else if(do_poly_clipping)
@@ -540,13 +610,13 @@ void AcceleratorKdTreeMultiThread::buildTreeWorker(const std::vector<const Primi
 			if(split.edges_[edge_id].end_ != BoundEdge::EndBound::Right)
 			{
 				left_indices.emplace_back(split.edges_[edge_id].index_);
-				left_primitive_indices.emplace_back(new_primitive_indices.get()[left_indices.back()]);
+				left_poly_primitive_indices.emplace_back(new_primitive_indices.get()[left_indices.back()]);
 			}
 		}
 		if(split.edges_[split.edge_offset_].end_ == BoundEdge::EndBound::Both)
 		{
 			right_indices.emplace_back(split.edges_[split.edge_offset_].index_);
-			right_primitive_indices.emplace_back(new_primitive_indices.get()[right_indices.back()]);
+			right_poly_primitive_indices.emplace_back(new_primitive_indices.get()[right_indices.back()]);
 		}
 		const int num_edges = static_cast<int>(split.edges_.size());
 		for(int edge_id = split.edge_offset_ + 1; edge_id < num_edges; ++edge_id)
@@ -554,10 +624,12 @@ void AcceleratorKdTreeMultiThread::buildTreeWorker(const std::vector<const Primi
 			if(split.edges_[edge_id].end_ != BoundEdge::EndBound::Left)
 			{
 				right_indices.emplace_back(split.edges_[edge_id].index_);
-				right_primitive_indices.emplace_back(new_primitive_indices.get()[right_indices.back()]);
+				right_poly_primitive_indices.emplace_back(new_primitive_indices.get()[right_indices.back()]);
 			}
 		}
 		split_pos = split.edges_[split.edge_offset_].pos_;
+		left_primitive_indices = std::cref(left_poly_primitive_indices);
+		right_primitive_indices = std::cref(right_poly_primitive_indices);
 	}
 #endif //POLY_CLIPPING_MULTITHREAD > 0
 	else //we did "normal" cost function
@@ -582,14 +654,13 @@ void AcceleratorKdTreeMultiThread::buildTreeWorker(const std::vector<const Primi
 			}
 		}
 		split_pos = split.edges_[split.edge_offset_].pos_;
-		left_primitive_indices = left_indices;
-		right_primitive_indices = right_indices;
 	}
 
 	Node node;
 	const Stats interior_stats = node.createInterior(Axis(split.axis_), split_pos);
 	result.stats_ += interior_stats;
 	result.nodes_.emplace_back(node);
+	const auto node_id = static_cast<uint32_t>(result.nodes_.size() - 1);
 	Bound bound_left = node_bound;
 	Bound bound_right = node_bound;
 	switch(split.axis_)
@@ -609,47 +680,54 @@ void AcceleratorKdTreeMultiThread::buildTreeWorker(const std::vector<const Primi
 	}
 #endif //POLY_CLIPPING_MULTITHREAD > 0
 
-	if(num_current_threads_ < parameters.num_threads_ && (left_primitive_indices.size() >= (right_primitive_indices.size() / 10)) && (right_primitive_indices.size() >= (left_primitive_indices.size() / 10)) && (left_primitive_indices.size() >= static_cast<size_t>(parameters.min_indices_to_spawn_threads_)))
+	if(task_pool.numThreads() > 1 && left_primitive_indices.get().size() >= static_cast<size_t>(parameters.min_indices_to_spawn_threads_))
 	{
+		//The left subtree is built as a task, which can be stolen by any idle thread of the pool, while this thread builds the right subtree.
+		//The subtree inputs are views of the lists owned by this call, which is safe because it does not return before the task is finished
 		const auto next_free_node_original = static_cast<uint32_t>(next_node_id + result.nodes_.size());
 		Result result_left;
-		auto left_worker = std::thread(&AcceleratorKdTreeMultiThread::buildTreeWorker, this, primitives, bound_left, left_indices, depth + 1, next_free_node_original, bad_refines, new_bounds, parameters, left_clip_plane, new_polygons, left_primitive_indices, std::ref(result_left), std::ref(num_current_threads));
-		num_current_threads++;
 		Result result_right;
-		auto right_worker = std::thread(&AcceleratorKdTreeMultiThread::buildTreeWorker, this, primitives, bound_right, right_indices, depth + 1, 0, bad_refines, new_bounds, parameters, right_clip_plane, new_polygons, right_primitive_indices, std::ref(result_right), std::ref(num_current_threads)); //We don't need to specify next_free_node (set to 0) because all internor node right childs will be modified later adding the left nodes list size once it's known
-		num_current_threads++;
-		left_worker.join();
-		num_current_threads--;
-		right_worker.join();
-		num_current_threads--;
+		TaskPool::TaskGroup task_group(task_pool);
+		task_group.run([&]
+		{
+			buildTreeWorker(primitives, bound_left, left_indices, depth + 1, next_free_node_original, bad_refines, new_bounds, parameters, left_clip_plane, new_polygons, left_primitive_indices, result_left, task_pool);
+		});
+		buildTreeWorker(primitives, bound_right, right_indices, depth + 1, 0, bad_refines, new_bounds, parameters, right_clip_plane, new_polygons, right_primitive_indices, result_right, task_pool); //We don't need to specify next_free_node (set to 0) because all internor node right childs will be modified later adding the left nodes list size once it's known
+		task_group.wait();
 
 		result.stats_ += result_left.stats_;
 		result.stats_ += result_right.stats_;
 
 		const auto num_nodes_left = static_cast<uint32_t>(result_left.nodes_.size());
 		const uint32_t next_free_node_left = next_free_node_original + num_nodes_left;
-		result.nodes_.back().setRightChild(next_free_node_left);
-		//Correct the "right child" in the right nodes adding the original nodes + left nodes list sizes as offset to each
+		result.nodes_[node_id].setRightChild(next_free_node_left);
+		//Merge the subtrees into the result lists: the leaves primitives offsets are relative to each subtree primitives list and the right nodes "right child" are relative to the right subtree first node
+		const auto primitives_offset_left = static_cast<uint32_t>(result.primitives_.size());
+		const auto primitives_offset_right = static_cast<uint32_t>(primitives_offset_left + result_left.primitives_.size());
+		for(auto &left_node : result_left.nodes_)
+		{
+			if(left_node.isLeaf()) left_node.setPrimitivesOffset(left_node.getPrimitivesOffset() + primitives_offset_left);
+		}
 		for(auto &right_node : result_right.nodes_)
 		{
-			if(!right_node.isLeaf()) right_node.setRightChild(right_node.getRightChild() + next_free_node_left);
+			if(right_node.isLeaf()) right_node.setPrimitivesOffset(right_node.getPrimitivesOffset() + primitives_offset_right);
+			else right_node.setRightChild(right_node.getRightChild() + next_free_node_left);
 		}
-		result.nodes_.reserve(next_free_node_original + num_nodes_left + result_right.nodes_.size());
+		result.nodes_.reserve(result.nodes_.size() + num_nodes_left + result_right.nodes_.size());
 		result.nodes_.insert(result.nodes_.end(), result_left.nodes_.begin(), result_left.nodes_.end());
 		result.nodes_.insert(result.nodes_.end(), result_right.nodes_.begin(), result_right.nodes_.end());
+		result.primitives_.reserve(primitives_offset_right + result_right.primitives_.size());
+		result.primitives_.insert(result.primitives_.end(), result_left.primitives_.begin(), result_left.primitives_.end());
+		result.primitives_.insert(result.primitives_.end(), result_right.primitives_.begin(), result_right.primitives_.end());
 	}
 	else
 	{
 		//<< recurse left child >>
-		const Result result_left = buildTree(primitives, bound_left, left_indices, depth + 1, next_node_id + result.nodes_.size(), bad_refines, new_bounds, parameters, left_clip_plane, new_polygons, left_primitive_indices, num_current_threads);
-		result.stats_ += result_left.stats_;
-		result.nodes_.back().setRightChild(next_node_id + result.nodes_.size() + result_left.nodes_.size());
-		result.nodes_.insert(result.nodes_.end(), result_left.nodes_.begin(), result_left.nodes_.end());
+		buildTreeWorker(primitives, bound_left, left_indices, depth + 1, next_node_id, bad_refines, new_bounds, parameters, left_clip_plane, new_polygons, left_primitive_indices, result, task_pool);
+		result.nodes_[node_id].setRightChild(next_node_id + result.nodes_.size());
 
 		//<< recurse right child >>
-		const Result result_right = buildTree(primitives, bound_right, right_indices, depth + 1, next_node_id + result.nodes_.size(), bad_refines, new_bounds, parameters, right_clip_plane, new_polygons, right_primitive_indices, num_current_threads);
-		result.stats_ += result_right.stats_;
-		result.nodes_.insert(result.nodes_.end(), result_right.nodes_.begin(), result_right.nodes_.end());
+		buildTreeWorker(primitives, bound_right, right_indices, depth + 1, next_node_id, bad_refines, new_bounds, parameters, right_clip_plane, new_polygons, right_primitive_indices, result, task_pool);
 	}
 }
 
@@ -659,10 +737,10 @@ void AcceleratorKdTreeMultiThread::buildTreeWorker(const std::vector<const Primi
 */
 AcceleratorIntersectData AcceleratorKdTreeMultiThread::intersect(const Ray &ray, float t_max) const
 {
-	return intersect(ray, t_max, nodes_, tree_bound_);
+	return intersect(ray, t_max, nodes_, primitives_, triangle_soup_, tree_bound_);
 }
 
-AcceleratorIntersectData AcceleratorKdTreeMultiThread::intersect(const Ray &ray, float t_max, const std::vector<Node> &nodes, const Bound &tree_bound)
+AcceleratorIntersectData AcceleratorKdTreeMultiThread::intersect(const Ray &ray, float t_max, const CachedArray<Node> &nodes, const std::vector<const Primitive *> &primitives, const TriangleSoup &triangle_soup, const Bound &tree_bound)
 {
 	AcceleratorIntersectData accelerator_intersect_data;
 	accelerator_intersect_data.t_max_ = t_max;
@@ -698,6 +776,7 @@ AcceleratorIntersectData AcceleratorKdTreeMultiThread::intersect(const Ray &ray,
 		// loop until leaf is found
 		while(!curr_node->isLeaf())
 		{
+			countNodeTests(1);
 			const int axis = curr_node->splitAxis();
 			const float split_val = curr_node->splitPos();
 
@@ -750,9 +829,9 @@ AcceleratorIntersectData AcceleratorKdTreeMultiThread::intersect(const Ray &ray,
 		}
 
 		// Check for intersections inside leaf node
-		const auto &primitive_intersection = [](AcceleratorIntersectData &accelerator_intersect_data, const Primitive *primitive, const Ray &ray) -> void
+		const auto &primitive_intersection = [](AcceleratorIntersectData &accelerator_intersect_data, const TriangleSoup &triangle_soup, uint32_t prim_num, const Primitive *primitive, const Ray &ray) -> void
 		{
-			const IntersectData intersect_data = primitive->intersect(ray);
+			const IntersectData intersect_data = triangle_soup.intersect(prim_num, primitive, ray);
 			if(intersect_data.hit_)
 			{
 				if(intersect_data.t_hit_ < accelerator_intersect_data.t_max_ && intersect_data.t_hit_ >= ray.tmin_)
@@ -771,9 +850,10 @@ AcceleratorIntersectData AcceleratorKdTreeMultiThread::intersect(const Ray &ray,
 				}
 			}
 		};
-		for(const auto &prim : curr_node->primitives_)
+		const uint32_t prims_end = curr_node->getPrimitivesOffset() + curr_node->nPrimitives();
+		for(uint32_t prim_num = curr_node->getPrimitivesOffset(); prim_num < prims_end; ++prim_num)
 		{
-			primitive_intersection(accelerator_intersect_data, prim, ray);
+			primitive_intersection(accelerator_intersect_data, triangle_soup, prim_num, primitives[prim_num], ray);
 		}
 		if(accelerator_intersect_data.hit_ && accelerator_intersect_data.t_max_ <= stack[exit_id].t_)
 		{
@@ -789,10 +869,10 @@ AcceleratorIntersectData AcceleratorKdTreeMultiThread::intersect(const Ray &ray,
 
 AcceleratorIntersectData AcceleratorKdTreeMultiThread::intersectS(const Ray &ray, float t_max, float shadow_bias) const
 {
-	return intersectS(ray, t_max, shadow_bias, nodes_, tree_bound_);
+	return intersectS(ray, t_max, shadow_bias, nodes_, primitives_, triangle_soup_, tree_bound_);
 }
 
-AcceleratorIntersectData AcceleratorKdTreeMultiThread::intersectS(const Ray &ray, float t_max, float, const std::vector<Node> &nodes, const Bound &tree_bound)
+AcceleratorIntersectData AcceleratorKdTreeMultiThread::intersectS(const Ray &ray, float t_max, float, const CachedArray<Node> &nodes, const std::vector<const Primitive *> &primitives, const TriangleSoup &triangle_soup, const Bound &tree_bound)
 {
 	AcceleratorIntersectData accelerator_intersect_data;
 	const Bound::Cross cross = tree_bound.cross(ray, t_max);
@@ -823,6 +903,7 @@ AcceleratorIntersectData AcceleratorKdTreeMultiThread::intersectS(const Ray &ray
 		// loop until leaf is found
 		while(!curr_node->isLeaf())
 		{
+			countNodeTests(1);
 			const int axis = curr_node->splitAxis();
 			const float split_val = curr_node->splitPos();
 			if(stack[entry_id].point_[axis] <= split_val)
@@ -874,9 +955,9 @@ AcceleratorIntersectData AcceleratorKdTreeMultiThread::intersectS(const Ray &ray
 		}
 
 		// Check for intersections inside leaf node
-		const auto &primitive_intersection = [](AcceleratorIntersectData &accelerator_intersect_data, const Primitive *primitive, const Ray &ray, float t_max) -> bool
+		const auto &primitive_intersection = [](AcceleratorIntersectData &accelerator_intersect_data, const TriangleSoup &triangle_soup, uint32_t prim_num, const Primitive *primitive, const Ray &ray, float t_max) -> bool
 		{
-			const IntersectData intersect_data = primitive->intersect(ray);
+			const IntersectData intersect_data = triangle_soup.intersect(prim_num, primitive, ray);
 			if(intersect_data.hit_)
 			{
 				if(intersect_data.t_hit_ < t_max && intersect_data.t_hit_ >= 0.f)  // '>=' ?
@@ -896,10 +977,11 @@ AcceleratorIntersectData AcceleratorKdTreeMultiThread::intersectS(const Ray &ray
 			}
 			return false;
 		};
-		for(const auto &prim : curr_node->primitives_)
-			{
-				if(primitive_intersection(accelerator_intersect_data, prim, ray, t_max)) return accelerator_intersect_data;
-			}
+		const uint32_t prims_end = curr_node->getPrimitivesOffset() + curr_node->nPrimitives();
+		for(uint32_t prim_num = curr_node->getPrimitivesOffset(); prim_num < prims_end; ++prim_num)
+		{
+			if(primitive_intersection(accelerator_intersect_data, triangle_soup, prim_num, primitives[prim_num], ray, t_max)) return accelerator_intersect_data;
+		}
 		entry_id = exit_id;
 		curr_node = stack[exit_id].node_;
 		exit_id = stack[entry_id].prev_stack_id_;
@@ -914,10 +996,10 @@ AcceleratorIntersectData AcceleratorKdTreeMultiThread::intersectS(const Ray &ray
 
 AcceleratorTsIntersectData AcceleratorKdTreeMultiThread::intersectTs(const Ray &ray, int max_depth, float t_max, float shadow_bias, const Camera *camera) const
 {
-	return intersectTs(ray, max_depth, t_max, shadow_bias, nodes_, tree_bound_, camera);
+	return intersectTs(ray, max_depth, t_max, shadow_bias, nodes_, primitives_, triangle_soup_, tree_bound_, camera);
 }
 
-AcceleratorTsIntersectData AcceleratorKdTreeMultiThread::intersectTs(const Ray &ray, int max_depth, float t_max, float, const std::vector<Node> &nodes, const Bound &tree_bound, const Camera *camera)
+AcceleratorTsIntersectData AcceleratorKdTreeMultiThread::intersectTs(const Ray &ray, int max_depth, float t_max, float, const CachedArray<Node> &nodes, const std::vector<const Primitive *> &primitives, const TriangleSoup &triangle_soup, const Bound &tree_bound, const Camera *camera)
 {
 	AcceleratorTsIntersectData accelerator_intersect_data;
 	const Bound::Cross cross = tree_bound.cross(ray, t_max);
@@ -936,7 +1018,6 @@ AcceleratorTsIntersectData AcceleratorKdTreeMultiThread::intersectTs(const Ray &
 	else inv_dir_z = 1.f / ray.dir_.z();
 
 	Vec3 inv_dir(inv_dir_x, inv_dir_y, inv_dir_z);
-	int depth = 0;
 
 	std::set<const Primitive *> filtered;
 	std::array<Stack, kd_max_stack_> stack;
@@ -965,6 +1046,7 @@ AcceleratorTsIntersectData AcceleratorKdTreeMultiThread::intersectTs(const Ray &
 		// loop until leaf is found
 		while(!curr_node->isLeaf())
 		{
+			countNodeTests(1);
 			const int axis = curr_node->splitAxis();
 			const float split_val = curr_node->splitPos();
 			if(stack[entry_id].point_[axis] <= split_val)
@@ -1015,9 +1097,9 @@ AcceleratorTsIntersectData AcceleratorKdTreeMultiThread::intersectTs(const Ray &
 		}
 
 		// Check for intersections inside leaf node
-		const auto &primitive_intersection = [](AcceleratorTsIntersectData &accelerator_intersect_data, std::set<const Primitive *> &filtered, int &depth, int max_depth, const Primitive *primitive, const Ray &ray, float t_max, const Camera *camera) -> bool
+		const auto &primitive_intersection = [](AcceleratorTsIntersectData &accelerator_intersect_data, std::set<const Primitive *> &filtered, int max_depth, const TriangleSoup &triangle_soup, uint32_t prim_num, const Primitive *primitive, const Ray &ray, float t_max, const Camera *camera) -> bool
 		{
-			const IntersectData intersect_data = primitive->intersect(ray);
+			const IntersectData intersect_data = triangle_soup.intersect(prim_num, primitive, ray);
 			if(intersect_data.hit_)
 			{
 				if(intersect_data.t_hit_ < t_max && intersect_data.t_hit_ >= ray.tmin_)  // '>=' ?
@@ -1030,11 +1112,10 @@ AcceleratorTsIntersectData AcceleratorKdTreeMultiThread::intersectTs(const Ray &
 						if(!mat->isTransparent()) return true;
 						if(filtered.insert(primitive).second)
 						{
-							if(depth >= max_depth) return true;
+							if(accelerator_intersect_data.transparent_depth_ >= max_depth) return true;
 							const Point3 hit_point{ray.from_ + accelerator_intersect_data.t_hit_ * ray.dir_};
-							const auto sp = primitive->getSurface(ray.differentials_.get(), hit_point, accelerator_intersect_data, nullptr, camera);
-							if(sp) accelerator_intersect_data.transparent_color_ *= sp->getTransparency(ray.dir_, camera);
-							++depth;
+							accelerator_intersect_data.transparent_color_ *= primitive->getShadowTransparency(hit_point, accelerator_intersect_data, ray.dir_, nullptr, camera);
+							++accelerator_intersect_data.transparent_depth_;
 						}
 					}
 				}
@@ -1043,9 +1124,10 @@ AcceleratorTsIntersectData AcceleratorKdTreeMultiThread::intersectTs(const Ray &
 		};
 
 
-		for(const auto &prim : curr_node->primitives_)
+		const uint32_t prims_end = curr_node->getPrimitivesOffset() + curr_node->nPrimitives();
+		for(uint32_t prim_num = curr_node->getPrimitivesOffset(); prim_num < prims_end; ++prim_num)
 		{
-				if(primitive_intersection(accelerator_intersect_data, filtered, depth, max_depth, prim, ray, t_max, camera)) return accelerator_intersect_data;
+			if(primitive_intersection(accelerator_intersect_data, filtered, max_depth, triangle_soup, prim_num, primitives[prim_num], ray, t_max, camera)) return accelerator_intersect_data;
 		}
 		entry_id = exit_id;
 		curr_node = stack[exit_id].node_;
@@ -1055,4 +1137,9 @@ AcceleratorTsIntersectData AcceleratorKdTreeMultiThread::intersectTs(const Ray &
 	return accelerator_intersect_data;
 }
 
+size_t AcceleratorKdTreeMultiThread::memoryUsed() const
+{
+	return nodes_.size() * sizeof(Node) + primitives_.size() * sizeof(const Primitive *) + triangle_soup_.memoryUsed();
+}
+
 END_YAFARAY
@@ -24,7 +24,7 @@
 
 BEGIN_YAFARAY
 
-const Accelerator * AcceleratorSimpleTest::factory(Logger &logger, const std::vector<const Primitive *> &primitives, const ParamMap &params)
+Accelerator * AcceleratorSimpleTest::factory(Logger &logger, const std::vector<const Primitive *> &primitives, const ParamMap &params)
 {
 	return new AcceleratorSimpleTest(logger, primitives);
 }
@@ -58,16 +58,25 @@ AcceleratorSimpleTest::AcceleratorSimpleTest(Logger &logger, const std::vector<c
 	if(logger_.isVerbose()) logger_.logVerbose("AcceleratorSimpleTest: Objects: ", objects_data_.size(), ", primitives in tree: ", num_primitives, ", bound: (", bound_.a_, ", ", bound_.g_, ")");
 }
 
+size_t AcceleratorSimpleTest::memoryUsed() const
+{
+	size_t memory_used = 0;
+	for(const auto &object_data : objects_data_) memory_used += sizeof(ObjectData) + object_data.second.primitives_.size() * sizeof(const Primitive *);
+	return memory_used;
+}
+
 AcceleratorIntersectData AcceleratorSimpleTest::intersect(const Ray &ray, float t_max) const
 {
 	AcceleratorIntersectData accelerator_intersect_data;
 	accelerator_intersect_data.t_max_ = t_max;
 	for(const auto &object_data : objects_data_)
 	{
+		countNodeTests(1);
 		const Bound::Cross cross = object_data.second.bound_.cross(ray, accelerator_intersect_data.t_max_);
 		if(!cross.crossed_) continue;
 		for(const auto &primitive : object_data.second.primitives_)
 		{
+			countPrimitiveTest();
 			const IntersectData intersect_data = primitive->intersect(ray);
 			if(intersect_data.hit_ && intersect_data.t_hit_ >= ray.tmin_ && intersect_data.t_hit_ < accelerator_intersect_data.t_max_)
 			{
@@ -92,10 +101,12 @@ AcceleratorIntersectData AcceleratorSimpleTest::intersectS(const Ray &ray, float
 {
 	for(const auto &object_data : objects_data_)
 	{
+		countNodeTests(1);
 		const Bound::Cross cross = object_data.second.bound_.cross(ray, t_max);
 		if(!cross.crossed_) continue;
 		for(const auto &primitive : object_data.second.primitives_)
 		{
+			countPrimitiveTest();
 			const IntersectData intersect_data = primitive->intersect(ray);
 			if(intersect_data.hit_ && intersect_data.t_hit_ >= (ray.tmin_ + shadow_bias) && intersect_data.t_hit_ < t_max)
 			{
@@ -120,10 +131,12 @@ AcceleratorTsIntersectData AcceleratorSimpleTest::intersectTs(const Ray &ray, in
 {
 	for(const auto &object_data : objects_data_)
 	{
+		countNodeTests(1);
 		const Bound::Cross cross = object_data.second.bound_.cross(ray, t_max);
 		if(!cross.crossed_) continue;
 		for(const auto &primitive : object_data.second.primitives_)
 		{
+			countPrimitiveTest();
 			const IntersectData intersect_data = primitive->intersect(ray);
 			if(intersect_data.hit_ && intersect_data.t_hit_ >= ray.tmin_ && intersect_data.t_hit_ < t_max)
 			{
@@ -0,0 +1,308 @@
+/****************************************************************************
+ *      This is part of the libYafaRay package
+ *
+ *      This library is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU Lesser General Public
+ *      License as published by the Free Software Foundation; either
+ *      version 2.1 of the License, or (at your option) any later version.
+ *
+ *      This library is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *      Lesser General Public License for more details.
+ *
+ *      You should have received a copy of the GNU Lesser General Public
+ *      License along with this library; if not, write to the Free Software
+ *      Foundation,Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include "accelerator/accelerator_two_level.h"
+#include "accelerator/accelerator_bvh.h"
+#include "geometry/object/object.h"
+#include "common/logger.h"
+#include "common/param.h"
+#include "common/timer.h"
+#include <map>
+
+BEGIN_YAFARAY
+
+Accelerator * AcceleratorTwoLevel::factory(Logger &logger, const std::vector<const Primitive *> &primitives, const std::vector<const Object *> &instances, const ParamMap &params)
+{
+	return new AcceleratorTwoLevel(logger, primitives, instances, params);
+}
+
+AcceleratorTwoLevel::AcceleratorTwoLevel(Logger &logger, const std::vector<const Primitive *> &primitives, const std::vector<const Object *> &instances, const ParamMap &params) : Accelerator(logger)
+{
+	logger_.logInfo("Two-Level Accelerator: Starting build (", primitives.size(), " prims, ", instances.size(), " instances)");
+	Timer timer;
+	timer.addEvent("two_level_build");
+	timer.start("two_level_build");
+	ParamMap accelerator_params = params;
+	if(!primitives.empty()) primitives_accelerator_ = std::unique_ptr<Accelerator>(Accelerator::factory(logger, primitives, params));
+
+	std::map<const Object *, const Accelerator *> base_objects_accelerators;
+	std::vector<Bound> bounds;
+	std::vector<Instance> instances_unordered;
+	size_t num_instanced_primitives = 0;
+	for(const auto &instance : instances)
+	{
+		const Object *base_object = instance->getInstanceBaseObject();
+		const Matrix4 *obj_to_world = instance->getObjToWorldMatrix();
+		if(!base_object || !obj_to_world || base_object->numPrimitives() == 0) continue;
+		const int num_time_steps = instance->numTimeSteps();
+		bool invertible = true;
+		for(int time_step = 0; time_step < num_time_steps; ++time_step)
+		{
+			Matrix4 world_to_obj {obj_to_world[time_step]};
+			if(world_to_obj.inverse().invalid()) invertible = false;
+		}
+		if(!invertible)
+		{
+			logger_.logWarning("Two-Level Accelerator: instance of '", base_object->getName(), "' has a non-invertible transformation matrix, ignoring it");
+			continue;
+		}
+		Matrix4 world_to_obj {*obj_to_world};
+		world_to_obj.inverse();
+		const Accelerator *&base_object_accelerator = base_objects_accelerators[base_object];
+		if(!base_object_accelerator)
+		{
+			const std::vector<const Primitive *> base_primitives = base_object->getPrimitives();
+			accelerator_params["num_primitives"] = static_cast<int>(base_primitives.size());
+			base_objects_accelerators_.emplace_back(Accelerator::factory(logger, base_primitives, accelerator_params));
+			base_object_accelerator = base_objects_accelerators_.back().get();
+		}
+		instances_unordered.push_back({base_object_accelerator, obj_to_world, num_time_steps, world_to_obj});
+		bounds.emplace_back(instances_unordered.back().worldBound());
+		num_instanced_primitives += base_object->numPrimitives();
+	}
+
+	BvhBuilder::Parameters parameters;
+	params.getParam("accelerator_threads", parameters.num_threads_);
+	BvhBuilder::Result bvh_result = BvhBuilder(bounds, parameters).build();
+	nodes_ = std::move(bvh_result.nodes_);
+	instances_.reserve(instances_unordered.size());
+	for(const auto &instance_id : bvh_result.prim_indices_) instances_.emplace_back(instances_unordered[instance_id]);
+	buildMotionBounds();
+
+	updateTreeBound();
+
+	timer.stop("two_level_build");
+	logger_.logInfo("Two-Level Accelerator: Build time: ", timer.getTime("two_level_build"), "s");
+	logger_.logInfo("Two-Level Accelerator: ", instances_.size(), " instances of ", base_objects_accelerators_.size(), " base objects (", num_instanced_primitives, " instanced prims)");
+	if(logger_.isVerbose())
+	{
+		bvh_result.stats_.outputLog(logger, static_cast<uint32_t>(instances_.size()), nodes_.size(), nodes_.size() * sizeof(BvhBuilder::Node) + instances_.size() * sizeof(Instance) + motion_bounds_.memoryUsed());
+	}
+}
+
+AcceleratorTwoLevel::~AcceleratorTwoLevel()
+{
+	if(logger_.isVerbose()) logger_.logVerbose("Two-Level Accelerator: Done");
+}
+
+/*! Bound of the instance during the whole frame time */
+Bound AcceleratorTwoLevel::Instance::worldBound() const
+{
+	Bound world_bound = worldBound(0);
+	for(int time_step = 1; time_step < num_time_steps_; ++time_step) world_bound = Bound(world_bound, worldBound(time_step));
+	return world_bound;
+}
+
+/*! The world bound of the instance is the bound of its transformed object bound corners */
+Bound AcceleratorTwoLevel::Instance::worldBound(int time_step) const
+{
+	const Bound object_bound = accelerator_->getBound();
+	Bound world_bound;
+	for(int corner = 0; corner < 8; ++corner)
+	{
+		const Point3 object_corner {(corner & 1) ? object_bound.g_.x() : object_bound.a_.x(), (corner & 2) ? object_bound.g_.y() : object_bound.a_.y(), (corner & 4) ? object_bound.g_.z() : object_bound.a_.z()};
+		const Point3 world_corner {obj_to_world_[time_step] * object_corner};
+		if(corner == 0) world_bound = {world_corner, world_corner};
+		else world_bound.include(world_corner);
+	}
+	return world_bound;
+}
+
+void AcceleratorTwoLevel::updateTreeBound()
+{
+	if(primitives_accelerator_) tree_bound_ = primitives_accelerator_->getBound();
+	if(!nodes_.empty()) tree_bound_ = primitives_accelerator_ ? Bound(tree_bound_, nodes_.front().getBound()) : nodes_.front().getBound();
+	else if(!primitives_accelerator_) tree_bound_ = {{0.f, 0.f, 0.f}, {0.f, 0.f, 0.f}};
+}
+
+/*! Calculates the top-level node bounds in the motion blur time steps, if any instance moves. The instances with a different
+	number of time steps are enclosed in all of them by their whole frame time bound, as well as the moving base objects */
+void AcceleratorTwoLevel::buildMotionBounds()
+{
+	int num_time_steps = 1;
+	for(const auto &instance : instances_) num_time_steps = std::max(num_time_steps, instance.num_time_steps_);
+	if(num_time_steps == 1)
+	{
+		motion_bounds_ = {};
+		return;
+	}
+	motion_bounds_ = BvhBuilder::MotionBounds(nodes_.data(), nodes_.size(), num_time_steps, [this, num_time_steps](uint32_t instance_num, int time_step)
+	{
+		const Instance &instance = instances_[instance_num];
+		if(instance.num_time_steps_ == num_time_steps) return instance.worldBound(time_step);
+		else return instance.worldBound();
+	});
+}
+
+size_t AcceleratorTwoLevel::memoryUsed() const
+{
+	size_t memory_used = nodes_.size() * sizeof(BvhBuilder::Node) + motion_bounds_.memoryUsed() + instances_.size() * sizeof(Instance);
+	if(primitives_accelerator_) memory_used += primitives_accelerator_->memoryUsed();
+	for(const auto &base_object_accelerator : base_objects_accelerators_) memory_used += base_object_accelerator->memoryUsed();
+	return memory_used;
+}
+
+/*! Refits the bottom-level accelerators first and then the top-level BVH over the new instances bounds */
+bool AcceleratorTwoLevel::refit(int num_threads)
+{
+	if(primitives_accelerator_ && !primitives_accelerator_->refit(num_threads)) return false;
+	for(auto &base_object_accelerator : base_objects_accelerators_)
+	{
+		if(!base_object_accelerator->refit(num_threads)) return false;
+	}
+	if(!nodes_.empty()) BvhBuilder::refit(nodes_.data(), [this](uint32_t instance_num) { return instances_[instance_num].worldBound(); }, num_threads);
+	buildMotionBounds();
+	updateTreeBound();
+	return true;
+}
+
+/*! Visits the instances whose world bounds are crossed by the ray closer than t_max. The
+	instance function can reduce t_max to cull farther instances, or return true to stop */
+template <typename InstanceFunction>
+static void traverseInstances(const std::vector<BvhBuilder::Node> &nodes, const BvhBuilder::MotionBounds &motion_bounds, const Ray &ray, const float &t_max, const InstanceFunction &instance_function)
+{
+	if(nodes.empty()) return;
+	const Vec3 inv_dir = AcceleratorBvh::invDirection(ray.dir_);
+	const auto intersect_node = [&](uint32_t node_id) -> bool
+	{
+		Accelerator::countNodeTests(1);
+		if(motion_bounds.empty()) return nodes[node_id].intersect(ray.from_, inv_dir, t_max) != std::numeric_limits<float>::infinity();
+		else return motion_bounds.intersect(node_id, ray.from_, inv_dir, t_max, ray.time_) != std::numeric_limits<float>::infinity();
+	};
+	if(!intersect_node(0)) return;
+	std::array<uint32_t, BvhBuilder::max_depth_> stack;
+	int stack_id = 0;
+	uint32_t node_id = 0;
+	while(true)
+	{
+		const BvhBuilder::Node &node = nodes[node_id];
+		if(node.isLeaf())
+		{
+			const uint32_t instances_end = node.getPrimitivesOffset() + node.nPrimitives();
+			for(uint32_t instance_num = node.getPrimitivesOffset(); instance_num < instances_end; ++instance_num)
+			{
+				if(instance_function(instance_num)) return;
+			}
+		}
+		else
+		{
+			const uint32_t left_child = node.getLeftChild();
+			const uint32_t right_child = node.getRightChild();
+			const bool hit_left = intersect_node(left_child);
+			const bool hit_right = intersect_node(right_child);
+			if(hit_left)
+			{
+				if(hit_right) stack[stack_id++] = right_child;
+				node_id = left_child;
+				continue;
+			}
+			else if(hit_right)
+			{
+				node_id = right_child;
+				continue;
+			}
+		}
+		if(stack_id == 0) return;
+		node_id = stack[--stack_id];
+	}
+}
+
+AcceleratorIntersectData AcceleratorTwoLevel::intersect(const Ray &ray, float t_max) const
+{
+	AcceleratorIntersectData accelerator_intersect_data;
+	if(primitives_accelerator_) accelerator_intersect_data = primitives_accelerator_->intersect(ray, t_max);
+	float t_closest = accelerator_intersect_data.hit_ ? accelerator_intersect_data.t_max_ : t_max;
+	traverseInstances(nodes_, motion_bounds_, ray, t_closest, [&](uint32_t instance_num) -> bool
+	{
+		const Instance &instance = instances_[instance_num];
+		float distance_scale;
+		const Ray object_ray = instance.objectRay(ray, distance_scale);
+		const AcceleratorIntersectData instance_intersect_data = instance.accelerator_->intersect(object_ray, t_closest * distance_scale);
+		if(instance_intersect_data.hit_)
+		{
+			accelerator_intersect_data = instance_intersect_data;
+			t_closest = instance_intersect_data.t_max_ / distance_scale;
+			accelerator_intersect_data.t_hit_ = t_closest;
+			accelerator_intersect_data.t_max_ = t_closest;
+			accelerator_intersect_data.obj_to_world_ = instance.obj_to_world_;
+			accelerator_intersect_data.obj_to_world_time_steps_ = instance.num_time_steps_;
+		}
+		return false;
+	});
+	return accelerator_intersect_data;
+}
+
+AcceleratorIntersectData AcceleratorTwoLevel::intersectS(const Ray &ray, float t_max, float shadow_bias) const
+{
+	if(primitives_accelerator_)
+	{
+		const AcceleratorIntersectData accelerator_intersect_data = primitives_accelerator_->intersectS(ray, t_max, shadow_bias);
+		if(accelerator_intersect_data.hit_) return accelerator_intersect_data;
+	}
+	AcceleratorIntersectData accelerator_intersect_data;
+	traverseInstances(nodes_, motion_bounds_, ray, t_max, [&](uint32_t instance_num) -> bool
+	{
+		const Instance &instance = instances_[instance_num];
+		float distance_scale;
+		const Ray object_ray = instance.objectRay(ray, distance_scale);
+		accelerator_intersect_data = instance.accelerator_->intersectS(object_ray, t_max * distance_scale, shadow_bias);
+		if(!accelerator_intersect_data.hit_) return false;
+		accelerator_intersect_data.t_hit_ /= distance_scale;
+		accelerator_intersect_data.obj_to_world_ = instance.obj_to_world_;
+		accelerator_intersect_data.obj_to_world_time_steps_ = instance.num_time_steps_;
+		return true;
+	});
+	return accelerator_intersect_data;
+}
+
+/*! The transparent primitives found in the primitives accelerator and in each instance share the same max_depth,
+	so each lower level query only gets the depth not used yet. The ray is blocked once no depth is left */
+AcceleratorTsIntersectData AcceleratorTwoLevel::intersectTs(const Ray &ray, int max_depth, float t_max, float shadow_bias, const Camera *camera) const
+{
+	AcceleratorTsIntersectData accelerator_intersect_data;
+	if(primitives_accelerator_)
+	{
+		accelerator_intersect_data = primitives_accelerator_->intersectTs(ray, max_depth, t_max, shadow_bias, camera);
+		if(accelerator_intersect_data.hit_) return accelerator_intersect_data;
+	}
+	traverseInstances(nodes_, motion_bounds_, ray, t_max, [&](uint32_t instance_num) -> bool
+	{
+		const Instance &instance = instances_[instance_num];
+		float distance_scale;
+		const Ray object_ray = instance.objectRay(ray, distance_scale);
+		const AcceleratorTsIntersectData instance_intersect_data = instance.accelerator_->intersectTs(object_ray, max_depth - accelerator_intersect_data.transparent_depth_, t_max * distance_scale, shadow_bias, camera);
+		const Rgb transparent_color = accelerator_intersect_data.transparent_color_ * instance_intersect_data.transparent_color_;
+		const int transparent_depth = accelerator_intersect_data.transparent_depth_ + instance_intersect_data.transparent_depth_;
+		if(!instance_intersect_data.hit_)
+		{
+			accelerator_intersect_data.transparent_color_ = transparent_color;
+			accelerator_intersect_data.transparent_depth_ = transparent_depth;
+			return false;
+		}
+		accelerator_intersect_data = instance_intersect_data;
+		accelerator_intersect_data.transparent_color_ = transparent_color;
+		accelerator_intersect_data.transparent_depth_ = transparent_depth;
+		accelerator_intersect_data.t_hit_ /= distance_scale;
+		accelerator_intersect_data.obj_to_world_ = instance.obj_to_world_;
+		accelerator_intersect_data.obj_to_world_time_steps_ = instance.num_time_steps_;
+		return true;
+	});
+	return accelerator_intersect_data;
+}
+
+END_YAFARAY
@@ -0,0 +1,278 @@
+/****************************************************************************
+ *      This is part of the libYafaRay package
+ *
+ *      This library is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU Lesser General Public
+ *      License as published by the Free Software Foundation; either
+ *      version 2.1 of the License, or (at your option) any later version.
+ *
+ *      This library is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *      Lesser General Public License for more details.
+ *
+ *      You should have received a copy of the GNU Lesser General Public
+ *      License along with this library; if not, write to the Free Software
+ *      Foundation,Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include "accelerator/bvh_builder.h"
+#include "common/logger.h"
+#include "common/task_pool.h"
+#include <algorithm>
+
+BEGIN_YAFARAY
+
+constexpr int BvhBuilder::max_depth_;
+constexpr int BvhBuilder::max_bins_;
+constexpr int BvhBuilder::refit_tasks_max_depth_;
+
+BvhBuilder::BvhBuilder(const std::vector<Bound> &bounds, const Parameters &parameters) : bounds_(bounds), parameters_(parameters)
+{
+	centroids_.reserve(bounds_.size());
+	for(const auto &bound : bounds_) centroids_.emplace_back(bound.center());
+}
+
+BvhBuilder::Result BvhBuilder::build()
+{
+	Result result;
+	const auto num_primitives = static_cast<uint32_t>(bounds_.size());
+	if(num_primitives == 0) return result;
+	prim_indices_.resize(num_primitives);
+	for(uint32_t prim_num = 0; prim_num < num_primitives; prim_num++) prim_indices_[prim_num] = prim_num;
+	//A binary tree with N leaves has 2N-1 nodes, and there cannot be more leaves than primitives
+	nodes_.resize(2 * static_cast<size_t>(num_primitives) - 1);
+	num_nodes_ = 1;
+	TaskPool task_pool(parameters_.num_threads_);
+	buildTreeWorker(0, 0, num_primitives, 0, task_pool, result.stats_);
+	nodes_.resize(num_nodes_);
+	nodes_.shrink_to_fit();
+	result.nodes_ = std::move(nodes_);
+	result.prim_indices_ = std::move(prim_indices_);
+	return result;
+}
+
+void BvhBuilder::Stats::outputLog(Logger &logger, uint32_t num_primitives, size_t num_nodes, size_t memory_bytes) const
+{
+	if(logger.isVerbose())
+	{
+		logger.logVerbose("BVH: Primitives in tree: ", num_primitives);
+		logger.logVerbose("BVH: Interior nodes: ", bvh_inodes_, " / ", "leaf nodes: ", bvh_leaves_, " (total nodes: ", num_nodes, ")");
+		logger.logVerbose("BVH: => ", static_cast<float>(bvh_prims_) / bvh_leaves_, " prims per leaf, max depth: ", max_depth_);
+		logger.logVerbose("BVH: Leaves due to depth limit/coincident centroids: ", depth_limit_reached_, "/", num_degenerate_leaves_);
+		if(spatial_splits_ > 0) logger.logVerbose("BVH: Spatial splits: ", spatial_splits_, ", duplicated primitive references: ", duplicated_references_);
+		logger.logVerbose("BVH: Memory used by nodes and primitive references: ", memory_bytes / 1024, "KB (", static_cast<float>(memory_bytes) / num_primitives, " bytes per primitive)");
+	}
+}
+
+BvhBuilder::Stats BvhBuilder::Stats::operator += (const Stats &bvh_stats)
+{
+	bvh_inodes_ += bvh_stats.bvh_inodes_;
+	bvh_leaves_ += bvh_stats.bvh_leaves_;
+	bvh_prims_ += bvh_stats.bvh_prims_;
+	max_depth_ = std::max(max_depth_, bvh_stats.max_depth_);
+	depth_limit_reached_ += bvh_stats.depth_limit_reached_;
+	num_degenerate_leaves_ += bvh_stats.num_degenerate_leaves_;
+	spatial_splits_ += bvh_stats.spatial_splits_;
+	duplicated_references_ += bvh_stats.duplicated_references_;
+	return *this;
+}
+
+// ============================================================
+/*!
+	Cost function: Find the optimal split with SAH, binning
+	the primitive centroids along each axis => O(n)
+*/
+
+BvhBuilder::SplitCost BvhBuilder::binnedMinCost(const Bound &node_bound, const Bound &centroid_bound, uint32_t index_begin, uint32_t index_end) const
+{
+	const int num_bins = parameters_.num_bins_;
+	const float inv_node_area = 1.f / halfArea(node_bound);
+	SplitCost split;
+	for(int axis = 0; axis < 3; ++axis)
+	{
+		const float min = centroid_bound.a_[axis];
+		const float extent = centroid_bound.g_[axis] - min;
+		if(extent <= 0.f) continue;
+		const float scale = num_bins * (1.f - 1e-5f) / extent;
+		std::array<Bin, max_bins_> bins;
+		for(uint32_t index_num = index_begin; index_num < index_end; ++index_num)
+		{
+			const uint32_t prim_id = prim_indices_[index_num];
+			int bin_id = static_cast<int>((centroids_[prim_id][axis] - min) * scale);
+			if(bin_id >= num_bins) bin_id = num_bins - 1;
+			else if(bin_id < 0) bin_id = 0;
+			bins[bin_id].bound_ = Bound(bins[bin_id].bound_, bounds_[prim_id]);
+			++bins[bin_id].num_primitives_;
+		}
+		//sweep from the right side first, storing the accumulated areas/counts, then from the left evaluating the cost of each split
+		std::array<float, max_bins_> right_areas;
+		std::array<uint32_t, max_bins_> right_counts;
+		Bin accumulated;
+		for(int bin_id = num_bins - 1; bin_id > 0; --bin_id)
+		{
+			accumulated.bound_ = Bound(accumulated.bound_, bins[bin_id].bound_);
+			accumulated.num_primitives_ += bins[bin_id].num_primitives_;
+			right_counts[bin_id] = accumulated.num_primitives_;
+			right_areas[bin_id] = accumulated.num_primitives_ > 0 ? halfArea(accumulated.bound_) : 0.f;
+		}
+		accumulated = {};
+		for(int bin_id = 1; bin_id < num_bins; ++bin_id)
+		{
+			accumulated.bound_ = Bound(accumulated.bound_, bins[bin_id - 1].bound_);
+			accumulated.num_primitives_ += bins[bin_id - 1].num_primitives_;
+			if(accumulated.num_primitives_ == 0 || right_counts[bin_id] == 0) continue;
+			const float cost = parameters_.cost_ratio_ + inv_node_area * (halfArea(accumulated.bound_) * accumulated.num_primitives_ + right_areas[bin_id] * right_counts[bin_id]);
+			if(cost < split.cost_)
+			{
+				split.cost_ = cost;
+				split.axis_ = axis;
+				split.bin_ = bin_id;
+			}
+		}
+	}
+	return split;
+}
+
+// ============================================================
+/*!
+	recursively build the BVH. Each call owns the range [index_begin, index_end)
+	of the primitive indices list, which is reordered in place, so subtrees can be
+	built in parallel without copying any of the build data.
+*/
+void BvhBuilder::buildTreeWorker(uint32_t node_id, uint32_t index_begin, uint32_t index_end, int depth, TaskPool &task_pool, Stats &stats)
+{
+	const uint32_t num_indices = index_end - index_begin;
+	Bound node_bound = bounds_[prim_indices_[index_begin]];
+	Bound centroid_bound {centroids_[prim_indices_[index_begin]], centroids_[prim_indices_[index_begin]]};
+	for(uint32_t index_num = index_begin + 1; index_num < index_end; ++index_num)
+	{
+		const uint32_t prim_id = prim_indices_[index_num];
+		node_bound = Bound(node_bound, bounds_[prim_id]);
+		centroid_bound.include(centroids_[prim_id]);
+	}
+	if(depth > stats.max_depth_) stats.max_depth_ = depth;
+
+	const auto create_leaf = [&]()
+	{
+		nodes_[node_id].createLeaf(node_bound, index_begin, num_indices);
+		++stats.bvh_leaves_;
+		stats.bvh_prims_ += num_indices;
+	};
+
+	//	<< check if leaf criteria met >>
+	if(num_indices == 1) { create_leaf(); return; }
+	if(depth >= max_depth_)
+	{
+		create_leaf();
+		++stats.depth_limit_reached_;
+		return;
+	}
+
+	//<< calculate cost for all axes and chose minimum >>
+	const SplitCost split = binnedMinCost(node_bound, centroid_bound, index_begin, index_end);
+	if(split.axis_ == Axis::None)
+	{
+		create_leaf();
+		if(num_indices > static_cast<uint32_t>(parameters_.max_leaf_size_)) ++stats.num_degenerate_leaves_;
+		return;
+	}
+	if(split.cost_ >= static_cast<float>(num_indices) && num_indices <= static_cast<uint32_t>(parameters_.max_leaf_size_)) { create_leaf(); return; }
+
+	// Classify primitives with respect to split
+	const float min = centroid_bound.a_[split.axis_];
+	const float scale = parameters_.num_bins_ * (1.f - 1e-5f) / (centroid_bound.g_[split.axis_] - min);
+	const auto middle = std::partition(prim_indices_.begin() + index_begin, prim_indices_.begin() + index_end, [&](uint32_t prim_id)
+	{
+		const int bin_id = static_cast<int>((centroids_[prim_id][split.axis_] - min) * scale);
+		return bin_id < split.bin_;
+	});
+	uint32_t index_middle = static_cast<uint32_t>(middle - prim_indices_.begin());
+	if(index_middle == index_begin || index_middle == index_end)
+	{
+		//Should not happen as the split cost ensures both sides have primitives, but just in case of floating point issues split in two halves
+		index_middle = index_begin + num_indices / 2;
+		std::nth_element(prim_indices_.begin() + index_begin, prim_indices_.begin() + index_middle, prim_indices_.begin() + index_end, [&](uint32_t prim_id_a, uint32_t prim_id_b) { return centroids_[prim_id_a][split.axis_] < centroids_[prim_id_b][split.axis_]; });
+	}
+
+	const uint32_t left_child = num_nodes_.fetch_add(2);
+	nodes_[node_id].createInterior(node_bound, left_child);
+	++stats.bvh_inodes_;
+
+	const uint32_t num_left_indices = index_middle - index_begin;
+	const uint32_t num_right_indices = index_end - index_middle;
+	if(task_pool.numThreads() > 1 && num_left_indices >= static_cast<uint32_t>(parameters_.min_indices_to_spawn_threads_) && num_right_indices >= static_cast<uint32_t>(parameters_.min_indices_to_spawn_threads_))
+	{
+		Stats stats_left;
+		Stats stats_right;
+		TaskPool::TaskGroup task_group(task_pool);
+		task_group.run([&] { buildTreeWorker(left_child, index_begin, index_middle, depth + 1, task_pool, stats_left); });
+		buildTreeWorker(left_child + 1, index_middle, index_end, depth + 1, task_pool, stats_right);
+		task_group.wait();
+		stats += stats_left;
+		stats += stats_right;
+	}
+	else
+	{
+		buildTreeWorker(left_child, index_begin, index_middle, depth + 1, task_pool, stats);
+		buildTreeWorker(left_child + 1, index_middle, index_end, depth + 1, task_pool, stats);
+	}
+}
+
+/*! Recomputes the bounds of all the nodes of a built tree after its primitives moved, keeping
+	the tree topology. The primitive bound function receives the primitive number in leaf order */
+void BvhBuilder::refit(Node *nodes, const std::function<Bound(uint32_t prim_num)> &primitive_bound, int num_threads)
+{
+	TaskPool task_pool(num_threads);
+	refitWorker(nodes, 0, 0, primitive_bound, task_pool);
+}
+
+Bound BvhBuilder::refitWorker(Node *nodes, uint32_t node_id, int depth, const std::function<Bound(uint32_t prim_num)> &primitive_bound, TaskPool &task_pool)
+{
+	Node &node = nodes[node_id];
+	Bound bound;
+	if(node.isLeaf())
+	{
+		const uint32_t primitives_end = node.getPrimitivesOffset() + node.nPrimitives();
+		bound = primitive_bound(node.getPrimitivesOffset());
+		for(uint32_t prim_num = node.getPrimitivesOffset() + 1; prim_num < primitives_end; ++prim_num) bound = Bound(bound, primitive_bound(prim_num));
+	}
+	else if(task_pool.numThreads() > 1 && depth < refit_tasks_max_depth_)
+	{
+		Bound left_bound;
+		TaskPool::TaskGroup task_group(task_pool);
+		task_group.run([&]
+		{
+			left_bound = refitWorker(nodes, node.getLeftChild(), depth + 1, primitive_bound, task_pool);
+		});
+		const Bound right_bound = refitWorker(nodes, node.getRightChild(), depth + 1, primitive_bound, task_pool);
+		task_group.wait();
+		bound = Bound(left_bound, right_bound);
+	}
+	else bound = Bound(refitWorker(nodes, node.getLeftChild(), depth + 1, primitive_bound, task_pool), refitWorker(nodes, node.getRightChild(), depth + 1, primitive_bound, task_pool));
+	node.setBound(bound);
+	return bound;
+}
+
+/*! Children are always stored after their parents, so the nodes can be processed in reverse order
+	to calculate the bounds bottom-up. The primitive bound function receives the primitive number in leaf order */
+BvhBuilder::MotionBounds::MotionBounds(const Node *nodes, size_t num_nodes, int num_time_steps, const std::function<Bound(uint32_t prim_num, int time_step)> &primitive_bound) : num_time_steps_(num_time_steps), bounds_(num_nodes * num_time_steps)
+{
+	for(size_t node_id = num_nodes; node_id-- > 0;)
+	{
+		const Node &node = nodes[node_id];
+		Bound *node_bounds = &bounds_[node_id * num_time_steps_];
+		for(int time_step = 0; time_step < num_time_steps_; ++time_step)
+		{
+			if(node.isLeaf())
+			{
+				const uint32_t prims_end = node.getPrimitivesOffset() + node.nPrimitives();
+				node_bounds[time_step] = primitive_bound(node.getPrimitivesOffset(), time_step);
+				for(uint32_t prim_num = node.getPrimitivesOffset() + 1; prim_num < prims_end; ++prim_num) node_bounds[time_step] = Bound(node_bounds[time_step], primitive_bound(prim_num, time_step));
+			}
+			else node_bounds[time_step] = Bound(bounds_[node.getLeftChild() * num_time_steps_ + time_step], bounds_[node.getRightChild() * num_time_steps_ + time_step]);
+		}
+	}
+}
+
+END_YAFARAY
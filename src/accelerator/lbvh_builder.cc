@@ -0,0 +1,386 @@
+/****************************************************************************
+ *      This is part of the libYafaRay package
+ *
+ *      This library is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU Lesser General Public
+ *      License as published by the Free Software Foundation; either
+ *      version 2.1 of the License, or (at your option) any later version.
+ *
+ *      This library is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *      Lesser General Public License for more details.
+ *
+ *      You should have received a copy of the GNU Lesser General Public
+ *      License along with this library; if not, write to the Free Software
+ *      Foundation,Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include "accelerator/lbvh_builder.h"
+#include "common/task_pool.h"
+
+BEGIN_YAFARAY
+
+constexpr int LbvhBuilder::morton_bits_;
+constexpr int LbvhBuilder::radix_bits_;
+constexpr int LbvhBuilder::treelet_max_leaves_;
+
+LbvhBuilder::LbvhBuilder(const std::vector<Bound> &bounds, const BvhBuilder::Parameters &parameters) : bounds_(bounds), parameters_(parameters)
+{
+}
+
+BvhBuilder::Result LbvhBuilder::build()
+{
+	BvhBuilder::Result result;
+	const auto num_primitives = static_cast<uint32_t>(bounds_.size());
+	if(num_primitives == 0) return result;
+	TaskPool task_pool(parameters_.num_threads_);
+	computeMortonCodes(task_pool);
+	radixSort(task_pool);
+	//A binary tree with N leaves has 2N-1 nodes, and there cannot be more leaves than primitives
+	nodes_.resize(2 * static_cast<size_t>(num_primitives) - 1);
+	heights_.resize(nodes_.size());
+	num_nodes_ = 1;
+	buildTreeWorker(0, 0, num_primitives, morton_bits_ - 1, 0, task_pool, result.stats_);
+	morton_codes_.clear();
+	morton_codes_.shrink_to_fit();
+	for(int pass = 0; pass < parameters_.treelet_passes_; ++pass) optimizeTreeletsWorker(0, 0, task_pool);
+	if(parameters_.treelet_passes_ > 0) compactTree(result);
+	else
+	{
+		nodes_.resize(num_nodes_);
+		nodes_.shrink_to_fit();
+		result.nodes_ = std::move(nodes_);
+	}
+	result.prim_indices_ = std::move(prim_indices_);
+	return result;
+}
+
+/*! Only split the work in several chunks when there are enough items to compensate the tasks overhead */
+int LbvhBuilder::numChunks(const TaskPool &task_pool, uint32_t size) const
+{
+	if(size < static_cast<uint32_t>(parameters_.min_indices_to_spawn_threads_)) return 1;
+	return task_pool.numThreads();
+}
+
+/*! Runs the function over the range [0, size) split in consecutive chunks of similar size, in parallel */
+void LbvhBuilder::parallelFor(TaskPool &task_pool, uint32_t size, int num_chunks, const std::function<void(uint32_t begin, uint32_t end, int chunk)> &function)
+{
+	const auto chunk_begin = [size, num_chunks](int chunk) { return static_cast<uint32_t>(static_cast<uint64_t>(size) * chunk / num_chunks); };
+	if(num_chunks == 1)
+	{
+		function(0, size, 0);
+		return;
+	}
+	TaskPool::TaskGroup task_group(task_pool);
+	for(int chunk = 1; chunk < num_chunks; ++chunk)
+	{
+		task_group.run([&function, &chunk_begin, chunk] { function(chunk_begin(chunk), chunk_begin(chunk + 1), chunk); });
+	}
+	function(0, chunk_begin(1), 0);
+	task_group.wait();
+}
+
+void LbvhBuilder::computeMortonCodes(TaskPool &task_pool)
+{
+	const auto num_primitives = static_cast<uint32_t>(bounds_.size());
+	const int num_chunks = numChunks(task_pool, num_primitives);
+	std::vector<Bound> chunk_centroid_bounds(num_chunks);
+	parallelFor(task_pool, num_primitives, num_chunks, [&](uint32_t begin, uint32_t end, int chunk)
+	{
+		Bound centroid_bound {bounds_[begin].center(), bounds_[begin].center()};
+		for(uint32_t prim_id = begin + 1; prim_id < end; ++prim_id) centroid_bound.include(bounds_[prim_id].center());
+		chunk_centroid_bounds[chunk] = centroid_bound;
+	});
+	Bound centroid_bound = chunk_centroid_bounds.front();
+	for(int chunk = 1; chunk < num_chunks; ++chunk) centroid_bound = Bound(centroid_bound, chunk_centroid_bounds[chunk]);
+
+	morton_codes_.resize(num_primitives);
+	prim_indices_.resize(num_primitives);
+	parallelFor(task_pool, num_primitives, num_chunks, [&](uint32_t begin, uint32_t end, int chunk)
+	{
+		for(uint32_t prim_id = begin; prim_id < end; ++prim_id)
+		{
+			morton_codes_[prim_id] = mortonCode(bounds_[prim_id].center(), centroid_bound);
+			prim_indices_[prim_id] = prim_id;
+		}
+	});
+}
+
+// ============================================================
+/*!
+	Least significant digit radix sort of the Morton codes and their primitive
+	indices. In each pass every chunk counts its digits, then the chunks scatter
+	their items in parallel, each one after the items of the same digit in the
+	previous chunks so the sort is stable.
+*/
+void LbvhBuilder::radixSort(TaskPool &task_pool)
+{
+	constexpr uint32_t num_buckets = 1 << radix_bits_;
+	const auto num_primitives = static_cast<uint32_t>(morton_codes_.size());
+	const int num_chunks = numChunks(task_pool, num_primitives);
+	std::vector<std::array<uint32_t, num_buckets>> chunk_offsets(num_chunks);
+	std::vector<uint32_t> sorted_codes(num_primitives);
+	std::vector<uint32_t> sorted_indices(num_primitives);
+	for(int shift = 0; shift < morton_bits_; shift += radix_bits_)
+	{
+		parallelFor(task_pool, num_primitives, num_chunks, [&](uint32_t begin, uint32_t end, int chunk)
+		{
+			std::array<uint32_t, num_buckets> &counts = chunk_offsets[chunk];
+			counts.fill(0);
+			for(uint32_t index = begin; index < end; ++index) ++counts[(morton_codes_[index] >> shift) & (num_buckets - 1)];
+		});
+		uint32_t offset = 0;
+		for(uint32_t bucket = 0; bucket < num_buckets; ++bucket)
+		{
+			for(int chunk = 0; chunk < num_chunks; ++chunk)
+			{
+				const uint32_t count = chunk_offsets[chunk][bucket];
+				chunk_offsets[chunk][bucket] = offset;
+				offset += count;
+			}
+		}
+		parallelFor(task_pool, num_primitives, num_chunks, [&](uint32_t begin, uint32_t end, int chunk)
+		{
+			std::array<uint32_t, num_buckets> &offsets = chunk_offsets[chunk];
+			for(uint32_t index = begin; index < end; ++index)
+			{
+				const uint32_t sorted_index = offsets[(morton_codes_[index] >> shift) & (num_buckets - 1)]++;
+				sorted_codes[sorted_index] = morton_codes_[index];
+				sorted_indices[sorted_index] = prim_indices_[index];
+			}
+		});
+		morton_codes_.swap(sorted_codes);
+		prim_indices_.swap(sorted_indices);
+	}
+}
+
+// ============================================================
+/*!
+	recursively build the LBVH. Each node is split where the highest Morton code
+	bit differing between its first and last primitives changes, which splits the
+	node space in two halves along one axis. Returns the node bound, calculated
+	from the children bounds.
+*/
+Bound LbvhBuilder::buildTreeWorker(uint32_t node_id, uint32_t index_begin, uint32_t index_end, int bit, int depth, TaskPool &task_pool, BvhBuilder::Stats &stats)
+{
+	const uint32_t num_indices = index_end - index_begin;
+	if(depth > stats.max_depth_) stats.max_depth_ = depth;
+	if(num_indices <= static_cast<uint32_t>(parameters_.max_leaf_size_) || depth >= BvhBuilder::max_depth_)
+	{
+		Bound node_bound = bounds_[prim_indices_[index_begin]];
+		for(uint32_t index_num = index_begin + 1; index_num < index_end; ++index_num) node_bound = Bound(node_bound, bounds_[prim_indices_[index_num]]);
+		nodes_[node_id].createLeaf(node_bound, index_begin, num_indices);
+		heights_[node_id] = 0;
+		++stats.bvh_leaves_;
+		stats.bvh_prims_ += num_indices;
+		if(num_indices > static_cast<uint32_t>(parameters_.max_leaf_size_)) ++stats.depth_limit_reached_;
+		return node_bound;
+	}
+
+	//If all the Morton codes in the node are equal, split it in two halves
+	uint32_t index_middle = index_begin + num_indices / 2;
+	for(; bit >= 0; --bit)
+	{
+		const uint32_t bit_mask = 1u << bit;
+		if(((morton_codes_[index_begin] ^ morton_codes_[index_end - 1]) & bit_mask) == 0) continue;
+		const auto middle = std::partition_point(morton_codes_.begin() + index_begin, morton_codes_.begin() + index_end, [bit_mask](uint32_t code) { return (code & bit_mask) == 0; });
+		index_middle = static_cast<uint32_t>(middle - morton_codes_.begin());
+		break;
+	}
+
+	const uint32_t left_child = num_nodes_.fetch_add(2);
+	++stats.bvh_inodes_;
+	Bound left_bound, right_bound;
+	const uint32_t num_left_indices = index_middle - index_begin;
+	const uint32_t num_right_indices = index_end - index_middle;
+	if(task_pool.numThreads() > 1 && num_left_indices >= static_cast<uint32_t>(parameters_.min_indices_to_spawn_threads_) && num_right_indices >= static_cast<uint32_t>(parameters_.min_indices_to_spawn_threads_))
+	{
+		BvhBuilder::Stats stats_left;
+		BvhBuilder::Stats stats_right;
+		TaskPool::TaskGroup task_group(task_pool);
+		task_group.run([&] { left_bound = buildTreeWorker(left_child, index_begin, index_middle, bit - 1, depth + 1, task_pool, stats_left); });
+		right_bound = buildTreeWorker(left_child + 1, index_middle, index_end, bit - 1, depth + 1, task_pool, stats_right);
+		task_group.wait();
+		stats += stats_left;
+		stats += stats_right;
+	}
+	else
+	{
+		left_bound = buildTreeWorker(left_child, index_begin, index_middle, bit - 1, depth + 1, task_pool, stats);
+		right_bound = buildTreeWorker(left_child + 1, index_middle, index_end, bit - 1, depth + 1, task_pool, stats);
+	}
+	const Bound node_bound {left_bound, right_bound};
+	nodes_[node_id].createInterior(node_bound, left_child);
+	heights_[node_id] = static_cast<uint8_t>(1 + std::max(heights_[left_child], heights_[left_child + 1]));
+	return node_bound;
+}
+
+/*! Optimizes the treelets bottom-up, so each treelet is formed from already optimized subtrees */
+void LbvhBuilder::optimizeTreeletsWorker(uint32_t node_id, int depth, TaskPool &task_pool)
+{
+	const Node &node = nodes_[node_id];
+	if(node.isLeaf()) return;
+	const uint32_t left_child = node.getLeftChild();
+	if(task_pool.numThreads() > 1 && depth < BvhBuilder::refit_tasks_max_depth_)
+	{
+		TaskPool::TaskGroup task_group(task_pool);
+		task_group.run([&] { optimizeTreeletsWorker(left_child, depth + 1, task_pool); });
+		optimizeTreeletsWorker(left_child + 1, depth + 1, task_pool);
+		task_group.wait();
+	}
+	else
+	{
+		optimizeTreeletsWorker(left_child, depth + 1, task_pool);
+		optimizeTreeletsWorker(left_child + 1, depth + 1, task_pool);
+	}
+	optimizeTreelet(node_id, depth);
+}
+
+// ============================================================
+/*!
+	The treelet is formed by the node and its descendants, expanding the
+	treelet leaf with the largest area until it has treelet_max_leaves_
+	leaves. Its optimal topology is found by dynamic programming over all
+	the subsets of treelet leaves, minimizing the sum of the areas of the
+	interior nodes, as the cost of the treelet leaves does not change.
+	The interior nodes are then rebuilt in the same node slots, so the
+	rest of the tree is not affected.
+*/
+void LbvhBuilder::optimizeTreelet(uint32_t node_id, int depth)
+{
+	std::array<uint32_t, treelet_max_leaves_> leaf_ids;
+	std::array<uint32_t, treelet_max_leaves_ - 1> children_ids; //!< left child of each pair of children of the treelet interior nodes
+	int num_leaves = 2;
+	int num_interior_nodes = 1;
+	children_ids[0] = nodes_[node_id].getLeftChild();
+	//The children treelets are already optimized, so the height of this node is updated from them before any of the early returns below, and overwritten again if the treelet is restructured
+	heights_[node_id] = static_cast<uint8_t>(1 + std::max(heights_[children_ids[0]], heights_[children_ids[0] + 1]));
+	leaf_ids[0] = children_ids[0];
+	leaf_ids[1] = children_ids[0] + 1;
+	float old_cost = BvhBuilder::halfArea(nodes_[node_id].getBound());
+	while(num_leaves < treelet_max_leaves_)
+	{
+		int leaf_expanded = -1;
+		float leaf_expanded_area = 0.f;
+		for(int leaf = 0; leaf < num_leaves; ++leaf)
+		{
+			const Node &leaf_node = nodes_[leaf_ids[leaf]];
+			if(leaf_node.isLeaf()) continue;
+			const float area = BvhBuilder::halfArea(leaf_node.getBound());
+			if(leaf_expanded < 0 || area > leaf_expanded_area)
+			{
+				leaf_expanded = leaf;
+				leaf_expanded_area = area;
+			}
+		}
+		if(leaf_expanded < 0) break;
+		old_cost += leaf_expanded_area;
+		const uint32_t left_child = nodes_[leaf_ids[leaf_expanded]].getLeftChild();
+		children_ids[num_interior_nodes++] = left_child;
+		leaf_ids[leaf_expanded] = left_child;
+		leaf_ids[num_leaves++] = left_child + 1;
+	}
+	if(num_leaves < 3) return;
+
+	constexpr int max_subsets = 1 << treelet_max_leaves_;
+	std::array<Bound, max_subsets> subset_bounds;
+	std::array<float, max_subsets> subset_costs;
+	std::array<int, max_subsets> subset_heights;
+	std::array<int, max_subsets> subset_partitions; //!< leaves subset going to the left child
+	std::array<Node, treelet_max_leaves_> leaf_nodes;
+	std::array<uint8_t, treelet_max_leaves_> leaf_heights;
+	for(int leaf = 0; leaf < num_leaves; ++leaf)
+	{
+		leaf_nodes[leaf] = nodes_[leaf_ids[leaf]];
+		leaf_heights[leaf] = heights_[leaf_ids[leaf]];
+		subset_bounds[1 << leaf] = leaf_nodes[leaf].getBound();
+		subset_costs[1 << leaf] = 0.f;
+		subset_heights[1 << leaf] = leaf_heights[leaf];
+	}
+	//Subsets are processed in increasing order so all their own subsets are already processed
+	const int all_leaves = (1 << num_leaves) - 1;
+	for(int subset = 3; subset <= all_leaves; ++subset)
+	{
+		if((subset & (subset - 1)) == 0) continue;
+		const int lowest_leaf = subset & -subset;
+		const int other_leaves = subset ^ lowest_leaf;
+		subset_bounds[subset] = Bound(subset_bounds[lowest_leaf], subset_bounds[other_leaves]);
+		//Each partition is only evaluated once, with the lowest leaf always in the left side
+		float best_cost = std::numeric_limits<float>::infinity();
+		int other_leaves_left = other_leaves;
+		do
+		{
+			other_leaves_left = (other_leaves_left - 1) & other_leaves;
+			const int left_leaves = lowest_leaf | other_leaves_left;
+			const float cost = subset_costs[left_leaves] + subset_costs[subset ^ left_leaves];
+			if(cost < best_cost)
+			{
+				best_cost = cost;
+				subset_partitions[subset] = left_leaves;
+			}
+		}
+		while(other_leaves_left != 0);
+		const int left_leaves = subset_partitions[subset];
+		subset_costs[subset] = BvhBuilder::halfArea(subset_bounds[subset]) + best_cost;
+		subset_heights[subset] = 1 + std::max(subset_heights[left_leaves], subset_heights[subset ^ left_leaves]);
+	}
+	if(subset_costs[all_leaves] >= old_cost * 0.999f) return;
+	if(depth + subset_heights[all_leaves] > BvhBuilder::max_depth_) return;
+
+	//Rebuild the interior nodes breadth first, each one taking the next pair of children slots
+	std::array<std::pair<uint32_t, int>, treelet_max_leaves_ - 1> interior_nodes; //!< node id and leaves subset
+	interior_nodes[0] = {node_id, all_leaves};
+	int interior_nodes_end = 1;
+	for(int interior_node = 0; interior_node < num_interior_nodes; ++interior_node)
+	{
+		const uint32_t interior_node_id = interior_nodes[interior_node].first;
+		const int subset = interior_nodes[interior_node].second;
+		const uint32_t left_child = children_ids[interior_node];
+		nodes_[interior_node_id].createInterior(subset_bounds[subset], left_child);
+		heights_[interior_node_id] = static_cast<uint8_t>(subset_heights[subset]);
+		const std::array<int, 2> children_subsets {{subset_partitions[subset], subset ^ subset_partitions[subset]}};
+		for(int child = 0; child < 2; ++child)
+		{
+			const uint32_t child_id = left_child + child;
+			const int child_subset = children_subsets[child];
+			if((child_subset & (child_subset - 1)) != 0) interior_nodes[interior_nodes_end++] = {child_id, child_subset};
+			else
+			{
+				int leaf = 0;
+				while((1 << leaf) != child_subset) ++leaf;
+				nodes_[child_id] = leaf_nodes[leaf];
+				heights_[child_id] = leaf_heights[leaf];
+			}
+		}
+	}
+}
+
+/*! After the treelets optimization the nodes are scattered and children can be stored before their
+	parents, so the nodes are copied to the result in depth first order, also calculating the tree depth */
+void LbvhBuilder::compactTree(BvhBuilder::Result &result) const
+{
+	result.nodes_.resize(num_nodes_);
+	result.nodes_[0] = nodes_[0];
+	result.stats_.max_depth_ = 0;
+	std::vector<std::pair<uint32_t, int>> stack {{0, 0}}; //!< node id in the result and depth
+	uint32_t num_nodes = 1;
+	while(!stack.empty())
+	{
+		const uint32_t node_id = stack.back().first;
+		const int depth = stack.back().second;
+		stack.pop_back();
+		if(depth > result.stats_.max_depth_) result.stats_.max_depth_ = depth;
+		Node &node = result.nodes_[node_id];
+		if(node.isLeaf()) continue;
+		const uint32_t left_child = node.getLeftChild();
+		result.nodes_[num_nodes] = nodes_[left_child];
+		result.nodes_[num_nodes + 1] = nodes_[left_child + 1];
+		node.createInterior(node.getBound(), num_nodes);
+		stack.push_back({num_nodes + 1, depth + 1});
+		stack.push_back({num_nodes, depth + 1});
+		num_nodes += 2;
+	}
+}
+
+END_YAFARAY
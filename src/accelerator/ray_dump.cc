@@ -0,0 +1,137 @@
+/****************************************************************************
+ *      This is part of the libYafaRay package
+ *
+ *      This library is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU Lesser General Public
+ *      License as published by the Free Software Foundation; either
+ *      version 2.1 of the License, or (at your option) any later version.
+ *
+ *      This library is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *      Lesser General Public License for more details.
+ *
+ *      You should have received a copy of the GNU Lesser General Public
+ *      License along with this library; if not, write to the Free Software
+ *      Foundation,Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include "accelerator/ray_dump.h"
+#include "common/logger.h"
+
+BEGIN_YAFARAY
+
+static constexpr std::array<char, 8> ray_dump_signature {{'Y', 'A', 'F', 'R', 'A', 'Y', 'S', 'D'}};
+
+struct RayDump::Header
+{
+	std::array<char, 8> signature_;
+	uint32_t version_;
+	uint32_t record_size_;
+};
+
+constexpr uint32_t RayDump::version_;
+constexpr size_t RayDump::buffer_size_;
+
+static uint64_t newRayDumpId()
+{
+	static std::atomic<uint64_t> last_ray_dump_id { 0 };
+	return ++last_ray_dump_id;
+}
+
+RayDump::RayDump(Logger &logger, const std::string &file_path) : logger_(logger), file_path_(file_path), id_(newRayDumpId()), file_(file_path, std::ios::binary | std::ios::trunc)
+{
+}
+
+/*! Returns nullptr if the file cannot be created */
+std::unique_ptr<RayDump> RayDump::create(Logger &logger, const std::string &file_path)
+{
+	std::unique_ptr<RayDump> ray_dump(new RayDump(logger, file_path));
+	const Header header {ray_dump_signature, version_, sizeof(Record)};
+	ray_dump->file_.write(reinterpret_cast<const char *>(&header), sizeof(Header));
+	if(!ray_dump->file_)
+	{
+		logger.logError("RayDump: could not create the ray dump file '", file_path, "'");
+		return nullptr;
+	}
+	logger.logInfo("RayDump: recording the accelerator queries into '", file_path, "'");
+	return ray_dump;
+}
+
+RayDump::~RayDump()
+{
+	flush();
+	logger_.logInfo("RayDump: ", num_records_, " accelerator queries recorded into '", file_path_, "'");
+}
+
+/*! Records are added to the end of the list, so it can be loaded after any previous ones */
+bool RayDump::load(Logger &logger, const std::string &file_path, std::vector<Record> &records)
+{
+	std::ifstream file(file_path, std::ios::binary);
+	Header header;
+	file.read(reinterpret_cast<char *>(&header), sizeof(Header));
+	if(!file || header.signature_ != ray_dump_signature || header.version_ != version_ || header.record_size_ != sizeof(Record))
+	{
+		logger.logError("RayDump: '", file_path, "' does not exist or it is not a valid ray dump file for this version");
+		return false;
+	}
+	file.seekg(0, std::ios::end);
+	const auto file_size = static_cast<size_t>(file.tellg());
+	const size_t num_records = (file_size - sizeof(Header)) / sizeof(Record);
+	const size_t records_offset = records.size();
+	records.resize(records_offset + num_records);
+	file.seekg(sizeof(Header));
+	file.read(reinterpret_cast<char *>(records.data() + records_offset), num_records * sizeof(Record));
+	if(!file)
+	{
+		logger.logError("RayDump: could not read the ray dump file '", file_path, "'");
+		records.resize(records_offset);
+		return false;
+	}
+	if(logger.isVerbose()) logger.logVerbose("RayDump: ", num_records, " accelerator queries loaded from '", file_path, "'");
+	return true;
+}
+
+/*! Each thread gets a new buffer the first time it records rays in each ray dump */
+std::vector<RayDump::Record> &RayDump::threadBuffer()
+{
+	static thread_local uint64_t thread_buffer_ray_dump_id = 0;
+	static thread_local std::vector<Record> *thread_buffer = nullptr;
+	if(thread_buffer_ray_dump_id != id_)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		thread_buffers_.emplace_back(new std::vector<Record>());
+		thread_buffer = thread_buffers_.back().get();
+		thread_buffer->reserve(buffer_size_);
+		thread_buffer_ray_dump_id = id_;
+	}
+	return *thread_buffer;
+}
+
+void RayDump::record(Query query, const Ray &ray, float t_max, float shadow_bias, int max_depth)
+{
+	std::vector<Record> &buffer = threadBuffer();
+	buffer.push_back({query, max_depth, {{ray.from_.x(), ray.from_.y(), ray.from_.z()}}, {{ray.dir_.x(), ray.dir_.y(), ray.dir_.z()}}, ray.tmin_, ray.tmax_, ray.time_, t_max, shadow_bias});
+	if(buffer.size() >= buffer_size_)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		write(buffer);
+	}
+}
+
+void RayDump::flush()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	for(auto &thread_buffer : thread_buffers_) write(*thread_buffer);
+	file_.flush();
+}
+
+/*! Must be called with the mutex locked */
+void RayDump::write(std::vector<Record> &records)
+{
+	file_.write(reinterpret_cast<const char *>(records.data()), records.size() * sizeof(Record));
+	num_records_ += records.size();
+	records.clear();
+}
+
+END_YAFARAY
@@ -0,0 +1,438 @@
+/****************************************************************************
+ *      This is part of the libYafaRay package
+ *
+ *      This library is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU Lesser General Public
+ *      License as published by the Free Software Foundation; either
+ *      version 2.1 of the License, or (at your option) any later version.
+ *
+ *      This library is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *      Lesser General Public License for more details.
+ *
+ *      You should have received a copy of the GNU Lesser General Public
+ *      License along with this library; if not, write to the Free Software
+ *      Foundation,Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include "accelerator/sbvh_builder.h"
+#include "common/task_pool.h"
+#include <algorithm>
+
+BEGIN_YAFARAY
+
+constexpr float SbvhBuilder::overlap_threshold_;
+
+SbvhBuilder::SbvhBuilder(const std::vector<Bound> &bounds, const ClipFunction &clip_function, const BvhBuilder::Parameters &parameters) : bounds_(bounds), clip_function_(clip_function), parameters_(parameters)
+{
+}
+
+uint32_t SbvhBuilder::maxReferences(uint32_t num_primitives, const BvhBuilder::Parameters &parameters)
+{
+	return num_primitives + static_cast<uint32_t>(static_cast<double>(num_primitives) * std::max(0.f, parameters.spatial_split_budget_));
+}
+
+BvhBuilder::Result SbvhBuilder::build()
+{
+	BvhBuilder::Result result;
+	const auto num_primitives = static_cast<uint32_t>(bounds_.size());
+	if(num_primitives == 0) return result;
+	const uint32_t max_references = maxReferences(num_primitives, parameters_);
+	remaining_duplicates_ = static_cast<int>(max_references - num_primitives);
+	std::vector<Reference> references(num_primitives);
+	Bound root_bound = bounds_.front();
+	for(uint32_t prim_id = 0; prim_id < num_primitives; ++prim_id)
+	{
+		references[prim_id] = {bounds_[prim_id], prim_id};
+		root_bound = Bound(root_bound, bounds_[prim_id]);
+	}
+	root_half_area_ = BvhBuilder::halfArea(root_bound);
+	//A binary tree with N leaves has 2N-1 nodes, and there cannot be more leaves than references
+	nodes_.resize(2 * static_cast<size_t>(max_references) - 1);
+	prim_indices_.resize(max_references);
+	num_nodes_ = 1;
+	num_prim_indices_ = 0;
+	TaskPool task_pool(parameters_.num_threads_);
+	buildTreeWorker(0, references, 0, task_pool, result.stats_);
+	nodes_.resize(num_nodes_);
+	nodes_.shrink_to_fit();
+	prim_indices_.resize(num_prim_indices_);
+	prim_indices_.shrink_to_fit();
+	result.nodes_ = std::move(nodes_);
+	result.prim_indices_ = std::move(prim_indices_);
+	return result;
+}
+
+bool SbvhBuilder::reserveDuplicates(int num_duplicates)
+{
+	int remaining_duplicates = remaining_duplicates_.load();
+	do
+	{
+		if(remaining_duplicates < num_duplicates) return false;
+	}
+	while(!remaining_duplicates_.compare_exchange_weak(remaining_duplicates, remaining_duplicates - num_duplicates));
+	return true;
+}
+
+/*! The clipped bound is also limited to the requested bound, in case of clipping precision issues */
+bool SbvhBuilder::clipReference(uint32_t prim_id, const Bound &bound, Bound &clipped_bound) const
+{
+	if(!clip_function_)
+	{
+		clipped_bound = bound;
+		return true;
+	}
+	Bound primitive_bound;
+	if(!clip_function_(prim_id, bound, primitive_bound)) return false;
+	for(int axis = 0; axis < 3; ++axis)
+	{
+		clipped_bound.a_[axis] = std::max(primitive_bound.a_[axis], bound.a_[axis]);
+		clipped_bound.g_[axis] = std::min(primitive_bound.g_[axis], bound.g_[axis]);
+	}
+	return validBound(clipped_bound);
+}
+
+// ============================================================
+/*!
+	Object split: binned SAH over the reference centroids, as in
+	BvhBuilder::binnedMinCost, also keeping the children bounds
+*/
+
+SbvhBuilder::Split SbvhBuilder::findObjectSplit(const std::vector<Reference> &references, const Bound &node_bound, const Bound &centroid_bound) const
+{
+	const int num_bins = parameters_.num_bins_;
+	const float inv_node_area = 1.f / BvhBuilder::halfArea(node_bound);
+	Split split;
+	for(int axis = 0; axis < 3; ++axis)
+	{
+		const float min = centroid_bound.a_[axis];
+		const float extent = centroid_bound.g_[axis] - min;
+		if(extent <= 0.f) continue;
+		const float scale = num_bins * (1.f - 1e-5f) / extent;
+		std::array<Bin, BvhBuilder::max_bins_> bins;
+		for(const auto &reference : references)
+		{
+			int bin_id = static_cast<int>((reference.bound_.center()[axis] - min) * scale);
+			if(bin_id >= num_bins) bin_id = num_bins - 1;
+			else if(bin_id < 0) bin_id = 0;
+			bins[bin_id].bound_ = Bound(bins[bin_id].bound_, reference.bound_);
+			++bins[bin_id].num_entries_;
+		}
+		std::array<Bin, BvhBuilder::max_bins_> right_bins;
+		Bin accumulated;
+		for(int bin_id = num_bins - 1; bin_id > 0; --bin_id)
+		{
+			accumulated.bound_ = Bound(accumulated.bound_, bins[bin_id].bound_);
+			accumulated.num_entries_ += bins[bin_id].num_entries_;
+			right_bins[bin_id] = accumulated;
+		}
+		accumulated = {};
+		for(int bin_id = 1; bin_id < num_bins; ++bin_id)
+		{
+			accumulated.bound_ = Bound(accumulated.bound_, bins[bin_id - 1].bound_);
+			accumulated.num_entries_ += bins[bin_id - 1].num_entries_;
+			const Bin &right_bin = right_bins[bin_id];
+			if(accumulated.num_entries_ == 0 || right_bin.num_entries_ == 0) continue;
+			const float cost = parameters_.cost_ratio_ + inv_node_area * (BvhBuilder::halfArea(accumulated.bound_) * accumulated.num_entries_ + BvhBuilder::halfArea(right_bin.bound_) * right_bin.num_entries_);
+			if(cost < split.cost_)
+			{
+				split.cost_ = cost;
+				split.axis_ = axis;
+				split.bin_ = bin_id;
+				split.left_bound_ = accumulated.bound_;
+				split.right_bound_ = right_bin.bound_;
+				split.num_left_ = accumulated.num_entries_;
+				split.num_right_ = right_bin.num_entries_;
+			}
+		}
+	}
+	return split;
+}
+
+// ============================================================
+/*!
+	Spatial split: the node bound is divided in bins of the same size,
+	and each reference is clipped to all the bins it overlaps. The left
+	child of each candidate plane gets the references entering any bin
+	before it and the right child the references exiting any bin after
+	it, so the references crossing the plane are counted in both.
+*/
+
+SbvhBuilder::Split SbvhBuilder::findSpatialSplit(const std::vector<Reference> &references, const Bound &node_bound) const
+{
+	const int num_bins = parameters_.num_bins_;
+	const float inv_node_area = 1.f / BvhBuilder::halfArea(node_bound);
+	Split split;
+	for(int axis = 0; axis < 3; ++axis)
+	{
+		const float min = node_bound.a_[axis];
+		const float extent = node_bound.g_[axis] - min;
+		if(extent <= 0.f) continue;
+		const float scale = num_bins * (1.f - 1e-5f) / extent;
+		const float bin_size = extent / num_bins;
+		const auto bin_of = [min, scale, num_bins](float coordinate) { return std::max(0, std::min(num_bins - 1, static_cast<int>((coordinate - min) * scale))); };
+		std::array<Bin, BvhBuilder::max_bins_> bins;
+		for(const auto &reference : references)
+		{
+			const int first_bin = bin_of(reference.bound_.a_[axis]);
+			const int last_bin = bin_of(reference.bound_.g_[axis]);
+			++bins[first_bin].num_entries_;
+			++bins[last_bin].num_exits_;
+			if(first_bin == last_bin)
+			{
+				bins[first_bin].bound_ = Bound(bins[first_bin].bound_, reference.bound_);
+				continue;
+			}
+			for(int bin_id = first_bin; bin_id <= last_bin; ++bin_id)
+			{
+				Bound bin_bound = reference.bound_;
+				if(bin_id > first_bin) bin_bound.a_[axis] = min + bin_id * bin_size;
+				if(bin_id < last_bin) bin_bound.g_[axis] = min + (bin_id + 1) * bin_size;
+				Bound clipped_bound;
+				if(clipReference(reference.prim_id_, bin_bound, clipped_bound)) bins[bin_id].bound_ = Bound(bins[bin_id].bound_, clipped_bound);
+			}
+		}
+		std::array<Bin, BvhBuilder::max_bins_> right_bins;
+		Bin accumulated;
+		for(int bin_id = num_bins - 1; bin_id > 0; --bin_id)
+		{
+			accumulated.bound_ = Bound(accumulated.bound_, bins[bin_id].bound_);
+			accumulated.num_exits_ += bins[bin_id].num_exits_;
+			right_bins[bin_id] = accumulated;
+		}
+		accumulated = {};
+		for(int bin_id = 1; bin_id < num_bins; ++bin_id)
+		{
+			accumulated.bound_ = Bound(accumulated.bound_, bins[bin_id - 1].bound_);
+			accumulated.num_entries_ += bins[bin_id - 1].num_entries_;
+			const Bin &right_bin = right_bins[bin_id];
+			if(accumulated.num_entries_ == 0 || right_bin.num_exits_ == 0) continue;
+			//The clipped parts of some bins could have disappeared due to precision issues
+			if(!validBound(accumulated.bound_) || !validBound(right_bin.bound_)) continue;
+			const float cost = parameters_.cost_ratio_ + inv_node_area * (BvhBuilder::halfArea(accumulated.bound_) * accumulated.num_entries_ + BvhBuilder::halfArea(right_bin.bound_) * right_bin.num_exits_);
+			if(cost < split.cost_)
+			{
+				split.cost_ = cost;
+				split.axis_ = axis;
+				split.bin_ = bin_id;
+				split.left_bound_ = accumulated.bound_;
+				split.right_bound_ = right_bin.bound_;
+				split.num_left_ = accumulated.num_entries_;
+				split.num_right_ = right_bin.num_exits_;
+			}
+		}
+	}
+	return split;
+}
+
+void SbvhBuilder::partitionObjects(std::vector<Reference> &references, const Split &split, const Bound &centroid_bound, std::vector<Reference> &left_references, std::vector<Reference> &right_references) const
+{
+	const float min = centroid_bound.a_[split.axis_];
+	const float scale = parameters_.num_bins_ * (1.f - 1e-5f) / (centroid_bound.g_[split.axis_] - min);
+	auto middle = std::partition(references.begin(), references.end(), [&](const Reference &reference)
+	{
+		const int bin_id = static_cast<int>((reference.bound_.center()[split.axis_] - min) * scale);
+		return bin_id < split.bin_;
+	});
+	if(middle == references.begin() || middle == references.end())
+	{
+		//Should not happen as the split cost ensures both sides have references, but just in case of floating point issues split in two halves
+		middle = references.begin() + references.size() / 2;
+		std::nth_element(references.begin(), middle, references.end(), [&](const Reference &reference_a, const Reference &reference_b) { return reference_a.bound_.center()[split.axis_] < reference_b.bound_.center()[split.axis_]; });
+	}
+	left_references.assign(references.begin(), middle);
+	right_references.assign(middle, references.end());
+}
+
+// ============================================================
+/*!
+	Distributes the references between both sides of the split plane. The
+	references crossing it are split in two unless it is cheaper to put
+	them whole in one of the children ("reference unsplitting"). Returns the
+	number of duplicated references, or -1 if any of the children is empty.
+*/
+
+int SbvhBuilder::partitionSpatial(const std::vector<Reference> &references, const Split &split, const Bound &node_bound, std::vector<Reference> &left_references, std::vector<Reference> &right_references) const
+{
+	const int axis = split.axis_;
+	const float min = node_bound.a_[axis];
+	const float extent = node_bound.g_[axis] - min;
+	const float scale = parameters_.num_bins_ * (1.f - 1e-5f) / extent;
+	const float position = min + split.bin_ * (extent / parameters_.num_bins_);
+	const auto bin_of = [this, min, scale](float coordinate) { return std::max(0, std::min(parameters_.num_bins_ - 1, static_cast<int>((coordinate - min) * scale))); };
+	Bound left_bound = split.left_bound_;
+	Bound right_bound = split.right_bound_;
+	float num_left = static_cast<float>(split.num_left_);
+	float num_right = static_cast<float>(split.num_right_);
+	left_references.reserve(split.num_left_);
+	right_references.reserve(split.num_right_);
+	int num_duplicates = 0;
+	for(const auto &reference : references)
+	{
+		if(bin_of(reference.bound_.g_[axis]) < split.bin_)
+		{
+			left_references.emplace_back(reference);
+			continue;
+		}
+		if(bin_of(reference.bound_.a_[axis]) >= split.bin_)
+		{
+			right_references.emplace_back(reference);
+			continue;
+		}
+		const Bound left_unsplit_bound {left_bound, reference.bound_};
+		const Bound right_unsplit_bound {right_bound, reference.bound_};
+		const float cost_split = BvhBuilder::halfArea(left_bound) * num_left + BvhBuilder::halfArea(right_bound) * num_right;
+		const float cost_unsplit_left = BvhBuilder::halfArea(left_unsplit_bound) * num_left + BvhBuilder::halfArea(right_bound) * (num_right - 1.f);
+		const float cost_unsplit_right = BvhBuilder::halfArea(left_bound) * (num_left - 1.f) + BvhBuilder::halfArea(right_unsplit_bound) * num_right;
+		if(cost_unsplit_left < cost_split && cost_unsplit_left <= cost_unsplit_right)
+		{
+			left_references.emplace_back(reference);
+			left_bound = left_unsplit_bound;
+			num_right -= 1.f;
+			continue;
+		}
+		if(cost_unsplit_right < cost_split)
+		{
+			right_references.emplace_back(reference);
+			right_bound = right_unsplit_bound;
+			num_left -= 1.f;
+			continue;
+		}
+		Bound left_side_bound = reference.bound_;
+		Bound right_side_bound = reference.bound_;
+		left_side_bound.g_[axis] = position;
+		right_side_bound.a_[axis] = position;
+		Bound left_part_bound, right_part_bound;
+		const bool left_part = clipReference(reference.prim_id_, left_side_bound, left_part_bound);
+		const bool right_part = clipReference(reference.prim_id_, right_side_bound, right_part_bound);
+		if(left_part) left_references.push_back({left_part_bound, reference.prim_id_});
+		if(right_part) right_references.push_back({right_part_bound, reference.prim_id_});
+		if(left_part && right_part) ++num_duplicates;
+		else if(!left_part && !right_part) right_references.emplace_back(reference); //should not happen, keep the reference anyway
+	}
+	if(left_references.empty() || right_references.empty()) return -1;
+	return num_duplicates;
+}
+
+// ============================================================
+/*!
+	recursively build the SBVH. Each call owns its references list, which
+	is released before building the children, so subtrees can be built in
+	parallel and the references memory does not grow with the tree depth.
+*/
+void SbvhBuilder::buildTreeWorker(uint32_t node_id, std::vector<Reference> &references, int depth, TaskPool &task_pool, BvhBuilder::Stats &stats)
+{
+	const auto num_references = static_cast<uint32_t>(references.size());
+	Bound node_bound = references.front().bound_;
+	Bound centroid_bound {node_bound.center(), node_bound.center()};
+	for(const auto &reference : references)
+	{
+		node_bound = Bound(node_bound, reference.bound_);
+		centroid_bound.include(reference.bound_.center());
+	}
+	if(depth > stats.max_depth_) stats.max_depth_ = depth;
+
+	const auto create_leaf = [&]()
+	{
+		const uint32_t prims_offset = num_prim_indices_.fetch_add(num_references);
+		for(uint32_t reference_num = 0; reference_num < num_references; ++reference_num) prim_indices_[prims_offset + reference_num] = references[reference_num].prim_id_;
+		nodes_[node_id].createLeaf(node_bound, prims_offset, num_references);
+		++stats.bvh_leaves_;
+		stats.bvh_prims_ += num_references;
+	};
+
+	//	<< check if leaf criteria met >>
+	if(num_references == 1) { create_leaf(); return; }
+	if(depth >= BvhBuilder::max_depth_)
+	{
+		create_leaf();
+		++stats.depth_limit_reached_;
+		return;
+	}
+
+	//<< calculate cost of the object and spatial splits and chose minimum >>
+	const Split object_split = findObjectSplit(references, node_bound, centroid_bound);
+	Split spatial_split;
+	//Splitting the few references of a node already small enough to be a leaf would only duplicate them, without reducing the children much
+	bool try_spatial_split = remaining_duplicates_.load() > 0 && root_half_area_ > 0.f && num_references > static_cast<uint32_t>(parameters_.max_leaf_size_);
+	if(try_spatial_split && object_split.axis_ != Axis::None)
+	{
+		//Children only touching each other, as the neighbour triangles of a mesh, do not overlap even if the touching face has some area
+		Bound overlap_bound;
+		for(int axis = 0; axis < 3; ++axis)
+		{
+			overlap_bound.a_[axis] = std::max(object_split.left_bound_.a_[axis], object_split.right_bound_.a_[axis]);
+			overlap_bound.g_[axis] = std::min(object_split.left_bound_.g_[axis], object_split.right_bound_.g_[axis]);
+			if(overlap_bound.g_[axis] < overlap_bound.a_[axis] || (overlap_bound.g_[axis] == overlap_bound.a_[axis] && node_bound.g_[axis] > node_bound.a_[axis])) try_spatial_split = false;
+		}
+		if(try_spatial_split) try_spatial_split = BvhBuilder::halfArea(overlap_bound) / root_half_area_ > overlap_threshold_;
+	}
+	if(try_spatial_split) spatial_split = findSpatialSplit(references, node_bound);
+	const float split_cost = std::min(object_split.cost_, spatial_split.cost_);
+	if(split_cost == std::numeric_limits<float>::infinity())
+	{
+		create_leaf();
+		if(num_references > static_cast<uint32_t>(parameters_.max_leaf_size_)) ++stats.num_degenerate_leaves_;
+		return;
+	}
+	if(split_cost >= static_cast<float>(num_references) && num_references <= static_cast<uint32_t>(parameters_.max_leaf_size_)) { create_leaf(); return; }
+
+	std::vector<Reference> left_references;
+	std::vector<Reference> right_references;
+	bool spatial_split_done = false;
+	if(spatial_split.cost_ < object_split.cost_)
+	{
+		const int max_duplicates = static_cast<int>(spatial_split.num_left_ + spatial_split.num_right_ - num_references);
+		if(reserveDuplicates(max_duplicates))
+		{
+			const int num_duplicates = partitionSpatial(references, spatial_split, node_bound, left_references, right_references);
+			remaining_duplicates_ += max_duplicates - std::max(num_duplicates, 0);
+			if(num_duplicates >= 0)
+			{
+				spatial_split_done = true;
+				++stats.spatial_splits_;
+				stats.duplicated_references_ += num_duplicates;
+			}
+			else
+			{
+				left_references.clear();
+				right_references.clear();
+			}
+		}
+	}
+	if(!spatial_split_done)
+	{
+		if(object_split.axis_ == Axis::None)
+		{
+			create_leaf();
+			if(num_references > static_cast<uint32_t>(parameters_.max_leaf_size_)) ++stats.num_degenerate_leaves_;
+			return;
+		}
+		partitionObjects(references, object_split, centroid_bound, left_references, right_references);
+	}
+	std::vector<Reference>().swap(references);
+
+	const uint32_t left_child = num_nodes_.fetch_add(2);
+	nodes_[node_id].createInterior(node_bound, left_child);
+	++stats.bvh_inodes_;
+
+	if(task_pool.numThreads() > 1 && left_references.size() >= static_cast<size_t>(parameters_.min_indices_to_spawn_threads_) && right_references.size() >= static_cast<size_t>(parameters_.min_indices_to_spawn_threads_))
+	{
+		BvhBuilder::Stats stats_left;
+		BvhBuilder::Stats stats_right;
+		TaskPool::TaskGroup task_group(task_pool);
+		task_group.run([&] { buildTreeWorker(left_child, left_references, depth + 1, task_pool, stats_left); });
+		buildTreeWorker(left_child + 1, right_references, depth + 1, task_pool, stats_right);
+		task_group.wait();
+		stats += stats_left;
+		stats += stats_right;
+	}
+	else
+	{
+		buildTreeWorker(left_child, left_references, depth + 1, task_pool, stats);
+		buildTreeWorker(left_child + 1, right_references, depth + 1, task_pool, stats);
+	}
+}
+
+END_YAFARAY
@@ -0,0 +1,41 @@
+/****************************************************************************
+ *      This is part of the libYafaRay package
+ *
+ *      This library is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU Lesser General Public
+ *      License as published by the Free Software Foundation; either
+ *      version 2.1 of the License, or (at your option) any later version.
+ *
+ *      This library is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *      Lesser General Public License for more details.
+ *
+ *      You should have received a copy of the GNU Lesser General Public
+ *      License along with this library; if not, write to the Free Software
+ *      Foundation,Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include "accelerator/triangle_soup.h"
+
+BEGIN_YAFARAY
+
+TriangleSoup::TriangleSoup(const std::vector<const Primitive *> &primitives)
+{
+	triangles_.resize(primitives.size());
+	const size_t num_primitives = primitives.size();
+	for(size_t prim_num = 0; prim_num < num_primitives; ++prim_num)
+	{
+		std::array<Point3, 3> vertices;
+		if(!primitives[prim_num]->getTriangleVertices(vertices)) continue;
+		Triangle &triangle = triangles_[prim_num];
+		triangle.vertex_0_ = vertices[0];
+		triangle.edge_1_ = vertices[1] - vertices[0];
+		triangle.edge_2_ = vertices[2] - vertices[0];
+		triangle.epsilon_ = TrianglePrimitive::intersectEpsilon(triangle.edge_1_, triangle.edge_2_);
+		++num_triangles_;
+	}
+	if(num_triangles_ == 0) triangles_ = {}; //no need to keep the list when all primitives fall back to their own intersect function
+}
+
+END_YAFARAY
@@ -29,6 +29,9 @@
 #include <windows.h>
 #else //defined(_WIN32)
 #include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
 #endif //defined(_WIN32)
 #include <iostream>
 #include <ctime>
@@ -301,4 +304,44 @@ std::vector<std::string> File::listFiles(const std::string &directory)
 	return files;
 }
 
+MappedFile::MappedFile(const std::string &path)
+{
+#if defined(_WIN32)
+	HANDLE file_handle = ::CreateFileW(string::utf8ToWutf16Le(path).c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if(file_handle == INVALID_HANDLE_VALUE) return;
+	file_handle_ = file_handle;
+	LARGE_INTEGER file_size;
+	if(!::GetFileSizeEx(file_handle, &file_size) || file_size.QuadPart == 0) return;
+	mapping_handle_ = ::CreateFileMappingW(file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if(!mapping_handle_) return;
+	data_ = static_cast<const char *>(::MapViewOfFile(mapping_handle_, FILE_MAP_READ, 0, 0, 0));
+	if(data_) size_ = static_cast<size_t>(file_size.QuadPart);
+#else //defined(_WIN32)
+	const int file_descriptor = ::open(path.c_str(), O_RDONLY);
+	if(file_descriptor < 0) return;
+	struct stat file_stat;
+	if(::fstat(file_descriptor, &file_stat) == 0 && file_stat.st_size > 0)
+	{
+		void *data = ::mmap(nullptr, static_cast<size_t>(file_stat.st_size), PROT_READ, MAP_PRIVATE, file_descriptor, 0);
+		if(data != MAP_FAILED)
+		{
+			data_ = static_cast<const char *>(data);
+			size_ = static_cast<size_t>(file_stat.st_size);
+		}
+	}
+	::close(file_descriptor); //The mapping stays valid after closing the file
+#endif //defined(_WIN32)
+}
+
+MappedFile::~MappedFile()
+{
+#if defined(_WIN32)
+	if(data_) ::UnmapViewOfFile(data_);
+	if(mapping_handle_) ::CloseHandle(mapping_handle_);
+	if(file_handle_) ::CloseHandle(file_handle_);
+#else //defined(_WIN32)
+	if(data_) ::munmap(const_cast<char *>(data_), size_);
+#endif //defined(_WIN32)
+}
+
 END_YAFARAY
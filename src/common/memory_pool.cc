@@ -0,0 +1,86 @@
+/****************************************************************************
+ *      This is part of the libYafaRay package
+ *
+ *      This library is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU Lesser General Public
+ *      License as published by the Free Software Foundation; either
+ *      version 2.1 of the License, or (at your option) any later version.
+ *
+ *      This library is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *      Lesser General Public License for more details.
+ *
+ *      You should have received a copy of the GNU Lesser General Public
+ *      License along with this library; if not, write to the Free Software
+ *      Foundation,Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include "common/memory_pool.h"
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+BEGIN_YAFARAY
+
+constexpr size_t MemoryPool::granularity_;
+constexpr size_t MemoryPool::num_size_classes_;
+constexpr size_t MemoryPool::max_free_blocks_;
+
+MemoryPool::~MemoryPool()
+{
+	for(auto &free_list : free_lists_)
+	{
+		while(free_list.first_)
+		{
+			FreeBlock *block = free_list.first_;
+			free_list.first_ = block->next_;
+			std::free(block);
+		}
+	}
+}
+
+MemoryPool &MemoryPool::threadPool()
+{
+	static thread_local MemoryPool memory_pool;
+	return memory_pool;
+}
+
+void *MemoryPool::allocate(size_t size)
+{
+	const size_t size_class = sizeClass(size);
+	if(size_class <= num_size_classes_)
+	{
+		FreeList &free_list = threadPool().free_lists_[size_class];
+		if(free_list.first_)
+		{
+			FreeBlock *block = free_list.first_;
+			free_list.first_ = block->next_;
+			--free_list.size_;
+			return block;
+		}
+	}
+	//All the blocks of a size class have the same size, so any of them can be reused for another object of that size class
+	void *block = std::malloc(std::max<size_t>(size_class, 1) * granularity_);
+	if(!block) throw std::bad_alloc();
+	return block;
+}
+
+void MemoryPool::deallocate(void *block, size_t size)
+{
+	if(!block) return;
+	const size_t size_class = sizeClass(size);
+	if(size_class <= num_size_classes_)
+	{
+		FreeList &free_list = threadPool().free_lists_[size_class];
+		if(free_list.size_ < max_free_blocks_)
+		{
+			free_list.first_ = new (block) FreeBlock{free_list.first_};
+			++free_list.size_;
+			return;
+		}
+	}
+	std::free(block);
+}
+
+END_YAFARAY
@@ -0,0 +1,143 @@
+/****************************************************************************
+ *      This is part of the libYafaRay package
+ *
+ *      This library is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU Lesser General Public
+ *      License as published by the Free Software Foundation; either
+ *      version 2.1 of the License, or (at your option) any later version.
+ *
+ *      This library is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *      Lesser General Public License for more details.
+ *
+ *      You should have received a copy of the GNU Lesser General Public
+ *      License along with this library; if not, write to the Free Software
+ *      Foundation,Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include "common/task_pool.h"
+#include <algorithm>
+
+BEGIN_YAFARAY
+
+thread_local const TaskPool *TaskPool::current_pool_ = nullptr;
+thread_local int TaskPool::current_queue_id_ = 0;
+
+TaskPool::TaskPool(int num_threads)
+{
+	if(num_threads < 1) num_threads = 1;
+	for(int queue_id = 0; queue_id < num_threads; ++queue_id) queues_.emplace_back(new Queue);
+	//The thread owning the pool also runs tasks while waiting for them, so one thread less is needed
+	for(int queue_id = 1; queue_id < num_threads; ++queue_id) workers_.emplace_back(&TaskPool::workerLoop, this, queue_id);
+}
+
+TaskPool::~TaskPool()
+{
+	{
+		std::lock_guard<std::mutex> lock_guard(sleep_mutex_);
+		finish_ = true;
+	}
+	sleep_condition_.notify_all();
+	for(auto &worker : workers_) worker.join();
+}
+
+int TaskPool::currentQueueId() const
+{
+	return current_pool_ == this ? current_queue_id_ : 0;
+}
+
+void TaskPool::push(std::function<void()> &&task)
+{
+	Queue &queue = *queues_[currentQueueId()];
+	{
+		std::lock_guard<std::mutex> lock_guard(queue.mutex_);
+		queue.tasks_.emplace_back(std::move(task));
+	}
+	{
+		std::lock_guard<std::mutex> lock_guard(sleep_mutex_);
+		++num_pending_tasks_;
+	}
+	sleep_condition_.notify_one();
+}
+
+/*! Runs one pending task, the newest from the own queue or else the oldest stolen from another queue. Returns false if there were no pending tasks */
+bool TaskPool::runPendingTask()
+{
+	const int num_queues = numThreads();
+	const int own_queue_id = currentQueueId();
+	std::function<void()> task;
+	for(int queue_num = 0; queue_num < num_queues && !task; ++queue_num)
+	{
+		const int queue_id = (own_queue_id + queue_num) % num_queues;
+		Queue &queue = *queues_[queue_id];
+		std::lock_guard<std::mutex> lock_guard(queue.mutex_);
+		if(queue.tasks_.empty()) continue;
+		if(queue_id == own_queue_id)
+		{
+			task = std::move(queue.tasks_.back());
+			queue.tasks_.pop_back();
+		}
+		else
+		{
+			task = std::move(queue.tasks_.front());
+			queue.tasks_.pop_front();
+		}
+	}
+	if(!task) return false;
+	--num_pending_tasks_;
+	task();
+	return true;
+}
+
+void TaskPool::workerLoop(int queue_id)
+{
+	current_pool_ = this;
+	current_queue_id_ = queue_id;
+	while(true)
+	{
+		if(runPendingTask()) continue;
+		std::unique_lock<std::mutex> lock(sleep_mutex_);
+		sleep_condition_.wait(lock, [this] { return finish_ || num_pending_tasks_ > 0; });
+		if(finish_) break;
+	}
+}
+
+/*! Splits [begin, end) into ranges of consecutive indices, a few per thread but not smaller than min_range_size, and runs the function for each range in parallel, waiting for all of them */
+void TaskPool::parallelFor(size_t begin, size_t end, const std::function<void(size_t range_begin, size_t range_end)> &function, size_t min_range_size)
+{
+	if(end <= begin) return;
+	const size_t range_size = std::max(min_range_size, (end - begin + 8 * numThreads() - 1) / (8 * numThreads()));
+	if(numThreads() == 1 || end - begin <= range_size)
+	{
+		function(begin, end);
+		return;
+	}
+	TaskGroup task_group(*this);
+	for(size_t range_begin = begin; range_begin < end; range_begin += range_size)
+	{
+		const size_t range_end = std::min(end, range_begin + range_size);
+		task_group.run([&function, range_begin, range_end] { function(range_begin, range_end); });
+	}
+	task_group.wait();
+}
+
+void TaskPool::TaskGroup::run(std::function<void()> &&task)
+{
+	++num_pending_tasks_;
+	task_pool_.push([this, task]()
+	{
+		task();
+		--num_pending_tasks_;
+	});
+}
+
+void TaskPool::TaskGroup::wait()
+{
+	while(num_pending_tasks_ > 0)
+	{
+		if(!task_pool_.runPendingTask()) std::this_thread::yield();
+	}
+}
+
+END_YAFARAY
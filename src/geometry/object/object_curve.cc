@@ -30,7 +30,7 @@ Object * CurveObject::factory(Logger &logger, const Scene &scene, const std::str
 		logger.logDebug("CurveObject::factory");
 		params.logContents(logger);
 	}
-	std::string light_name, visibility, base_object_name;
+	std::string light_name, visibility, base_object_name, strand_geometry_name = "triangles", strand_basis_name = "linear";
 	bool is_base_object = false, has_uv = false, has_orco = false;
 	int num_vertices = 0;
 	int object_index = 0;
@@ -45,9 +45,15 @@ Object * CurveObject::factory(Logger &logger, const Scene &scene, const std::str
 	params.getParam("strand_start", strand_start);
 	params.getParam("strand_end", strand_end);
 	params.getParam("strand_shape", strand_shape);
+	params.getParam("strand_geometry", strand_geometry_name); //Options: "triangles" (default, triangulated strands), "ribbon" (flat, facing the rays), "round" (flat with the shading normals of a cylinder)
+	params.getParam("strand_basis", strand_basis_name); //Options: "linear", "bspline" (uniform cubic B-spline through the points, for the curve primitives)
 	params.getParam("has_uv", has_uv);
 	params.getParam("has_orco", has_orco);
-	auto object = new CurveObject(num_vertices, strand_start, strand_end, strand_shape, has_uv, has_orco);
+	StrandGeometry strand_geometry = StrandGeometry::Triangles;
+	if(strand_geometry_name == "round") strand_geometry = StrandGeometry::Round;
+	else if(strand_geometry_name == "ribbon") strand_geometry = StrandGeometry::Ribbon;
+	const StrandBasis strand_basis = (strand_basis_name == "bspline") ? StrandBasis::BSpline : StrandBasis::Linear;
+	auto object = new CurveObject(num_vertices, strand_start, strand_end, strand_shape, strand_geometry, strand_basis, has_uv, has_orco);
 	object->setName(name);
 	object->setLight(scene.getLight(light_name));
 	object->setVisibility(visibility::fromString(visibility));
@@ -56,11 +62,81 @@ Object * CurveObject::factory(Logger &logger, const Scene &scene, const std::str
 	return object;
 }
 
-CurveObject::CurveObject(int num_vertices, float strand_start, float strand_end, float strand_shape, bool has_uv, bool has_orco) : MeshObject(num_vertices, 2 * (num_vertices - 1), has_uv, has_orco), strand_start_(strand_start), strand_end_(strand_end), strand_shape_(strand_shape)
+CurveObject::CurveObject(int num_vertices, float strand_start, float strand_end, float strand_shape, StrandGeometry strand_geometry, StrandBasis strand_basis, bool has_uv, bool has_orco) : MeshObject(num_vertices, strand_geometry == StrandGeometry::Triangles ? 2 * (num_vertices - 1) : 0, has_uv, has_orco), strand_start_(strand_start), strand_end_(strand_end), strand_shape_(strand_shape), strand_geometry_(strand_geometry), strand_basis_(strand_basis)
 {
 }
 
+int CurveObject::numPrimitives() const
+{
+	if(strand_geometry_ == StrandGeometry::Triangles) return MeshObject::numPrimitives();
+	else return static_cast<int>(segments_.size());
+}
+
+const std::vector<const Primitive *> CurveObject::getPrimitives() const
+{
+	if(strand_geometry_ == StrandGeometry::Triangles) return MeshObject::getPrimitives();
+	std::vector<const Primitive *> primitives;
+	primitives.reserve(segments_.size());
+	for(const auto &segment : segments_) primitives.push_back(&segment);
+	return primitives;
+}
+
+/*! The strands are built from the object's own points, so the external buffers are released without being used */
+bool CurveObject::setExternalPoints(Logger &logger, std::unique_ptr<const ExternalBuffer> points)
+{
+	logger.logError("CurveObject: '", getName(), "' cannot use external points");
+	return false;
+}
+
+bool CurveObject::setExternalFaces(Logger &logger, std::unique_ptr<const ExternalBuffer> vertex_indices, const std::unique_ptr<const Material> *material)
+{
+	logger.logError("CurveObject: '", getName(), "' cannot use external faces");
+	return false;
+}
+
+float CurveObject::strandRadius(int point, int num_points) const
+{
+	if(strand_shape_ < 0)
+	{
+		return strand_start_ + math::pow((float)point / (num_points - 1), 1 + strand_shape_) * (strand_end_ - strand_start_);
+	}
+	else
+	{
+		return strand_start_ + (1 - math::pow(((float)(num_points - point - 1)) / (num_points - 1), 1 - strand_shape_)) * (strand_end_ - strand_start_);
+	}
+}
+
+/*! The linear segments are straight lines between the strand points. The B-spline segments use the neighbouring points
+	as well, with points mirrored at the ends of the strand so the curve starts and ends at the first and last points */
+std::array<Point3, 4> CurveObject::getSegmentControlPoints(int segment) const
+{
+	const Point3 &p_1 = points_[segment];
+	const Point3 &p_2 = points_[segment + 1];
+	if(strand_basis_ == StrandBasis::Linear) return {{p_1, (2.f * p_1 + p_2) / 3.f, (p_1 + 2.f * p_2) / 3.f, p_2}};
+	const Point3 p_0 = segment > 0 ? points_[segment - 1] : Point3{2.f * p_1 - p_2};
+	const Point3 p_3 = segment + 2 < static_cast<int>(points_.size()) ? points_[segment + 2] : Point3{2.f * p_2 - p_1};
+	return {{(p_0 + 4.f * p_1 + p_2) / 6.f, (2.f * p_1 + p_2) / 3.f, (p_1 + 2.f * p_2) / 3.f, (p_1 + 4.f * p_2 + p_3) / 6.f}};
+}
+
 bool CurveObject::calculateObject(const std::unique_ptr<const Material> *material)
+{
+	const int points_size = points_.size();
+	if(strand_geometry_ == StrandGeometry::Triangles)
+	{
+		calculateTriangles(material);
+		return true;
+	}
+	material_ = material;
+	radii_.clear();
+	radii_.reserve(points_size);
+	for(int i = 0; i < points_size; ++i) radii_.push_back(strandRadius(i, points_size));
+	segments_.clear();
+	segments_.reserve(std::max(points_size - 1, 0));
+	for(int i = 0; i < points_size - 1; ++i) segments_.emplace_back(*this, i);
+	return true;
+}
+
+void CurveObject::calculateTriangles(const std::unique_ptr<const Material> *material)
 {
 	const std::vector<Point3> &points = getPoints();
 	const int points_size = points.size();
@@ -70,15 +146,7 @@ bool CurveObject::calculateObject(const std::unique_ptr<const Material> *materia
 	for(int i = 0; i < points_size; i++)
 	{
 		const Point3 o{points[i]};
-		float r;	//current radius
-		if(strand_shape_ < 0)
-		{
-			r = strand_start_ + math::pow((float)i / (points_size - 1), 1 + strand_shape_) * (strand_end_ - strand_start_);
-		}
-		else
-		{
-			r = strand_start_ + (1 - math::pow(((float)(points_size - i - 1)) / (points_size - 1), 1 - strand_shape_)) * (strand_end_ - strand_start_);
-		}
+		const float r = strandRadius(i, points_size);	//current radius
 		// Last point keep previous tangent plane
 		if(i < points_size - 1)
 		{
@@ -122,8 +190,6 @@ bool CurveObject::calculateObject(const std::unique_ptr<const Material> *materia
 	}
 	// Close top
 	addFace({i, 2 * i + points_size, 2 * i + points_size + 1}, {iv, iv, iv}, material);
-	calculateNormals();
-	return true;
 }
 
 
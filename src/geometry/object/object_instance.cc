@@ -22,14 +22,21 @@
 
 BEGIN_YAFARAY
 
-ObjectInstance::ObjectInstance(const Object &base_object, const Matrix4 &obj_to_world) : base_object_(base_object), obj_to_world_(new Matrix4(obj_to_world))
+ObjectInstance::ObjectInstance(const Object &base_object, const std::vector<Matrix4> &obj_to_world_time_steps) : base_object_(base_object), obj_to_world_(obj_to_world_time_steps)
 {
+	//The primitive instances are created on demand in calculateObject(), as two-level accelerators use the base object primitives directly
+}
+
+bool ObjectInstance::calculateObject(const std::unique_ptr<const Material> *)
+{
+	if(!primitive_instances_.empty()) return true;
 	const std::vector<const Primitive *> primitives = base_object_.getPrimitives();
-	primitive_instances_.reserve(base_object.numPrimitives());
+	primitive_instances_.reserve(primitives.size());
 	for(const auto &primitive : primitives)
 	{
 		primitive_instances_.emplace_back(new PrimitiveInstance(primitive, *this));
 	}
+	return true;
 }
 
 const std::vector<const Primitive *> ObjectInstance::getPrimitives() const
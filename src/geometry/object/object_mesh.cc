@@ -18,10 +18,15 @@
 
 #include "geometry/object/object_mesh.h"
 #include "geometry/primitive/primitive_triangle.h"
+#include "geometry/primitive/primitive_triangle_motion.h"
+#include "math/interpolation.h"
 #include "geometry/uv.h"
 #include "scene/scene.h"
 #include "common/logger.h"
 #include "common/param.h"
+#include "common/task_pool.h"
+#include "common/timer.h"
+#include <algorithm>
 #include <array>
 
 BEGIN_YAFARAY
@@ -34,8 +39,8 @@ Object * MeshObject::factory(Logger &logger, const Scene &scene, const std::stri
 		params.logContents(logger);
 	}
 	std::string light_name, visibility, base_object_name;
-	bool is_base_object = false, has_uv = false, has_orco = false;
-	int num_faces = 0, num_vertices = 0;
+	bool is_base_object = false, has_uv = false, has_orco = false, compact_attributes = false;
+	int num_faces = 0, num_vertices = 0, num_time_steps = 1;
 	int object_index = 0;
 	params.getParam("light_name", light_name);
 	params.getParam("visibility", visibility);
@@ -45,7 +50,9 @@ Object * MeshObject::factory(Logger &logger, const Scene &scene, const std::stri
 	params.getParam("num_vertices", num_vertices);
 	params.getParam("has_uv", has_uv);
 	params.getParam("has_orco", has_orco);
-	auto object = new MeshObject(num_vertices, num_faces, has_uv, has_orco);
+	params.getParam("time_steps", num_time_steps);
+	params.getParam("compact_attributes", compact_attributes);
+	auto object = new MeshObject(num_vertices, num_faces, has_uv, has_orco, std::max(1, num_time_steps), compact_attributes);
 	object->setName(name);
 	object->setLight(scene.getLight(light_name));
 	object->setVisibility(visibility::fromString(visibility));
@@ -54,10 +61,18 @@ Object * MeshObject::factory(Logger &logger, const Scene &scene, const std::stri
 	return object;
 }
 
-MeshObject::MeshObject(int num_vertices, int num_faces, bool has_uv, bool has_orco)
+constexpr uint32_t MeshObject::no_index_;
+
+MeshObject::MeshObject(int num_vertices, int num_faces, bool has_uv, bool has_orco, int num_time_steps, bool compact_attributes) : motion_points_(num_time_steps - 1), compact_attributes_(compact_attributes)
 {
-	faces_.reserve(num_faces);
+	vertex_indices_.reserve(3 * num_faces);
+	if(has_uv) uv_indices_.reserve(3 * num_faces);
+	face_materials_.reserve(num_faces);
+	face_normals_.reserve(num_faces);
+	if(motion_points_.empty()) triangles_.reserve(num_faces);
+	else motion_triangles_.reserve(num_faces);
 	points_.reserve(num_vertices);
+	for(auto &time_step_points : motion_points_) time_step_points.reserve(num_vertices);
 	if(has_orco) orco_points_.reserve(num_vertices);
 	if(has_uv) uv_values_.reserve(num_vertices);
 }
@@ -66,176 +81,551 @@ MeshObject::~MeshObject()
 {
 }
 
-void MeshObject::addFace(std::unique_ptr<FacePrimitive> face)
+void MeshObject::addFace(const std::vector<int> &vertices, const std::vector<int> &vertices_uv, const std::unique_ptr<const Material> *material)
 {
-	if(face)
+	if(vertices.size() != 3 || external_vertex_indices_) return; //Other primitives are not supported
+	const size_t face_index = face_materials_.size();
+	for(const int vertex : vertices) vertex_indices_.push_back(static_cast<uint32_t>(vertex));
+	if(!normal_indices_.empty())
 	{
-		face->setSelfIndex(faces_.size());
-		faces_.emplace_back(std::move(face));
+		for(const int vertex : vertices) normal_indices_.push_back(hasNormalsExported() ? static_cast<uint32_t>(vertex) : no_index_);
 	}
+	if(vertices_uv.size() == 3)
+	{
+		uv_indices_.resize(3 * face_index, 0);
+		for(const int vertex_uv : vertices_uv) uv_indices_.push_back(static_cast<uint32_t>(vertex_uv));
+	}
+	else if(!uv_indices_.empty()) uv_indices_.resize(3 * (face_index + 1), 0);
+	face_materials_.push_back(getMaterialId(material));
+	addFaceHandles(face_index, face_index + 1);
 }
 
-void MeshObject::addFace(const std::vector<int> &vertices, const std::vector<int> &vertices_uv, const std::unique_ptr<const Material> *material)
+/*! Adds consecutive triangles given three point indices per face and optionally three uv indices per face, all with the same material.
+	The indices are checked against the points and uv values already added, so nothing is added if any of them is out of range */
+bool MeshObject::addFaces(Logger &logger, std::vector<uint32_t> &&vertex_indices, std::vector<uint32_t> &&uv_indices, const std::unique_ptr<const Material> *material)
+{
+	if(external_vertex_indices_)
+	{
+		logger.logError("MeshObject: '", getName(), "' cannot add faces, it uses external face vertex indices");
+		return false;
+	}
+	if(vertex_indices.size() % 3 != 0 || (!uv_indices.empty() && uv_indices.size() != vertex_indices.size()))
+	{
+		logger.logError("MeshObject: the faces need three point indices each and, if given, the same number of uv indices");
+		return false;
+	}
+	const size_t num_points = numVertices();
+	for(const uint32_t vertex_index : vertex_indices)
+	{
+		if(vertex_index >= num_points)
+		{
+			logger.logError("MeshObject: face point index ", vertex_index, " is out of range, the mesh has ", num_points, " points");
+			return false;
+		}
+	}
+	const size_t num_uv_values = uv_values_.size();
+	for(const uint32_t uv_index : uv_indices)
+	{
+		if(uv_index >= num_uv_values)
+		{
+			logger.logError("MeshObject: face uv index ", uv_index, " is out of range, the mesh has ", num_uv_values, " uv values");
+			return false;
+		}
+	}
+	const size_t first_face = face_materials_.size();
+	const size_t num_faces = first_face + vertex_indices.size() / 3;
+	if(!normal_indices_.empty())
+	{
+		for(const uint32_t vertex_index : vertex_indices) normal_indices_.push_back(hasNormalsExported() ? vertex_index : no_index_);
+	}
+	if(!uv_indices.empty())
+	{
+		uv_indices_.resize(3 * first_face, 0);
+		appendOrMove(uv_indices_, std::move(uv_indices));
+	}
+	else if(!uv_indices_.empty()) uv_indices_.resize(3 * num_faces, 0);
+	appendOrMove(vertex_indices_, std::move(vertex_indices));
+	face_materials_.resize(num_faces, getMaterialId(material));
+	addFaceHandles(first_face, num_faces);
+	return true;
+}
+
+/*! Calculates the geometric normals and creates the primitives of the faces already in the face arrays from first_face to the one before last_face */
+void MeshObject::addFaceHandles(size_t first_face, size_t last_face)
 {
-	std::unique_ptr<FacePrimitive> face;
-	if(vertices.size() == 3) face = std::unique_ptr<FacePrimitive>(new TrianglePrimitive(vertices, vertices_uv, *this));
-	else return; //Other primitives are not supported
-	face->setMaterial(material);
-	if(hasNormalsExported()) face->setNormalsIndices(vertices);
-	addFace(std::move(face));
+	for(size_t face_index = first_face; face_index < last_face; ++face_index)
+	{
+		face_normals_.push_back(calculateFaceNormal(face_index));
+		if(motion_points_.empty()) triangles_.emplace_back(*this, face_index);
+		else motion_triangles_.emplace_back(*this, face_index);
+	}
 }
 
-void MeshObject::calculateNormals()
+bool MeshObject::setExternalPoints(Logger &logger, std::unique_ptr<const ExternalBuffer> points)
 {
-	for(auto &face : faces_) face->calculateGeometricNormal();
+	if(!points->isValid<float>(3))
+	{
+		logger.logError("MeshObject: '", getName(), "' external points need a buffer with a stride of at least three floats, and both the buffer address and the stride aligned to a float");
+		return false;
+	}
+	if(external_points_ || !points_.empty() || !motion_points_.empty())
+	{
+		logger.logError("MeshObject: '", getName(), "' can only use external points if it does not have points or motion blur time steps yet");
+		return false;
+	}
+	external_points_ = std::move(points);
+	points_ = {};
+	return true;
+}
+
+/*! The face vertex indices are checked against the points once, when they are set. All the faces have the same material */
+bool MeshObject::setExternalFaces(Logger &logger, std::unique_ptr<const ExternalBuffer> vertex_indices, const std::unique_ptr<const Material> *material)
+{
+	if(!vertex_indices->isValid<int>(3))
+	{
+		logger.logError("MeshObject: '", getName(), "' external faces need a buffer with a stride of at least three ints, and both the buffer address and the stride aligned to an int");
+		return false;
+	}
+	if(external_vertex_indices_ || numFaces() > 0)
+	{
+		logger.logError("MeshObject: '", getName(), "' can only use external faces if it does not have faces yet");
+		return false;
+	}
+	const size_t num_faces = vertex_indices->size();
+	const int num_points = numVertices();
+	for(size_t face_index = 0; face_index < num_faces; ++face_index)
+	{
+		const int *face_vertex_indices = vertex_indices->get<int>(face_index);
+		for(size_t vertex_number = 0; vertex_number < 3; ++vertex_number)
+		{
+			if(face_vertex_indices[vertex_number] < 0 || face_vertex_indices[vertex_number] >= num_points)
+			{
+				logger.logError("MeshObject: '", getName(), "' external face point index ", face_vertex_indices[vertex_number], " is out of range, the mesh has ", num_points, " points");
+				return false;
+			}
+		}
+	}
+	external_vertex_indices_ = std::move(vertex_indices);
+	vertex_indices_ = {};
+	uv_indices_ = {};
+	face_materials_.assign(num_faces, getMaterialId(material));
+	if(!normal_indices_.empty()) normal_indices_.assign(3 * num_faces, no_index_);
+	addFaceHandles(0, num_faces);
+	return true;
+}
+
+Point3 MeshObject::getVertex(int index) const
+{
+	if(external_points_)
+	{
+		const float *point = external_points_->get<float>(index);
+		return {point[0], point[1], point[2]};
+	}
+	else return points_[index];
+}
+
+uint32_t MeshObject::getFaceVertexIndex(size_t face_index, size_t vertex_number) const
+{
+	if(external_vertex_indices_) return static_cast<uint32_t>(external_vertex_indices_->get<int>(face_index)[vertex_number]);
+	else return vertex_indices_[3 * face_index + vertex_number];
+}
+
+/*! The faces are usually added grouped by material, so the last material added is checked first */
+uint32_t MeshObject::getMaterialId(const std::unique_ptr<const Material> *material)
+{
+	if(!materials_.empty() && materials_.back() == material) return static_cast<uint32_t>(materials_.size()) - 1;
+	const auto it = std::find(materials_.begin(), materials_.end(), material);
+	if(it != materials_.end()) return static_cast<uint32_t>(it - materials_.begin());
+	materials_.push_back(material);
+	return static_cast<uint32_t>(materials_.size()) - 1;
+}
+
+/*! Without explicit normal indices the face vertices use the normals with the same indices as their points, if there are any */
+uint32_t MeshObject::getFaceNormalIndex(size_t face_index, size_t vertex_number) const
+{
+	if(!normal_indices_.empty()) return normal_indices_[3 * face_index + vertex_number];
+	else if(hasNormalsExported()) return getFaceVertexIndex(face_index, vertex_number);
+	else return no_index_;
+}
+
+/*! The external faces do not have uv indices, their vertices use the uv values with the same indices as their points */
+uint32_t MeshObject::getFaceUvIndex(size_t face_index, size_t vertex_number) const
+{
+	if(!uv_indices_.empty()) return uv_indices_[3 * face_index + vertex_number];
+	else if(external_vertex_indices_) return getFaceVertexIndex(face_index, vertex_number);
+	else return 0;
+}
+
+Vec3 MeshObject::calculateFaceNormal(size_t face_index) const
+{
+	const Point3 vertex_0{getVertex(getFaceVertexIndex(face_index, 0))};
+	const Point3 vertex_1{getVertex(getFaceVertexIndex(face_index, 1))};
+	const Point3 vertex_2{getVertex(getFaceVertexIndex(face_index, 2))};
+	return ((vertex_1 - vertex_0) ^ (vertex_2 - vertex_0)).normalize();
+}
+
+void MeshObject::calculateNormals(int num_threads)
+{
+	TaskPool task_pool(num_threads);
+	task_pool.parallelFor(0, face_normals_.size(), [&](size_t faces_begin, size_t faces_end)
+	{
+		for(size_t face_index = faces_begin; face_index < faces_end; ++face_index) face_normals_[face_index] = calculateFaceNormal(face_index);
+	});
+}
+
+int MeshObject::addPoint(const Point3 &p, int time_step)
+{
+	if(time_step == 0)
+	{
+		if(external_points_) return -1;
+		points_.push_back(p);
+		return lastVertexId();
+	}
+	if(time_step < 0 || time_step > static_cast<int>(motion_points_.size())) return -1;
+	std::vector<Point3> &time_step_points = motion_points_[time_step - 1];
+	time_step_points.push_back(p);
+	return static_cast<int>(time_step_points.size()) - 1;
+}
+
+/*! The points move linearly between the time steps, uniformly distributed in the frame time */
+Point3 MeshObject::getVertexAtTime(int index, float time) const
+{
+	if(motion_points_.empty()) return getVertex(index);
+	float segment_time;
+	const int time_step = math::uniformSegment(time, numTimeSteps(), segment_time);
+	return math::lerp(getVertexTimeStep(index, time_step), getVertexTimeStep(index, time_step + 1), segment_time);
 }
 
 bool MeshObject::calculateObject(const std::unique_ptr<const Material> *)
 {
-	faces_.shrink_to_fit();
+	bool result = true;
+	for(auto &time_step_points : motion_points_)
+	{
+		//All the time steps must have the same points, otherwise the mesh cannot move
+		if(time_step_points.size() != points_.size())
+		{
+			time_step_points = points_;
+			result = false;
+		}
+		time_step_points.shrink_to_fit();
+	}
+	//The external faces use one uv value per point
+	if(external_vertex_indices_ && hasUv() && static_cast<int>(uv_values_.size()) < numVertices())
+	{
+		uv_values_.clear();
+		result = false;
+	}
+	vertex_indices_.shrink_to_fit();
+	if(!uv_indices_.empty()) uv_indices_.shrink_to_fit();
+	face_materials_.shrink_to_fit();
+	face_normals_.shrink_to_fit();
+	triangles_.shrink_to_fit();
+	motion_triangles_.shrink_to_fit();
 	points_.shrink_to_fit();
 	if(!orco_points_.empty()) orco_points_.shrink_to_fit();
 	if(!uv_values_.empty()) uv_values_.shrink_to_fit();
-	calculateNormals();
-	return true;
+	if(compact_attributes_)
+	{
+		packNormals();
+		packUvValues();
+		packOrcoPoints();
+	}
+	return result;
+}
+
+void MeshObject::packNormals()
+{
+	if(normals_.empty()) return;
+	packed_normals_.clear();
+	packed_normals_.reserve(normals_.size());
+	for(const auto &normal : normals_) packed_normals_.emplace_back(normal);
+	normals_.clear();
+	normals_.shrink_to_fit();
+}
+
+void MeshObject::unpackNormals()
+{
+	if(packed_normals_.empty()) return;
+	normals_.clear();
+	normals_.reserve(packed_normals_.size());
+	for(const auto &packed_normal : packed_normals_) normals_.push_back(packed_normal.unpack());
+	packed_normals_.clear();
+	packed_normals_.shrink_to_fit();
+}
+
+/*! The uv values are packed within the range of the u and v values of the whole mesh, so the precision is the size of that range divided by 65535 */
+void MeshObject::packUvValues()
+{
+	if(uv_values_.empty()) return;
+	std::array<float, 2> min {{uv_values_.front().u_, uv_values_.front().v_}}, max = min;
+	for(const auto &uv : uv_values_)
+	{
+		min = {{std::min(min[0], uv.u_), std::min(min[1], uv.v_)}};
+		max = {{std::max(max[0], uv.u_), std::max(max[1], uv.v_)}};
+	}
+	uv_ranges_ = {{ {min[0], max[0]}, {min[1], max[1]} }};
+	packed_uv_values_.clear();
+	packed_uv_values_.reserve(uv_values_.size());
+	for(const auto &uv : uv_values_) packed_uv_values_.push_back({{uv_ranges_[0].pack(uv.u_), uv_ranges_[1].pack(uv.v_)}});
+	uv_values_.clear();
+	uv_values_.shrink_to_fit();
+}
+
+/*! The orco points are packed within their bound, with a precision of the bound size divided by 65535 in each axis */
+void MeshObject::packOrcoPoints()
+{
+	if(orco_points_.empty()) return;
+	Point3 min{orco_points_.front()}, max{orco_points_.front()};
+	for(const auto &orco_point : orco_points_)
+	{
+		for(int axis = 0; axis < 3; ++axis)
+		{
+			min[axis] = std::min(min[axis], orco_point[axis]);
+			max[axis] = std::max(max[axis], orco_point[axis]);
+		}
+	}
+	for(int axis = 0; axis < 3; ++axis) orco_ranges_[axis] = {min[axis], max[axis]};
+	packed_orco_points_.clear();
+	packed_orco_points_.reserve(orco_points_.size());
+	for(const auto &orco_point : orco_points_) packed_orco_points_.push_back({{orco_ranges_[0].pack(orco_point[0]), orco_ranges_[1].pack(orco_point[1]), orco_ranges_[2].pack(orco_point[2])}});
+	orco_points_.clear();
+	orco_points_.shrink_to_fit();
 }
 
 const std::vector<const Primitive *> MeshObject::getPrimitives() const
 {
 	std::vector<const Primitive *> primitives;
-	primitives.reserve(faces_.size());
-	for(const auto &face : faces_) primitives.push_back(face.get());
+	primitives.reserve(numFaces());
+	for(const auto &triangle : triangles_) primitives.push_back(&triangle);
+	for(const auto &motion_triangle : motion_triangles_) primitives.push_back(&motion_triangle);
 	return primitives;
 }
 
 void MeshObject::addNormal(const Vec3 &n)
 {
-	const size_t points_size = points_.size();
+	const size_t points_size = numVertices();
 	if(normals_.size() < points_size) normals_.reserve(points_size);
 	normals_.push_back(n);
 }
 
-float MeshObject::getAngleSine(const std::array<int, 3> &triangle_indices, const std::vector<Point3> &vertices)
+float MeshObject::getAngleSine(const std::array<uint32_t, 3> &triangle_indices) const
 {
-	const Vec3 edge_1{vertices[triangle_indices[1]] - vertices[triangle_indices[0]]};
-	const Vec3 edge_2{vertices[triangle_indices[2]] - vertices[triangle_indices[0]]};
+	const Point3 vertex_0{getVertex(triangle_indices[0])};
+	const Vec3 edge_1{getVertex(triangle_indices[1]) - vertex_0};
+	const Vec3 edge_2{getVertex(triangle_indices[2]) - vertex_0};
 	return edge_1.sinFromVectors(edge_2);
 }
 
-bool MeshObject::smoothNormals(Logger &logger, float angle)
+/*! Face corners using each point, in CSR layout. The corners are counted per point, the counts turned into offsets with a prefix sum
+	and the corners scattered into their slots. The slots of each point are sorted at the end, so the corners are in face order and
+	the normals are accumulated in the same order regardless of the number of threads */
+MeshObject::PointCorners MeshObject::getPointCorners(TaskPool &task_pool) const
+{
+	const size_t num_points = numVertices();
+	const size_t num_corners = 3 * face_normals_.size();
+	std::unique_ptr<std::atomic<uint32_t>[]> slots_next(new std::atomic<uint32_t>[num_points]);
+	task_pool.parallelFor(0, num_points, [&](size_t points_begin, size_t points_end)
+	{
+		for(size_t point_id = points_begin; point_id < points_end; ++point_id) slots_next[point_id].store(0, std::memory_order_relaxed);
+	});
+	task_pool.parallelFor(0, num_corners, [&](size_t corners_begin, size_t corners_end)
+	{
+		for(size_t corner = corners_begin; corner < corners_end; ++corner) slots_next[getFaceVertexIndex(corner / 3, corner % 3)].fetch_add(1, std::memory_order_relaxed);
+	});
+	PointCorners point_corners;
+	point_corners.offsets_.resize(num_points + 1);
+	point_corners.offsets_[0] = 0;
+	for(size_t point_id = 0; point_id < num_points; ++point_id)
+	{
+		point_corners.offsets_[point_id + 1] = point_corners.offsets_[point_id] + slots_next[point_id].load(std::memory_order_relaxed);
+		slots_next[point_id].store(point_corners.offsets_[point_id], std::memory_order_relaxed);
+	}
+	point_corners.corners_.resize(num_corners);
+	task_pool.parallelFor(0, num_corners, [&](size_t corners_begin, size_t corners_end)
+	{
+		for(size_t corner = corners_begin; corner < corners_end; ++corner) point_corners.corners_[slots_next[getFaceVertexIndex(corner / 3, corner % 3)].fetch_add(1, std::memory_order_relaxed)] = static_cast<uint32_t>(corner);
+	});
+	//With a single thread the corners are already scattered in face order
+	if(task_pool.numThreads() > 1) task_pool.parallelFor(0, num_points, [&](size_t points_begin, size_t points_end)
+	{
+		for(size_t point_id = points_begin; point_id < points_end; ++point_id) std::sort(point_corners.corners_.begin() + point_corners.offsets_[point_id], point_corners.corners_.begin() + point_corners.offsets_[point_id + 1]);
+	});
+	return point_corners;
+}
+
+/*! Sine of the angle of the face at the corner, used to weight the face normal in the vertex normal */
+float MeshObject::getCornerAngleSine(uint32_t corner) const
 {
-	const size_t points_size = points_.size();
+	const size_t face_index = corner / 3;
+	const size_t vertex_number = corner % 3;
+	return getAngleSine({getFaceVertexIndex(face_index, vertex_number), getFaceVertexIndex(face_index, (vertex_number + 1) % 3), getFaceVertexIndex(face_index, (vertex_number + 2) % 3)});
+}
+
+/*! The points are processed in parallel, each one only writing its own normals and the normal indices of its own corners, so no locks are needed.
+	The normals created by the angle dependant smoothing are counted per point first and placed with a prefix sum, in the same order as if the
+	points were processed one after another */
+bool MeshObject::smoothNormals(Logger &logger, float angle, int num_threads)
+{
+	Timer timer;
+	timer.addEvent("smooth");
+	timer.start("smooth");
+	smooth_angle_ = angle;
+	unpackNormals();
+	const size_t points_size = numVertices();
+	const size_t num_faces = face_normals_.size();
+	//Without exported normals, the face vertices do not have normals until they are smoothed
+	if(normal_indices_.empty() && !hasNormalsExported()) normal_indices_.assign(3 * num_faces, no_index_);
 	normals_.resize(points_size, {0, 0, 0});
+	TaskPool task_pool(num_threads);
 
-	if(angle >= 180)
+	if(angle >= 180 && task_pool.numThreads() == 1)
 	{
-		for(auto &face : faces_)
+		//A single thread accumulates the face normals directly, in the same order as the points would gather them
+		for(size_t face_index = 0; face_index < num_faces; ++face_index)
 		{
-			const Vec3 n{face->Primitive::getGeometricNormal()};
-			const std::vector<int> vert_indices = face->getVerticesIndices();
-			const size_t num_indices = vert_indices.size();
-			for(size_t relative_vertex = 0; relative_vertex < num_indices; ++relative_vertex)
+			const Vec3 &n = face_normals_[face_index];
+			const std::array<uint32_t, 3> vert_indices {getFaceVertexIndex(face_index, 0), getFaceVertexIndex(face_index, 1), getFaceVertexIndex(face_index, 2)};
+			for(size_t relative_vertex = 0; relative_vertex < 3; ++relative_vertex)
 			{
-				normals_[vert_indices[relative_vertex]] += n * getAngleSine({vert_indices[relative_vertex], vert_indices[(relative_vertex + 1) % num_indices], vert_indices[(relative_vertex + 2) % num_indices]}, points_);
+				normals_[vert_indices[relative_vertex]] += n * getAngleSine({vert_indices[relative_vertex], vert_indices[(relative_vertex + 1) % 3], vert_indices[(relative_vertex + 2) % 3]});
 			}
-			face->setNormalsIndices(vert_indices);
 		}
-		for(auto &normal : normals_) normal.normalize();
+		for(size_t point_id = 0; point_id < points_size; ++point_id) normals_[point_id].normalize();
+		normal_indices_.clear();
 	}
-	else if(angle > 0.1f) // angle dependant smoothing
+	else if(angle >= 180)
 	{
-		const float angle_threshold = math::cos(math::degToRad(angle));
-		// create list of faces that include given vertex
-		std::vector<std::vector<FacePrimitive *>> points_faces(points_size);
-		std::vector<std::vector<float>> points_angles_sines(points_size);
-		for(auto &face : faces_)
+		const PointCorners point_corners = getPointCorners(task_pool);
+		task_pool.parallelFor(0, points_size, [&](size_t points_begin, size_t points_end)
 		{
-			const std::vector<int> vert_indices = face->getVerticesIndices();
-			const size_t num_indices = vert_indices.size();
-			for(size_t relative_vertex = 0; relative_vertex < num_indices; ++relative_vertex)
+			for(size_t point_id = points_begin; point_id < points_end; ++point_id)
 			{
-				points_angles_sines[vert_indices[relative_vertex]].push_back(getAngleSine({vert_indices[relative_vertex], vert_indices[(relative_vertex + 1) % num_indices], vert_indices[(relative_vertex + 2) % num_indices]}, points_));
-				points_faces[vert_indices[relative_vertex]].push_back(face.get());
+				Vec3 &normal = normals_[point_id];
+				for(uint32_t slot = point_corners.offsets_[point_id]; slot < point_corners.offsets_[point_id + 1]; ++slot)
+				{
+					const uint32_t corner = point_corners.corners_[slot];
+					normal += face_normals_[corner / 3] * getCornerAngleSine(corner);
+				}
+				normal.normalize();
 			}
-		}
-		for(size_t point_id = 0; point_id < points_size; ++point_id)
+		});
+		//The face vertices use the normals of their points
+		normal_indices_.clear();
+	}
+	else if(angle > 0.1f) // angle dependant smoothing
+	{
+		const float angle_threshold = math::cos(math::degToRad(angle));
+		normal_indices_.resize(3 * num_faces);
+		const PointCorners point_corners = getPointCorners(task_pool);
+		const size_t num_corners = point_corners.corners_.size();
+		//Arrays with an element per slot of the CSR layout. The normals of each point are stored in the first of its slots
+		std::vector<float> slot_angles_sines(num_corners);
+		std::vector<Vec3> slot_normals(num_corners);
+		std::vector<uint32_t> slot_normal_ids(num_corners);
+		std::vector<uint32_t> points_first_normal(points_size + 1);
+		task_pool.parallelFor(0, points_size, [&](size_t points_begin, size_t points_end)
 		{
-			int j = 0;
-			std::vector<Vec3> vertex_normals;
-			std::vector<int> vertex_normals_indices;
-			for(const auto &point_face : points_faces[point_id])
+			for(size_t point_id = points_begin; point_id < points_end; ++point_id)
 			{
-				bool smooth = false;
-				// calculate vertex normal for face
-				const Vec3 face_normal{point_face->Primitive::getGeometricNormal()};
-				Vec3 vertex_normal{face_normal * points_angles_sines[point_id][j]};
-				int k = 0;
-				for(const auto &point_face_2 : points_faces[point_id])
-				{
-					if(point_face == point_face_2)
-					{
-						k++;
-						continue;
-					}
-					const Vec3 face_2_normal{point_face_2->Primitive::getGeometricNormal()};
-					if((face_normal * face_2_normal) > angle_threshold)
-					{
-						smooth = true;
-						vertex_normal += face_2_normal * points_angles_sines[point_id][k];
-					}
-					k++;
-				}
-				int normal_idx = -1;
-				if(smooth)
+				const uint32_t slots_begin = point_corners.offsets_[point_id];
+				const uint32_t slots_end = point_corners.offsets_[point_id + 1];
+				for(uint32_t slot = slots_begin; slot < slots_end; ++slot) slot_angles_sines[slot] = getCornerAngleSine(point_corners.corners_[slot]);
+				uint32_t num_point_normals = 0;
+				for(uint32_t slot = slots_begin; slot < slots_end; ++slot)
 				{
-					vertex_normal.normalize();
-					//search for existing normal
-					const size_t num_vertex_normals = vertex_normals.size();
-					for(size_t vertex_normal_id = 0; vertex_normal_id < num_vertex_normals; ++vertex_normal_id)
+					bool smooth = false;
+					// calculate vertex normal for face
+					const uint32_t point_face = point_corners.corners_[slot] / 3;
+					const Vec3 &face_normal = face_normals_[point_face];
+					Vec3 vertex_normal{face_normal * slot_angles_sines[slot]};
+					for(uint32_t slot_2 = slots_begin; slot_2 < slots_end; ++slot_2)
 					{
-						if(vertex_normal * vertex_normals[vertex_normal_id] > 0.999f)
+						const uint32_t point_face_2 = point_corners.corners_[slot_2] / 3;
+						if(point_face == point_face_2) continue;
+						const Vec3 &face_2_normal = face_normals_[point_face_2];
+						if((face_normal * face_2_normal) > angle_threshold)
 						{
-							normal_idx = vertex_normals_indices[vertex_normal_id];
-							break;
+							smooth = true;
+							vertex_normal += face_2_normal * slot_angles_sines[slot_2];
 						}
 					}
-					// create new if none found
-					if(normal_idx == -1)
-					{
-						normal_idx = normals_.size();
-						vertex_normals.push_back(vertex_normal);
-						vertex_normals_indices.push_back(normal_idx);
-						normals_.push_back(vertex_normal);
-					}
-				}
-				// set vertex normal to idx
-				const std::vector<int> vertices_indices = point_face->getVerticesIndices();
-				std::vector<int> normals_indices = point_face->getNormalsIndices();
-				bool smooth_ok = false;
-				const size_t num_vertices = vertices_indices.size();
-				for(size_t relative_vertex = 0; relative_vertex < num_vertices; ++relative_vertex)
-				{
-					if(vertices_indices[relative_vertex] == static_cast<int>(point_id))
+					uint32_t normal_id = no_index_;
+					if(smooth)
 					{
-						normals_indices[relative_vertex] = normal_idx;
-						smooth_ok = true;
-						break;
+						vertex_normal.normalize();
+						//search for existing normal
+						for(uint32_t point_normal_id = 0; point_normal_id < num_point_normals; ++point_normal_id)
+						{
+							if(vertex_normal * slot_normals[slots_begin + point_normal_id] > 0.999f)
+							{
+								normal_id = point_normal_id;
+								break;
+							}
+						}
+						// create new if none found
+						if(normal_id == no_index_)
+						{
+							normal_id = num_point_normals++;
+							slot_normals[slots_begin + normal_id] = vertex_normal;
+						}
 					}
+					slot_normal_ids[slot] = normal_id;
 				}
-				if(smooth_ok)
-				{
-					point_face->setNormalsIndices(normals_indices);
-					j++;
-				}
-				else
+				points_first_normal[point_id + 1] = num_point_normals;
+			}
+		});
+		points_first_normal[0] = static_cast<uint32_t>(normals_.size());
+		for(size_t point_id = 0; point_id < points_size; ++point_id) points_first_normal[point_id + 1] += points_first_normal[point_id];
+		normals_.resize(points_first_normal[points_size]);
+		task_pool.parallelFor(0, points_size, [&](size_t points_begin, size_t points_end)
+		{
+			for(size_t point_id = points_begin; point_id < points_end; ++point_id)
+			{
+				const uint32_t slots_begin = point_corners.offsets_[point_id];
+				const uint32_t first_normal = points_first_normal[point_id];
+				std::copy(slot_normals.begin() + slots_begin, slot_normals.begin() + slots_begin + (points_first_normal[point_id + 1] - first_normal), normals_.begin() + first_normal);
+				for(uint32_t slot = slots_begin; slot < point_corners.offsets_[point_id + 1]; ++slot)
 				{
-					logger.logError("Mesh smoothing error!");
-					return false;
+					// set vertex normal to idx
+					const uint32_t normal_id = slot_normal_ids[slot];
+					normal_indices_[point_corners.corners_[slot]] = normal_id == no_index_ ? no_index_ : first_normal + normal_id;
 				}
 			}
-		}
+		});
 	}
 	setSmooth(true);
+	if(compact_attributes_) packNormals();
+	timer.stop("smooth");
+	if(logger.isVerbose()) logger.logVerbose("MeshObject: '", getName(), "' normals smoothed with angle ", angle, " in ", timer.getTime("smooth"), "s (", num_faces, " faces, ", task_pool.numThreads(), " threads)");
+	return true;
+}
+
+bool MeshObject::updatePoints(Logger &logger, const std::vector<Point3> &points, int num_threads)
+{
+	if(external_points_)
+	{
+		logger.logError("MeshObject: '", getName(), "' cannot update the points of a mesh with external points");
+		return false;
+	}
+	if(points.size() != points_.size())
+	{
+		logger.logError("MeshObject: '", getName(), "' cannot update ", points.size(), " points, the mesh has ", points_.size(), " points");
+		return false;
+	}
+	if(!motion_points_.empty())
+	{
+		logger.logError("MeshObject: '", getName(), "' cannot update the points of a mesh with motion blur time steps");
+		return false;
+	}
+	points_ = points;
+	calculateNormals(num_threads);
+	if(smooth_angle_ >= 0.f)
+	{
+		//The smooth normals calculated from the old points are calculated again. Meshes with exported normals never reach this, as they are not smoothed
+		normals_.clear();
+		packed_normals_.clear();
+		return smoothNormals(logger, smooth_angle_, num_threads);
+	}
 	return true;
 }
 
@@ -27,9 +27,16 @@
 
 BEGIN_YAFARAY
 
-std::unique_ptr<const SurfacePoint> Primitive::getSurface(const RayDifferentials *ray_differentials, const Point3 &hit, const IntersectData &data, const Matrix4 *obj_to_world, const Camera *camera) const
+bool Primitive::getSurface(SurfacePoint &sp, const RayDifferentials *ray_differentials, const Point3 &hit, const IntersectData &data, const Matrix4 *obj_to_world, const Camera *camera) const
 {
-	return {};
+	return false;
+}
+
+Rgb Primitive::getShadowTransparency(const Point3 &hit, const IntersectData &data, const Vec3 &wo, const Matrix4 *obj_to_world, const Camera *camera) const
+{
+	SurfacePoint sp;
+	if(getSurface(sp, nullptr, hit, data, obj_to_world, camera)) return sp.getTransparency(wo, camera);
+	else return Rgb{1.f};
 }
 
 IntersectData Primitive::intersect(const Ray &ray, const Matrix4 *obj_to_world) const
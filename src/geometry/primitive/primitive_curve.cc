@@ -0,0 +1,336 @@
+/****************************************************************************
+ *      This is part of the libYafaRay package
+ *
+ *      This library is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU Lesser General Public
+ *      License as published by the Free Software Foundation; either
+ *      version 2.1 of the License, or (at your option) any later version.
+ *
+ *      This library is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *      Lesser General Public License for more details.
+ *
+ *      You should have received a copy of the GNU Lesser General Public
+ *      License along with this library; if not, write to the Free Software
+ *      Foundation,Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include "geometry/primitive/primitive_curve.h"
+#include "geometry/object/object_curve.h"
+#include "geometry/matrix4.h"
+#include "geometry/surface.h"
+#include "material/material.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+BEGIN_YAFARAY
+
+constexpr int CurvePrimitive::max_subdivisions_;
+
+const Material *CurvePrimitive::getMaterial() const
+{
+	return curve_object_.getMaterial();
+}
+
+const Object *CurvePrimitive::getObject() const
+{
+	return &curve_object_;
+}
+
+Visibility CurvePrimitive::getVisibility() const
+{
+	return curve_object_.getVisibility();
+}
+
+CurvePrimitive::ControlPoints CurvePrimitive::getControlPoints(const Matrix4 *obj_to_world) const
+{
+	const std::array<Point3, 4> points = curve_object_.getSegmentControlPoints(segment_);
+	ControlPoints control_points;
+	for(size_t i = 0; i < points.size(); ++i) control_points[i] = Vec3{obj_to_world ? (*obj_to_world) * points[i] : points[i]};
+	return control_points;
+}
+
+/*! With a transform, the widths are scaled by the largest scaling of its axes */
+std::array<float, 2> CurvePrimitive::getWidths(const Matrix4 *obj_to_world) const
+{
+	std::array<float, 2> widths = curve_object_.getSegmentWidths(segment_);
+	if(obj_to_world)
+	{
+		const float scale = std::max({((*obj_to_world) * Vec3{1.f, 0.f, 0.f}).length(), ((*obj_to_world) * Vec3{0.f, 1.f, 0.f}).length(), ((*obj_to_world) * Vec3{0.f, 0.f, 1.f}).length()});
+		for(float &width : widths) width *= scale;
+	}
+	return widths;
+}
+
+Bound CurvePrimitive::getBound(const Matrix4 *obj_to_world) const
+{
+	const ControlPoints control_points = getControlPoints(obj_to_world);
+	const std::array<float, 2> widths = getWidths(obj_to_world);
+	Vec3 min_point{control_points[0]}, max_point{control_points[0]};
+	for(size_t i = 1; i < control_points.size(); ++i)
+	{
+		for(size_t axis = 0; axis < 3; ++axis)
+		{
+			min_point[axis] = std::min(min_point[axis], control_points[i][axis]);
+			max_point[axis] = std::max(max_point[axis], control_points[i][axis]);
+		}
+	}
+	//The curve is inside the convex hull of its control points
+	const Vec3 half_width{0.5f * std::max(widths[0], widths[1])};
+	return {Point3{min_point - half_width}, Point3{max_point + half_width}};
+}
+
+IntersectData CurvePrimitive::intersect(const Ray &ray, const Matrix4 *obj_to_world) const
+{
+	const float dir_length = ray.dir_.length();
+	if(dir_length == 0.f) return {};
+	const ControlPoints control_points = getControlPoints(obj_to_world);
+	const std::array<float, 2> widths = getWidths(obj_to_world);
+	//Control points in the coordinate system of the ray, which starts at the origin and goes along the z axis
+	const Vec3 dir_z{ray.dir_ / dir_length};
+	Vec3 dir_x, dir_y;
+	std::tie(dir_x, dir_y) = Vec3::createCoordsSystem(dir_z);
+	ControlPoints control_points_ray;
+	for(size_t i = 0; i < control_points.size(); ++i)
+	{
+		const Vec3 offset{control_points[i] - Vec3{ray.from_}};
+		control_points_ray[i] = {offset * dir_x, offset * dir_y, offset * dir_z};
+	}
+	const float max_width = std::max(widths[0], widths[1]);
+	if(outsideRay(control_points_ray, 0.5f * max_width, std::numeric_limits<float>::infinity())) return {};
+	//Subdivisions needed so the curve pieces are close enough to straight lines, from the second differences of the control points
+	float second_difference = 0.f;
+	for(size_t i = 0; i < 2; ++i)
+	{
+		for(size_t axis = 0; axis < 3; ++axis)
+		{
+			second_difference = std::max(second_difference, std::abs(control_points_ray[i][axis] - 2.f * control_points_ray[i + 1][axis] + control_points_ray[i + 2][axis]));
+		}
+	}
+	const float epsilon = 0.05f * max_width;
+	int max_depth = 0;
+	if(second_difference > 0.f && epsilon > 0.f)
+	{
+		const float depth = std::log2(1.41421356237f * 6.f * second_difference / (8.f * epsilon)) / 2.f;
+		if(depth > 0.f) max_depth = static_cast<int>(std::min(depth, static_cast<float>(max_subdivisions_)));
+	}
+	float z_hit = std::numeric_limits<float>::infinity();
+	float u_hit = 0.f;
+	if(!intersectRecursive(control_points_ray, widths, 0.f, 1.f, max_depth, z_hit, u_hit)) return {};
+	IntersectData intersect_data;
+	intersect_data.hit_ = true;
+	intersect_data.t_hit_ = z_hit / dir_length;
+	intersect_data.barycentric_u_ = u_hit;
+	//Orientation of the ribbon, facing the ray, and position of the hit across its width
+	Vec3 derivative;
+	const Vec3 curve_point{evalBezier(control_points, u_hit, &derivative)};
+	const Vec3 tangent{derivative.normalize()};
+	const auto tangent_coords{Vec3::createCoordsSystem(tangent)};
+	Vec3 facing{(dir_z * tangent) * tangent - dir_z};
+	if(facing.lengthSqr() > 0.f) facing.normalize();
+	else facing = tangent_coords.first;
+	const Vec3 hit_offset{Vec3{ray.from_} + intersect_data.t_hit_ * ray.dir_ - curve_point};
+	const float hit_width = widths[0] + u_hit * (widths[1] - widths[0]);
+	intersect_data.barycentric_v_ = std::min(std::max(0.5f + (hit_offset * (tangent ^ facing)) / hit_width, 0.f), 1.f);
+	intersect_data.barycentric_w_ = std::atan2(facing * tangent_coords.second, facing * tangent_coords.first);
+	intersect_data.time_ = ray.time_;
+	return intersect_data;
+}
+
+/*! The ray is in the origin going along the z axis, the control points are in the ray coordinate system */
+bool CurvePrimitive::intersectRecursive(const ControlPoints &control_points, const std::array<float, 2> &widths, float u_start, float u_end, int depth, float &z_hit, float &u_hit)
+{
+	if(depth > 0)
+	{
+		const std::array<Vec3, 7> control_points_split = splitBezier(control_points);
+		const std::array<float, 3> u {{u_start, 0.5f * (u_start + u_end), u_end}};
+		bool hit = false;
+		for(size_t half = 0; half < 2; ++half)
+		{
+			const ControlPoints control_points_half {{control_points_split[3 * half], control_points_split[3 * half + 1], control_points_split[3 * half + 2], control_points_split[3 * half + 3]}};
+			//The width changes linearly along the curve, so the largest one is at one of the ends
+			const float half_width = 0.5f * std::max(widths[0] + u[half] * (widths[1] - widths[0]), widths[0] + u[half + 1] * (widths[1] - widths[0]));
+			if(outsideRay(control_points_half, half_width, z_hit)) continue;
+			if(intersectRecursive(control_points_half, widths, u[half], u[half + 1], depth - 1, z_hit, u_hit)) hit = true;
+		}
+		return hit;
+	}
+	//The curve piece is intersected as a straight line. First the ray is tested against the lines perpendicular to the curve at its ends, so consecutive pieces do not overlap
+	const float edge_start = (control_points[1].y() - control_points[0].y()) * -control_points[0].y() + control_points[0].x() * (control_points[0].x() - control_points[1].x());
+	if(edge_start < 0.f) return false;
+	const float edge_end = (control_points[2].y() - control_points[3].y()) * -control_points[3].y() + control_points[3].x() * (control_points[3].x() - control_points[2].x());
+	if(edge_end < 0.f) return false;
+	//Parameter of the point in the line closest to the ray
+	const float segment_x = control_points[3].x() - control_points[0].x();
+	const float segment_y = control_points[3].y() - control_points[0].y();
+	const float denominator = segment_x * segment_x + segment_y * segment_y;
+	if(denominator == 0.f) return false;
+	const float w = -(control_points[0].x() * segment_x + control_points[0].y() * segment_y) / denominator;
+	const float u = std::min(std::max(u_start + w * (u_end - u_start), u_start), u_end);
+	const float hit_width = widths[0] + u * (widths[1] - widths[0]);
+	const Vec3 curve_point{evalBezier(control_points, std::min(std::max(w, 0.f), 1.f), nullptr)};
+	if(curve_point.x() * curve_point.x() + curve_point.y() * curve_point.y() > 0.25f * hit_width * hit_width) return false;
+	//Hits closer to the ray origin than the strand width are discarded, as they would be the strand intersecting the rays leaving its own surface
+	if(curve_point.z() < hit_width || curve_point.z() >= z_hit) return false;
+	z_hit = curve_point.z();
+	u_hit = u;
+	return true;
+}
+
+/*! Checks if the bound of the curve (in the ray coordinate system) enlarged by its half width misses the ray between the origin and z_max */
+bool CurvePrimitive::outsideRay(const ControlPoints &control_points, float half_width, float z_max)
+{
+	Vec3 min_point{control_points[0]}, max_point{control_points[0]};
+	for(size_t i = 1; i < control_points.size(); ++i)
+	{
+		for(size_t axis = 0; axis < 3; ++axis)
+		{
+			min_point[axis] = std::min(min_point[axis], control_points[i][axis]);
+			max_point[axis] = std::max(max_point[axis], control_points[i][axis]);
+		}
+	}
+	return max_point.x() + half_width < 0.f || min_point.x() - half_width > 0.f || max_point.y() + half_width < 0.f || min_point.y() - half_width > 0.f || max_point.z() + half_width < 0.f || min_point.z() - half_width > z_max;
+}
+
+/*! De Casteljau evaluation. The derivative is with respect to the curve parameter u */
+Vec3 CurvePrimitive::evalBezier(const ControlPoints &control_points, float u, Vec3 *derivative)
+{
+	const std::array<Vec3, 3> control_points_1 {{
+		(1.f - u) * control_points[0] + u * control_points[1],
+		(1.f - u) * control_points[1] + u * control_points[2],
+		(1.f - u) * control_points[2] + u * control_points[3]
+	}};
+	const std::array<Vec3, 2> control_points_2 {{
+		(1.f - u) * control_points_1[0] + u * control_points_1[1],
+		(1.f - u) * control_points_1[1] + u * control_points_1[2]
+	}};
+	if(derivative)
+	{
+		const Vec3 difference{control_points_2[1] - control_points_2[0]};
+		if(difference.lengthSqr() > 0.f) *derivative = 3.f * difference;
+		else *derivative = control_points[3] - control_points[0];
+	}
+	return (1.f - u) * control_points_2[0] + u * control_points_2[1];
+}
+
+/*! Splits the curve in two halves, the control points of the first half are the first four returned and the ones of the second half are the last four */
+std::array<Vec3, 7> CurvePrimitive::splitBezier(const ControlPoints &control_points)
+{
+	return {{
+		control_points[0],
+		0.5f * (control_points[0] + control_points[1]),
+		0.25f * (control_points[0] + 2.f * control_points[1] + control_points[2]),
+		0.125f * (control_points[0] + 3.f * control_points[1] + 3.f * control_points[2] + control_points[3]),
+		0.25f * (control_points[1] + 2.f * control_points[2] + control_points[3]),
+		0.5f * (control_points[2] + control_points[3]),
+		control_points[3]
+	}};
+}
+
+/*! Returns the normal of the ribbon, facing the ray which hit it, and the direction across its width */
+std::pair<Vec3, Vec3> CurvePrimitive::ribbonFrame(const Vec3 &tangent, float ribbon_angle)
+{
+	const auto tangent_coords{Vec3::createCoordsSystem(tangent)};
+	const Vec3 facing{std::cos(ribbon_angle) * tangent_coords.first + std::sin(ribbon_angle) * tangent_coords.second};
+	return {facing, tangent ^ facing};
+}
+
+bool CurvePrimitive::getSurface(SurfacePoint &sp, const RayDifferentials *ray_differentials, const Point3 &hit, const IntersectData &intersect_data, const Matrix4 *obj_to_world, const Camera *camera) const
+{
+	fillSurface(sp, ray_differentials, hit, intersect_data, obj_to_world);
+	sp.mat_data_ = MaterialDataPtr(sp.material_->initBsdf(sp, camera));
+	return true;
+}
+
+Rgb CurvePrimitive::getShadowTransparency(const Point3 &hit, const IntersectData &intersect_data, const Vec3 &wo, const Matrix4 *obj_to_world, const Camera *camera) const
+{
+	SurfacePoint sp;
+	fillSurface(sp, nullptr, hit, intersect_data, obj_to_world);
+	return sp.material_->getShadowTransparency(sp, wo, camera);
+}
+
+void CurvePrimitive::fillSurface(SurfacePoint &sp, const RayDifferentials *ray_differentials, const Point3 &hit, const IntersectData &intersect_data, const Matrix4 *obj_to_world) const
+{
+	const ControlPoints control_points = getControlPoints(obj_to_world);
+	const std::array<float, 2> widths = getWidths(obj_to_world);
+	const float u = intersect_data.barycentric_u_;
+	Vec3 derivative;
+	evalBezier(control_points, u, &derivative);
+	const Vec3 tangent{Vec3{derivative}.normalize()};
+	Vec3 facing, side;
+	std::tie(facing, side) = ribbonFrame(tangent, intersect_data.barycentric_w_);
+	sp.intersect_data_ = intersect_data;
+	sp.ng_ = facing;
+	if(curve_object_.getStrandGeometry() == CurveObject::StrandGeometry::Round)
+	{
+		//Normal of a cylinder around the curve at the position of the hit across the width
+		const float side_position = 2.f * intersect_data.barycentric_v_ - 1.f;
+		sp.n_ = math::sqrt(std::max(0.f, 1.f - side_position * side_position)) * facing + side_position * side;
+		sp.n_.normalize();
+	}
+	else sp.n_ = sp.ng_;
+	if(curve_object_.hasOrco())
+	{
+		sp.orco_p_ = (1.f - u) * curve_object_.getOrcoVertex(segment_) + u * curve_object_.getOrcoVertex(segment_ + 1);
+		sp.has_orco_ = true;
+	}
+	else
+	{
+		sp.orco_p_ = hit;
+		sp.has_orco_ = false;
+	}
+	sp.orco_ng_ = sp.ng_;
+	//Same mapping as the triangulated strands, with both texture coordinates going from 0 to 1 along the whole strand
+	const int num_segments = curve_object_.numSegments();
+	sp.u_ = sp.v_ = (static_cast<float>(segment_) + u) / num_segments;
+	sp.has_uv_ = true;
+	//Copy original dPdU and dPdV before normalization to the "absolute" dPdU and dPdV (for mipmap calculations)
+	sp.dp_du_abs_ = derivative * static_cast<float>(num_segments);
+	sp.dp_dv_abs_ = side * (widths[0] + u * (widths[1] - widths[0]));
+	sp.dp_du_ = tangent;
+	sp.dp_dv_ = side;
+	sp.object_ = &curve_object_;
+	sp.light_ = curve_object_.getLight();
+	sp.prim_num_ = segment_;
+	sp.p_ = hit;
+	//The shading coordinate system follows the strand, for anisotropic materials
+	sp.nu_ = tangent;
+	sp.nv_ = sp.n_ ^ tangent;
+	sp.ds_du_ = {sp.nu_ * sp.dp_du_, sp.nv_ * sp.dp_du_, sp.n_ * sp.dp_du_};
+	sp.ds_dv_ = {sp.nu_ * sp.dp_dv_, sp.nv_ * sp.dp_dv_, sp.n_ * sp.dp_dv_};
+	sp.material_ = curve_object_.getMaterial();
+	sp.setRayDifferentials(ray_differentials);
+}
+
+/*! Approximated as the length of the control polygon multiplied by the average width */
+float CurvePrimitive::surfaceArea(const Matrix4 *obj_to_world) const
+{
+	const ControlPoints control_points = getControlPoints(obj_to_world);
+	const std::array<float, 2> widths = getWidths(obj_to_world);
+	float length = 0.f;
+	for(size_t i = 1; i < control_points.size(); ++i) length += (control_points[i] - control_points[i - 1]).length();
+	return length * 0.5f * (widths[0] + widths[1]);
+}
+
+/*! The ribbon faces the incoming rays, so there is no single geometric normal. An arbitrary normal perpendicular to the curve is returned */
+Vec3 CurvePrimitive::getGeometricNormal(const Matrix4 *obj_to_world, float u, float v) const
+{
+	Vec3 derivative;
+	evalBezier(getControlPoints(obj_to_world), u, &derivative);
+	return Vec3::createCoordsSystem(derivative.normalize()).first;
+}
+
+std::pair<Point3, Vec3> CurvePrimitive::sample(float s_1, float s_2, const Matrix4 *obj_to_world) const
+{
+	const std::array<float, 2> widths = getWidths(obj_to_world);
+	Vec3 derivative;
+	const Vec3 curve_point{evalBezier(getControlPoints(obj_to_world), s_1, &derivative)};
+	Vec3 normal, side;
+	std::tie(normal, side) = ribbonFrame(derivative.normalize(), 0.f);
+	const float width = widths[0] + s_1 * (widths[1] - widths[0]);
+	return {Point3{curve_point + ((s_2 - 0.5f) * width) * side}, normal};
+}
+
+END_YAFARAY
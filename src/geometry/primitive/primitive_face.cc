@@ -24,28 +24,42 @@
 
 BEGIN_YAFARAY
 
-FacePrimitive::FacePrimitive(const std::vector<int> &vertices_indices, const std::vector<int> &vertices_uv_indices, const MeshObject &mesh_object) : base_mesh_object_(mesh_object), vertices_(vertices_indices), vertex_normals_(vertices_indices.size(), -1), vertex_uvs_(vertices_uv_indices)
+constexpr size_t FacePrimitive::num_vertices_;
+
+const Material *FacePrimitive::getMaterial() const
+{
+	return base_mesh_object_.getFaceMaterial(face_index_);
+}
+
+const Object *FacePrimitive::getObject() const
+{
+	return &base_mesh_object_;
+}
+
+Visibility FacePrimitive::getVisibility() const
 {
+	return base_mesh_object_.getVisibility();
 }
 
 Point3 FacePrimitive::getVertex(size_t vertex_number, const Matrix4 *obj_to_world) const
 {
-	const Point3 point{base_mesh_object_.getVertex(vertices_[vertex_number])};
+	const Point3 point{base_mesh_object_.getVertex(base_mesh_object_.getFaceVertexIndex(face_index_, vertex_number))};
 	if(obj_to_world) return (*obj_to_world) * point;
 	else return point;
 }
 
 Point3 FacePrimitive::getOrcoVertex(size_t vertex_number) const
 {
-	if(base_mesh_object_.hasOrco()) return base_mesh_object_.getOrcoVertex(vertices_[vertex_number]);
+	if(base_mesh_object_.hasOrco()) return base_mesh_object_.getOrcoVertex(base_mesh_object_.getFaceVertexIndex(face_index_, vertex_number));
 	else return getVertex(vertex_number);
 }
 
 Vec3 FacePrimitive::getVertexNormal(size_t vertex_number, const Vec3 &surface_normal_world, const Matrix4 *obj_to_world) const
 {
-	if(vertex_normals_[vertex_number] >= 0)
+	const uint32_t normal_index = base_mesh_object_.getFaceNormalIndex(face_index_, vertex_number);
+	if(normal_index != MeshObject::no_index_)
 	{
-		const Vec3 vertex_normal{base_mesh_object_.getVertexNormal(vertex_normals_[vertex_number])};
+		const Vec3 vertex_normal{base_mesh_object_.getVertexNormal(normal_index)};
 		if(obj_to_world) return ((*obj_to_world) * vertex_normal).normalize();
 		else return vertex_normal;
 	}
@@ -54,15 +68,13 @@ Vec3 FacePrimitive::getVertexNormal(size_t vertex_number, const Vec3 &surface_no
 
 Uv FacePrimitive::getVertexUv(size_t vertex_number) const
 {
-	return base_mesh_object_.getUvValues()[vertex_uvs_[vertex_number]];
+	return base_mesh_object_.getUvValue(base_mesh_object_.getFaceUvIndex(face_index_, vertex_number));
 }
 
 std::vector<Point3> FacePrimitive::getVertices(const Matrix4 *obj_to_world) const
 {
-	const size_t num_vertices = vertices_.size();
-	std::vector<Point3> result(num_vertices);
-	//result.reserve(num_vertices);
-	for(size_t vert_num = 0; vert_num < num_vertices; ++vert_num)
+	std::vector<Point3> result(num_vertices_);
+	for(size_t vert_num = 0; vert_num < num_vertices_; ++vert_num)
 	{
 		result[vert_num] = getVertex(vert_num, obj_to_world);
 	}
@@ -71,10 +83,8 @@ std::vector<Point3> FacePrimitive::getVertices(const Matrix4 *obj_to_world) cons
 
 std::vector<Point3> FacePrimitive::getOrcoVertices() const
 {
-	const size_t num_vertices = vertices_.size();
-	std::vector<Point3> result(num_vertices);
-	//result.reserve(num_vertices);
-	for(size_t vert_num = 0; vert_num < num_vertices; ++vert_num)
+	std::vector<Point3> result(num_vertices_);
+	for(size_t vert_num = 0; vert_num < num_vertices_; ++vert_num)
 	{
 		result[vert_num] = getOrcoVertex(vert_num);
 	}
@@ -83,10 +93,8 @@ std::vector<Point3> FacePrimitive::getOrcoVertices() const
 
 std::vector<Vec3> FacePrimitive::getVerticesNormals(const Vec3 &surface_normal, const Matrix4 *obj_to_world) const
 {
-	const size_t num_vertices = vertices_.size();
-	std::vector<Vec3> result(num_vertices);
-	//result.reserve(num_vertices);
-	for(size_t vert_num = 0; vert_num < num_vertices; ++vert_num)
+	std::vector<Vec3> result(num_vertices_);
+	for(size_t vert_num = 0; vert_num < num_vertices_; ++vert_num)
 	{
 		result[vert_num] = getVertexNormal(vert_num, surface_normal, obj_to_world);
 	}
@@ -95,10 +103,8 @@ std::vector<Vec3> FacePrimitive::getVerticesNormals(const Vec3 &surface_normal,
 
 std::vector<Uv> FacePrimitive::getVerticesUvs() const
 {
-	const size_t num_vertices = vertices_.size();
-	std::vector<Uv> result(num_vertices);
-	//result.reserve(num_vertices);
-	for(size_t vert_num = 0; vert_num < num_vertices; ++vert_num)
+	std::vector<Uv> result(num_vertices_);
+	for(size_t vert_num = 0; vert_num < num_vertices_; ++vert_num)
 	{
 		result[vert_num] = getVertexUv(vert_num);
 	}
@@ -129,8 +135,9 @@ Bound FacePrimitive::getBound(const std::vector<Point3> &vertices)
 
 Vec3 FacePrimitive::getGeometricNormal(const Matrix4 *obj_to_world, float, float) const
 {
-	if(obj_to_world) return ((*obj_to_world) * normal_geometric_).normalize();
-	else return normal_geometric_;
+	const Vec3 &normal_geometric = base_mesh_object_.getFaceNormal(face_index_);
+	if(obj_to_world) return ((*obj_to_world) * normal_geometric).normalize();
+	else return normal_geometric;
 }
 
 END_YAFARAY
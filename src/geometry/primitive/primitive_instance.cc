@@ -27,11 +27,28 @@ BEGIN_YAFARAY
 
 Bound PrimitiveInstance::getBound(const Matrix4 *) const
 {
-	return base_primitive_->getBound(base_instance_.getObjToWorldMatrix());
+	Bound bound = base_primitive_->getBound(base_instance_.getObjToWorldMatrix());
+	const int num_time_steps = base_instance_.numTimeSteps();
+	for(int time_step = 1; time_step < num_time_steps; ++time_step) bound = Bound(bound, base_primitive_->getBound(&base_instance_.getObjToWorldMatrix()[time_step]));
+	return bound;
+}
+
+/*! The time steps of moving instances take precedence, in them the base primitive motion is enclosed by its whole frame time bound */
+int PrimitiveInstance::numTimeSteps() const
+{
+	if(hasMotion()) return base_instance_.numTimeSteps();
+	else return base_primitive_->numTimeSteps();
+}
+
+Bound PrimitiveInstance::getTimeStepBound(int time_step, const Matrix4 *) const
+{
+	if(hasMotion()) return base_primitive_->getBound(&base_instance_.getObjToWorldMatrix()[time_step]);
+	else return base_primitive_->getTimeStepBound(time_step, base_instance_.getObjToWorldMatrix());
 }
 
 bool PrimitiveInstance::intersectsBound(const ExBound &b, const Matrix4 *) const
 {
+	if(hasMotion()) return true;
 	return base_primitive_->intersectsBound(b, base_instance_.getObjToWorldMatrix());
 }
 
@@ -42,12 +59,38 @@ PolyDouble::ClipResultWithBound PrimitiveInstance::clipToBound(Logger &logger, c
 
 IntersectData PrimitiveInstance::intersect(const Ray &ray, const Matrix4 *) const
 {
+	if(hasMotion())
+	{
+		const Matrix4 obj_to_world {base_instance_.getObjToWorldMatrixAtTime(ray.time_)};
+		return base_primitive_->intersect(ray, &obj_to_world);
+	}
 	return base_primitive_->intersect(ray, base_instance_.getObjToWorldMatrix());
 }
 
-std::unique_ptr<const SurfacePoint> PrimitiveInstance::getSurface(const RayDifferentials *ray_differentials, const Point3 &hit, const IntersectData &intersect_data, const Matrix4 *obj_to_world, const Camera *camera) const
+bool PrimitiveInstance::getTriangleVertices(std::array<Point3, 3> &vertices, const Matrix4 *) const
+{
+	if(hasMotion()) return false;
+	return base_primitive_->getTriangleVertices(vertices, base_instance_.getObjToWorldMatrix());
+}
+
+bool PrimitiveInstance::getSurface(SurfacePoint &sp, const RayDifferentials *ray_differentials, const Point3 &hit, const IntersectData &intersect_data, const Matrix4 *obj_to_world, const Camera *camera) const
+{
+	if(hasMotion())
+	{
+		const Matrix4 obj_to_world_at_time {base_instance_.getObjToWorldMatrixAtTime(intersect_data.time_)};
+		return base_primitive_->getSurface(sp, ray_differentials, hit, intersect_data, &obj_to_world_at_time, camera);
+	}
+	return base_primitive_->getSurface(sp, ray_differentials, hit, intersect_data, base_instance_.getObjToWorldMatrix(), camera);
+}
+
+Rgb PrimitiveInstance::getShadowTransparency(const Point3 &hit_point, const IntersectData &intersect_data, const Vec3 &wo, const Matrix4 *, const Camera *camera) const
 {
-	return base_primitive_->getSurface(ray_differentials, hit, intersect_data, base_instance_.getObjToWorldMatrix(), camera);
+	if(hasMotion())
+	{
+		const Matrix4 obj_to_world_at_time {base_instance_.getObjToWorldMatrixAtTime(intersect_data.time_)};
+		return base_primitive_->getShadowTransparency(hit_point, intersect_data, wo, &obj_to_world_at_time, camera);
+	}
+	return base_primitive_->getShadowTransparency(hit_point, intersect_data, wo, base_instance_.getObjToWorldMatrix(), camera);
 }
 
 float PrimitiveInstance::surfaceArea(const Matrix4 *) const
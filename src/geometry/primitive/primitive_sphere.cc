@@ -77,30 +77,30 @@ IntersectData SpherePrimitive::intersect(const Ray &ray, const Matrix4 *obj_to_w
 	IntersectData intersect_data;
 	intersect_data.hit_ = true;
 	intersect_data.t_hit_ = sol;
+	intersect_data.time_ = ray.time_;
 	return intersect_data;
 }
 
-std::unique_ptr<const SurfacePoint> SpherePrimitive::getSurface(const RayDifferentials *ray_differentials, const Point3 &hit, const IntersectData &intersect_data, const Matrix4 *obj_to_world, const Camera *camera) const
+bool SpherePrimitive::getSurface(SurfacePoint &sp, const RayDifferentials *ray_differentials, const Point3 &hit, const IntersectData &intersect_data, const Matrix4 *obj_to_world, const Camera *camera) const
 {
-	auto sp = std::unique_ptr<SurfacePoint>(new SurfacePoint);
-	sp->intersect_data_ = intersect_data;
+	sp.intersect_data_ = intersect_data;
 	Vec3 normal{hit - center_};
-	sp->orco_p_ = static_cast<Point3>(normal);
+	sp.orco_p_ = static_cast<Point3>(normal);
 	normal.normalize();
-	sp->material_ = material_->get();
-	sp->object_ = &base_object_;
-	sp->n_ = normal;
-	sp->ng_ = normal;
-	//sp->origin = (void*)this;
-	sp->has_orco_ = true;
-	sp->p_ = hit;
-	std::tie(sp->nu_, sp->nv_) = Vec3::createCoordsSystem(sp->n_);
-	sp->u_ = std::atan2(normal.y(), normal.x()) * math::div_1_by_pi + 1;
-	sp->v_ = 1.f - math::acos(normal.z()) * math::div_1_by_pi;
-	sp->light_ = nullptr;
-	sp->setRayDifferentials(ray_differentials);
-	sp->mat_data_ = std::shared_ptr<const MaterialData>(sp->material_->initBsdf(*sp, camera));
-	return sp;
+	sp.material_ = material_->get();
+	sp.object_ = &base_object_;
+	sp.n_ = normal;
+	sp.ng_ = normal;
+	//sp.origin = (void*)this;
+	sp.has_orco_ = true;
+	sp.p_ = hit;
+	std::tie(sp.nu_, sp.nv_) = Vec3::createCoordsSystem(sp.n_);
+	sp.u_ = std::atan2(normal.y(), normal.x()) * math::div_1_by_pi + 1;
+	sp.v_ = 1.f - math::acos(normal.z()) * math::div_1_by_pi;
+	sp.light_ = nullptr;
+	sp.setRayDifferentials(ray_differentials);
+	sp.mat_data_ = MaterialDataPtr(sp.material_->initBsdf(sp, camera));
+	return true;
 }
 
 float SpherePrimitive::surfaceArea(const Matrix4 *obj_to_world) const
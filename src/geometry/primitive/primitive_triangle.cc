@@ -31,11 +31,6 @@
 
 BEGIN_YAFARAY
 
-TrianglePrimitive::TrianglePrimitive(const std::vector<int> &vertices_indices, const std::vector<int> &vertices_uv_indices, const MeshObject &mesh_object) : FacePrimitive(vertices_indices, vertices_uv_indices, mesh_object)
-{
-	calculateGeometricNormal();
-}
-
 IntersectData TrianglePrimitive::intersect(const Ray &ray, const Matrix4 *obj_to_world) const
 {
 	return TrianglePrimitive::intersect(ray, { getVertex(0, obj_to_world), getVertex(1, obj_to_world), getVertex(2, obj_to_world) });
@@ -43,31 +38,15 @@ IntersectData TrianglePrimitive::intersect(const Ray &ray, const Matrix4 *obj_to
 
 IntersectData TrianglePrimitive::intersect(const Ray &ray, const std::array<Point3, 3> &vertices)
 {
-	//Tomas Moller and Ben Trumbore ray intersection scheme
 	const Vec3 edge_1{vertices[1] - vertices[0]};
 	const Vec3 edge_2{vertices[2] - vertices[0]};
-	const float epsilon = 0.1f * min_raydist_global * std::max(edge_1.length(), edge_2.length());
-	const Vec3 pvec{ray.dir_ ^ edge_2};
-	const float det = edge_1 * pvec;
-	if(det > -epsilon && det < epsilon) return {};
-	const float inv_det = 1.f / det;
-	const Vec3 tvec{ray.from_ - vertices[0]};
-	const float u = (tvec * pvec) * inv_det;
-	if(u < 0.f || u > 1.f) return {};
-	const Vec3 qvec{tvec ^ edge_1};
-	const float v = (ray.dir_ * qvec) * inv_det;
-	if((v < 0.f) || ((u + v) > 1.f)) return {};
-	const float t = edge_2 * qvec * inv_det;
-	if(t < epsilon) return {};
-	IntersectData intersect_data;
-	intersect_data.hit_ = true;
-	intersect_data.t_hit_ = t;
-	//UV <-> Barycentric UVW relationship is not obvious, interesting explanation in: https://www.scratchapixel.com/lessons/3d-basic-rendering/ray-tracing-rendering-a-triangle/barycentric-coordinates
-	intersect_data.barycentric_u_ = 1.f - u - v;
-	intersect_data.barycentric_v_ = u;
-	intersect_data.barycentric_w_ = v;
-	intersect_data.time_ = ray.time_;
-	return intersect_data;
+	return intersect(ray, vertices[0], edge_1, edge_2, intersectEpsilon(edge_1, edge_2));
+}
+
+bool TrianglePrimitive::getTriangleVertices(std::array<Point3, 3> &vertices, const Matrix4 *obj_to_world) const
+{
+	vertices = { getVertex(0, obj_to_world), getVertex(1, obj_to_world), getVertex(2, obj_to_world) };
+	return true;
 }
 
 bool TrianglePrimitive::intersectsBound(const ExBound &ex_bound, const Matrix4 *obj_to_world) const
@@ -84,54 +63,68 @@ bool TrianglePrimitive::intersectsBound(const ExBound &ex_bound, const std::arra
 	return triBoxOverlap(ex_bound.center_, ex_bound.half_size_, t_points);
 }
 
-void TrianglePrimitive::calculateGeometricNormal()
+bool TrianglePrimitive::getSurface(SurfacePoint &sp, const RayDifferentials *ray_differentials, const Point3 &hit_point, const IntersectData &intersect_data, const Matrix4 *obj_to_world, const Camera *camera) const
+{
+	return getSurface(sp, *this, { getVertex(0, obj_to_world), getVertex(1, obj_to_world), getVertex(2, obj_to_world) }, Primitive::getGeometricNormal(obj_to_world), ray_differentials, hit_point, intersect_data, obj_to_world, camera);
+}
+
+Rgb TrianglePrimitive::getShadowTransparency(const Point3 &hit_point, const IntersectData &intersect_data, const Vec3 &wo, const Matrix4 *obj_to_world, const Camera *camera) const
+{
+	return getShadowTransparency(*this, { getVertex(0, obj_to_world), getVertex(1, obj_to_world), getVertex(2, obj_to_world) }, Primitive::getGeometricNormal(obj_to_world), hit_point, intersect_data, wo, obj_to_world, camera);
+}
+
+bool TrianglePrimitive::getSurface(SurfacePoint &sp, const FacePrimitive &face, const std::array<Point3, 3> &vertices, const Vec3 &normal_geometric, const RayDifferentials *ray_differentials, const Point3 &hit_point, const IntersectData &intersect_data, const Matrix4 *obj_to_world, const Camera *camera)
 {
-	normal_geometric_ = calculateNormal({ getVertex(0), getVertex(1), getVertex(2) });
+	fillSurface(sp, face, vertices, normal_geometric, ray_differentials, hit_point, intersect_data, obj_to_world);
+	sp.mat_data_ = MaterialDataPtr(sp.material_->initBsdf(sp, camera));
+	return true;
 }
 
-Vec3 TrianglePrimitive::calculateNormal(const std::array<Point3, 3> &vertices)
+Rgb TrianglePrimitive::getShadowTransparency(const FacePrimitive &face, const std::array<Point3, 3> &vertices, const Vec3 &normal_geometric, const Point3 &hit_point, const IntersectData &intersect_data, const Vec3 &wo, const Matrix4 *obj_to_world, const Camera *camera)
 {
-	return ((vertices[1] - vertices[0]) ^ (vertices[2] - vertices[0])).normalize();
+	SurfacePoint sp;
+	fillSurface(sp, face, vertices, normal_geometric, nullptr, hit_point, intersect_data, obj_to_world);
+	return sp.material_->getShadowTransparency(sp, wo, camera);
 }
 
-std::unique_ptr<const SurfacePoint> TrianglePrimitive::getSurface(const RayDifferentials *ray_differentials, const Point3 &hit_point, const IntersectData &intersect_data, const Matrix4 *obj_to_world, const Camera *camera) const
+void TrianglePrimitive::fillSurface(SurfacePoint &sp, const FacePrimitive &face, const std::array<Point3, 3> &vertices, const Vec3 &normal_geometric, const RayDifferentials *ray_differentials, const Point3 &hit_point, const IntersectData &intersect_data, const Matrix4 *obj_to_world)
 {
-	auto sp = std::unique_ptr<SurfacePoint>(new SurfacePoint);
-	sp->intersect_data_ = intersect_data;
-	sp->ng_ = Primitive::getGeometricNormal(obj_to_world);
+	const MeshObject &mesh_object = face.getMeshObject();
+	sp.intersect_data_ = intersect_data;
+	sp.ng_ = normal_geometric;
 	const float barycentric_u = intersect_data.barycentric_u_, barycentric_v = intersect_data.barycentric_v_, barycentric_w = intersect_data.barycentric_w_;
-	if(base_mesh_object_.isSmooth() || base_mesh_object_.hasNormalsExported())
+	if(mesh_object.isSmooth() || mesh_object.hasNormalsExported())
 	{
 		const std::array<Vec3, 3> v {
-			getVertexNormal(0, sp->ng_, obj_to_world),
-			getVertexNormal(1, sp->ng_, obj_to_world),
-			getVertexNormal(2, sp->ng_, obj_to_world)
+			face.getVertexNormal(0, sp.ng_, obj_to_world),
+			face.getVertexNormal(1, sp.ng_, obj_to_world),
+			face.getVertexNormal(2, sp.ng_, obj_to_world)
 		};
-		sp->n_ = barycentric_u * v[0] + barycentric_v * v[1] + barycentric_w * v[2];
-		sp->n_.normalize();
+		sp.n_ = barycentric_u * v[0] + barycentric_v * v[1] + barycentric_w * v[2];
+		sp.n_.normalize();
 	}
-	else sp->n_ = sp->ng_;
-	if(base_mesh_object_.hasOrco())
+	else sp.n_ = sp.ng_;
+	if(mesh_object.hasOrco())
 	{
-		const std::array<Point3, 3> orco_p { getOrcoVertex(0), getOrcoVertex(1), getOrcoVertex(2) };
+		const std::array<Point3, 3> orco_p { face.getOrcoVertex(0), face.getOrcoVertex(1), face.getOrcoVertex(2) };
 
-		sp->orco_p_ = barycentric_u * orco_p[0] + barycentric_v * orco_p[1] + barycentric_w * orco_p[2];
-		sp->orco_ng_ = ((orco_p[1] - orco_p[0]) ^ (orco_p[2] - orco_p[0])).normalize();
-		sp->has_orco_ = true;
+		sp.orco_p_ = barycentric_u * orco_p[0] + barycentric_v * orco_p[1] + barycentric_w * orco_p[2];
+		sp.orco_ng_ = ((orco_p[1] - orco_p[0]) ^ (orco_p[2] - orco_p[0])).normalize();
+		sp.has_orco_ = true;
 	}
 	else
 	{
-		sp->orco_p_ = hit_point;
-		sp->has_orco_ = false;
-		sp->orco_ng_ = Primitive::getGeometricNormal();
+		sp.orco_p_ = hit_point;
+		sp.has_orco_ = false;
+		sp.orco_ng_ = face.Primitive::getGeometricNormal();
 	}
 	bool implicit_uv = true;
-	const std::array<Point3, 3> p { getVertex(0, obj_to_world), getVertex(1, obj_to_world), getVertex(2, obj_to_world) };
-	if(base_mesh_object_.hasUv())
+	const std::array<Point3, 3> &p = vertices;
+	if(mesh_object.hasUv())
 	{
-		const std::array<Uv, 3> uv { getVertexUv(0), getVertexUv(1), getVertexUv(2) };
-		sp->u_ = barycentric_u * uv[0].u_ + barycentric_v * uv[1].u_ + barycentric_w * uv[2].u_;
-		sp->v_ = barycentric_u * uv[0].v_ + barycentric_v * uv[1].v_ + barycentric_w * uv[2].v_;
+		const std::array<Uv, 3> uv { face.getVertexUv(0), face.getVertexUv(1), face.getVertexUv(2) };
+		sp.u_ = barycentric_u * uv[0].u_ + barycentric_v * uv[1].u_ + barycentric_w * uv[2].u_;
+		sp.v_ = barycentric_u * uv[0].v_ + barycentric_v * uv[1].v_ + barycentric_w * uv[2].v_;
 		// calculate dPdU and dPdV
 		const float du_1 = uv[1].u_ - uv[0].u_;
 		const float du_2 = uv[2].u_ - uv[0].u_;
@@ -143,36 +136,34 @@ std::unique_ptr<const SurfacePoint> TrianglePrimitive::getSurface(const RayDiffe
 			const float invdet = 1.f / det;
 			const Vec3 dp_1{p[1] - p[0]};
 			const Vec3 dp_2{p[2] - p[0]};
-			sp->dp_du_ = (dv_2 * dp_1 - dv_1 * dp_2) * invdet;
-			sp->dp_dv_ = (du_1 * dp_2 - du_2 * dp_1) * invdet;
+			sp.dp_du_ = (dv_2 * dp_1 - dv_1 * dp_2) * invdet;
+			sp.dp_dv_ = (du_1 * dp_2 - du_2 * dp_1) * invdet;
 			implicit_uv = false;
 		}
 	}
 	if(implicit_uv)
 	{
-		// implicit mapping, p0 = 0/0, p1 = 1/0, p2 = 0/1 => sp->u_ = barycentric_u, sp->v_ = barycentric_v; (arbitrary choice)
-		sp->dp_du_ = p[1] - p[0];
-		sp->dp_dv_ = p[2] - p[0];
-		sp->u_ = barycentric_u;
-		sp->v_ = barycentric_v;
+		// implicit mapping, p0 = 0/0, p1 = 1/0, p2 = 0/1 => sp.u_ = barycentric_u, sp.v_ = barycentric_v; (arbitrary choice)
+		sp.dp_du_ = p[1] - p[0];
+		sp.dp_dv_ = p[2] - p[0];
+		sp.u_ = barycentric_u;
+		sp.v_ = barycentric_v;
 	}
-	sp->has_uv_ = !implicit_uv;
+	sp.has_uv_ = !implicit_uv;
 	//Copy original dPdU and dPdV before normalization to the "absolute" dPdU and dPdV (for mipmap calculations)
-	sp->dp_du_abs_ = sp->dp_du_;
-	sp->dp_dv_abs_ = sp->dp_dv_;
-	sp->dp_du_.normalize();
-	sp->dp_dv_.normalize();
-	sp->object_ = &base_mesh_object_;
-	sp->light_ = base_mesh_object_.getLight();
-	sp->has_uv_ = base_mesh_object_.hasUv();
-	sp->prim_num_ = getSelfIndex();
-	sp->p_ = hit_point;
-	std::tie(sp->nu_, sp->nv_) = Vec3::createCoordsSystem(sp->n_);
-	calculateShadingSpace(*sp);
-	sp->material_ = getMaterial();
-	sp->setRayDifferentials(ray_differentials);
-	sp->mat_data_ = std::shared_ptr<const MaterialData>(sp->material_->initBsdf(*sp, camera));
-	return sp;
+	sp.dp_du_abs_ = sp.dp_du_;
+	sp.dp_dv_abs_ = sp.dp_dv_;
+	sp.dp_du_.normalize();
+	sp.dp_dv_.normalize();
+	sp.object_ = &mesh_object;
+	sp.light_ = mesh_object.getLight();
+	sp.has_uv_ = mesh_object.hasUv();
+	sp.prim_num_ = face.getSelfIndex();
+	sp.p_ = hit_point;
+	std::tie(sp.nu_, sp.nv_) = Vec3::createCoordsSystem(sp.n_);
+	calculateShadingSpace(sp);
+	sp.material_ = face.getMaterial();
+	sp.setRayDifferentials(ray_differentials);
 }
 
 void TrianglePrimitive::calculateShadingSpace(SurfacePoint &sp)
@@ -25,18 +25,12 @@
 
 BEGIN_YAFARAY
 
-BsTrianglePrimitive::BsTrianglePrimitive(const std::vector<int> &vertices_indices, const std::vector<int> &vertices_uv_indices, const MeshObject &mesh_object) : FacePrimitive(vertices_indices, vertices_uv_indices, mesh_object)
-{
-	//calculateGeometricNormal(); //FIXME?
-}
-
 IntersectData BsTrianglePrimitive::intersect(const Ray &ray, const Matrix4 *obj_to_world) const
 {
-	const std::vector<int> vertices_indices = getVerticesIndices();
 	const std::vector<Point3> &points = base_mesh_object_.getPoints();
-	const Point3 *an = &points[vertices_indices[0]];
-	const Point3 *bn = &points[vertices_indices[1]];
-	const Point3 *cn = &points[vertices_indices[2]];
+	const Point3 *an = &points[base_mesh_object_.getFaceVertexIndex(face_index_, 0)];
+	const Point3 *bn = &points[base_mesh_object_.getFaceVertexIndex(face_index_, 1)];
+	const Point3 *cn = &points[base_mesh_object_.getFaceVertexIndex(face_index_, 2)];
 	const float tc = 1.f - ray.time_;
 	const float b_1 = tc * tc, b_2 = 2.f * ray.time_ * tc, b_3 = ray.time_ * ray.time_;
 	const Point3 a{b_1 * an[0] + b_2 * an[1] + b_3 * an[2]};
@@ -67,11 +61,10 @@ IntersectData BsTrianglePrimitive::intersect(const Ray &ray, const Matrix4 *obj_
 
 Bound BsTrianglePrimitive::getBound(const Matrix4 *obj_to_world) const
 {
-	const std::vector<int> vertices_indices = getVerticesIndices();
 	const std::vector<Point3> &points = base_mesh_object_.getPoints();
-	const Point3 *an = &points[vertices_indices[0]];
-	const Point3 *bn = &points[vertices_indices[1]];
-	const Point3 *cn = &points[vertices_indices[2]];
+	const Point3 *an = &points[base_mesh_object_.getFaceVertexIndex(face_index_, 0)];
+	const Point3 *bn = &points[base_mesh_object_.getFaceVertexIndex(face_index_, 1)];
+	const Point3 *cn = &points[base_mesh_object_.getFaceVertexIndex(face_index_, 2)];
 	const Point3 amin {math::min(an[0].x(), an[1].x(), an[2].x()), math::min(an[0].y(), an[1].y(), an[2].y()), math::min(an[0].z(), an[1].z(), an[2].z()) };
 	const Point3 bmin {math::min(bn[0].x(), bn[1].x(), bn[2].x()), math::min(bn[0].y(), bn[1].y(), bn[2].y()), math::min(bn[0].z(), bn[1].z(), bn[2].z()) };
 	const Point3 cmin {math::min(cn[0].x(), cn[1].x(), cn[2].x()), math::min(cn[0].y(), cn[1].y(), cn[2].y()), math::min(cn[0].z(), cn[1].z(), cn[2].z()) };
@@ -83,14 +76,13 @@ Bound BsTrianglePrimitive::getBound(const Matrix4 *obj_to_world) const
 	return {l, h};
 }
 
-std::unique_ptr<const SurfacePoint> BsTrianglePrimitive::getSurface(const RayDifferentials *ray_differentials, const Point3 &hit, const IntersectData &intersect_data, const Matrix4 *obj_to_world, const Camera *camera) const
+bool BsTrianglePrimitive::getSurface(SurfacePoint &sp, const RayDifferentials *ray_differentials, const Point3 &hit, const IntersectData &intersect_data, const Matrix4 *obj_to_world, const Camera *camera) const
 {
 	// recalculating the points is not really the nicest solution...
-	const std::vector<int> vertices_indices = getVerticesIndices();
 	const std::vector<Point3> &points = base_mesh_object_.getPoints();
-	const Point3 *an = &points[vertices_indices[0]];
-	const Point3 *bn = &points[vertices_indices[1]];
-	const Point3 *cn = &points[vertices_indices[2]];
+	const Point3 *an = &points[base_mesh_object_.getFaceVertexIndex(face_index_, 0)];
+	const Point3 *bn = &points[base_mesh_object_.getFaceVertexIndex(face_index_, 1)];
+	const Point3 *cn = &points[base_mesh_object_.getFaceVertexIndex(face_index_, 2)];
 	const float time = intersect_data.time_;
 	const float tc = 1.f - time;
 	const float b_1 = tc * tc, b_2 = 2.f * time * tc, b_3 = time * time;
@@ -98,9 +90,8 @@ std::unique_ptr<const SurfacePoint> BsTrianglePrimitive::getSurface(const RayDif
 	const Point3 b{b_1 * bn[0] + b_2 * bn[1] + b_3 * bn[2]};
 	const Point3 c{b_1 * cn[0] + b_2 * cn[1] + b_3 * cn[2]};
 
-	auto sp = std::unique_ptr<SurfacePoint>(new SurfacePoint);
-	sp->intersect_data_ = intersect_data;
-	sp->ng_ = ((b - a) ^ (c - a)).normalize();
+	sp.intersect_data_ = intersect_data;
+	sp.ng_ = ((b - a) ^ (c - a)).normalize();
 	// the "u" and "v" in triangle intersection code are actually "v" and "w" when u=>p1, v=>p2, w=>p3
 	const float barycentric_u = intersect_data.barycentric_u_, barycentric_v = intersect_data.barycentric_v_, barycentric_w = intersect_data.barycentric_w_;
 
@@ -108,36 +99,35 @@ std::unique_ptr<const SurfacePoint> BsTrianglePrimitive::getSurface(const RayDif
 	/* if(mesh->is_smooth || mesh->normals_exported)
 	{
 		vector3d_t va(na>0? mesh->normals[na] : normal), vb(nb>0? mesh->normals[nb] : normal), vc(nc>0? mesh->normals[nc] : normal);
-		sp->N = u*va + v*vb + w*vc;
-		sp->N.normalize();
+		sp.N = u*va + v*vb + w*vc;
+		sp.N.normalize();
 	}
-	else  */sp->n_ = sp->ng_;
+	else  */sp.n_ = sp.ng_;
 
 	if(base_mesh_object_.hasOrco())
 	{
 		const std::vector<Point3> orco = getOrcoVertices();
-		sp->orco_p_ = barycentric_u * orco[0] + barycentric_v * orco[1] + barycentric_w * orco[2];
-		sp->orco_ng_ = ((orco[1] - orco[0]) ^ (orco[2] - orco[0])).normalize();
-		sp->has_orco_ = true;
+		sp.orco_p_ = barycentric_u * orco[0] + barycentric_v * orco[1] + barycentric_w * orco[2];
+		sp.orco_ng_ = ((orco[1] - orco[0]) ^ (orco[2] - orco[0])).normalize();
+		sp.has_orco_ = true;
 	}
 	else
 	{
-		sp->orco_p_ = hit;
-		sp->orco_ng_ = sp->ng_;
-		sp->has_orco_ = false;
+		sp.orco_p_ = hit;
+		sp.orco_ng_ = sp.ng_;
+		sp.has_orco_ = false;
 	}
 	if(base_mesh_object_.hasUv())
 	{
-		const int uvi_1 = vertex_uvs_[0], uvi_2 = vertex_uvs_[1], uvi_3 = vertex_uvs_[2];
-		const auto &it = base_mesh_object_.getUvValues().begin();
-		sp->u_ = barycentric_u * it[uvi_1].u_ + barycentric_v * it[uvi_2].u_ + barycentric_w * it[uvi_3].u_;
-		sp->v_ = barycentric_u * it[uvi_1].v_ + barycentric_v * it[uvi_2].v_ + barycentric_w * it[uvi_3].v_;
+		const std::vector<Uv> it = getVerticesUvs();
+		sp.u_ = barycentric_u * it[0].u_ + barycentric_v * it[1].u_ + barycentric_w * it[2].u_;
+		sp.v_ = barycentric_u * it[0].v_ + barycentric_v * it[1].v_ + barycentric_w * it[2].v_;
 
 		// calculate dPdU and dPdV
-		const float du_1 = it[uvi_1].u_ - it[uvi_3].u_;
-		const float du_2 = it[uvi_2].u_ - it[uvi_3].u_;
-		const float dv_1 = it[uvi_1].v_ - it[uvi_3].v_;
-		const float dv_2 = it[uvi_2].v_ - it[uvi_3].v_;
+		const float du_1 = it[0].u_ - it[2].u_;
+		const float du_2 = it[1].u_ - it[2].u_;
+		const float dv_1 = it[0].v_ - it[2].v_;
+		const float dv_2 = it[1].v_ - it[2].v_;
 		const float det = du_1 * dv_2 - dv_1 * du_2;
 
 		const std::vector<Point3> vert = getVertices();
@@ -146,54 +136,54 @@ std::unique_ptr<const SurfacePoint> BsTrianglePrimitive::getSurface(const RayDif
 			const float invdet = 1.f / det;
 			const Vec3 dp_1{vert[0] - vert[2]};
 			const Vec3 dp_2{vert[1] - vert[2]};
-			sp->dp_du_ = (dv_2 * invdet) * dp_1 - (dv_1 * invdet) * dp_2;
-			sp->dp_dv_ = (du_1 * invdet) * dp_2 - (du_2 * invdet) * dp_1;
+			sp.dp_du_ = (dv_2 * invdet) * dp_1 - (dv_1 * invdet) * dp_2;
+			sp.dp_dv_ = (du_1 * invdet) * dp_2 - (du_2 * invdet) * dp_1;
 		}
 		else
 		{
-			// implicit mapping, p0 = 0/0, p1 = 1/0, p2 = 0/1 => sp->u_ = barycentric_u, sp->v_ = barycentric_v; (arbitrary choice)
-			sp->dp_du_ = vert[1] - vert[0];
-			sp->dp_dv_ = vert[2] - vert[0];
-			sp->u_ = barycentric_u;
-			sp->v_ = barycentric_v;
+			// implicit mapping, p0 = 0/0, p1 = 1/0, p2 = 0/1 => sp.u_ = barycentric_u, sp.v_ = barycentric_v; (arbitrary choice)
+			sp.dp_du_ = vert[1] - vert[0];
+			sp.dp_dv_ = vert[2] - vert[0];
+			sp.u_ = barycentric_u;
+			sp.v_ = barycentric_v;
 		}
 	}
 	else
 	{
-		// implicit mapping, p0 = 0/0, p1 = 1/0, p2 = 0/1 => sp->u_ = barycentric_u, sp->v_ = barycentric_v; (arbitrary choice)
+		// implicit mapping, p0 = 0/0, p1 = 1/0, p2 = 0/1 => sp.u_ = barycentric_u, sp.v_ = barycentric_v; (arbitrary choice)
 		const std::vector<Point3> vert = getVertices();
-		sp->dp_du_ = vert[1] - vert[0];
-		sp->dp_dv_ = vert[2] - vert[0];
-		sp->u_ = barycentric_u;
-		sp->v_ = barycentric_v;
+		sp.dp_du_ = vert[1] - vert[0];
+		sp.dp_dv_ = vert[2] - vert[0];
+		sp.u_ = barycentric_u;
+		sp.v_ = barycentric_v;
 	}
 
 	//Copy original dPdU and dPdV before normalization to the "absolute" dPdU and dPdV (for mipmap calculations)
-	sp->dp_du_abs_ = sp->dp_du_;
-	sp->dp_dv_abs_ = sp->dp_dv_;
+	sp.dp_du_abs_ = sp.dp_du_;
+	sp.dp_dv_abs_ = sp.dp_dv_;
 
-	sp->dp_du_.normalize();
-	sp->dp_dv_.normalize();
+	sp.dp_du_.normalize();
+	sp.dp_dv_.normalize();
 
-	sp->material_ = material_->get();
-	sp->object_ = &base_mesh_object_;
-	sp->p_ = hit;
-	std::tie(sp->nu_, sp->nv_) = Vec3::createCoordsSystem(sp->n_);
+	sp.material_ = getMaterial();
+	sp.object_ = &base_mesh_object_;
+	sp.p_ = hit;
+	std::tie(sp.nu_, sp.nv_) = Vec3::createCoordsSystem(sp.n_);
 	// transform dPdU and dPdV in shading space
-	sp->ds_du_.x() = sp->nu_ * sp->dp_du_;
-	sp->ds_du_.y() = sp->nv_ * sp->dp_du_;
-	sp->ds_du_.z() = sp->n_ * sp->dp_du_;
-	sp->ds_dv_.x() = sp->nu_ * sp->dp_dv_;
-	sp->ds_dv_.y() = sp->nv_ * sp->dp_dv_;
-	sp->ds_dv_.z() = sp->n_ * sp->dp_dv_;
-	sp->light_ = base_mesh_object_.getLight();
-	sp->has_uv_ = base_mesh_object_.hasUv();
-	sp->prim_num_ = getSelfIndex();
-	std::tie(sp->nu_, sp->nv_) = Vec3::createCoordsSystem(sp->n_);
-	sp->material_ = getMaterial();
-	sp->setRayDifferentials(ray_differentials);
-	sp->mat_data_ = std::shared_ptr<const MaterialData>(sp->material_->initBsdf(*sp, camera));
-	return sp;
+	sp.ds_du_.x() = sp.nu_ * sp.dp_du_;
+	sp.ds_du_.y() = sp.nv_ * sp.dp_du_;
+	sp.ds_du_.z() = sp.n_ * sp.dp_du_;
+	sp.ds_dv_.x() = sp.nu_ * sp.dp_dv_;
+	sp.ds_dv_.y() = sp.nv_ * sp.dp_dv_;
+	sp.ds_dv_.z() = sp.n_ * sp.dp_dv_;
+	sp.light_ = base_mesh_object_.getLight();
+	sp.has_uv_ = base_mesh_object_.hasUv();
+	sp.prim_num_ = getSelfIndex();
+	std::tie(sp.nu_, sp.nv_) = Vec3::createCoordsSystem(sp.n_);
+	sp.material_ = getMaterial();
+	sp.setRayDifferentials(ray_differentials);
+	sp.mat_data_ = MaterialDataPtr(sp.material_->initBsdf(sp, camera));
+	return true;
 }
 
 END_YAFARAY
@@ -0,0 +1,112 @@
+/****************************************************************************
+ *      This is part of the libYafaRay package
+ *
+ *      This library is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU Lesser General Public
+ *      License as published by the Free Software Foundation; either
+ *      version 2.1 of the License, or (at your option) any later version.
+ *
+ *      This library is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *      Lesser General Public License for more details.
+ *
+ *      You should have received a copy of the GNU Lesser General Public
+ *      License along with this library; if not, write to the Free Software
+ *      Foundation,Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include "geometry/primitive/primitive_triangle_motion.h"
+#include "geometry/primitive/primitive_triangle.h"
+#include "geometry/object/object_mesh.h"
+#include "geometry/ray.h"
+#include "geometry/bound.h"
+#include "geometry/surface.h"
+#include "geometry/matrix4.h"
+
+BEGIN_YAFARAY
+
+int MotionTrianglePrimitive::numTimeSteps() const
+{
+	return base_mesh_object_.numTimeSteps();
+}
+
+std::array<Point3, 3> MotionTrianglePrimitive::getVerticesTimeStep(int time_step, const Matrix4 *obj_to_world) const
+{
+	std::array<Point3, 3> vertices;
+	for(size_t vertex_number = 0; vertex_number < 3; ++vertex_number)
+	{
+		vertices[vertex_number] = base_mesh_object_.getVertexTimeStep(base_mesh_object_.getFaceVertexIndex(face_index_, vertex_number), time_step);
+		if(obj_to_world) vertices[vertex_number] = (*obj_to_world) * vertices[vertex_number];
+	}
+	return vertices;
+}
+
+std::array<Point3, 3> MotionTrianglePrimitive::getVerticesAtTime(float time, const Matrix4 *obj_to_world) const
+{
+	std::array<Point3, 3> vertices;
+	for(size_t vertex_number = 0; vertex_number < 3; ++vertex_number)
+	{
+		vertices[vertex_number] = base_mesh_object_.getVertexAtTime(base_mesh_object_.getFaceVertexIndex(face_index_, vertex_number), time);
+		if(obj_to_world) vertices[vertex_number] = (*obj_to_world) * vertices[vertex_number];
+	}
+	return vertices;
+}
+
+IntersectData MotionTrianglePrimitive::intersect(const Ray &ray, const Matrix4 *obj_to_world) const
+{
+	const std::array<Point3, 3> vertices = getVerticesAtTime(ray.time_, obj_to_world);
+	const Vec3 edge_1{vertices[1] - vertices[0]};
+	const Vec3 edge_2{vertices[2] - vertices[0]};
+	return TrianglePrimitive::intersect(ray, vertices[0], edge_1, edge_2, TrianglePrimitive::intersectEpsilon(edge_1, edge_2));
+}
+
+/*! Bound of the triangle during the whole frame time */
+Bound MotionTrianglePrimitive::getBound(const Matrix4 *obj_to_world) const
+{
+	Bound bound = getTimeStepBound(0, obj_to_world);
+	const int num_time_steps = numTimeSteps();
+	for(int time_step = 1; time_step < num_time_steps; ++time_step) bound = Bound(bound, getTimeStepBound(time_step, obj_to_world));
+	return bound;
+}
+
+Bound MotionTrianglePrimitive::getTimeStepBound(int time_step, const Matrix4 *obj_to_world) const
+{
+	const std::array<Point3, 3> vertices = getVerticesTimeStep(time_step, obj_to_world);
+	return FacePrimitive::getBound({vertices.begin(), vertices.end()});
+}
+
+bool MotionTrianglePrimitive::getSurface(SurfacePoint &sp, const RayDifferentials *ray_differentials, const Point3 &hit_point, const IntersectData &intersect_data, const Matrix4 *obj_to_world, const Camera *camera) const
+{
+	const std::array<Point3, 3> vertices = getVerticesAtTime(intersect_data.time_, obj_to_world);
+	const Vec3 normal_geometric {((vertices[1] - vertices[0]) ^ (vertices[2] - vertices[0])).normalize()};
+	return TrianglePrimitive::getSurface(sp, *this, vertices, normal_geometric, ray_differentials, hit_point, intersect_data, obj_to_world, camera);
+}
+
+Rgb MotionTrianglePrimitive::getShadowTransparency(const Point3 &hit_point, const IntersectData &intersect_data, const Vec3 &wo, const Matrix4 *obj_to_world, const Camera *camera) const
+{
+	const std::array<Point3, 3> vertices = getVerticesAtTime(intersect_data.time_, obj_to_world);
+	const Vec3 normal_geometric {((vertices[1] - vertices[0]) ^ (vertices[2] - vertices[0])).normalize()};
+	return TrianglePrimitive::getShadowTransparency(*this, vertices, normal_geometric, hit_point, intersect_data, wo, obj_to_world, camera);
+}
+
+/*! The surface area and sampling of the triangle, used by mesh lights, are taken at the first time step */
+float MotionTrianglePrimitive::surfaceArea(const Matrix4 *obj_to_world) const
+{
+	const std::array<Point3, 3> vertices = getVerticesTimeStep(0, obj_to_world);
+	return 0.5f * ((vertices[1] - vertices[0]) ^ (vertices[2] - vertices[0])).length();
+}
+
+std::pair<Point3, Vec3> MotionTrianglePrimitive::sample(float s_1, float s_2, const Matrix4 *obj_to_world) const
+{
+	const std::array<Point3, 3> vertices = getVerticesTimeStep(0, obj_to_world);
+	const float su_1 = math::sqrt(s_1);
+	const float u = 1.f - su_1;
+	const float v = s_2 * su_1;
+	return {
+		u * vertices[0] + v * vertices[1] + (1.f - u - v) * vertices[2],
+		Primitive::getGeometricNormal(obj_to_world)
+	};
+}
+
+END_YAFARAY
@@ -35,8 +35,10 @@ void SurfacePoint::setRayDifferentials(const RayDifferentials *ray_differentials
 		const Vec3 ryv(ray_differentials->yfrom_);
 		const float ty = -((n_ * ryv) + d) / (n_ * ray_differentials->ydir_);
 		const Point3 py{ray_differentials->yfrom_ + ty * ray_differentials->ydir_};
-		differentials_ = std::unique_ptr<SurfaceDifferentials>(new SurfaceDifferentials{px - p_, py - p_});
+		differentials_ = {px - p_, py - p_};
+		has_differentials_ = true;
 	}
+	else has_differentials_ = false;
 }
 
 SurfacePoint SurfacePoint::blendSurfacePoints(SurfacePoint const &sp_1, SurfacePoint const &sp_2, float alpha)
@@ -49,31 +51,35 @@ SurfacePoint SurfacePoint::blendSurfacePoints(SurfacePoint const &sp_1, SurfaceP
 	result.dp_dv_ = math::lerp(sp_1.dp_dv_, sp_2.dp_dv_, alpha);
 	result.ds_du_ = math::lerp(sp_1.ds_du_, sp_2.ds_du_, alpha);
 	result.ds_dv_ = math::lerp(sp_1.ds_dv_, sp_2.ds_dv_, alpha);
-	if(sp_1.differentials_ && sp_2.differentials_)
+	if(sp_1.has_differentials_ && sp_2.has_differentials_)
 	{
-		result.differentials_ = std::unique_ptr<SurfaceDifferentials>(new SurfaceDifferentials{
-				math::lerp(sp_1.differentials_->dp_dx_, sp_2.differentials_->dp_dx_, alpha),
-				math::lerp(sp_1.differentials_->dp_dy_, sp_2.differentials_->dp_dy_, alpha)
-		}); //FIXME: should this std::max or std::min instead of lerp?
+		result.differentials_ = {
+				math::lerp(sp_1.differentials_.dp_dx_, sp_2.differentials_.dp_dx_, alpha),
+				math::lerp(sp_1.differentials_.dp_dy_, sp_2.differentials_.dp_dy_, alpha)
+		}; //FIXME: should this std::max or std::min instead of lerp?
 	}
-	else if(sp_1.differentials_)
+	else if(sp_2.has_differentials_)
 	{
-		result.differentials_ = std::unique_ptr<SurfaceDifferentials>(new SurfaceDifferentials{*sp_1.differentials_});
-	}
-	else if(sp_2.differentials_)
-	{
-		result.differentials_ = std::unique_ptr<SurfaceDifferentials>(new SurfaceDifferentials{*sp_2.differentials_});
+		result.differentials_ = sp_2.differentials_;
+		result.has_differentials_ = true;
 	}
 	return result;
 }
 
-std::unique_ptr<RayDifferentials> SurfacePoint::reflectedRay(const RayDifferentials *in_differentials, const Vec3 &in_dir, const Vec3 &out_dir) const
+void SurfacePoint::reflectedRay(const Ray &in_ray, Ray &out_ray) const
 {
-	if(!differentials_ || !in_differentials) return nullptr;
-	auto out_differentials = std::unique_ptr<RayDifferentials>(new RayDifferentials());
+	const RayDifferentials *in_differentials = in_ray.getDifferentials();
+	if(!has_differentials_ || !in_differentials)
+	{
+		out_ray.clearDifferentials();
+		return;
+	}
+	const Vec3 &in_dir = in_ray.dir_;
+	const Vec3 &out_dir = out_ray.dir_;
+	RayDifferentials out_differentials;
 	// Compute ray differential _rd_ for specular reflection
-	out_differentials->xfrom_ = p_ + differentials_->dp_dx_;
-	out_differentials->yfrom_ = p_ + differentials_->dp_dy_;
+	out_differentials.xfrom_ = p_ + differentials_.dp_dx_;
+	out_differentials.yfrom_ = p_ + differentials_.dp_dy_;
 	// Compute differential reflected directions
 	//	Normal dndx = bsdf->dgShading.dndu * bsdf->dgShading.dudx +
 	//				  bsdf->dgShading.dndv * bsdf->dgShading.dvdx;
@@ -83,18 +89,25 @@ std::unique_ptr<RayDifferentials> SurfacePoint::reflectedRay(const RayDifferenti
 	const Vec3 dwody{in_dir - in_differentials->ydir_};
 	const float d_d_ndx = (dwodx * n_); // + (out.dir * dndx);
 	const float d_d_ndy = (dwody * n_); // + (out.dir * dndy);
-	out_differentials->xdir_ = out_dir - dwodx + 2 * (/* (out.dir * sp.N) * dndx + */ d_d_ndx * n_);
-	out_differentials->ydir_ = out_dir - dwody + 2 * (/* (out.dir * sp.N) * dndy + */ d_d_ndy * n_);
-	return out_differentials;
+	out_differentials.xdir_ = out_dir - dwodx + 2 * (/* (out.dir * sp.N) * dndx + */ d_d_ndx * n_);
+	out_differentials.ydir_ = out_dir - dwody + 2 * (/* (out.dir * sp.N) * dndy + */ d_d_ndy * n_);
+	out_ray.setDifferentials(out_differentials);
 }
 
-std::unique_ptr<RayDifferentials> SurfacePoint::refractedRay(const RayDifferentials *in_differentials, const Vec3 &in_dir, const Vec3 &out_dir, float ior) const
+void SurfacePoint::refractedRay(const Ray &in_ray, Ray &out_ray, float ior) const
 {
-	if(!differentials_ || !in_differentials) return nullptr;
-	auto out_differentials = std::unique_ptr<RayDifferentials>(new RayDifferentials());
+	const RayDifferentials *in_differentials = in_ray.getDifferentials();
+	if(!has_differentials_ || !in_differentials)
+	{
+		out_ray.clearDifferentials();
+		return;
+	}
+	const Vec3 &in_dir = in_ray.dir_;
+	const Vec3 &out_dir = out_ray.dir_;
+	RayDifferentials out_differentials;
 	//RayDifferential rd(p, wi);
-	out_differentials->xfrom_ = p_ + differentials_->dp_dx_;
-	out_differentials->yfrom_ = p_ + differentials_->dp_dy_;
+	out_differentials.xfrom_ = p_ + differentials_.dp_dx_;
+	out_differentials.yfrom_ = p_ + differentials_.dp_dy_;
 	//if (Dot(wo, n) < 0) eta = 1.f / eta;
 	//Normal dndx = bsdf->dgShading.dndu * bsdf->dgShading.dudx + bsdf->dgShading.dndv * bsdf->dgShading.dvdx;
 	//Normal dndy = bsdf->dgShading.dndu * bsdf->dgShading.dudy + bsdf->dgShading.dndv * bsdf->dgShading.dvdy;
@@ -105,14 +118,14 @@ std::unique_ptr<RayDifferentials> SurfacePoint::refractedRay(const RayDifferenti
 	//	float mu = IOR * (in.dir * sp.N) - (out.dir * sp.N);
 	const float dmudx = (ior - (ior * ior * (in_dir * n_)) / (out_dir * n_)) * d_d_ndx;
 	const float dmudy = (ior - (ior * ior * (in_dir * n_)) / (out_dir * n_)) * d_d_ndy;
-	out_differentials->xdir_ = out_dir + ior * dwodx - (/* mu * dndx + */ dmudx * n_);
-	out_differentials->ydir_ = out_dir + ior * dwody - (/* mu * dndy + */ dmudy * n_);
-	return out_differentials;
+	out_differentials.xdir_ = out_dir + ior * dwodx - (/* mu * dndx + */ dmudx * n_);
+	out_differentials.ydir_ = out_dir + ior * dwody - (/* mu * dndy + */ dmudy * n_);
+	out_ray.setDifferentials(out_differentials);
 }
 
 float SurfacePoint::projectedPixelArea()
 {
-	if(differentials_) return (differentials_->dp_dx_ ^ differentials_->dp_dy_).length();
+	if(has_differentials_) return (differentials_.dp_dx_ ^ differentials_.dp_dy_).length();
 	else return 0.f;
 }
 
@@ -143,10 +156,10 @@ void SurfacePoint::dUdvFromDpdPdUdPdV(float &du, float &dv, const Point3 &dp, co
 
 void SurfacePoint::getUVdifferentials(float &du_dx, float &dv_dx, float &du_dy, float &dv_dy) const
 {
-	if(differentials_)
+	if(has_differentials_)
 	{
-		dUdvFromDpdPdUdPdV(du_dx, dv_dx, static_cast<Point3>(differentials_->dp_dx_), dp_du_abs_, dp_dv_abs_);
-		dUdvFromDpdPdUdPdV(du_dy, dv_dy, static_cast<Point3>(differentials_->dp_dy_), dp_du_abs_, dp_dv_abs_);
+		dUdvFromDpdPdUdPdV(du_dx, dv_dx, static_cast<Point3>(differentials_.dp_dx_), dp_du_abs_, dp_dv_abs_);
+		dUdvFromDpdPdUdPdV(du_dy, dv_dy, static_cast<Point3>(differentials_.dp_dy_), dp_du_abs_, dp_dv_abs_);
 	}
 }
 
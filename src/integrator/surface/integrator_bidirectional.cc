@@ -223,10 +223,11 @@ std::pair<Rgb, float> BidirectionalIntegrator::integrate(Ray &ray, RandomGenerat
 {
 	Rgb col {0.f};
 	float alpha = 1.f;
-	std::unique_ptr<const SurfacePoint> sp;
+	SurfacePoint sp;
+	bool hit;
 	float intersect_tmax;
-	std::tie(sp, intersect_tmax) = accelerator_->intersect(ray, camera_); //FIXME: should we change directly ray.tmax_ here or not?
-	if(sp)
+	std::tie(hit, intersect_tmax) = accelerator_->intersect(ray, camera_, sp); //FIXME: should we change directly ray.tmax_ here or not?
+	if(hit)
 	{
 		const Vec3 wo{-ray.dir_};
 		PathData path_data;
@@ -360,8 +361,8 @@ std::pair<Rgb, float> BidirectionalIntegrator::integrate(Ray &ray, RandomGenerat
 		}
 		if(color_layers)
 		{
-			generateCommonLayers(color_layers, *sp, mask_params_);
-			generateOcclusionLayers(color_layers, *accelerator_, chromatic_enabled, wavelength, ray_division, camera_, pixel_sampling_data, *sp, wo, ao_samples_, shadow_bias_auto_, shadow_bias_, ao_dist_, ao_col_, s_depth_);
+			generateCommonLayers(color_layers, sp, mask_params_);
+			generateOcclusionLayers(color_layers, *accelerator_, chromatic_enabled, wavelength, ray_division, camera_, pixel_sampling_data, sp, wo, ao_samples_, shadow_bias_auto_, shadow_bias_, ao_dist_, ao_col_, s_depth_);
 		}
 	}
 	else
@@ -390,10 +391,9 @@ int BidirectionalIntegrator::createPath(RandomGenerator &random_generator, const
 	{
 		path.push_back({});
 		PathVertex &v = path[n_vert];
-		std::unique_ptr<const SurfacePoint> sp;
-		std::tie(sp, ray.tmax_) = accelerator_->intersect(ray, camera_);
-		if(!sp) break;
-		v.sp_ = *sp;
+		bool hit;
+		std::tie(hit, ray.tmax_) = accelerator_->intersect(ray, camera_, v.sp_);
+		if(!hit) break;
 		const PathVertex &v_prev = path[n_vert - 1];
 		// compute alpha_i+1 = alpha_i * fs(wi, wo) / P_proj(wo), where P_proj = bsdf_pdf(wo) / cos(wo*N)
 		v.alpha_ = v_prev.alpha_ * v_prev.f_s_ * v_prev.cos_wo_ / (v_prev.pdf_wo_ * v_prev.qi_wo_);
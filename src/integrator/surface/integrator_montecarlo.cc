@@ -85,6 +85,7 @@ Rgb MonteCarloIntegrator::diracLight(RandomGenerator &random_generator, ColorLay
 	{
 		Rgb col{0.f};
 		light_ray.from_ = sp.p_;
+		light_ray.time_ = sp.intersect_data_.time_;
 		Rgba *color_layer_shadow = nullptr;
 		Rgba *color_layer_diffuse = nullptr;
 		Rgba *color_layer_diffuse_no_shadow = nullptr;
@@ -157,6 +158,7 @@ Rgb MonteCarloIntegrator::areaLightSampleLight(Halton &hal_2, Halton &hal_3, Ran
 {
 	Ray light_ray;
 	light_ray.from_ = sp.p_;
+	light_ray.time_ = sp.intersect_data_.time_;
 	Rgb col{0.f};
 	std::unique_ptr<ColorLayerAccum> layer_shadow;
 	std::unique_ptr<ColorLayerAccum> layer_mat_index_mask_shadow;
@@ -306,6 +308,7 @@ Rgb MonteCarloIntegrator::areaLightSampleMaterial(Halton &hal_2, Halton &hal_3,
 		}
 		Ray light_ray;
 		light_ray.from_ = sp.p_;
+		light_ray.time_ = sp.intersect_data_.time_;
 		Rgb col{0.f};
 		Rgb lcol;
 		Ray b_ray;
@@ -314,6 +317,7 @@ Rgb MonteCarloIntegrator::areaLightSampleMaterial(Halton &hal_2, Halton &hal_3,
 			if(ray_min_dist_auto_) b_ray.tmin_ = ray_min_dist_ * std::max(1.f, sp.p_.length());
 			else b_ray.tmin_ = ray_min_dist_;
 			b_ray.from_ = sp.p_;
+			b_ray.time_ = sp.intersect_data_.time_;
 			const float s_1 = hal_2.getNext();
 			const float s_2 = hal_3.getNext();
 			float W = 0.f;
@@ -426,7 +430,8 @@ void MonteCarloIntegrator::causticWorker(unsigned int &total_photons_shot, int t
 	unsigned int curr = 0;
 	const unsigned int n_caus_photons_thread = 1 + ((n_caus_photons_ - 1) / num_threads_photons_);
 	std::vector<Photon> local_caustic_photons;
-	std::unique_ptr<const SurfacePoint> hit_prev, hit_curr;
+	std::array<SurfacePoint, 2> hit_points; //!< current and previous photon hits, swapped at each bounce
+	SurfacePoint *hit_curr = &hit_points[0], *hit_prev = &hit_points[1];
 	local_caustic_photons.clear();
 	local_caustic_photons.reserve(n_caus_photons_thread);
 	while(!done)
@@ -470,11 +475,12 @@ void MonteCarloIntegrator::causticWorker(unsigned int &total_photons_shot, int t
 		bool chromatic_enabled = true;
 		while(true)
 		{
-			std::tie(hit_curr, ray.tmax_) = accelerator_->intersect(ray, camera_);
-			if(!hit_curr) break;
+			bool hit;
+			std::tie(hit, ray.tmax_) = accelerator_->intersect(ray, camera_, *hit_curr);
+			if(!hit) break;
 			// check for volumetric effects, based on the material from the previous photon bounce
 			Rgb transm(1.f);
-			if(material_prev && hit_prev && mat_bsdfs_prev.hasAny(BsdfFlags::Volumetric))
+			if(material_prev && mat_bsdfs_prev.hasAny(BsdfFlags::Volumetric))
 			{
 				if(const VolumeHandler *vol = material_prev->getVolumeHandler(hit_prev->ng_ * ray.dir_ < 0))
 				{
@@ -698,7 +704,7 @@ std::pair<Rgb, float> MonteCarloIntegrator::dispersive(RandomGenerator &random_g
 		if(s.pdf_ > 1.0e-6f && s.sampled_flags_.hasAny(BsdfFlags::Dispersive))
 		{
 			const Rgb wl_col = spectrum::wl2Rgb(wavelength_dispersive);
-			Ray ref_ray(sp.p_, wi, ray_min_dist_);
+			Ray ref_ray(sp.p_, wi, ray_min_dist_, -1.f, sp.intersect_data_.time_);
 			auto integ = integrate(ref_ray, random_generator, nullptr, thread_id, ray_level, false, wavelength_dispersive, additional_depth, ray_division_new, pixel_sampling_data);
 			integ.first *= mcol * wl_col * w;
 			dcol += integ.first;
@@ -811,8 +817,8 @@ std::pair<Rgb, float> MonteCarloIntegrator::glossy(RandomGenerator &random_gener
 
 std::pair<Rgb, float> MonteCarloIntegrator::glossyReflect(RandomGenerator &random_generator, int thread_id, int ray_level, bool chromatic_enabled, float wavelength, const Ray &ray, const SurfacePoint &sp, const BsdfFlags &bsdfs, int additional_depth, const PixelSamplingData &pixel_sampling_data, const RayDivision &ray_division_new, const Rgb &reflect_color, float w, const Vec3 &dir) const
 {
-	Ray ref_ray = Ray(sp.p_, dir, ray_min_dist_);
-	if(ray.differentials_) ref_ray.differentials_ = sp.reflectedRay(ray.differentials_.get(), ray.dir_, ref_ray.dir_);
+	Ray ref_ray = Ray(sp.p_, dir, ray_min_dist_, -1.f, ray.time_);
+	if(ray.hasDifferentials()) sp.reflectedRay(ray, ref_ray);
 	auto integ = integrate(ref_ray, random_generator, nullptr, thread_id, ray_level, chromatic_enabled, wavelength, additional_depth, ray_division_new, pixel_sampling_data);
 	if(bsdfs.hasAny(BsdfFlags::Volumetric))
 	{
@@ -827,8 +833,8 @@ std::pair<Rgb, float> MonteCarloIntegrator::glossyReflect(RandomGenerator &rando
 
 std::pair<Rgb, float> MonteCarloIntegrator::glossyTransmit(RandomGenerator &random_generator, int thread_id, int ray_level, bool chromatic_enabled, float wavelength, const Ray &ray, const SurfacePoint &sp, const BsdfFlags &bsdfs, int additional_depth, const PixelSamplingData &pixel_sampling_data, const RayDivision &ray_division_new, const Rgb &transmit_col, float w, const Vec3 &dir) const
 {
-	Ray ref_ray = Ray(sp.p_, dir, ray_min_dist_);
-	if(ray.differentials_) ref_ray.differentials_ = sp.refractedRay(ray.differentials_.get(), ray.dir_, ref_ray.dir_, sp.material_->getMatIor());
+	Ray ref_ray = Ray(sp.p_, dir, ray_min_dist_, -1.f, ray.time_);
+	if(ray.hasDifferentials()) sp.refractedRay(ray, ref_ray, sp.material_->getMatIor());
 	auto integ = integrate(ref_ray, random_generator, nullptr, thread_id, ray_level, chromatic_enabled, wavelength, additional_depth, ray_division_new, pixel_sampling_data);
 	if(bsdfs.hasAny(BsdfFlags::Volumetric))
 	{
@@ -847,11 +853,11 @@ std::pair<Rgb, float> MonteCarloIntegrator::glossyReflectNoTransmit(RandomGenera
 	Sample s(s_1, s_2, BsdfFlags::Glossy | BsdfFlags::Reflect);
 	Vec3 wi;
 	const Rgb mcol = sp.sample(wo, wi, s, w, chromatic_enabled, wavelength, camera_);
-	Ray ref_ray(sp.p_, wi, ray_min_dist_);
-	if(ray.differentials_)
+	Ray ref_ray(sp.p_, wi, ray_min_dist_, -1.f, ray.time_);
+	if(ray.hasDifferentials())
 	{
-		if(s.sampled_flags_.hasAny(BsdfFlags::Reflect)) ref_ray.differentials_ = sp.reflectedRay(ray.differentials_.get(), ray.dir_, ref_ray.dir_);
-		else if(s.sampled_flags_.hasAny(BsdfFlags::Transmit)) ref_ray.differentials_ = sp.refractedRay(ray.differentials_.get(), ray.dir_, ref_ray.dir_, sp.material_->getMatIor());
+		if(s.sampled_flags_.hasAny(BsdfFlags::Reflect)) sp.reflectedRay(ray, ref_ray);
+		else if(s.sampled_flags_.hasAny(BsdfFlags::Transmit)) sp.refractedRay(ray, ref_ray, sp.material_->getMatIor());
 	}
 	auto integ = integrate(ref_ray, random_generator, nullptr, thread_id, ray_level, chromatic_enabled, wavelength, additional_depth, ray_division_new, pixel_sampling_data);
 	if(bsdfs.hasAny(BsdfFlags::Volumetric))
@@ -867,8 +873,8 @@ std::pair<Rgb, float> MonteCarloIntegrator::glossyReflectNoTransmit(RandomGenera
 
 std::pair<Rgb, float> MonteCarloIntegrator::specularReflect(RandomGenerator &random_generator, ColorLayers *color_layers, int thread_id, int ray_level, bool chromatic_enabled, float wavelength, const Ray &ray, const SurfacePoint &sp, const Material *material, const BsdfFlags &bsdfs, const DirectionColor *reflect_data, int additional_depth, const RayDivision &ray_division, const PixelSamplingData &pixel_sampling_data) const
 {
-	Ray ref_ray(sp.p_, reflect_data->dir_, ray_min_dist_);
-	if(ray.differentials_) ref_ray.differentials_ = sp.reflectedRay(ray.differentials_.get(), ray.dir_, ref_ray.dir_);
+	Ray ref_ray(sp.p_, reflect_data->dir_, ray_min_dist_, -1.f, ray.time_);
+	if(ray.hasDifferentials()) sp.reflectedRay(ray, ref_ray);
 	auto integ = integrate(ref_ray, random_generator, nullptr, thread_id, ray_level, chromatic_enabled, wavelength, additional_depth, ray_division, pixel_sampling_data);
 	if(bsdfs.hasAny(BsdfFlags::Volumetric))
 	{
@@ -893,11 +899,11 @@ std::pair<Rgb, float> MonteCarloIntegrator::specularRefract(RandomGenerator &ran
 	{
 		const bool transpbias_multiply_raydepth = material->getTransparentBiasMultiplyRayDepth();
 		if(transpbias_multiply_raydepth) transp_bias_factor *= ray_level;
-		ref_ray = Ray(sp.p_ + refract_data->dir_ * transp_bias_factor, refract_data->dir_, ray_min_dist_);
+		ref_ray = Ray(sp.p_ + refract_data->dir_ * transp_bias_factor, refract_data->dir_, ray_min_dist_, -1.f, ray.time_);
 	}
-	else ref_ray = Ray(sp.p_, refract_data->dir_, ray_min_dist_);
+	else ref_ray = Ray(sp.p_, refract_data->dir_, ray_min_dist_, -1.f, ray.time_);
 
-	if(ray.differentials_) ref_ray.differentials_ = sp.refractedRay(ray.differentials_.get(), ray.dir_, ref_ray.dir_, material->getMatIor());
+	if(ray.hasDifferentials()) sp.refractedRay(ray, ref_ray, material->getMatIor());
 	auto integ = integrate(ref_ray, random_generator, nullptr, thread_id, ray_level, chromatic_enabled, wavelength, additional_depth, ray_division, pixel_sampling_data);
 
 	if(bsdfs.hasAny(BsdfFlags::Volumetric))
@@ -124,18 +124,19 @@ std::pair<Rgb, float> PathIntegrator::integrate(Ray &ray, RandomGenerator &rando
 	Rgb col {0.f};
 	float alpha = 1.f;
 	float w = 0.f;
-	std::unique_ptr<const SurfacePoint> sp;
-	std::tie(sp, ray.tmax_) = accelerator_->intersect(ray, camera_);
-	if(sp)
+	SurfacePoint sp;
+	bool ray_hit;
+	std::tie(ray_hit, ray.tmax_) = accelerator_->intersect(ray, camera_, sp);
+	if(ray_hit)
 	{
-		const BsdfFlags &mat_bsdfs = sp->mat_data_->bsdf_flags_;
+		const BsdfFlags &mat_bsdfs = sp.mat_data_->bsdf_flags_;
 		const Vec3 wo{-ray.dir_};
-		additional_depth = std::max(additional_depth, sp->material_->getAdditionalDepth());
+		additional_depth = std::max(additional_depth, sp.material_->getAdditionalDepth());
 
 		// contribution of light emitting surfaces
 		if(mat_bsdfs.hasAny(BsdfFlags::Emit))
 		{
-			const Rgb col_emit = sp->emit(wo);
+			const Rgb col_emit = sp.emit(wo);
 			col += col_emit;
 			if(color_layers && color_layers->getFlags().hasAny(LayerDef::Flags::BasicLayers))
 			{
@@ -145,10 +146,10 @@ std::pair<Rgb, float> PathIntegrator::integrate(Ray &ray, RandomGenerator &rando
 
 		if(mat_bsdfs.hasAny(BsdfFlags::Diffuse))
 		{
-			col += estimateAllDirectLight(random_generator, color_layers, chromatic_enabled, wavelength, *sp, wo, ray_division, pixel_sampling_data);
+			col += estimateAllDirectLight(random_generator, color_layers, chromatic_enabled, wavelength, sp, wo, ray_division, pixel_sampling_data);
 			if(caustic_type_ == CausticType::Photon || caustic_type_ == CausticType::Both)
 			{
-				col += causticPhotons(color_layers, ray, *sp, wo, aa_noise_params_.clamp_indirect_, caustic_map_.get(), caus_radius_, n_caus_search_);
+				col += causticPhotons(color_layers, ray, sp, wo, aa_noise_params_.clamp_indirect_, caustic_map_.get(), caus_radius_, n_caus_search_);
 			}
 		}
 		// path tracing:
@@ -168,7 +169,8 @@ std::pair<Rgb, float> PathIntegrator::integrate(Ray &ray, RandomGenerator &rando
 				unsigned int offs = n_paths_ * pixel_sampling_data.sample_ + pixel_sampling_data.offset_ + i; // some redunancy here...
 				Rgb throughput(1.0);
 				Rgb lcol, scol;
-				auto hit = std::unique_ptr<const SurfacePoint>(new SurfacePoint(*sp));
+				SurfacePoint hit;
+				bool path_hit;
 				Vec3 pwo{wo};
 				Ray p_ray;
 
@@ -183,20 +185,21 @@ std::pair<Rgb, float> PathIntegrator::integrate(Ray &ray, RandomGenerator &rando
 				}
 				// do proper sampling now...
 				Sample s(s_1, s_2, path_flags);
-				scol = sp->sample(pwo, p_ray.dir_, s, w, chromatic_enabled, wavelength_dispersive, camera_);
+				scol = sp.sample(pwo, p_ray.dir_, s, w, chromatic_enabled, wavelength_dispersive, camera_);
 				scol *= w;
 				throughput = scol;
 				p_ray.tmin_ = ray_min_dist_;
 				p_ray.tmax_ = -1.f;
-				p_ray.from_ = sp->p_;
-				std::tie(hit, p_ray.tmax_) = accelerator_->intersect(p_ray, camera_);
-				if(!hit) continue; //hit background
+				p_ray.from_ = sp.p_;
+				p_ray.time_ = ray.time_;
+				std::tie(path_hit, p_ray.tmax_) = accelerator_->intersect(p_ray, camera_, hit);
+				if(!path_hit) continue; //hit background
 				if(s.sampled_flags_ != BsdfFlags::None) pwo = -p_ray.dir_; //Fix for white dots in path tracing with shiny diffuse with transparent PNG texture and transparent shadows, especially in Win32, (precision?). Sometimes the first sampling does not take place and pRay.dir is not initialized, so before this change when that happened pwo = -pRay.dir was getting a random_generator non-initialized value! This fix makes that, if the first sample fails for some reason, pwo is not modified and the rest of the sampling continues with the same pwo value. FIXME: Question: if the first sample fails, should we continue as now or should we exit the loop with the "continue" command?
-				lcol = estimateOneDirectLight(random_generator, thread_id, chromatic_enabled, wavelength_dispersive, *hit, pwo, offs, ray_division, pixel_sampling_data);
-				const BsdfFlags mat_bsd_fs = hit->mat_data_->bsdf_flags_;
+				lcol = estimateOneDirectLight(random_generator, thread_id, chromatic_enabled, wavelength_dispersive, hit, pwo, offs, ray_division, pixel_sampling_data);
+				const BsdfFlags mat_bsd_fs = hit.mat_data_->bsdf_flags_;
 				if(mat_bsd_fs.hasAny(BsdfFlags::Emit))
 				{
-					const Rgb col_emit = hit->emit(pwo);
+					const Rgb col_emit = hit.emit(pwo);
 					lcol += col_emit;
 					if(color_layers && color_layers->getFlags().hasAny(LayerDef::Flags::BasicLayers))
 					{
@@ -222,25 +225,25 @@ std::pair<Rgb, float> PathIntegrator::integrate(Ray &ray, RandomGenerator &rando
 
 					s.flags_ = BsdfFlags::All;
 
-					scol = hit->sample(pwo, p_ray.dir_, s, w, chromatic_enabled, wavelength_dispersive, camera_);
+					scol = hit.sample(pwo, p_ray.dir_, s, w, chromatic_enabled, wavelength_dispersive, camera_);
 					scol *= w;
 					if(scol.isBlack()) break;
 					throughput *= scol;
 					caustic = trace_caustics_ && s.sampled_flags_.hasAny(BsdfFlags::Specular | BsdfFlags::Glossy | BsdfFlags::Filter);
 					p_ray.tmin_ = ray_min_dist_;
 					p_ray.tmax_ = -1.f;
-					p_ray.from_ = hit->p_;
-					auto intersect_result = accelerator_->intersect(p_ray, camera_);
-					if(!intersect_result.first) break; //hit background
-					std::swap(hit, intersect_result.first);
+					p_ray.from_ = hit.p_;
+					p_ray.time_ = ray.time_;
+					//The next hit is calculated in place of the current one, which is not needed any more
+					if(!accelerator_->intersect(p_ray, camera_, hit).first) break; //hit background
 					pwo = -p_ray.dir_;
 
-					if(mat_bsd_fs.hasAny(BsdfFlags::Diffuse)) lcol = estimateOneDirectLight(random_generator, thread_id, chromatic_enabled, wavelength_dispersive, *hit, pwo, offs, ray_division, pixel_sampling_data);
+					if(mat_bsd_fs.hasAny(BsdfFlags::Diffuse)) lcol = estimateOneDirectLight(random_generator, thread_id, chromatic_enabled, wavelength_dispersive, hit, pwo, offs, ray_division, pixel_sampling_data);
 					else lcol = Rgb(0.f);
 
 					if(mat_bsd_fs.hasAny(BsdfFlags::Volumetric))
 					{
-						if(const VolumeHandler *vol = hit->material_->getVolumeHandler(hit->n_ * pwo < 0))
+						if(const VolumeHandler *vol = hit.material_->getVolumeHandler(hit.n_ * pwo < 0))
 						{
 							throughput *= vol->transmittance(p_ray);
 						}
@@ -256,7 +259,7 @@ std::pair<Rgb, float> PathIntegrator::integrate(Ray &ray, RandomGenerator &rando
 
 					if(mat_bsd_fs.hasAny(BsdfFlags::Emit) && caustic)
 					{
-						const Rgb col_tmp = hit->emit(pwo);
+						const Rgb col_tmp = hit.emit(pwo);
 						lcol += col_tmp;
 						if(color_layers && color_layers->getFlags().hasAny(LayerDef::Flags::BasicLayers))
 						{
@@ -268,13 +271,13 @@ std::pair<Rgb, float> PathIntegrator::integrate(Ray &ray, RandomGenerator &rando
 			}
 			col += path_col / n_samples;
 		}
-		const auto recursive_result = recursiveRaytrace(random_generator, color_layers, thread_id, ray_level + 1, chromatic_enabled, wavelength, ray, mat_bsdfs, *sp, wo, additional_depth, ray_division, pixel_sampling_data);
+		const auto recursive_result = recursiveRaytrace(random_generator, color_layers, thread_id, ray_level + 1, chromatic_enabled, wavelength, ray, mat_bsdfs, sp, wo, additional_depth, ray_division, pixel_sampling_data);
 		col += recursive_result.first;
 		alpha = recursive_result.second;
 		if(color_layers)
 		{
-			generateCommonLayers(color_layers, *sp, mask_params_);
-			generateOcclusionLayers(color_layers, *accelerator_, chromatic_enabled, wavelength, ray_division, camera_, pixel_sampling_data, *sp, wo, ao_samples_, shadow_bias_auto_, shadow_bias_, ao_dist_, ao_col_, s_depth_);
+			generateCommonLayers(color_layers, sp, mask_params_);
+			generateOcclusionLayers(color_layers, *accelerator_, chromatic_enabled, wavelength, ray_division, camera_, pixel_sampling_data, sp, wo, ao_samples_, shadow_bias_auto_, shadow_bias_, ao_dist_, ao_col_, s_depth_);
 		}
 	}
 	else //nothing hit, return background
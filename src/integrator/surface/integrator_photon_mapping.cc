@@ -112,7 +112,8 @@ void PhotonIntegrator::diffuseWorker(PreGatherData &pgdat, unsigned int &total_p
 	//shoot photons
 	bool done = false;
 	unsigned int curr = 0;
-	std::unique_ptr<const SurfacePoint> hit_prev, hit_curr;
+	std::array<SurfacePoint, 2> hit_points; //!< current and previous photon hits, swapped at each bounce
+	SurfacePoint *hit_curr = &hit_points[0], *hit_prev = &hit_points[1];
 	const int num_lights_diffuse = lights_diffuse.size();
 	const auto f_num_lights = static_cast<float>(num_lights_diffuse);
 	unsigned int n_diffuse_photons_thread = 1 + ((n_diffuse_photons_ - 1) / num_threads_photons_);
@@ -161,10 +162,11 @@ void PhotonIntegrator::diffuseWorker(PreGatherData &pgdat, unsigned int &total_p
 		BsdfFlags mat_bsdfs_prev = BsdfFlags::None;
 		while(true)
 		{
-			std::tie(hit_curr, ray.tmax_) = accelerator_->intersect(ray, camera_);
-			if(!hit_curr) break;
+			bool hit;
+			std::tie(hit, ray.tmax_) = accelerator_->intersect(ray, camera_, *hit_curr);
+			if(!hit) break;
 			Rgb transm(1.f);
-			if(material_prev && hit_prev && mat_bsdfs_prev.hasAny(BsdfFlags::Volumetric))
+			if(material_prev && mat_bsdfs_prev.hasAny(BsdfFlags::Volumetric))
 			{
 				if(const VolumeHandler *vol = material_prev->getVolumeHandler(hit_prev->ng_ * -ray.dir_ < 0))
 				{
@@ -650,7 +652,7 @@ Rgb PhotonIntegrator::finalGathering(RandomGenerator &random_generator, int thre
 	{
 		Rgb throughput(1.0);
 		float length = 0;
-		auto hit = std::unique_ptr<const SurfacePoint>(new SurfacePoint(sp));
+		SurfacePoint hit;
 		Vec3 pwo{wo};
 		Ray p_ray;
 		bool did_hit;
@@ -666,20 +668,20 @@ Rgb PhotonIntegrator::finalGathering(RandomGenerator &random_generator, int thre
 		}
 
 		Sample s(s_1, s_2, BsdfFlags::Diffuse | BsdfFlags::Reflect | BsdfFlags::Transmit); // glossy/dispersion/specular done via recursive raytracing
-		scol = hit->sample(pwo, p_ray.dir_, s, w, chromatic_enabled, wavelength, camera_);
+		scol = sp.sample(pwo, p_ray.dir_, s, w, chromatic_enabled, wavelength, camera_);
 
 		scol *= w;
 		if(scol.isBlack()) continue;
 
 		p_ray.tmin_ = ray_min_dist_;
 		p_ray.tmax_ = -1.f;
-		p_ray.from_ = hit->p_;
+		p_ray.from_ = sp.p_;
 		throughput = scol;
-		std::tie(hit, p_ray.tmax_) = accelerator_->intersect(p_ray, camera_);
-		did_hit = static_cast<bool>(hit);
+		std::tie(did_hit, p_ray.tmax_) = accelerator_->intersect(p_ray, camera_, hit);
 		if(!did_hit) continue;   //hit background
 		length = p_ray.tmax_;
-		const BsdfFlags &mat_bsd_fs = hit->mat_data_->bsdf_flags_;
+		//Flags of the material at the current path vertex, updated at each bounce
+		BsdfFlags mat_bsd_fs = hit.mat_data_->bsdf_flags_;
 		bool has_spec = mat_bsd_fs.hasAny(BsdfFlags::Specular);
 		bool caustic = false;
 		bool close = length < gather_dist_;
@@ -691,7 +693,7 @@ Rgb PhotonIntegrator::finalGathering(RandomGenerator &random_generator, int thre
 			pwo = -p_ray.dir_;
 			if(mat_bsd_fs.hasAny(BsdfFlags::Volumetric))
 			{
-				if(const VolumeHandler *vol = hit->material_->getVolumeHandler(hit->n_ * pwo < 0))
+				if(const VolumeHandler *vol = hit.material_->getVolumeHandler(hit.n_ * pwo < 0))
 				{
 					throughput *= vol->transmittance(p_ray);
 				}
@@ -700,18 +702,18 @@ Rgb PhotonIntegrator::finalGathering(RandomGenerator &random_generator, int thre
 			{
 				if(close)
 				{
-					lcol = estimateOneDirectLight(random_generator, thread_id, chromatic_enabled, wavelength, *hit, pwo, offs, ray_division, pixel_sampling_data);
+					lcol = estimateOneDirectLight(random_generator, thread_id, chromatic_enabled, wavelength, hit, pwo, offs, ray_division, pixel_sampling_data);
 				}
 				else if(caustic)
 				{
-					Vec3 sf{SurfacePoint::normalFaceForward(hit->ng_, hit->n_, pwo)};
-					const Photon *nearest = radiance_map_->findNearest(hit->p_, sf, lookup_rad_);
+					Vec3 sf{SurfacePoint::normalFaceForward(hit.ng_, hit.n_, pwo)};
+					const Photon *nearest = radiance_map_->findNearest(hit.p_, sf, lookup_rad_);
 					if(nearest) lcol = nearest->color();
 				}
 
 				if(close || caustic)
 				{
-					if(mat_bsd_fs.hasAny(BsdfFlags::Emit)) lcol += hit->emit(pwo);
+					if(mat_bsd_fs.hasAny(BsdfFlags::Emit)) lcol += hit.emit(pwo);
 					path_col += lcol * throughput;
 				}
 			}
@@ -726,7 +728,7 @@ Rgb PhotonIntegrator::finalGathering(RandomGenerator &random_generator, int thre
 			}
 
 			Sample sb(s_1, s_2, (close) ? BsdfFlags::All : BsdfFlags::AllSpecular | BsdfFlags::Filter);
-			scol = hit->sample(pwo, p_ray.dir_, sb, w, chromatic_enabled, wavelength, camera_);
+			scol = hit.sample(pwo, p_ray.dir_, sb, w, chromatic_enabled, wavelength, camera_);
 
 			if(sb.pdf_ <= 1.0e-6f)
 			{
@@ -736,11 +738,11 @@ Rgb PhotonIntegrator::finalGathering(RandomGenerator &random_generator, int thre
 			scol *= w;
 			p_ray.tmin_ = ray_min_dist_;
 			p_ray.tmax_ = -1.f;
-			p_ray.from_ = hit->p_;
+			p_ray.from_ = hit.p_;
 			throughput *= scol;
-			std::tie(hit, p_ray.tmax_) = accelerator_->intersect(p_ray, camera_);
-			did_hit = static_cast<bool>(hit);
+			std::tie(did_hit, p_ray.tmax_) = accelerator_->intersect(p_ray, camera_, hit);
 			if(!did_hit) break; //hit background
+			mat_bsd_fs = hit.mat_data_->bsdf_flags_;
 			length += p_ray.tmax_;
 			caustic = (caustic || !depth) && sb.sampled_flags_.hasAny(BsdfFlags::Specular | BsdfFlags::Filter);
 			close = length < gather_dist_;
@@ -751,10 +753,10 @@ Rgb PhotonIntegrator::finalGathering(RandomGenerator &random_generator, int thre
 		{
 			if(mat_bsd_fs.hasAny(BsdfFlags::Diffuse | BsdfFlags::Glossy))
 			{
-				Vec3 sf{SurfacePoint::normalFaceForward(hit->ng_, hit->n_, -p_ray.dir_)};
-				const Photon *nearest = radiance_map_->findNearest(hit->p_, sf, lookup_rad_);
+				Vec3 sf{SurfacePoint::normalFaceForward(hit.ng_, hit.n_, -p_ray.dir_)};
+				const Photon *nearest = radiance_map_->findNearest(hit.p_, sf, lookup_rad_);
 				if(nearest) lcol = nearest->color(); //FIXME should lcol be a local variable? Is it getting its value from previous functions or not??
-				if(mat_bsd_fs.hasAny(BsdfFlags::Emit)) lcol += hit->emit(-p_ray.dir_);
+				if(mat_bsd_fs.hasAny(BsdfFlags::Emit)) lcol += hit.emit(-p_ray.dir_);
 				path_col += lcol * throughput;
 			}
 		}
@@ -856,16 +858,17 @@ std::pair<Rgb, float> PhotonIntegrator::integrate(Ray &ray, RandomGenerator &ran
 	++calls;
 	Rgb col {0.f};
 	float alpha = 1.f;
-	std::unique_ptr<const SurfacePoint> sp;
-	std::tie(sp, ray.tmax_) = accelerator_->intersect(ray, camera_);
-	if(sp)
+	SurfacePoint sp;
+	bool hit;
+	std::tie(hit, ray.tmax_) = accelerator_->intersect(ray, camera_, sp);
+	if(hit)
 	{
 		const Vec3 wo{-ray.dir_};
-		const BsdfFlags &mat_bsdfs = sp->mat_data_->bsdf_flags_;
+		const BsdfFlags &mat_bsdfs = sp.mat_data_->bsdf_flags_;
 
-		additional_depth = std::max(additional_depth, sp->material_->getAdditionalDepth());
+		additional_depth = std::max(additional_depth, sp.material_->getAdditionalDepth());
 
-		const Rgb col_emit = sp->emit(wo);
+		const Rgb col_emit = sp.emit(wo);
 		col += col_emit;
 		if(color_layers && color_layers->getFlags().hasAny(LayerDef::Flags::BasicLayers))
 		{
@@ -875,8 +878,8 @@ std::pair<Rgb, float> PhotonIntegrator::integrate(Ray &ray, RandomGenerator &ran
 		{
 			if(show_map_)
 			{
-				const Vec3 n{SurfacePoint::normalFaceForward(sp->ng_, sp->n_, wo)};
-				const Photon *nearest = radiance_map_->findNearest(sp->p_, n, lookup_rad_);
+				const Vec3 n{SurfacePoint::normalFaceForward(sp.ng_, sp.n_, wo)};
+				const Photon *nearest = radiance_map_->findNearest(sp.p_, n, lookup_rad_);
 				if(nearest) col += nearest->color();
 			}
 			else
@@ -885,8 +888,8 @@ std::pair<Rgb, float> PhotonIntegrator::integrate(Ray &ray, RandomGenerator &ran
 				{
 					if(Rgba *color_layer = color_layers->find(LayerDef::Radiance))
 					{
-						const Vec3 n{SurfacePoint::normalFaceForward(sp->ng_, sp->n_, wo)};
-						const Photon *nearest = radiance_map_->findNearest(sp->p_, n, lookup_rad_);
+						const Vec3 n{SurfacePoint::normalFaceForward(sp.ng_, sp.n_, wo)};
+						const Photon *nearest = radiance_map_->findNearest(sp.p_, n, lookup_rad_);
 						if(nearest) *color_layer = Rgba{nearest->color()};
 					}
 				}
@@ -894,7 +897,7 @@ std::pair<Rgb, float> PhotonIntegrator::integrate(Ray &ray, RandomGenerator &ran
 				// contribution of light emitting surfaces
 				if(mat_bsdfs.hasAny(BsdfFlags::Emit))
 				{
-					const Rgb col_tmp = sp->emit(wo);
+					const Rgb col_tmp = sp.emit(wo);
 					col += col_tmp;
 					if(color_layers && color_layers->getFlags().hasAny(LayerDef::Flags::BasicLayers))
 					{
@@ -904,8 +907,8 @@ std::pair<Rgb, float> PhotonIntegrator::integrate(Ray &ray, RandomGenerator &ran
 
 				if(mat_bsdfs.hasAny(BsdfFlags::Diffuse))
 				{
-					col += estimateAllDirectLight(random_generator, color_layers, chromatic_enabled, wavelength, *sp, wo, ray_division, pixel_sampling_data);
-					Rgb col_tmp = finalGathering(random_generator, thread_id, chromatic_enabled, wavelength, *sp, wo, ray_division, pixel_sampling_data);
+					col += estimateAllDirectLight(random_generator, color_layers, chromatic_enabled, wavelength, sp, wo, ray_division, pixel_sampling_data);
+					Rgb col_tmp = finalGathering(random_generator, thread_id, chromatic_enabled, wavelength, sp, wo, ray_division, pixel_sampling_data);
 					if(aa_noise_params_.clamp_indirect_ > 0.f) col_tmp.clampProportionalRgb(aa_noise_params_.clamp_indirect_);
 					col += col_tmp;
 					if(color_layers && color_layers->getFlags().hasAny(LayerDef::Flags::DiffuseLayers))
@@ -919,8 +922,8 @@ std::pair<Rgb, float> PhotonIntegrator::integrate(Ray &ray, RandomGenerator &ran
 		{
 			if(use_photon_diffuse_ && show_map_)
 			{
-				const Vec3 n{SurfacePoint::normalFaceForward(sp->ng_, sp->n_, wo)};
-				const Photon *nearest = diffuse_map_->findNearest(sp->p_, n, ds_radius_);
+				const Vec3 n{SurfacePoint::normalFaceForward(sp.ng_, sp.n_, wo)};
+				const Photon *nearest = diffuse_map_->findNearest(sp.p_, n, ds_radius_);
 				if(nearest) col += nearest->color();
 			}
 			else
@@ -929,15 +932,15 @@ std::pair<Rgb, float> PhotonIntegrator::integrate(Ray &ray, RandomGenerator &ran
 				{
 					if(Rgba *color_layer = color_layers->find(LayerDef::Radiance))
 					{
-						const Vec3 n{SurfacePoint::normalFaceForward(sp->ng_, sp->n_, wo)};
-						const Photon *nearest = radiance_map_->findNearest(sp->p_, n, lookup_rad_);
+						const Vec3 n{SurfacePoint::normalFaceForward(sp.ng_, sp.n_, wo)};
+						const Photon *nearest = radiance_map_->findNearest(sp.p_, n, lookup_rad_);
 						if(nearest) *color_layer = Rgba{nearest->color()};
 					}
 				}
 
 				if(mat_bsdfs.hasAny(BsdfFlags::Emit))
 				{
-					const Rgb col_tmp = sp->emit(wo);
+					const Rgb col_tmp = sp.emit(wo);
 					col += col_tmp;
 					if(color_layers && color_layers->getFlags().hasAny(LayerDef::Flags::BasicLayers))
 					{
@@ -947,7 +950,7 @@ std::pair<Rgb, float> PhotonIntegrator::integrate(Ray &ray, RandomGenerator &ran
 
 				if(mat_bsdfs.hasAny(BsdfFlags::Diffuse))
 				{
-					col += estimateAllDirectLight(random_generator, color_layers, chromatic_enabled, wavelength, *sp, wo, ray_division, pixel_sampling_data);
+					col += estimateAllDirectLight(random_generator, color_layers, chromatic_enabled, wavelength, sp, wo, ray_division, pixel_sampling_data);
 				}
 
 				auto *gathered = static_cast<FoundPhoton *>(alloca(n_diffuse_search_ * sizeof(FoundPhoton)));
@@ -955,7 +958,7 @@ std::pair<Rgb, float> PhotonIntegrator::integrate(Ray &ray, RandomGenerator &ran
 
 				int n_gathered = 0;
 
-				if(use_photon_diffuse_ && diffuse_map_->nPhotons() > 0) n_gathered = diffuse_map_->gather(sp->p_, gathered, n_diffuse_search_, radius);
+				if(use_photon_diffuse_ && diffuse_map_->nPhotons() > 0) n_gathered = diffuse_map_->gather(sp.p_, gathered, n_diffuse_search_, radius);
 				if(use_photon_diffuse_ && n_gathered > 0)
 				{
 					if(n_gathered > n_max) n_max = n_gathered;
@@ -964,7 +967,7 @@ std::pair<Rgb, float> PhotonIntegrator::integrate(Ray &ray, RandomGenerator &ran
 					for(int i = 0; i < n_gathered; ++i)
 					{
 						const Vec3 pdir{gathered[i].photon_->direction()};
-						const Rgb surf_col = sp->eval(wo, pdir, BsdfFlags::Diffuse);
+						const Rgb surf_col = sp.eval(wo, pdir, BsdfFlags::Diffuse);
 
 						const Rgb col_tmp = surf_col * scale * gathered[i].photon_->color();
 						col += col_tmp;
@@ -980,16 +983,16 @@ std::pair<Rgb, float> PhotonIntegrator::integrate(Ray &ray, RandomGenerator &ran
 		// add caustics
 		if(use_photon_caustics_ && mat_bsdfs.hasAny(BsdfFlags::Diffuse))
 		{
-			col += causticPhotons(color_layers, ray, *sp, wo, aa_noise_params_.clamp_indirect_, caustic_map_.get(), caus_radius_, n_caus_search_);
+			col += causticPhotons(color_layers, ray, sp, wo, aa_noise_params_.clamp_indirect_, caustic_map_.get(), caus_radius_, n_caus_search_);
 		}
 
-		const auto recursive_result = recursiveRaytrace(random_generator, color_layers, thread_id, ray_level + 1, chromatic_enabled, wavelength, ray, mat_bsdfs, *sp, wo, additional_depth, ray_division, pixel_sampling_data);
+		const auto recursive_result = recursiveRaytrace(random_generator, color_layers, thread_id, ray_level + 1, chromatic_enabled, wavelength, ray, mat_bsdfs, sp, wo, additional_depth, ray_division, pixel_sampling_data);
 		col += recursive_result.first;
 		alpha = recursive_result.second;
 		if(color_layers)
 		{
-			generateCommonLayers(color_layers, *sp, mask_params_);
-			generateOcclusionLayers(color_layers, *accelerator_, chromatic_enabled, wavelength, ray_division, camera_, pixel_sampling_data, *sp, wo, ao_samples_, shadow_bias_auto_, shadow_bias_, ao_dist_, ao_col_, s_depth_);
+			generateCommonLayers(color_layers, sp, mask_params_);
+			generateOcclusionLayers(color_layers, *accelerator_, chromatic_enabled, wavelength, ray_division, camera_, pixel_sampling_data, sp, wo, ao_samples_, shadow_bias_auto_, shadow_bias_, ao_dist_, ao_col_, s_depth_);
 		}
 	}
 	else //nothing hit, return background
@@ -202,7 +202,7 @@ bool SppmIntegrator::renderTile(const RenderArea &a, int n_samples, int offset,
 				pixel_sampling_data.sample_ = pass_offs + sample;
 				const float time = math::addMod1(static_cast<float>(sample) * d_1, toff); //(0.5+(float)sample)*d1;
 				// the (1/n, Larcher&Pillichshammer-Seq.) only gives good coverage when total sample count is known
-				// hence we use scrambled (Sobol, van-der-Corput) for multipass AA //!< the current (normalized) frame time  //FIXME, time not currently used in libYafaRay
+				// hence we use scrambled (Sobol, van-der-Corput) for multipass AA //!< the current (normalized) frame time
 
 				float dx = 0.5f, dy = 0.5f;
 				dx = sample::riVdC(pixel_sampling_data.sample_, pixel_sampling_data.offset_);
@@ -223,13 +223,9 @@ bool SppmIntegrator::renderTile(const RenderArea &a, int n_samples, int offset,
 				if(render_control_.getDifferentialRaysEnabled())
 				{
 					//setup ray differentials
-					camera_ray.ray_.differentials_ = std::unique_ptr<RayDifferentials>(new RayDifferentials());
 					const CameraRay camera_diff_ray_x = camera_->shootRay(j + 1 + dx, i + dy, lens_u, lens_v);
-					camera_ray.ray_.differentials_->xfrom_ = camera_diff_ray_x.ray_.from_;
-					camera_ray.ray_.differentials_->xdir_ = camera_diff_ray_x.ray_.dir_;
 					const CameraRay camera_diff_ray_y = camera_->shootRay(j + dx, i + 1 + dy, lens_u, lens_v);
-					camera_ray.ray_.differentials_->yfrom_ = camera_diff_ray_y.ray_.from_;
-					camera_ray.ray_.differentials_->ydir_ = camera_diff_ray_y.ray_.dir_;
+					camera_ray.ray_.setDifferentials({camera_diff_ray_x.ray_.from_, camera_diff_ray_x.ray_.dir_, camera_diff_ray_y.ray_.from_, camera_diff_ray_y.ray_.dir_});
 					// col = T * L_o + L_v
 				}
 				camera_ray.ray_.time_ = time;
@@ -324,7 +320,8 @@ void SppmIntegrator::photonWorker(unsigned int &total_photons_shot, int thread_i
 	bool done = false;
 	unsigned int curr = 0;
 
-	std::unique_ptr<const SurfacePoint> hit_prev, hit_curr;
+	std::array<SurfacePoint, 2> hit_points; //!< current and previous photon hits, swapped at each bounce
+	SurfacePoint *hit_curr = &hit_points[0], *hit_prev = &hit_points[1];
 
 	const auto f_num_lights = static_cast<float>(num_d_lights);
 
@@ -391,10 +388,11 @@ void SppmIntegrator::photonWorker(unsigned int &total_photons_shot, int thread_i
 		bool chromatic_enabled = true;
 		while(true)   //scatter photons.
 		{
-			std::tie(hit_curr, ray.tmax_) = accelerator_->intersect(ray, camera_);
-			if(!hit_curr) break;
+			bool hit;
+			std::tie(hit, ray.tmax_) = accelerator_->intersect(ray, camera_, *hit_curr);
+			if(!hit) break;
 			Rgb transm(1.f);
-			if(material_prev && hit_prev && mat_bsdfs_prev.hasAny(BsdfFlags::Volumetric))
+			if(material_prev && mat_bsdfs_prev.hasAny(BsdfFlags::Volumetric))
 			{
 				if(const VolumeHandler *vol = material_prev->getVolumeHandler(hit_prev->ng_ * ray.dir_ < 0))
 				{
@@ -607,18 +605,19 @@ std::pair<Rgb, float> SppmIntegrator::integrate(Ray &ray, RandomGenerator &rando
 GatherInfo SppmIntegrator::traceGatherRay(Ray &ray, HitPoint &hp, RandomGenerator &random_generator, ColorLayers *color_layers, int thread_id, int ray_level, bool chromatic_enabled, float wavelength, const RayDivision &ray_division, const PixelSamplingData &pixel_sampling_data)
 {
 	GatherInfo g_info;
-	std::unique_ptr<const SurfacePoint> sp;
+	SurfacePoint sp;
+	bool hit;
 	float alpha = transp_background_ ? 0.f : 1.f;
-	std::tie(sp, ray.tmax_) = accelerator_->intersect(ray, camera_);
-	if(sp)
+	std::tie(hit, ray.tmax_) = accelerator_->intersect(ray, camera_, sp);
+	if(hit)
 	{
 		int additional_depth = 0;
 
 		const Vec3 wo{-ray.dir_};
-		const BsdfFlags &mat_bsdfs = sp->mat_data_->bsdf_flags_;
-		additional_depth = std::max(additional_depth, sp->material_->getAdditionalDepth());
+		const BsdfFlags &mat_bsdfs = sp.mat_data_->bsdf_flags_;
+		additional_depth = std::max(additional_depth, sp.material_->getAdditionalDepth());
 
-		const Rgb col_emit = sp->emit(wo);
+		const Rgb col_emit = sp.emit(wo);
 		g_info.constant_randiance_ += Rgba{col_emit}; //add only once, but FG seems add twice?
 		if(color_layers && color_layers->getFlags().hasAny(LayerDef::Flags::BasicLayers))
 		{
@@ -626,7 +625,7 @@ GatherInfo SppmIntegrator::traceGatherRay(Ray &ray, HitPoint &hp, RandomGenerato
 		}
 		if(mat_bsdfs.hasAny(BsdfFlags::Diffuse))
 		{
-			g_info.constant_randiance_ += Rgba{estimateAllDirectLight(random_generator, color_layers, chromatic_enabled, wavelength, *sp, wo, ray_division, pixel_sampling_data)};
+			g_info.constant_randiance_ += Rgba{estimateAllDirectLight(random_generator, color_layers, chromatic_enabled, wavelength, sp, wo, ray_division, pixel_sampling_data)};
 		}
 
 		// estimate radiance using photon map
@@ -640,9 +639,9 @@ GatherInfo SppmIntegrator::traceGatherRay(Ray &ray, HitPoint &hp, RandomGenerato
 			int n_gathered_1 = 0, n_gathered_2 = 0;
 
 			if(diffuse_map_->nPhotons() > 0)
-				n_gathered_1 = diffuse_map_->gather(sp->p_, gathered.get(), n_search_, radius_1);
+				n_gathered_1 = diffuse_map_->gather(sp.p_, gathered.get(), n_search_, radius_1);
 			if(caustic_map_->nPhotons() > 0)
-				n_gathered_2 = caustic_map_->gather(sp->p_, gathered.get(), n_search_, radius_2);
+				n_gathered_2 = caustic_map_->gather(sp.p_, gathered.get(), n_search_, radius_2);
 			if(n_gathered_1 > 0 || n_gathered_2 > 0) // it none photon gathered, we just skip.
 			{
 				if(radius_1 < radius_2) // we choose the smaller one to be the initial radius.
@@ -658,12 +657,12 @@ GatherInfo SppmIntegrator::traceGatherRay(Ray &ray, HitPoint &hp, RandomGenerato
 		float radius_2 = hp.radius_2_;
 
 		if(b_hashgrid_)
-			n_gathered = photon_grid_.gather(sp->p_, gathered.get(), n_max_gather_, radius_2); // disable now
+			n_gathered = photon_grid_.gather(sp.p_, gathered.get(), n_max_gather_, radius_2); // disable now
 		else
 		{
 			if(diffuse_map_->nPhotons() > 0) // this is needed to avoid a runtime error.
 			{
-				n_gathered = diffuse_map_->gather(sp->p_, gathered.get(), n_max_gather_, radius_2); //we always collected all the photon inside the radius
+				n_gathered = diffuse_map_->gather(sp.p_, gathered.get(), n_max_gather_, radius_2); //we always collected all the photon inside the radius
 			}
 
 			if(n_gathered > 0 && logger_.isDebug())
@@ -686,11 +685,11 @@ GatherInfo SppmIntegrator::traceGatherRay(Ray &ray, HitPoint &hp, RandomGenerato
 				for(int i = 0; i < n_gathered; ++i)
 				{
 					////test if the photon is in the ellipsoid
-					//vector3d_t scale  = sp->P - gathered[i].photon->pos;
+					//vector3d_t scale  = sp.P - gathered[i].photon->pos;
 					//vector3d_t temp;
-					//temp.x = scale VDOT sp->NU;
-					//temp.y = scale VDOT sp->NV;
-					//temp.z = scale VDOT sp->N;
+					//temp.x = scale VDOT sp.NU;
+					//temp.y = scale VDOT sp.NV;
+					//temp.z = scale VDOT sp.N;
 
 					//double inv_radi = 1 / sqrt(radius2);
 					//temp.x  *= inv_radi; temp.y *= inv_radi; temp.z *=  1. / (2.f * scene->rayMinDist);
@@ -698,9 +697,9 @@ GatherInfo SppmIntegrator::traceGatherRay(Ray &ray, HitPoint &hp, RandomGenerato
 
 					g_info.photon_count_++;
 					Vec3 pdir{gathered[i].photon_->direction()};
-					Rgb surf_col = sp->eval(wo, pdir, BsdfFlags::Diffuse); // seems could speed up using rho, (something pbrt made)
-					g_info.photon_flux_ += Rgba{surf_col * gathered[i].photon_->color()};// * std::abs(sp->N*pdir); //< wrong!?
-					//Rgb  flux= surfCol * gathered[i].photon->color();// * std::abs(sp->N*pdir); //< wrong!?
+					Rgb surf_col = sp.eval(wo, pdir, BsdfFlags::Diffuse); // seems could speed up using rho, (something pbrt made)
+					g_info.photon_flux_ += Rgba{surf_col * gathered[i].photon_->color()};// * std::abs(sp.N*pdir); //< wrong!?
+					//Rgb  flux= surfCol * gathered[i].photon->color();// * std::abs(sp.N*pdir); //< wrong!?
 
 					////start refine here
 					//double ALPHA = 0.7;
@@ -716,7 +715,7 @@ GatherInfo SppmIntegrator::traceGatherRay(Ray &ray, HitPoint &hp, RandomGenerato
 			{
 
 				radius_2 = hp.radius_2_; //reset radius2 & nGathered
-				n_gathered = caustic_map_->gather(sp->p_, gathered.get(), n_max_gather_, radius_2);
+				n_gathered = caustic_map_->gather(sp.p_, gathered.get(), n_max_gather_, radius_2);
 				if(n_gathered > 0)
 				{
 					Rgb surf_col(0.f);
@@ -724,9 +723,9 @@ GatherInfo SppmIntegrator::traceGatherRay(Ray &ray, HitPoint &hp, RandomGenerato
 					{
 						Vec3 pdir{gathered[i].photon_->direction()};
 						g_info.photon_count_++;
-						surf_col = sp->eval(wo, pdir, BsdfFlags::All); // seems could speed up using rho, (something pbrt made)
-						g_info.photon_flux_ += Rgba{surf_col * gathered[i].photon_->color()};// * std::abs(sp->N*pdir); //< wrong!?//gInfo.photonFlux += colorPasses.probe_add(PASS_INT_DIFFUSE_INDIRECT, surfCol * gathered[i].photon->color(), state.ray_level == 0);// * std::abs(sp->N*pdir); //< wrong!?
-						//Rgb  flux= surfCol * gathered[i].photon->color();// * std::abs(sp->N*pdir); //< wrong!?
+						surf_col = sp.eval(wo, pdir, BsdfFlags::All); // seems could speed up using rho, (something pbrt made)
+						g_info.photon_flux_ += Rgba{surf_col * gathered[i].photon_->color()};// * std::abs(sp.N*pdir); //< wrong!?//gInfo.photonFlux += colorPasses.probe_add(PASS_INT_DIFFUSE_INDIRECT, surfCol * gathered[i].photon->color(), state.ray_level == 0);// * std::abs(sp.N*pdir); //< wrong!?
+						//Rgb  flux= surfCol * gathered[i].photon->color();// * std::abs(sp.N*pdir); //< wrong!?
 
 						////start refine here
 						//double ALPHA = 0.7;
@@ -775,12 +774,12 @@ GatherInfo SppmIntegrator::traceGatherRay(Ray &ray, HitPoint &hp, RandomGenerato
 					++branch;
 					Sample s(0.5f, 0.5f, BsdfFlags::Reflect | BsdfFlags::Transmit | BsdfFlags::Dispersive);
 					Vec3 wi;
-					Rgb mcol = sp->sample(wo, wi, s, w, chromatic_enabled, wavelength_dispersive, camera_);
+					Rgb mcol = sp.sample(wo, wi, s, w, chromatic_enabled, wavelength_dispersive, camera_);
 
 					if(s.pdf_ > 1.0e-6f && s.sampled_flags_.hasAny(BsdfFlags::Dispersive))
 					{
 						const Rgb wl_col = spectrum::wl2Rgb(wavelength_dispersive);
-						ref_ray = Ray(sp->p_, wi, ray_min_dist_);
+						ref_ray = Ray(sp.p_, wi, ray_min_dist_, -1.f, ray.time_);
 						t_cing = traceGatherRay(ref_ray, hp, random_generator, nullptr, thread_id, ray_level, false, wavelength_dispersive, ray_division_new, pixel_sampling_data);
 						t_cing.photon_flux_ *= Rgba{mcol * wl_col * w};
 						t_cing.constant_randiance_ *= Rgba{mcol * wl_col * w};
@@ -793,7 +792,7 @@ GatherInfo SppmIntegrator::traceGatherRay(Ray &ray, HitPoint &hp, RandomGenerato
 				}
 				if(mat_bsdfs.hasAny(BsdfFlags::Volumetric))
 				{
-					if(const VolumeHandler *vol = sp->material_->getVolumeHandler(sp->ng_ * ref_ray.dir_ < 0))
+					if(const VolumeHandler *vol = sp.material_->getVolumeHandler(sp.ng_ * ref_ray.dir_ < 0))
 					{
 						const Rgb vcol = vol->transmittance(ref_ray);
 						cing.photon_flux_ *= Rgba{vcol};
@@ -846,17 +845,17 @@ GatherInfo SppmIntegrator::traceGatherRay(Ray &ray, HitPoint &hp, RandomGenerato
 
 					Sample s(s_1, s_2, BsdfFlags::AllGlossy);
 					Vec3 wi;
-					Rgb mcol = sp->sample(wo, wi, s, W, chromatic_enabled, wavelength, camera_);
+					Rgb mcol = sp.sample(wo, wi, s, W, chromatic_enabled, wavelength, camera_);
 
 					if(mat_bsdfs.hasAny(BsdfFlags::Reflect) && !mat_bsdfs.hasAny(BsdfFlags::Transmit))
 					{
 						float w = 0.f;
 
 						Sample s(s_1, s_2, BsdfFlags::Glossy | BsdfFlags::Reflect);
-						const Rgb mcol = sp->sample(wo, wi, s, w, chromatic_enabled, wavelength, camera_);
-						Ray ref_ray = Ray(sp->p_, wi, ray_min_dist_);
-						if(s.sampled_flags_.hasAny(BsdfFlags::Reflect)) ref_ray.differentials_ = sp->reflectedRay(ray.differentials_.get(), ray.dir_, ref_ray.dir_);
-						else if(s.sampled_flags_.hasAny(BsdfFlags::Transmit)) ref_ray.differentials_ = sp->refractedRay(ray.differentials_.get(), ray.dir_, ref_ray.dir_, sp->material_->getMatIor());
+						const Rgb mcol = sp.sample(wo, wi, s, w, chromatic_enabled, wavelength, camera_);
+						Ray ref_ray = Ray(sp.p_, wi, ray_min_dist_, -1.f, ray.time_);
+						if(s.sampled_flags_.hasAny(BsdfFlags::Reflect)) sp.reflectedRay(ray, ref_ray);
+						else if(s.sampled_flags_.hasAny(BsdfFlags::Transmit)) sp.refractedRay(ray, ref_ray, sp.material_->getMatIor());
 						//gcol += tmpColorPasses.probe_add(PASS_INT_GLOSSY_INDIRECT, (Rgb)integ * mcol * W, state.ray_level == 1);
 						GatherInfo trace_gather_ray = traceGatherRay(ref_ray, hp, random_generator, nullptr, thread_id, ray_level, chromatic_enabled, wavelength, ray_division_new, pixel_sampling_data);
 						trace_gather_ray.photon_flux_ *= Rgba{mcol * w};
@@ -869,11 +868,11 @@ GatherInfo SppmIntegrator::traceGatherRay(Ray &ray, HitPoint &hp, RandomGenerato
 						Rgb mcol[2];
 						float w[2];
 						Vec3 dir[2];
-						mcol[0] = sp->sample(wo, dir, mcol[1], s, w, chromatic_enabled, wavelength);
+						mcol[0] = sp.sample(wo, dir, mcol[1], s, w, chromatic_enabled, wavelength);
 						if(s.sampled_flags_.hasAny(BsdfFlags::Reflect) && !s.sampled_flags_.hasAny(BsdfFlags::Dispersive))
 						{
-							Ray ref_ray = Ray(sp->p_, dir[0], ray_min_dist_);
-							ref_ray.differentials_ = sp->reflectedRay(ray.differentials_.get(), ray.dir_, ref_ray.dir_);
+							Ray ref_ray = Ray(sp.p_, dir[0], ray_min_dist_, -1.f, ray.time_);
+							sp.reflectedRay(ray, ref_ray);
 							const Rgb col_reflect_factor = mcol[0] * w[0];
 							GatherInfo trace_gather_ray = traceGatherRay(ref_ray, hp, random_generator, nullptr, thread_id, ray_level, chromatic_enabled, wavelength, ray_division_new, pixel_sampling_data);
 							trace_gather_ray.photon_flux_ *= Rgba{col_reflect_factor};
@@ -887,8 +886,8 @@ GatherInfo SppmIntegrator::traceGatherRay(Ray &ray, HitPoint &hp, RandomGenerato
 
 						if(s.sampled_flags_.hasAny(BsdfFlags::Transmit))
 						{
-							Ray ref_ray = Ray(sp->p_, dir[1], ray_min_dist_);
-							ref_ray.differentials_ = sp->refractedRay(ray.differentials_.get(), ray.dir_, ref_ray.dir_, sp->material_->getMatIor());
+							Ray ref_ray = Ray(sp.p_, dir[1], ray_min_dist_, -1.f, ray.time_);
+							sp.refractedRay(ray, ref_ray, sp.material_->getMatIor());
 							const Rgb col_transmit_factor = mcol[1] * w[1];
 							GatherInfo trace_gather_ray = traceGatherRay(ref_ray, hp, random_generator, nullptr, thread_id, ray_level, chromatic_enabled, wavelength, ray_division_new, pixel_sampling_data);
 							trace_gather_ray.photon_flux_ *= Rgba{col_transmit_factor};
@@ -903,11 +902,11 @@ GatherInfo SppmIntegrator::traceGatherRay(Ray &ray, HitPoint &hp, RandomGenerato
 
 					else if(s.sampled_flags_.hasAny(BsdfFlags::Glossy))
 					{
-						Ray ref_ray = Ray(sp->p_, wi, ray_min_dist_);
-						if(ray.differentials_)
+						Ray ref_ray = Ray(sp.p_, wi, ray_min_dist_, -1.f, ray.time_);
+						if(ray.hasDifferentials())
 						{
-							if(s.sampled_flags_.hasAny(BsdfFlags::Reflect)) ref_ray.differentials_ = sp->reflectedRay(ray.differentials_.get(), ray.dir_, ref_ray.dir_);
-							else if(s.sampled_flags_.hasAny(BsdfFlags::Transmit)) ref_ray.differentials_ = sp->refractedRay(ray.differentials_.get(), ray.dir_, ref_ray.dir_, sp->material_->getMatIor());
+							if(s.sampled_flags_.hasAny(BsdfFlags::Reflect)) sp.reflectedRay(ray, ref_ray);
+							else if(s.sampled_flags_.hasAny(BsdfFlags::Transmit)) sp.refractedRay(ray, ref_ray, sp.material_->getMatIor());
 						}
 
 						GatherInfo trace_gather_ray = traceGatherRay(ref_ray, hp, random_generator, nullptr, thread_id, ray_level, chromatic_enabled, wavelength, ray_division_new, pixel_sampling_data);
@@ -921,8 +920,8 @@ GatherInfo SppmIntegrator::traceGatherRay(Ray &ray, HitPoint &hp, RandomGenerato
 					}
 					if(mat_bsdfs.hasAny(BsdfFlags::Volumetric))
 					{
-						const Ray ref_ray = Ray(sp->p_, wi, ray_min_dist_);
-						if(const VolumeHandler *vol = sp->material_->getVolumeHandler(sp->ng_ * ref_ray.dir_ < 0))
+						const Ray ref_ray = Ray(sp.p_, wi, ray_min_dist_, -1.f, ray.time_);
+						if(const VolumeHandler *vol = sp.material_->getVolumeHandler(sp.ng_ * ref_ray.dir_ < 0))
 						{
 							const Rgb vcol = vol->transmittance(ref_ray);
 							gather_info.photon_flux_ *= Rgba{vcol};
@@ -955,15 +954,15 @@ GatherInfo SppmIntegrator::traceGatherRay(Ray &ray, HitPoint &hp, RandomGenerato
 			//...perfect specular reflection/refraction with recursive raytracing...
 			if(mat_bsdfs.hasAny(BsdfFlags::Specular | BsdfFlags::Filter))
 			{
-				const Specular specular = sp->getSpecular(ray_level, wo, chromatic_enabled, wavelength);
+				const Specular specular = sp.getSpecular(ray_level, wo, chromatic_enabled, wavelength);
 				if(specular.reflect_)
 				{
-					Ray ref_ray(sp->p_, specular.reflect_->dir_, ray_min_dist_);
-					if(ray.differentials_) ref_ray.differentials_ = sp->reflectedRay(ray.differentials_.get(), ray.dir_, ref_ray.dir_); // compute the ray differentaitl
+					Ray ref_ray(sp.p_, specular.reflect_->dir_, ray_min_dist_, -1.f, ray.time_);
+					if(ray.hasDifferentials()) sp.reflectedRay(ray, ref_ray); // compute the ray differentaitl
 					GatherInfo refg = traceGatherRay(ref_ray, hp, random_generator, nullptr, thread_id, ray_level, chromatic_enabled, wavelength, ray_division, pixel_sampling_data);
 					if(mat_bsdfs.hasAny(BsdfFlags::Volumetric))
 					{
-						if(const VolumeHandler *vol = sp->material_->getVolumeHandler(sp->ng_ * ref_ray.dir_ < 0))
+						if(const VolumeHandler *vol = sp.material_->getVolumeHandler(sp.ng_ * ref_ray.dir_ < 0))
 						{
 							const Rgb vcol = vol->transmittance(ref_ray);
 							refg.constant_randiance_ *= Rgba{vcol};
@@ -981,12 +980,12 @@ GatherInfo SppmIntegrator::traceGatherRay(Ray &ray, HitPoint &hp, RandomGenerato
 				}
 				if(specular.refract_)
 				{
-					Ray ref_ray(sp->p_, specular.refract_->dir_, ray_min_dist_);
-					if(ray.differentials_) ref_ray.differentials_ = sp->refractedRay(ray.differentials_.get(), ray.dir_, ref_ray.dir_, sp->material_->getMatIor());
+					Ray ref_ray(sp.p_, specular.refract_->dir_, ray_min_dist_, -1.f, ray.time_);
+					if(ray.hasDifferentials()) sp.refractedRay(ray, ref_ray, sp.material_->getMatIor());
 					GatherInfo refg = traceGatherRay(ref_ray, hp, random_generator, nullptr, thread_id, ray_level, chromatic_enabled, wavelength, ray_division, pixel_sampling_data);
 					if(mat_bsdfs.hasAny(BsdfFlags::Volumetric))
 					{
-						if(const VolumeHandler *vol = sp->material_->getVolumeHandler(sp->ng_ * ref_ray.dir_ < 0))
+						if(const VolumeHandler *vol = sp.material_->getVolumeHandler(sp.ng_ * ref_ray.dir_ < 0))
 						{
 							const Rgb vcol = vol->transmittance(ref_ray);
 							refg.constant_randiance_ *= Rgba{vcol};
@@ -1007,12 +1006,12 @@ GatherInfo SppmIntegrator::traceGatherRay(Ray &ray, HitPoint &hp, RandomGenerato
 		}
 		if(color_layers)
 		{
-			generateCommonLayers(color_layers, *sp, mask_params_);
-			generateOcclusionLayers(color_layers, *accelerator_, chromatic_enabled, wavelength, ray_division, camera_, pixel_sampling_data, *sp, wo, ao_samples_, shadow_bias_auto_, shadow_bias_, ao_dist_, ao_col_, s_depth_);
+			generateCommonLayers(color_layers, sp, mask_params_);
+			generateOcclusionLayers(color_layers, *accelerator_, chromatic_enabled, wavelength, ray_division, camera_, pixel_sampling_data, sp, wo, ao_samples_, shadow_bias_auto_, shadow_bias_, ao_dist_, ao_col_, s_depth_);
 		}
 		if(transp_refracted_background_)
 		{
-			const float mat_alpha = sp->getAlpha(wo, camera_);
+			const float mat_alpha = sp.getAlpha(wo, camera_);
 			alpha = mat_alpha + (1.f - mat_alpha) * alpha;
 		}
 		else alpha = 1.f;
@@ -40,6 +40,7 @@
 #include "render/render_data.h"
 #include "image/image_output.h"
 #include "accelerator/accelerator.h"
+#include "geometry/ray_stream.h"
 #include "photon/photon.h"
 
 BEGIN_YAFARAY
@@ -83,8 +84,9 @@ void TiledIntegrator::precalcDepths()
 			for(int j = 0; j < w; ++j)
 			{
 				CameraRay camera_ray = camera_->shootRay(i, j, 0.5f, 0.5f);
-				std::unique_ptr<const SurfacePoint> sp;
-				std::tie(sp, camera_ray.ray_.tmax_) = accelerator_->intersect(camera_ray.ray_, camera_);
+				SurfacePoint sp;
+				bool hit;
+				std::tie(hit, camera_ray.ray_.tmax_) = accelerator_->intersect(camera_ray.ray_, camera_, sp);
 				if(camera_ray.ray_.tmax_ > max_depth_) max_depth_ = camera_ray.ray_.tmax_;
 				if(camera_ray.ray_.tmax_ < min_depth_ && camera_ray.ray_.tmax_ >= 0.f) min_depth_ = camera_ray.ray_.tmax_;
 			}
@@ -321,7 +323,7 @@ bool TiledIntegrator::renderTile(const RenderArea &a, int n_samples, int offset,
 
 				const float time = math::addMod1(static_cast<float>(sample) * d_1, toff); //(0.5+(float)sample)*d1;
 				// the (1/n, Larcher&Pillichshammer-Seq.) only gives good coverage when total sample count is known
-				// hence we use scrambled (Sobol, van-der-Corput) for multipass AA  //!< the current (normalized) frame time  //FIXME, time not currently used in libYafaRay
+				// hence we use scrambled (Sobol, van-der-Corput) for multipass AA  //!< the current (normalized) frame time
 				float dx = 0.5f, dy = 0.5f;
 				if(aa_noise_params_.passes_ > 1)
 				{
@@ -348,13 +350,9 @@ bool TiledIntegrator::renderTile(const RenderArea &a, int n_samples, int offset,
 				if(render_control_.getDifferentialRaysEnabled())
 				{
 					//setup ray differentials
-					camera_ray.ray_.differentials_ = std::unique_ptr<RayDifferentials>(new RayDifferentials());
 					const CameraRay camera_diff_ray_x = camera_->shootRay(j + 1 + dx, i + dy, lens_u, lens_v);
-					camera_ray.ray_.differentials_->xfrom_ = camera_diff_ray_x.ray_.from_;
-					camera_ray.ray_.differentials_->xdir_ = camera_diff_ray_x.ray_.dir_;
 					const CameraRay camera_diff_ray_y = camera_->shootRay(j + dx, i + 1 + dy, lens_u, lens_v);
-					camera_ray.ray_.differentials_->yfrom_ = camera_diff_ray_y.ray_.from_;
-					camera_ray.ray_.differentials_->ydir_ = camera_diff_ray_y.ray_.dir_;
+					camera_ray.ray_.setDifferentials({camera_diff_ray_x.ray_.from_, camera_diff_ray_x.ray_.dir_, camera_diff_ray_y.ray_.from_, camera_diff_ray_y.ray_.dir_});
 				}
 				camera_ray.ray_.time_ = time;
 				RayDivision ray_division;
@@ -467,19 +465,19 @@ void TiledIntegrator::generateCommonLayers(ColorLayers *color_layers, const Surf
 			{
 				if(Rgba *color_layer = color_layers->find(LayerDef::DebugDpLengths))
 				{
-					if(sp.differentials_) *color_layer = Rgba(sp.differentials_->dp_dx_.length(), sp.differentials_->dp_dy_.length(), 0.f, 1.f);
+					if(const SurfaceDifferentials *differentials = sp.getDifferentials()) *color_layer = Rgba(differentials->dp_dx_.length(), differentials->dp_dy_.length(), 0.f, 1.f);
 				}
 				if(Rgba *color_layer = color_layers->find(LayerDef::DebugDpdx))
 				{
-					if(sp.differentials_) *color_layer = Rgba((sp.differentials_->dp_dx_.x() + 1.f) * .5f, (sp.differentials_->dp_dx_.y() + 1.f) * .5f, (sp.differentials_->dp_dx_.z() + 1.f) * .5f, 1.f);
+					if(const SurfaceDifferentials *differentials = sp.getDifferentials()) *color_layer = Rgba((differentials->dp_dx_.x() + 1.f) * .5f, (differentials->dp_dx_.y() + 1.f) * .5f, (differentials->dp_dx_.z() + 1.f) * .5f, 1.f);
 				}
 				if(Rgba *color_layer = color_layers->find(LayerDef::DebugDpdy))
 				{
-					if(sp.differentials_) *color_layer = Rgba((sp.differentials_->dp_dy_.x() + 1.f) * .5f, (sp.differentials_->dp_dy_.y() + 1.f) * .5f, (sp.differentials_->dp_dy_.z() + 1.f) * .5f, 1.f);
+					if(const SurfaceDifferentials *differentials = sp.getDifferentials()) *color_layer = Rgba((differentials->dp_dy_.x() + 1.f) * .5f, (differentials->dp_dy_.y() + 1.f) * .5f, (differentials->dp_dy_.z() + 1.f) * .5f, 1.f);
 				}
 				if(Rgba *color_layer = color_layers->find(LayerDef::DebugDpdxy))
 				{
-					if(sp.differentials_) *color_layer = Rgba((sp.differentials_->dp_dx_.x() + sp.differentials_->dp_dy_.x() + 1.f) * .5f, (sp.differentials_->dp_dx_.y() + sp.differentials_->dp_dy_.y() + 1.f) * .5f, (sp.differentials_->dp_dx_.z() + sp.differentials_->dp_dy_.z() + 1.f) * .5f, 1.f);
+					if(const SurfaceDifferentials *differentials = sp.getDifferentials()) *color_layer = Rgba((differentials->dp_dx_.x() + differentials->dp_dy_.x() + 1.f) * .5f, (differentials->dp_dx_.y() + differentials->dp_dy_.y() + 1.f) * .5f, (differentials->dp_dx_.z() + differentials->dp_dy_.z() + 1.f) * .5f, 1.f);
 				}
 				if(color_layers->isDefinedAny({LayerDef::DebugDudxDvdx, LayerDef::DebugDudyDvdy, LayerDef::DebugDudxyDvdxy}))
 				{
@@ -645,12 +643,32 @@ Rgb TiledIntegrator::sampleAmbientOcclusion(const Accelerator &accelerator, bool
 {
 	Rgb col{0.f};
 	const BsdfFlags &mat_bsdfs = sp.mat_data_->bsdf_flags_;
-	Ray light_ray{sp.p_, Vec3{0.f}};
+	Ray light_ray{sp.p_, Vec3{0.f}, 0.f, -1.f, sp.intersect_data_.time_};
 	int n = ao_samples;//(int) ceilf(aoSamples*getSampleMultiplier());
 	if(ray_division.division_ > 1) n = std::max(1, n / ray_division.division_);
 	const unsigned int offs = n * pixel_sampling_data.sample_ + pixel_sampling_data.offset_;
 	Halton hal_2(2, offs - 1);
 	Halton hal_3(3, offs - 1);
+	struct OcclusionSample
+	{
+		Rgb surface_color_;
+		float cos_;
+		float w_;
+		float pdf_;
+	};
+	//The samples, rays and results arrays of each thread are reused, so the occlusion of each surface point does not allocate memory
+	struct OcclusionBatch
+	{
+		std::vector<OcclusionSample> samples_;
+		RayStream rays_;
+		std::vector<AcceleratorIntersectData> shadow_results_;
+		std::vector<AcceleratorTsIntersectData> transparent_shadow_results_;
+	};
+	static thread_local OcclusionBatch occlusion_batch;
+	std::vector<OcclusionSample> &occlusion_samples = occlusion_batch.samples_;
+	RayStream &occlusion_rays = occlusion_batch.rays_;
+	occlusion_samples.clear();
+	occlusion_rays.clear();
 	for(int i = 0; i < n; ++i)
 	{
 		float s_1 = hal_2.getNext();
@@ -672,21 +690,26 @@ Rgb TiledIntegrator::sampleAmbientOcclusion(const Accelerator &accelerator, bool
 							 sp.material_->sampleClay(sp, wo, light_ray.dir_, s, w) :
 							 sp.sample(wo, light_ray.dir_, s, w, chromatic_enabled, wavelength, camera);
 		if(clay) s.pdf_ = 1.f;
+		occlusion_samples.push_back({surf_col, std::abs(sp.n_ * light_ray.dir_), w, s.pdf_});
+		occlusion_rays.pushShadowRay(light_ray);
+	}
+	//The occlusion rays of all the samples are traced together, so the accelerator can trace them in packets
+	std::vector<AcceleratorTsIntersectData> &transparent_shadow_results = occlusion_batch.transparent_shadow_results_;
+	std::vector<AcceleratorIntersectData> &shadow_results = occlusion_batch.shadow_results_;
+	if(transparent_shadows) accelerator.isShadowed(occlusion_rays, transp_shadows_depth, shadow_bias, camera, transparent_shadow_results);
+	else accelerator.isShadowed(occlusion_rays, shadow_bias, shadow_results);
+	for(int i = 0; i < n; ++i)
+	{
+		const OcclusionSample &occlusion_sample = occlusion_samples[i];
 		if(mat_bsdfs.hasAny(BsdfFlags::Emit))
 		{
-			col += sp.emit(wo) * s.pdf_;
+			col += sp.emit(wo) * occlusion_sample.pdf_;
 		}
-		bool shadowed = false;
-		Rgb scol {0.f};
-		const Primitive *shadow_casting_primitive = nullptr;
-		if(transparent_shadows) std::tie(shadowed, scol, shadow_casting_primitive) = accelerator.isShadowed(light_ray, transp_shadows_depth, shadow_bias, camera);
-		else std::tie(shadowed, shadow_casting_primitive) = accelerator.isShadowed(light_ray, shadow_bias);
-		if(!shadowed)
+		if(transparent_shadows)
 		{
-			const float cos = std::abs(sp.n_ * light_ray.dir_);
-			if(transparent_shadows) col += ao_col * scol * surf_col * cos * w;
-			else col += ao_col * surf_col * cos * w;
+			if(!transparent_shadow_results[i].hit_) col += ao_col * transparent_shadow_results[i].transparent_color_ * occlusion_sample.surface_color_ * occlusion_sample.cos_ * occlusion_sample.w_;
 		}
+		else if(!shadow_results[i].hit_) col += ao_col * occlusion_sample.surface_color_ * occlusion_sample.cos_ * occlusion_sample.w_;
 	}
 	return col / static_cast<float>(n);
 }
@@ -154,6 +154,14 @@ int ExportC::addVertex(double x, double y, double z, double ox, double oy, doubl
 	return 0;
 }
 
+int ExportC::addVertexTimeStep(double x, double y, double z, int time_step) noexcept
+{
+	file_ << "\t" << "yafaray_addVertexTimeStep(yi, " << x << ", " << y << ", " << z << ", " << time_step << ");\n";
+	++section_num_lines_;
+	if(section_num_lines_ >= section_max_lines_) file_ << sectionSplit();
+	return 0;
+}
+
 void ExportC::addNormal(double x, double y, double z) noexcept
 {
 	file_ << "\t" << "yafaray_addNormal(yi, " << x << ", " << y << ", " << z << ");\n";
@@ -204,6 +212,19 @@ bool ExportC::smoothMesh(const char *name, double angle) noexcept
 	return true;
 }
 
+bool ExportC::updateObjectPoints(const char *name, const float *points, int num_points) noexcept
+{
+	file_ << "\t" << "{\n";
+	file_ << "\t\t" << "const float points[] = {";
+	for(int coordinate = 0; coordinate < 3 * num_points; ++coordinate) file_ << (coordinate > 0 ? ", " : " ") << points[coordinate];
+	file_ << " };\n";
+	file_ << "\t\t" << "yafaray_updateObjectPoints(yi, \"" << name << "\", points, " << num_points << ");\n";
+	file_ << "\t" << "}\n\n";
+	++section_num_lines_;
+	if(section_num_lines_ >= section_max_lines_) file_ << sectionSplit();
+	return true;
+}
+
 void ExportC::writeMatrix(const std::string &name, const Matrix4 &m, std::ofstream &file) noexcept
 {
 	file << "\"" << name << "\", " <<
@@ -277,6 +298,25 @@ bool ExportC::addInstance(const char *base_object_name, const Matrix4 &obj_to_wo
 	return true;
 }
 
+bool ExportC::addInstanceTimeSteps(const char *base_object_name, const std::vector<Matrix4> &obj_to_world_time_steps) noexcept
+{
+	file_ << "\t" << "{\n";
+	file_ << "\t\t" << "const float obj_to_world_time_steps[][4][4] = {";
+	for(size_t time_step = 0; time_step < obj_to_world_time_steps.size(); ++time_step)
+	{
+		const Matrix4 &m = obj_to_world_time_steps[time_step];
+		file_ << (time_step > 0 ? ", " : " ") << "{";
+		for(int row = 0; row < 4; ++row) file_ << (row > 0 ? ", " : " ") << "{" << m[row][0] << ", " << m[row][1] << ", " << m[row][2] << ", " << m[row][3] << "}";
+		file_ << " }";
+	}
+	file_ << " };\n";
+	file_ << "\t\t" << "yafaray_addInstanceTimeSteps(yi, \"" << base_object_name << "\", obj_to_world_time_steps, " << obj_to_world_time_steps.size() << ");\n";
+	file_ << "\t" << "}\n";
+	++section_num_lines_;
+	if(section_num_lines_ >= section_max_lines_) file_ << sectionSplit();
+	return true;
+}
+
 void ExportC::writeParamMap(const ParamMap &param_map, int indent) noexcept
 {
 	const std::string tabs(indent, '\t');
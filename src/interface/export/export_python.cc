@@ -104,6 +104,12 @@ int ExportPython::addVertex(double x, double y, double z, double ox, double oy,
 	return 0;
 }
 
+int ExportPython::addVertexTimeStep(double x, double y, double z, int time_step) noexcept
+{
+	file_ << "yi.addVertexTimeStep(" << x << ", " << y << ", " << z << ", " << time_step << ")\n";
+	return 0;
+}
+
 void ExportPython::addNormal(double x, double y, double z) noexcept
 {
 	file_ << "yi.addNormal(" << x << ", " << y << ", " << z << ")\n";
@@ -143,6 +149,14 @@ bool ExportPython::smoothMesh(const char *name, double angle) noexcept
 	return true;
 }
 
+bool ExportPython::updateObjectPoints(const char *name, const float *points, int num_points) noexcept
+{
+	file_ << "yi.updateObjectPoints(\"" << name << "\", [";
+	for(int coordinate = 0; coordinate < 3 * num_points; ++coordinate) file_ << (coordinate > 0 ? ", " : "") << points[coordinate];
+	file_ << "], " << num_points << ")\n";
+	return true;
+}
+
 void ExportPython::writeMatrix(const std::string &name, const Matrix4 &m, std::ofstream &file) noexcept
 {
 
@@ -215,6 +229,20 @@ bool ExportPython::addInstance(const char *base_object_name, const Matrix4 &obj_
 	return true;
 }
 
+bool ExportPython::addInstanceTimeSteps(const char *base_object_name, const std::vector<Matrix4> &obj_to_world_time_steps) noexcept
+{
+	file_ << "yi.addInstanceTimeSteps(\"" << base_object_name << "\", [";
+	for(size_t time_step = 0; time_step < obj_to_world_time_steps.size(); ++time_step)
+	{
+		const Matrix4 &m = obj_to_world_time_steps[time_step];
+		file_ << (time_step > 0 ? ", " : "") << "[";
+		for(int row = 0; row < 4; ++row) file_ << (row > 0 ? ", " : "") << "[" << m[row][0] << ", " << m[row][1] << ", " << m[row][2] << ", " << m[row][3] << "]";
+		file_ << "]";
+	}
+	file_ << "])\n";
+	return true;
+}
+
 void ExportPython::writeParamMap(const ParamMap &param_map, int indent) noexcept
 {
 	//const std::string tabs(indent, '\t');
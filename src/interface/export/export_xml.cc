@@ -96,6 +96,12 @@ int ExportXml::addVertex(double x, double y, double z, double ox, double oy, dou
 	return 0;
 }
 
+int ExportXml::addVertexTimeStep(double x, double y, double z, int time_step) noexcept
+{
+	file_ << "\t<p x=\"" << x << "\" y=\"" << y << "\" z=\"" << z << "\" time_step=\"" << time_step << "\"/>\n";
+	return 0;
+}
+
 void ExportXml::addNormal(double x, double y, double z) noexcept
 {
 	file_ << "\t<n x=\"" << x << "\" y=\"" << y << "\" z=\"" << z << "\"/>\n";
@@ -136,6 +142,14 @@ bool ExportXml::smoothMesh(const char *name, double angle) noexcept
 	return true;
 }
 
+bool ExportXml::updateObjectPoints(const char *name, const float *points, int num_points) noexcept
+{
+	file_ << "<update_points object_name=\"" << name << "\">\n";
+	for(int point_num = 0; point_num < num_points; ++point_num) file_ << "\t<p x=\"" << points[3 * point_num] << "\" y=\"" << points[3 * point_num + 1] << "\" z=\"" << points[3 * point_num + 2] << "\"/>\n";
+	file_ << "</update_points>\n";
+	return true;
+}
+
 void ExportXml::writeMatrix(const std::string &name, const Matrix4 &m, std::ofstream &file) noexcept
 {
 	file << "<" << name << " m00=\"" << m[0][0] << "\" m01=\"" << m[0][1] << "\" m02=\"" << m[0][2] << "\" m03=\"" << m[0][3] << "\""
@@ -204,6 +218,19 @@ bool ExportXml::addInstance(const char *base_object_name, const Matrix4 &obj_to_
 	return true;
 }
 
+bool ExportXml::addInstanceTimeSteps(const char *base_object_name, const std::vector<Matrix4> &obj_to_world_time_steps) noexcept
+{
+	file_ << "\n<instance base_object_name=\"" << base_object_name << "\" >\n";
+	for(const auto &obj_to_world : obj_to_world_time_steps)
+	{
+		file_ << "\t";
+		writeMatrix("transform", obj_to_world, file_);
+		file_ << "\n";
+	}
+	file_ << "</instance>\n";
+	return true;
+}
+
 void ExportXml::writeParamMap(const ParamMap &param_map, int indent) noexcept
 {
 	const std::string tabs(indent, '\t');
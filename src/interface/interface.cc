@@ -19,8 +19,10 @@
 #include "interface/interface.h"
 #include "common/version_build_info.h"
 #include "common/logger.h"
+#include "common/external_buffer.h"
 #include "scene/scene.h"
 #include "geometry/matrix4.h"
+#include "geometry/uv.h"
 #include "render/imagefilm.h"
 #include "common/param.h"
 #include "image/image_output.h"
@@ -91,6 +93,11 @@ int  Interface::addVertex(double x, double y, double z, double ox, double oy, do
 	return scene_->addVertex({static_cast<float>(x), static_cast<float>(y), static_cast<float>(z)}, {static_cast<float>(ox), static_cast<float>(oy), static_cast<float>(oz)});
 }
 
+int  Interface::addVertexTimeStep(double x, double y, double z, int time_step) noexcept
+{
+	return scene_->addVertexTimeStep({static_cast<float>(x), static_cast<float>(y), static_cast<float>(z)}, time_step);
+}
+
 void Interface::addNormal(double x, double y, double z) noexcept
 {
 	scene_->addNormal({static_cast<float>(x), static_cast<float>(y), static_cast<float>(z)});
@@ -108,13 +115,174 @@ bool Interface::addFace(int a, int b, int c, int uv_a, int uv_b, int uv_c) noexc
 
 int Interface::addUv(float u, float v) noexcept { return scene_->addUv(u, v); }
 
+int Interface::addVertices(const float *points, const float *orco_points, int num_points) noexcept
+{
+	if(!points || num_points < 0) return -1;
+	std::vector<Point3> points_vector;
+	points_vector.reserve(num_points);
+	for(int point_num = 0; point_num < num_points; ++point_num) points_vector.push_back({points[3 * point_num], points[3 * point_num + 1], points[3 * point_num + 2]});
+	std::vector<Point3> orco_points_vector;
+	if(orco_points)
+	{
+		orco_points_vector.reserve(num_points);
+		for(int point_num = 0; point_num < num_points; ++point_num) orco_points_vector.push_back({orco_points[3 * point_num], orco_points[3 * point_num + 1], orco_points[3 * point_num + 2]});
+	}
+	return scene_->addVertices(std::move(points_vector), std::move(orco_points_vector));
+}
+
+bool Interface::addNormals(const float *normals, int num_normals) noexcept
+{
+	if(!normals || num_normals < 0) return false;
+	std::vector<Vec3> normals_vector;
+	normals_vector.reserve(num_normals);
+	for(int normal_num = 0; normal_num < num_normals; ++normal_num) normals_vector.push_back({normals[3 * normal_num], normals[3 * normal_num + 1], normals[3 * normal_num + 2]});
+	return scene_->addNormals(std::move(normals_vector));
+}
+
+/*! Negative indices become out of range unsigned indices, so they are rejected by the mesh */
+bool Interface::addFaces(const int *vertex_indices, const int *uv_indices, int num_faces) noexcept
+{
+	if(!vertex_indices || num_faces < 0) return false;
+	std::vector<uint32_t> vertex_indices_vector(vertex_indices, vertex_indices + 3 * num_faces);
+	std::vector<uint32_t> uv_indices_vector;
+	if(uv_indices) uv_indices_vector.assign(uv_indices, uv_indices + 3 * num_faces);
+	return scene_->addFaces(std::move(vertex_indices_vector), std::move(uv_indices_vector));
+}
+
+int Interface::addUvs(const float *uvs, int num_uvs) noexcept
+{
+	if(!uvs || num_uvs < 0) return -1;
+	std::vector<Uv> uvs_vector;
+	uvs_vector.reserve(num_uvs);
+	for(int uv_num = 0; uv_num < num_uvs; ++uv_num) uvs_vector.push_back({uvs[2 * uv_num], uvs[2 * uv_num + 1]});
+	return scene_->addUvs(std::move(uvs_vector));
+}
+
+/*! The buffer is created first, so the release callback is called even if the arguments are wrong */
+bool Interface::setExternalVertices(const float *points, int stride, int num_points, yafaray_BufferReleaseCallback_t release_callback, void *callback_data) noexcept
+{
+	const size_t buffer_stride = stride == 0 ? 3 * sizeof(float) : static_cast<size_t>(std::max(stride, 0));
+	std::unique_ptr<const ExternalBuffer> buffer(new ExternalBuffer(points, buffer_stride, static_cast<size_t>(std::max(num_points, 0)), release_callback, callback_data));
+	if(num_points < 0) return false;
+	return scene_->setExternalPoints(std::move(buffer));
+}
+
+bool Interface::setExternalTriangles(const int *vertex_indices, int stride, int num_triangles, yafaray_BufferReleaseCallback_t release_callback, void *callback_data) noexcept
+{
+	const size_t buffer_stride = stride == 0 ? 3 * sizeof(int) : static_cast<size_t>(std::max(stride, 0));
+	std::unique_ptr<const ExternalBuffer> buffer(new ExternalBuffer(vertex_indices, buffer_stride, static_cast<size_t>(std::max(num_triangles, 0)), release_callback, callback_data));
+	if(num_triangles < 0) return false;
+	return scene_->setExternalFaces(std::move(buffer));
+}
+
+/*! For the exporters, which write the arrays as individual elements with the virtual functions for a single element */
+int Interface::addVerticesOneByOne(const float *points, const float *orco_points, int num_points) noexcept
+{
+	if(!points || num_points < 0) return -1;
+	int first_vertex = -1;
+	for(int point_num = 0; point_num < num_points; ++point_num)
+	{
+		const float *point = points + 3 * point_num;
+		int vertex_index;
+		if(orco_points)
+		{
+			const float *orco_point = orco_points + 3 * point_num;
+			vertex_index = addVertex(point[0], point[1], point[2], orco_point[0], orco_point[1], orco_point[2]);
+		}
+		else vertex_index = addVertex(point[0], point[1], point[2]);
+		if(point_num == 0) first_vertex = vertex_index;
+	}
+	return first_vertex;
+}
+
+bool Interface::addNormalsOneByOne(const float *normals, int num_normals) noexcept
+{
+	if(!normals || num_normals < 0) return false;
+	for(int normal_num = 0; normal_num < num_normals; ++normal_num) addNormal(normals[3 * normal_num], normals[3 * normal_num + 1], normals[3 * normal_num + 2]);
+	return true;
+}
+
+bool Interface::addFacesOneByOne(const int *vertex_indices, const int *uv_indices, int num_faces) noexcept
+{
+	if(!vertex_indices || num_faces < 0) return false;
+	for(int face_num = 0; face_num < num_faces; ++face_num)
+	{
+		const int *face = vertex_indices + 3 * face_num;
+		if(uv_indices)
+		{
+			const int *face_uv = uv_indices + 3 * face_num;
+			addFace(face[0], face[1], face[2], face_uv[0], face_uv[1], face_uv[2]);
+		}
+		else addFace(face[0], face[1], face[2]);
+	}
+	return true;
+}
+
+int Interface::addUvsOneByOne(const float *uvs, int num_uvs) noexcept
+{
+	if(!uvs || num_uvs < 0) return -1;
+	int first_uv = -1;
+	for(int uv_num = 0; uv_num < num_uvs; ++uv_num)
+	{
+		const int uv_index = addUv(uvs[2 * uv_num], uvs[2 * uv_num + 1]);
+		if(uv_num == 0) first_uv = uv_index;
+	}
+	return first_uv;
+}
+
+bool Interface::setExternalVerticesOneByOne(const float *points, int stride, int num_points, yafaray_BufferReleaseCallback_t release_callback, void *callback_data) noexcept
+{
+	const ExternalBuffer buffer(points, stride == 0 ? 3 * sizeof(float) : static_cast<size_t>(std::max(stride, 0)), static_cast<size_t>(std::max(num_points, 0)), release_callback, callback_data);
+	if(!buffer.isValid<float>(3))
+	{
+		logger_->logError("Interface: external vertices need a buffer with a stride of at least three floats, and both the buffer address and the stride aligned to a float");
+		return false;
+	}
+	for(size_t point_num = 0; point_num < buffer.size(); ++point_num)
+	{
+		const float *point = buffer.get<float>(point_num);
+		addVertex(point[0], point[1], point[2]);
+	}
+	return true;
+}
+
+bool Interface::setExternalTrianglesOneByOne(const int *vertex_indices, int stride, int num_triangles, yafaray_BufferReleaseCallback_t release_callback, void *callback_data) noexcept
+{
+	const ExternalBuffer buffer(vertex_indices, stride == 0 ? 3 * sizeof(int) : static_cast<size_t>(std::max(stride, 0)), static_cast<size_t>(std::max(num_triangles, 0)), release_callback, callback_data);
+	if(!buffer.isValid<int>(3))
+	{
+		logger_->logError("Interface: external triangles need a buffer with a stride of at least three ints, and both the buffer address and the stride aligned to an int");
+		return false;
+	}
+	for(size_t triangle_num = 0; triangle_num < buffer.size(); ++triangle_num)
+	{
+		const int *triangle = buffer.get<int>(triangle_num);
+		addFace(triangle[0], triangle[1], triangle[2]);
+	}
+	return true;
+}
+
 bool Interface::smoothMesh(const char *name, double angle) noexcept { return scene_->smoothNormals(name, angle); }
 
+bool Interface::updateObjectPoints(const char *name, const float *points, int num_points) noexcept
+{
+	if(!points || num_points < 0) return false;
+	std::vector<Point3> points_vector;
+	points_vector.reserve(num_points);
+	for(int point_num = 0; point_num < num_points; ++point_num) points_vector.push_back({points[3 * point_num], points[3 * point_num + 1], points[3 * point_num + 2]});
+	return scene_->updateObjectPoints(name, points_vector);
+}
+
 bool Interface::addInstance(const char *base_object_name, const Matrix4 &obj_to_world) noexcept
 {
 	return scene_->addInstance(base_object_name, obj_to_world);
 }
 
+bool Interface::addInstanceTimeSteps(const char *base_object_name, const std::vector<Matrix4> &obj_to_world_time_steps) noexcept
+{
+	return scene_->addInstance(base_object_name, obj_to_world_time_steps);
+}
+
 void Interface::paramsSetVector(const char *name, double x, double y, double z) noexcept
 {
 	(*cparams_)[std::string(name)] = Parameter{Vec3{static_cast<float>(x), static_cast<float>(y), static_cast<float>(z)}};
@@ -333,6 +501,12 @@ void Interface::render(std::shared_ptr<ProgressBar> progress_bar) noexcept
 	scene_->render();
 }
 
+bool Interface::benchmarkAccelerators(const char *ray_dump_path) noexcept
+{
+	if(!ray_dump_path) return false;
+	return scene_->benchmarkAccelerators(ray_dump_path);
+}
+
 void Interface::enablePrintDateTime(bool value) noexcept
 {
 	logger_->enablePrintDateTime(value);
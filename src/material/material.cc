@@ -153,6 +153,12 @@ bool Material::scatterPhoton(const MaterialData *mat_data, const SurfacePoint &s
 	return false;
 }
 
+Rgb Material::getShadowTransparency(SurfacePoint &sp, const Vec3 &wo, const Camera *camera) const
+{
+	const std::unique_ptr<const MaterialData> mat_data(initBsdf(sp, camera));
+	return getTransparency(mat_data.get(), sp, wo, camera);
+}
+
 Rgb Material::getReflectivity(const MaterialData *mat_data, const SurfacePoint &sp, BsdfFlags flags, bool chromatic, float wavelength, const Camera *camera) const
 {
 	if(!flags.hasAny((BsdfFlags::Transmit | BsdfFlags::Reflect) & bsdf_flags_)) return Rgb{0.f};
@@ -195,12 +195,22 @@ Rgb GlassMaterial::sample(const MaterialData *mat_data, const SurfacePoint &sp,
 }
 
 Rgb GlassMaterial::getTransparency(const MaterialData *mat_data, const SurfacePoint &sp, const Vec3 &wo, const Camera *camera) const
+{
+	return getTransparency(mat_data->node_tree_data_, sp, wo);
+}
+
+Rgb GlassMaterial::getShadowTransparency(SurfacePoint &sp, const Vec3 &wo, const Camera *camera) const
+{
+	return getTransparency(evalTransparencyNodes(sp, bump_shader_, camera), sp, wo);
+}
+
+Rgb GlassMaterial::getTransparency(const NodeTreeData &node_tree_data, const SurfacePoint &sp, const Vec3 &wo) const
 {
 	const Vec3 n{SurfacePoint::normalFaceForward(sp.ng_, sp.n_, wo)};
 	float kr, kt;
-	Vec3::fresnel(wo, n, getShaderScalar(ior_shader_, mat_data->node_tree_data_, ior_), kr, kt);
-	Rgb result = kt * getShaderColor(filter_color_shader_, mat_data->node_tree_data_, filter_color_);
-	applyWireFrame(result, wireframe_shader_, mat_data->node_tree_data_, sp);
+	Vec3::fresnel(wo, n, getShaderScalar(ior_shader_, node_tree_data, ior_), kr, kt);
+	Rgb result = kt * getShaderColor(filter_color_shader_, node_tree_data, filter_color_);
+	applyWireFrame(result, wireframe_shader_, node_tree_data, sp);
 	return result;
 }
 
@@ -407,6 +417,7 @@ const Material *GlassMaterial::factory(Logger &logger, const Scene &scene, const
 			mat->color_nodes_.insert(mat->color_nodes_.end(), shader_nodes_list.begin(), shader_nodes_list.end());
 		}
 		if(mat->bump_shader_) mat->bump_nodes_ = mat->getNodeList(mat->bump_shader_, nodes_sorted);
+		mat->transparency_nodes_ = mat->getNodeList({mat->filter_color_shader_, mat->ior_shader_, mat->wireframe_shader_}, nodes_sorted);
 	}
 	return mat;
 }
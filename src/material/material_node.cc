@@ -92,6 +92,32 @@ std::vector<const ShaderNode *> NodeMaterial::getNodeList(const ShaderNode *root
 	return nodes;
 }
 
+/*! same as getNodeList, for all the nodes in the trees given by several roots. Null roots are skipped */
+std::vector<const ShaderNode *> NodeMaterial::getNodeList(const std::vector<const ShaderNode *> &roots, const std::vector<const ShaderNode *> &nodes_sorted)
+{
+	std::set<const ShaderNode *> in_trees;
+	for(const auto &root : roots)
+	{
+		if(!root) continue;
+		const std::set<const ShaderNode *> in_tree = recursiveFinder(root);
+		in_trees.insert(in_tree.begin(), in_tree.end());
+	}
+	std::vector<const ShaderNode *> nodes;
+	for(const auto &node : nodes_sorted)
+	{
+		if(in_trees.find(node) != in_trees.end()) nodes.push_back(node);
+	}
+	return nodes;
+}
+
+NodeTreeData NodeMaterial::evalTransparencyNodes(SurfacePoint &sp, const ShaderNode *bump_shader_node, const Camera *camera) const
+{
+	NodeTreeData node_tree_data(color_nodes_.size() + bump_nodes_.size());
+	if(bump_shader_node) evalBump(node_tree_data, sp, bump_shader_node, camera);
+	evalNodes(sp, transparency_nodes_, node_tree_data, camera);
+	return node_tree_data;
+}
+
 void NodeMaterial::evalBump(NodeTreeData &node_tree_data, SurfacePoint &sp, const ShaderNode *bump_shader_node, const Camera *camera) const
 {
 	for(const auto &node : bump_nodes_) node->evalDerivative(node_tree_data, sp, camera);
@@ -439,6 +439,17 @@ Specular ShinyDiffuseMaterial::getSpecular(int ray_level, const MaterialData *ma
 }
 
 Rgb ShinyDiffuseMaterial::getTransparency(const MaterialData *mat_data, const SurfacePoint &sp, const Vec3 &wo, const Camera *camera) const
+{
+	return getTransparency(mat_data->node_tree_data_, sp, wo);
+}
+
+Rgb ShinyDiffuseMaterial::getShadowTransparency(SurfacePoint &sp, const Vec3 &wo, const Camera *camera) const
+{
+	if(!is_transparent_) return Rgb{0.f};
+	return getTransparency(evalTransparencyNodes(sp, bump_shader_, camera), sp, wo);
+}
+
+Rgb ShinyDiffuseMaterial::getTransparency(const NodeTreeData &node_tree_data, const SurfacePoint &sp, const Vec3 &wo) const
 {
 	if(!is_transparent_) return Rgb{0.f};
 	float accum = 1.f;
@@ -447,21 +458,21 @@ Rgb ShinyDiffuseMaterial::getTransparency(const MaterialData *mat_data, const Su
 	float cur_ior_squared;
 	if(ior_shader_)
 	{
-		cur_ior_squared = ior_ + ior_shader_->getScalar(mat_data->node_tree_data_);
+		cur_ior_squared = ior_ + ior_shader_->getScalar(node_tree_data);
 		cur_ior_squared *= cur_ior_squared;
 	}
 	else cur_ior_squared = ior_squared_;
 
 	const float kr = getFresnelKr(wo, n, cur_ior_squared);
 
-	if(is_mirror_) accum = 1.f - kr * getShaderScalar(mirror_shader_, mat_data->node_tree_data_, mirror_strength_);
+	if(is_mirror_) accum = 1.f - kr * getShaderScalar(mirror_shader_, node_tree_data, mirror_strength_);
 	if(is_transparent_) //uhm...should actually be true if this function gets called anyway...
 	{
-		accum *= transparency_shader_ ? transparency_shader_->getScalar(mat_data->node_tree_data_) * accum : transparency_strength_ * accum;
+		accum *= transparency_shader_ ? transparency_shader_->getScalar(node_tree_data) * accum : transparency_strength_ * accum;
 	}
-	const Rgb tcol = transmit_filter_strength_ * getShaderColor(diffuse_shader_, mat_data->node_tree_data_, diffuse_color_) + Rgb(1.f - transmit_filter_strength_);
+	const Rgb tcol = transmit_filter_strength_ * getShaderColor(diffuse_shader_, node_tree_data, diffuse_color_) + Rgb(1.f - transmit_filter_strength_);
 	Rgb result = accum * tcol;
-	applyWireFrame(result, wireframe_shader_, mat_data->node_tree_data_, sp);
+	applyWireFrame(result, wireframe_shader_, node_tree_data, sp);
 	return result;
 }
 
@@ -654,6 +665,7 @@ const Material *ShinyDiffuseMaterial::factory(Logger &logger, const Scene &scene
 			mat->color_nodes_.insert(mat->color_nodes_.end(), shader_nodes_list.begin(), shader_nodes_list.end());
 		}
 		if(mat->bump_shader_) mat->bump_nodes_ = mat->getNodeList(mat->bump_shader_, nodes_sorted);
+		mat->transparency_nodes_ = mat->getNodeList({mat->diffuse_shader_, mat->mirror_shader_, mat->transparency_shader_, mat->ior_shader_, mat->wireframe_shader_}, nodes_sorted);
 	}
 	mat->config();
 	return mat;
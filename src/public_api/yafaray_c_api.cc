@@ -83,6 +83,11 @@ int  yafaray_addVertexWithOrco(yafaray_Interface_t *interface, double x, double
 	return reinterpret_cast<yafaray::Interface *>(interface)->addVertex(x, y, z, ox, oy, oz);
 }
 
+int yafaray_addVertexTimeStep(yafaray_Interface_t *interface, double x, double y, double z, int time_step)
+{
+	return reinterpret_cast<yafaray::Interface *>(interface)->addVertexTimeStep(x, y, z, time_step);
+}
+
 void yafaray_addNormal(yafaray_Interface_t *interface, double nx, double ny, double nz) //!< add vertex normal to mesh; the vertex that will be attached to is the last one inserted by addVertex method
 {
 	reinterpret_cast<yafaray::Interface *>(interface)->addNormal(nx, ny, nz);
@@ -103,11 +108,56 @@ int  yafaray_addUv(yafaray_Interface_t *interface, float u, float v) //!< add a
 	return reinterpret_cast<yafaray::Interface *>(interface)->addUv(u, v);
 }
 
+int yafaray_addVertices(yafaray_Interface_t *interface, const float *points, int num_points) //!< add an array of vertices to mesh, given as consecutive x, y, z coordinates; returns the index of the first vertex added
+{
+	return reinterpret_cast<yafaray::Interface *>(interface)->addVertices(points, nullptr, num_points);
+}
+
+int yafaray_addVerticesWithOrco(yafaray_Interface_t *interface, const float *points, const float *orco_points, int num_points) //!< add an array of vertices with Orco to mesh, both given as consecutive x, y, z coordinates; returns the index of the first vertex added
+{
+	return reinterpret_cast<yafaray::Interface *>(interface)->addVertices(points, orco_points, num_points);
+}
+
+yafaray_bool_t yafaray_addNormals(yafaray_Interface_t *interface, const float *normals, int num_normals) //!< add an array of vertex normals to mesh, given as consecutive x, y, z coordinates, in the same order as the vertices
+{
+	return static_cast<yafaray_bool_t>(reinterpret_cast<yafaray::Interface *>(interface)->addNormals(normals, num_normals));
+}
+
+yafaray_bool_t yafaray_addTriangles(yafaray_Interface_t *interface, const int *vertex_indices, int num_triangles) //!< add an array of triangles given three vertex indices per triangle, with the current material
+{
+	return static_cast<yafaray_bool_t>(reinterpret_cast<yafaray::Interface *>(interface)->addFaces(vertex_indices, nullptr, num_triangles));
+}
+
+yafaray_bool_t yafaray_addTrianglesWithUv(yafaray_Interface_t *interface, const int *vertex_indices, const int *uv_indices, int num_triangles) //!< add an array of triangles given three vertex indices and three uv indices per triangle, with the current material
+{
+	return static_cast<yafaray_bool_t>(reinterpret_cast<yafaray::Interface *>(interface)->addFaces(vertex_indices, uv_indices, num_triangles));
+}
+
+int yafaray_addUvs(yafaray_Interface_t *interface, const float *uvs, int num_uvs) //!< add an array of UV coordinate pairs given as consecutive u, v values; returns the index of the first one added
+{
+	return reinterpret_cast<yafaray::Interface *>(interface)->addUvs(uvs, num_uvs);
+}
+
+yafaray_bool_t yafaray_setExternalVertices(yafaray_Interface_t *interface, const float *points, int stride, int num_points, yafaray_BufferReleaseCallback_t release_callback, void *callback_data) //!< use the client array of x, y, z coordinates as the vertices of the current mesh without copying it, with "stride" bytes between vertices (0 if packed). The array must not change until the release callback is called
+{
+	return static_cast<yafaray_bool_t>(reinterpret_cast<yafaray::Interface *>(interface)->setExternalVertices(points, stride, num_points, release_callback, callback_data));
+}
+
+yafaray_bool_t yafaray_setExternalTriangles(yafaray_Interface_t *interface, const int *vertex_indices, int stride, int num_triangles, yafaray_BufferReleaseCallback_t release_callback, void *callback_data) //!< use the client array of three vertex indices per triangle as the triangles of the current mesh without copying it, with "stride" bytes between triangles (0 if packed) and the current material. The array must not change until the release callback is called
+{
+	return static_cast<yafaray_bool_t>(reinterpret_cast<yafaray::Interface *>(interface)->setExternalTriangles(vertex_indices, stride, num_triangles, release_callback, callback_data));
+}
+
 yafaray_bool_t yafaray_smoothMesh(yafaray_Interface_t *interface, const char *name, double angle) //!< smooth vertex normals of mesh with given ID and angle (in degrees)
 {
 	return static_cast<yafaray_bool_t>(reinterpret_cast<yafaray::Interface *>(interface)->smoothMesh(name, angle));
 }
 
+yafaray_bool_t yafaray_updateObjectPoints(yafaray_Interface_t *interface, const char *name, const float *points, int num_points) //!< move all the points of an existing mesh, given as consecutive x, y, z coordinates, keeping its faces. Only the accelerator bounds are refit if nothing else changed
+{
+	return static_cast<yafaray_bool_t>(reinterpret_cast<yafaray::Interface *>(interface)->updateObjectPoints(name, points, num_points));
+}
+
 yafaray_bool_t yafaray_addInstance(yafaray_Interface_t *interface, const char *base_object_name, float m_00, float m_01, float m_02, float m_03, float m_10, float m_11, float m_12, float m_13, float m_20, float m_21, float m_22, float m_23, float m_30, float m_31, float m_32, float m_33)
 {
 	return static_cast<yafaray_bool_t>(reinterpret_cast<yafaray::Interface *>(interface)->addInstance(base_object_name, {m_00, m_01, m_02, m_03, m_10, m_11, m_12, m_13, m_20, m_21, m_22, m_23, m_30, m_31, m_32, m_33}));
@@ -118,6 +168,15 @@ yafaray_bool_t yafaray_addInstanceArray(yafaray_Interface_t *interface, const ch
 	return static_cast<yafaray_bool_t>(reinterpret_cast<yafaray::Interface *>(interface)->addInstance(base_object_name, yafaray::Matrix4(obj_to_world)));
 }
 
+yafaray_bool_t yafaray_addInstanceTimeSteps(yafaray_Interface_t *interface, const char *base_object_name, const float obj_to_world_time_steps[][4][4], int num_time_steps)
+{
+	if(!obj_to_world_time_steps || num_time_steps < 1) return YAFARAY_BOOL_FALSE;
+	std::vector<yafaray::Matrix4> obj_to_world_time_steps_vector;
+	obj_to_world_time_steps_vector.reserve(num_time_steps);
+	for(int time_step = 0; time_step < num_time_steps; ++time_step) obj_to_world_time_steps_vector.emplace_back(obj_to_world_time_steps[time_step]);
+	return static_cast<yafaray_bool_t>(reinterpret_cast<yafaray::Interface *>(interface)->addInstanceTimeSteps(base_object_name, obj_to_world_time_steps_vector));
+}
+
 void yafaray_paramsSetVector(yafaray_Interface_t *interface, const char *name, double x, double y, double z)
 {
 	reinterpret_cast<yafaray::Interface *>(interface)->paramsSetVector(name, x, y, z);
@@ -301,6 +360,11 @@ void yafaray_render(yafaray_Interface_t *interface, yafaray_ProgressBarCallback_
 	reinterpret_cast<yafaray::Interface *>(interface)->render(progress_bar);
 }
 
+yafaray_bool_t yafaray_benchmarkAccelerators(yafaray_Interface_t *interface, const char *ray_dump_path) //!< replay the accelerator queries recorded with the scene parameter "accelerator_ray_dump_path" against all the accelerator types, built over the current scene geometry, logging their performance
+{
+	return static_cast<yafaray_bool_t>(reinterpret_cast<yafaray::Interface *>(interface)->benchmarkAccelerators(ray_dump_path));
+}
+
 void yafaray_defineLayer(yafaray_Interface_t *interface)
 {
 	reinterpret_cast<yafaray::Interface *>(interface)->defineLayer();
@@ -23,6 +23,9 @@
 #include "common/logger.h"
 #include "common/sysinfo.h"
 #include "accelerator/accelerator.h"
+#include "accelerator/accelerator_two_level.h"
+#include "accelerator/accelerator_benchmark.h"
+#include "accelerator/ray_dump.h"
 #include "geometry/object/object.h"
 #include "geometry/object/object_instance.h"
 #include "geometry/uv.h"
@@ -216,6 +219,12 @@ bool Scene::render()
 	//if(creation_state_.changes_ != CreationState::Flags::CNone) //FIXME: handle better subsequent scene renders differently if previous render already complete
 	{
 		if(creation_state_.changes_ & CreationState::Flags::CGeom) updateObjects();
+		else if(creation_state_.changes_ & CreationState::Flags::CGeomPoints) refitObjects();
+		if(!accelerator_ray_dump_path_.empty() && accelerator_)
+		{
+			ray_dump_ = RayDump::create(logger_, accelerator_ray_dump_path_);
+			accelerator_->setRayDump(ray_dump_.get());
+		}
 
 		for(auto &l : getLights()) l.second->init(*this);
 
@@ -250,6 +259,7 @@ bool Scene::render()
 				logger_.logError("Scene: Rendering process failed, exiting...");
 				return false;
 			}
+			if(accelerator_) accelerator_->logShadowRayStats();
 			render_control_.setRenderInfo(surf_integrator_->getRenderInfo());
 			render_control_.setAaNoiseInfo(surf_integrator_->getAaNoiseInfo());
 			surf_integrator_->cleanup();
@@ -257,6 +267,11 @@ bool Scene::render()
 			render_control_.setFinished();
 			image_film_->cleanup();
 		}
+		if(ray_dump_)
+		{
+			accelerator_->setRayDump(nullptr);
+			ray_dump_ = nullptr;
+		}
 	}
 	creation_state_.changes_ = CreationState::Flags::CNone;
 	return true;
@@ -608,6 +623,13 @@ bool Scene::setupSceneRenderParams(Scene &scene, const ParamMap &params)
 	params.getParam("adv_base_sampling_offset", adv_base_sampling_offset); //Base sampling offset, in case of multi-computer rendering each should have a different offset so they don't "repeat" the same samples (user configurable)
 	params.getParam("adv_computer_node", adv_computer_node); //Computer node in multi-computer render environments/render farms
 	params.getParam("scene_accelerator", scene_accelerator_); //Computer node in multi-computer render environments/render farms
+	params.getParam("accelerator_precompute_triangles", accelerator_precompute_triangles_); //Faster triangle intersections in the accelerators supporting it, but using more memory
+	params.getParam("accelerator_compressed_nodes", accelerator_compressed_nodes_); //Less memory used by the nodes of the accelerators supporting it, but slower
+	params.getParam("accelerator_two_level_instances", accelerator_two_level_instances_); //Instances share one accelerator per base object instead of adding all their primitives to the scene accelerator
+	params.getParam("accelerator_treelet_passes", accelerator_treelet_passes_); //Treelet reoptimization passes in the linear BVH build, more passes give faster renders but slower builds
+	params.getParam("accelerator_spatial_split_budget", accelerator_spatial_split_budget_); //Maximum duplicated primitive references relative to the number of primitives in the spatial splits BVH build
+	params.getParam("accelerator_cache_dir", accelerator_cache_dir_); //Built trees are saved in this directory and reused by later renders of the same geometry
+	params.getParam("accelerator_ray_dump_path", accelerator_ray_dump_path_); //The accelerator queries of the renders are recorded into this file, to replay them later with benchmarkAccelerators
 
 	defineBasicLayers();
 	defineDependentLayers();
@@ -928,7 +950,22 @@ bool Scene::smoothNormals(const std::string &name, float angle)
 		object->setSmooth(true);
 		return true;
 	}
-	else return object->smoothNormals(logger_, angle);
+	else return object->smoothNormals(logger_, angle, sys_info::getNumSystemThreads());
+}
+
+/*! Moves the points of an existing mesh keeping its topology, so the accelerator can be refit instead of built again */
+bool Scene::updateObjectPoints(const std::string &name, const std::vector<Point3> &points)
+{
+	if(creation_state_.stack_.front() == CreationState::Object) return false;
+	Object *object = getObject(name);
+	if(!object)
+	{
+		logger_.logError("Scene: cannot update points of object '", name, "', it does not exist");
+		return false;
+	}
+	if(!object->updatePoints(logger_, points, sys_info::getNumSystemThreads())) return false;
+	creation_state_.changes_ |= CreationState::Flags::CGeomPoints;
+	return true;
 }
 
 int Scene::addVertex(const Point3 &p)
@@ -955,6 +992,13 @@ int Scene::addVertex(const Point3 &p, const Point3 &orco)
 	//	FIXME BsTriangle handling? if(object_creation_state_.cur_obj_->type_ == mtrim_global) return addVertex(p);
 }
 
+/*! Adds the position of an already added vertex in a motion blur time step, returns its index within the time step or -1 if the object has no such time step */
+int Scene::addVertexTimeStep(const Point3 &p, int time_step)
+{
+	if(creation_state_.stack_.front() != CreationState::Object) return -1;
+	return current_object_->addPoint(p, time_step);
+}
+
 void Scene::addNormal(const Vec3 &n)
 {
 	if(creation_state_.stack_.front() != CreationState::Object) return;
@@ -974,6 +1018,57 @@ int Scene::addUv(float u, float v)
 	return current_object_->addUvValue({u, v});
 }
 
+/*! Adds an array of vertices to the current object, optionally with their orco points. Returns the index of the first vertex added or -1 on error */
+int Scene::addVertices(std::vector<Point3> &&points, std::vector<Point3> &&orco_points)
+{
+	if(creation_state_.stack_.front() != CreationState::Object) return -1;
+	if(!orco_points.empty())
+	{
+		if(orco_points.size() != points.size())
+		{
+			logger_.logError("Scene: the number of orco points (", orco_points.size(), ") is different from the number of points (", points.size(), ")");
+			return -1;
+		}
+		current_object_->addOrcoPoints(std::move(orco_points));
+	}
+	return current_object_->addPoints(std::move(points));
+}
+
+bool Scene::addNormals(std::vector<Vec3> &&normals)
+{
+	if(creation_state_.stack_.front() != CreationState::Object) return false;
+	current_object_->addNormals(std::move(normals));
+	return true;
+}
+
+/*! Adds an array of triangles to the current object with the current material, given three vertex indices per triangle and optionally three uv indices per triangle */
+bool Scene::addFaces(std::vector<uint32_t> &&vertex_indices, std::vector<uint32_t> &&uv_indices)
+{
+	if(creation_state_.stack_.front() != CreationState::Object) return false;
+	return current_object_->addFaces(logger_, std::move(vertex_indices), std::move(uv_indices), creation_state_.current_material_);
+}
+
+/*! Adds an array of uv values to the current object. Returns the index of the first uv value added or -1 on error */
+int Scene::addUvs(std::vector<Uv> &&uv_values)
+{
+	if(creation_state_.stack_.front() != CreationState::Object) return -1;
+	return current_object_->addUvValues(std::move(uv_values));
+}
+
+/*! Makes the current object read its points in place from a client array. The buffer is released when it is not used */
+bool Scene::setExternalPoints(std::unique_ptr<const ExternalBuffer> points)
+{
+	if(creation_state_.stack_.front() != CreationState::Object) return false;
+	return current_object_->setExternalPoints(logger_, std::move(points));
+}
+
+/*! Makes the current object read its triangles in place from a client array, with the current material. The buffer is released when it is not used */
+bool Scene::setExternalFaces(std::unique_ptr<const ExternalBuffer> vertex_indices)
+{
+	if(creation_state_.stack_.front() != CreationState::Object) return false;
+	return current_object_->setExternalFaces(logger_, std::move(vertex_indices), creation_state_.current_material_);
+}
+
 Object *Scene::createObject(const std::string &name, const ParamMap &params)
 {
 	std::string pname = "Object";
@@ -1012,43 +1107,83 @@ Object *Scene::getObject(const std::string &name) const
 
 bool Scene::addInstance(const std::string &base_object_name, const Matrix4 &obj_to_world)
 {
-	const Object *base_object = objects_.find(base_object_name)->second.get();
-	if(objects_.find(base_object_name) == objects_.end())
+	return addInstance(base_object_name, std::vector<Matrix4>{obj_to_world});
+}
+
+/*! Adds an instance moving linearly between the transformation matrices of the motion blur time steps, uniformly distributed in the frame time */
+bool Scene::addInstance(const std::string &base_object_name, const std::vector<Matrix4> &obj_to_world_time_steps)
+{
+	const auto base_object_it = objects_.find(base_object_name);
+	if(base_object_it == objects_.end())
 	{
 		logger_.logError("Base mesh for instance doesn't exist ", base_object_name);
 		return false;
 	}
+	if(obj_to_world_time_steps.empty())
+	{
+		logger_.logError("Instance of ", base_object_name, " has no transformation matrices");
+		return false;
+	}
+	const Object *base_object = base_object_it->second.get();
 	int id = getNextFreeId();
 	if(id > 0)
 	{
 		const std::string instance_name = base_object_name + "-" + std::to_string(id);
 		if(logger_.isDebug())logger_.logDebug("  Instance: ", instance_name, " base_object_name=", base_object_name);
-		objects_[instance_name] = std::unique_ptr<Object>(new ObjectInstance(*base_object, obj_to_world));
+		objects_[instance_name] = std::unique_ptr<Object>(new ObjectInstance(*base_object, obj_to_world_time_steps));
+		creation_state_.changes_ |= CreationState::Flags::CGeom;
 		return true;
 	}
 	else return false;
 }
 
-bool Scene::updateObjects()
+/*! Primitives of the scene accelerator and, if the instances have their own accelerators, the instances */
+void Scene::getAcceleratorPrimitives(std::vector<const Primitive *> &primitives, std::vector<const Object *> &instances)
 {
-	std::vector<const Primitive *> primitives;
 	for(const auto &o : objects_)
 	{
 		if(o.second->getVisibility() == Visibility::Invisible) continue;
 		if(o.second->isBaseObject()) continue;
+		if(o.second->getInstanceBaseObject())
+		{
+			if(accelerator_two_level_instances_)
+			{
+				instances.emplace_back(o.second.get());
+				continue;
+			}
+			else o.second->calculateObject();
+		}
 		const auto prims = o.second->getPrimitives();
 		primitives.insert(primitives.end(), prims.begin(), prims.end());
 	}
-	if(primitives.empty())
-	{
-		logger_.logWarning("Scene: Scene is empty...");
-	}
+}
+
+std::unique_ptr<Accelerator> Scene::createAccelerator(const std::string &type, const std::vector<const Primitive *> &primitives, const std::vector<const Object *> &instances, bool use_cache) const
+{
 	ParamMap params;
-	params["type"] = scene_accelerator_;
+	params["type"] = type;
 	params["num_primitives"] = static_cast<int>(primitives.size());
 	params["accelerator_threads"] = getNumThreads();
+	params["precompute_triangles"] = accelerator_precompute_triangles_;
+	params["compressed_nodes"] = accelerator_compressed_nodes_;
+	params["treelet_passes"] = accelerator_treelet_passes_;
+	params["spatial_split_budget"] = accelerator_spatial_split_budget_;
+	if(use_cache && !accelerator_cache_dir_.empty()) params["cache_dir"] = accelerator_cache_dir_;
+
+	if(instances.empty()) return std::unique_ptr<Accelerator>(Accelerator::factory(logger_, primitives, params));
+	else return std::unique_ptr<Accelerator>(AcceleratorTwoLevel::factory(logger_, primitives, instances, params));
+}
 
-	accelerator_ = std::unique_ptr<const Accelerator>(Accelerator::factory(logger_, primitives, params));
+bool Scene::updateObjects()
+{
+	std::vector<const Primitive *> primitives;
+	std::vector<const Object *> instances;
+	getAcceleratorPrimitives(primitives, instances);
+	if(primitives.empty() && instances.empty())
+	{
+		logger_.logWarning("Scene: Scene is empty...");
+	}
+	accelerator_ = createAccelerator(scene_accelerator_, primitives, instances, true);
 	scene_bound_ = accelerator_->getBound();
 	if(logger_.isVerbose()) logger_.logVerbose("Scene: New scene bound is: ", "(", scene_bound_.a_.x(), ", ", scene_bound_.a_.y(), ", ", scene_bound_.a_.z(), "), (", scene_bound_.g_.x(), ", ", scene_bound_.g_.y(), ", ", scene_bound_.g_.z(), ")");
 
@@ -1059,4 +1194,35 @@ bool Scene::updateObjects()
 	return true;
 }
 
+/*! Replays the accelerator queries recorded in a ray dump file against all the accelerator types, built
+	over the current scene geometry. The scene must be the same that was rendered when recording the queries */
+bool Scene::benchmarkAccelerators(const std::string &ray_dump_path)
+{
+	std::vector<const Primitive *> primitives;
+	std::vector<const Object *> instances;
+	getAcceleratorPrimitives(primitives, instances);
+	if(primitives.empty() && instances.empty())
+	{
+		logger_.logError("Scene: Scene is empty, the accelerators cannot be benchmarked");
+		return false;
+	}
+	const Camera *camera = cameras_.empty() ? nullptr : cameras_.begin()->second.get();
+	return AcceleratorBenchmark::run(logger_, ray_dump_path, AcceleratorBenchmark::accelerator_types_, [&](const std::string &type)
+	{
+		return createAccelerator(type, primitives, instances, false);
+	}, camera);
+}
+
+bool Scene::refitObjects()
+{
+	if(!accelerator_ || !accelerator_->refit(getNumThreads()))
+	{
+		logger_.logInfo("Scene: the accelerator cannot be refit, building it again");
+		return updateObjects();
+	}
+	scene_bound_ = accelerator_->getBound();
+	if(logger_.isVerbose()) logger_.logVerbose("Scene: New scene bound is: ", "(", scene_bound_.a_.x(), ", ", scene_bound_.a_.y(), ", ", scene_bound_.a_.z(), "), (", scene_bound_.g_.x(), ", ", scene_bound_.g_.y(), ", ", scene_bound_.g_.z(), ")");
+	return true;
+}
+
 END_YAFARAY
@@ -0,0 +1,183 @@
+/****************************************************************************
+ *      This is part of the libYafaRay package
+ *
+ *      test05.c : accelerator benchmark, recording the accelerator queries
+ *      of a render into a ray dump file and replaying them against all the
+ *      accelerator types
+ *      Should work even with a "barebones" libYafaRay built without
+ *      any dependencies
+ *
+ *      This library is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU Lesser General Public
+ *      License as published by the Free Software Foundation; either
+ *      version 2.1 of the License, or (at your option) any later version.
+ *
+ *      This library is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *      Lesser General Public License for more details.
+ *
+ *      You should have received a copy of the GNU Lesser General Public
+ *      License along with this library; if not, write to the Free Software
+ *      Foundation,Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include "yafaray_c_api.h"
+#include <stdio.h>
+
+/* Triangle wave between -1 and 1 with the given period, to build the terrain without depending on the math library */
+static float wave(float x, float period)
+{
+	float t = x / period;
+	t -= (float) (int) t;
+	if(t < 0.f) t += 1.f;
+	return t < 0.5f ? 4.f * t - 1.f : 3.f - 4.f * t;
+}
+
+static float terrainHeight(float x, float y)
+{
+	return 0.6f * wave(x, 5.3f) * wave(y, 4.1f) + 0.15f * wave(x + y, 1.3f) + 0.05f * wave(x - 2.f * y, 0.37f);
+}
+
+/* Square grid of "grid_size" x "grid_size" quads centered at the origin, with the given side length */
+static void addGrid(yafaray_Interface_t *yi, int grid_size, float side, float z, int use_terrain_height)
+{
+	int i, j;
+	for(j = 0; j <= grid_size; ++j)
+	{
+		for(i = 0; i <= grid_size; ++i)
+		{
+			const float x = side * ((float) i / grid_size - 0.5f);
+			const float y = side * ((float) j / grid_size - 0.5f);
+			yafaray_addVertex(yi, x, y, use_terrain_height ? terrainHeight(x, y) : z + 0.2f * wave(x * y, 3.f));
+		}
+	}
+	for(j = 0; j < grid_size; ++j)
+	{
+		for(i = 0; i < grid_size; ++i)
+		{
+			const int a = j * (grid_size + 1) + i;
+			yafaray_addTriangle(yi, a, a + 1, a + grid_size + 2);
+			yafaray_addTriangle(yi, a, a + grid_size + 2, a + grid_size + 1);
+		}
+	}
+}
+
+int main()
+{
+	const int width = 240;
+	const int height = 160;
+	const char *ray_dump_path = "./test05-rays.bin";
+
+	printf("***** Test client 'test05' for libYafaRay *****\n");
+	printf("Using libYafaRay version (%d.%d.%d)\n", yafaray_getVersionMajor(), yafaray_getVersionMinor(), yafaray_getVersionPatch());
+
+	/* YafaRay standard rendering interface */
+	yafaray_Interface_t *yi = yafaray_createInterface(YAFARAY_INTERFACE_FOR_RENDERING, "test05.xml", NULL, NULL, YAFARAY_DISPLAY_CONSOLE_NORMAL);
+	yafaray_setConsoleLogColorsEnabled(yi, YAFARAY_BOOL_TRUE);
+	yafaray_setConsoleVerbosityLevel(yi, YAFARAY_LOG_LEVEL_INFO);
+
+	/* Creating scene */
+	yafaray_createScene(yi);
+	yafaray_paramsClearAll(yi);
+
+	/* Creating materials */
+	yafaray_paramsSetString(yi, "type", "shinydiffusemat");
+	yafaray_paramsSetColor(yi, "color", 0.6f, 0.5f, 0.3f, 1.f);
+	yafaray_createMaterial(yi, "MaterialTerrain");
+	yafaray_paramsClearAll(yi);
+
+	yafaray_paramsSetString(yi, "type", "shinydiffusemat");
+	yafaray_paramsSetColor(yi, "color", 0.2f, 0.7f, 0.3f, 1.f);
+	yafaray_paramsSetFloat(yi, "transparency", 0.6f);
+	yafaray_createMaterial(yi, "MaterialCanopy");
+	yafaray_paramsClearAll(yi);
+
+	/* Creating geometric objects in the scene */
+	yafaray_startGeometry(yi);
+
+	/* Terrain */
+	yafaray_paramsSetString(yi, "type", "mesh");
+	yafaray_createObject(yi, "Terrain");
+	yafaray_paramsClearAll(yi);
+	yafaray_setCurrentMaterial(yi, "MaterialTerrain");
+	addGrid(yi, 160, 20.f, 0.f, 1);
+	yafaray_endObject(yi);
+
+	/* Semi-transparent canopy over the terrain, so the shadow rays have to go through it */
+	yafaray_paramsSetString(yi, "type", "mesh");
+	yafaray_createObject(yi, "Canopy");
+	yafaray_paramsClearAll(yi);
+	yafaray_setCurrentMaterial(yi, "MaterialCanopy");
+	addGrid(yi, 40, 12.f, 2.5f, 0);
+	yafaray_endObject(yi);
+
+	/* Ending definition of geometric objects */
+	yafaray_endGeometry(yi);
+
+	/* Creating light/lamp */
+	yafaray_paramsSetString(yi, "type", "pointlight");
+	yafaray_paramsSetColor(yi, "color", 1.f, 1.f, 1.f, 1.f);
+	yafaray_paramsSetVector(yi, "from", 3.f, -4.f, 12.f);
+	yafaray_paramsSetFloat(yi, "power", 200.f);
+	yafaray_createLight(yi, "light_1");
+	yafaray_paramsClearAll(yi);
+
+	/* Creating scene background */
+	yafaray_paramsSetString(yi, "type", "constant");
+	yafaray_paramsSetColor(yi, "color", 0.5f, 0.6f, 0.8f, 1.f);
+	yafaray_createBackground(yi, "world_background");
+	yafaray_paramsClearAll(yi);
+
+	/* Creating camera */
+	yafaray_paramsSetString(yi, "type", "perspective");
+	yafaray_paramsSetInt(yi, "resx", width);
+	yafaray_paramsSetInt(yi, "resy", height);
+	yafaray_paramsSetFloat(yi, "focal", 1.1f);
+	yafaray_paramsSetVector(yi, "from", 0.f, -14.f, 7.f);
+	yafaray_paramsSetVector(yi, "to", 0.f, -13.2f, 6.5f);
+	yafaray_paramsSetVector(yi, "up", 0.f, -13.5f, 8.f);
+	yafaray_createCamera(yi, "cam_1");
+	yafaray_paramsClearAll(yi);
+
+	/* Creating scene view */
+	yafaray_paramsSetString(yi, "camera_name", "cam_1");
+	yafaray_createRenderView(yi, "view_1");
+	yafaray_paramsClearAll(yi);
+
+	/* Creating surface integrator with transparent shadows */
+	yafaray_paramsSetString(yi, "type", "directlighting");
+	yafaray_paramsSetBool(yi, "transpShad", YAFARAY_BOOL_TRUE);
+	yafaray_paramsSetInt(yi, "shadowDepth", 4);
+	yafaray_createIntegrator(yi, "surfintegr");
+	yafaray_paramsClearAll(yi);
+
+	/* Setting up render parameters. The accelerator queries of the render are recorded into the ray dump file */
+	yafaray_paramsSetString(yi, "integrator_name", "surfintegr");
+	yafaray_paramsSetString(yi, "scene_accelerator", "yafaray-bvh");
+	yafaray_paramsSetString(yi, "accelerator_ray_dump_path", ray_dump_path);
+	yafaray_paramsSetString(yi, "background_name", "world_background");
+	yafaray_paramsSetInt(yi, "width", width);
+	yafaray_paramsSetInt(yi, "height", height);
+	yafaray_paramsSetInt(yi, "AA_minsamples", 1);
+	yafaray_paramsSetInt(yi, "AA_passes", 1);
+	yafaray_paramsSetInt(yi, "threads", -1);
+	yafaray_setupRender(yi);
+	yafaray_paramsClearAll(yi);
+
+	/* Creating image output */
+	yafaray_paramsSetString(yi, "image_path", "./test05-output1.tga");
+	yafaray_createOutput(yi, "output1_tga");
+	yafaray_paramsClearAll(yi);
+
+	/* Rendering */
+	yafaray_render(yi, NULL, NULL, YAFARAY_DISPLAY_CONSOLE_NORMAL);
+
+	/* Replaying the recorded queries against all the accelerators, built over the same scene */
+	if(!yafaray_benchmarkAccelerators(yi, ray_dump_path)) printf("Error: the accelerator benchmark could not be run\n");
+
+	/* Destroying YafaRay interface. Scene and all objects inside are automatically destroyed */
+	yafaray_destroyInterface(yi);
+	return 0;
+}
+
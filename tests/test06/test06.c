@@ -0,0 +1,229 @@
+/****************************************************************************
+ *      This is part of the libYafaRay package
+ *
+ *      test06.c : ray differentials micro-benchmark, rendering the same
+ *      scene with mirror and glass spheres over a textured floor with a
+ *      bilinear texture (no ray differentials) and with a trilinear
+ *      texture (ray differentials for each camera ray and each specular
+ *      bounce), and printing the render time of both
+ *      Should work even with a "barebones" libYafaRay built without
+ *      any dependencies
+ *
+ *      This library is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU Lesser General Public
+ *      License as published by the Free Software Foundation; either
+ *      version 2.1 of the License, or (at your option) any later version.
+ *
+ *      This library is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *      Lesser General Public License for more details.
+ *
+ *      You should have received a copy of the GNU Lesser General Public
+ *      License along with this library; if not, write to the Free Software
+ *      Foundation,Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include "yafaray_c_api.h"
+#include <stdio.h>
+#include <time.h>
+
+static void addSphere(yafaray_Interface_t *yi, const char *name, const char *material, float x, float y, float radius)
+{
+	yafaray_paramsSetString(yi, "type", "sphere");
+	yafaray_paramsSetVector(yi, "center", x, y, radius);
+	yafaray_paramsSetFloat(yi, "radius", radius);
+	yafaray_paramsSetString(yi, "material", material);
+	yafaray_createObject(yi, name);
+	yafaray_paramsClearAll(yi);
+}
+
+/* Renders the scene and returns the processor time taken by the render, in seconds */
+static double renderScene(const char *interpolation, const char *output_path)
+{
+	const int width = 320;
+	const int height = 240;
+	const int tex_size = 256;
+	yafaray_Interface_t *yi = NULL;
+	yafaray_Image_t *image = NULL;
+	clock_t render_start;
+	double render_seconds;
+	int i, j;
+
+	/* YafaRay standard rendering interface */
+	yi = yafaray_createInterface(YAFARAY_INTERFACE_FOR_RENDERING, "test06.xml", NULL, NULL, YAFARAY_DISPLAY_CONSOLE_NORMAL);
+	yafaray_setConsoleLogColorsEnabled(yi, YAFARAY_BOOL_TRUE);
+	yafaray_setConsoleVerbosityLevel(yi, YAFARAY_LOG_LEVEL_INFO);
+
+	/* Creating scene */
+	yafaray_createScene(yi);
+	yafaray_paramsClearAll(yi);
+
+	/* Creating checker image in memory, so no image file or image format support is needed */
+	yafaray_paramsSetString(yi, "type", "ColorAlpha");
+	yafaray_paramsSetString(yi, "image_optimization", "none");
+	yafaray_paramsSetInt(yi, "width", tex_size);
+	yafaray_paramsSetInt(yi, "height", tex_size);
+	image = yafaray_createImage(yi, "ImageChecker");
+	yafaray_paramsClearAll(yi);
+	for(i = 0; i < tex_size; ++i)
+	{
+		for(j = 0; j < tex_size; ++j)
+		{
+			const float value = ((i / 16 + j / 16) % 2) ? 0.9f : 0.1f;
+			yafaray_setImageColor(image, i, j, value, 0.8f * value, 0.5f * value, 1.f);
+		}
+	}
+
+	/* Creating texture from image. With "mipmap_trilinear" (or "mipmap_ewa") interpolation the ray differentials are enabled for the render */
+	yafaray_paramsSetString(yi, "type", "image");
+	yafaray_paramsSetString(yi, "image_name", "ImageChecker");
+	yafaray_paramsSetString(yi, "interpolate", interpolation);
+	yafaray_paramsSetString(yi, "clipping", "repeat");
+	yafaray_paramsSetInt(yi, "xrepeat", 8);
+	yafaray_paramsSetInt(yi, "yrepeat", 8);
+	yafaray_createTexture(yi, "TextureChecker");
+	yafaray_paramsClearAll(yi);
+
+	/* Creating materials */
+	yafaray_paramsSetString(yi, "type", "shinydiffusemat");
+	yafaray_paramsSetColor(yi, "color", 0.9f, 0.9f, 0.9f, 1.f);
+	yafaray_paramsPushList(yi);
+	yafaray_paramsSetString(yi, "element", "shader_node");
+	yafaray_paramsSetString(yi, "name", "diff_layer0");
+	yafaray_paramsSetString(yi, "input", "map0");
+	yafaray_paramsSetString(yi, "type", "layer");
+	yafaray_paramsSetString(yi, "blend_mode", "mix");
+	yafaray_paramsSetColor(yi, "upper_color", 1.f, 1.f, 1.f, 1.f);
+	yafaray_paramsPushList(yi);
+	yafaray_paramsSetString(yi, "element", "shader_node");
+	yafaray_paramsSetString(yi, "name", "map0");
+	yafaray_paramsSetString(yi, "type", "texture_mapper");
+	yafaray_paramsSetString(yi, "texco", "uv");
+	yafaray_paramsSetString(yi, "texture", "TextureChecker");
+	yafaray_paramsEndList(yi);
+	yafaray_paramsSetString(yi, "diffuse_shader", "diff_layer0");
+	yafaray_createMaterial(yi, "MaterialFloor");
+	yafaray_paramsClearAll(yi);
+
+	yafaray_paramsSetString(yi, "type", "shinydiffusemat");
+	yafaray_paramsSetColor(yi, "color", 0.f, 0.f, 0.f, 1.f);
+	yafaray_paramsSetColor(yi, "mirror_color", 0.9f, 0.9f, 0.9f, 1.f);
+	yafaray_paramsSetFloat(yi, "specular_reflect", 1.f);
+	yafaray_createMaterial(yi, "MaterialMirror");
+	yafaray_paramsClearAll(yi);
+
+	yafaray_paramsSetString(yi, "type", "glass");
+	yafaray_paramsSetFloat(yi, "IOR", 1.5f);
+	yafaray_paramsSetColor(yi, "filter_color", 1.f, 1.f, 1.f, 1.f);
+	yafaray_paramsSetColor(yi, "mirror_color", 1.f, 1.f, 1.f, 1.f);
+	yafaray_createMaterial(yi, "MaterialGlass");
+	yafaray_paramsClearAll(yi);
+
+	/* Creating geometric objects in the scene */
+	yafaray_startGeometry(yi);
+
+	/* Textured floor */
+	yafaray_paramsSetString(yi, "type", "mesh");
+	yafaray_paramsSetBool(yi, "has_uv", YAFARAY_BOOL_TRUE);
+	yafaray_createObject(yi, "Floor");
+	yafaray_paramsClearAll(yi);
+	yafaray_setCurrentMaterial(yi, "MaterialFloor");
+	yafaray_addVertex(yi, -20.f, -20.f, 0.f);
+	yafaray_addVertex(yi, 20.f, -20.f, 0.f);
+	yafaray_addVertex(yi, 20.f, 20.f, 0.f);
+	yafaray_addVertex(yi, -20.f, 20.f, 0.f);
+	yafaray_addUv(yi, 0.f, 0.f);
+	yafaray_addUv(yi, 1.f, 0.f);
+	yafaray_addUv(yi, 1.f, 1.f);
+	yafaray_addUv(yi, 0.f, 1.f);
+	yafaray_addTriangleWithUv(yi, 0, 1, 2, 0, 1, 2);
+	yafaray_addTriangleWithUv(yi, 0, 2, 3, 0, 2, 3);
+	yafaray_endObject(yi);
+
+	/* Mirror and glass spheres, so most of the camera rays have specular bounces */
+	addSphere(yi, "SphereMirror1", "MaterialMirror", -2.2f, 0.f, 1.f);
+	addSphere(yi, "SphereGlass", "MaterialGlass", 0.f, -1.f, 1.f);
+	addSphere(yi, "SphereMirror2", "MaterialMirror", 2.2f, 0.f, 1.f);
+	addSphere(yi, "SphereMirror3", "MaterialMirror", 0.f, 2.5f, 1.5f);
+
+	/* Ending definition of geometric objects */
+	yafaray_endGeometry(yi);
+
+	/* Creating light/lamp */
+	yafaray_paramsSetString(yi, "type", "pointlight");
+	yafaray_paramsSetColor(yi, "color", 1.f, 1.f, 1.f, 1.f);
+	yafaray_paramsSetVector(yi, "from", 3.f, -5.f, 8.f);
+	yafaray_paramsSetFloat(yi, "power", 100.f);
+	yafaray_createLight(yi, "light_1");
+	yafaray_paramsClearAll(yi);
+
+	/* Creating scene background */
+	yafaray_paramsSetString(yi, "type", "constant");
+	yafaray_paramsSetColor(yi, "color", 0.5f, 0.6f, 0.8f, 1.f);
+	yafaray_createBackground(yi, "world_background");
+	yafaray_paramsClearAll(yi);
+
+	/* Creating camera */
+	yafaray_paramsSetString(yi, "type", "perspective");
+	yafaray_paramsSetInt(yi, "resx", width);
+	yafaray_paramsSetInt(yi, "resy", height);
+	yafaray_paramsSetFloat(yi, "focal", 1.1f);
+	yafaray_paramsSetVector(yi, "from", 0.f, -9.f, 3.5f);
+	yafaray_paramsSetVector(yi, "to", 0.f, -8.1f, 3.1f);
+	yafaray_paramsSetVector(yi, "up", 0.f, -8.6f, 4.4f);
+	yafaray_createCamera(yi, "cam_1");
+	yafaray_paramsClearAll(yi);
+
+	/* Creating scene view */
+	yafaray_paramsSetString(yi, "camera_name", "cam_1");
+	yafaray_createRenderView(yi, "view_1");
+	yafaray_paramsClearAll(yi);
+
+	/* Creating surface integrator */
+	yafaray_paramsSetString(yi, "type", "directlighting");
+	yafaray_paramsSetInt(yi, "raydepth", 6);
+	yafaray_createIntegrator(yi, "surfintegr");
+	yafaray_paramsClearAll(yi);
+
+	/* Setting up render parameters. A single render thread, so the processor time is the render time */
+	yafaray_paramsSetString(yi, "integrator_name", "surfintegr");
+	yafaray_paramsSetString(yi, "background_name", "world_background");
+	yafaray_paramsSetInt(yi, "width", width);
+	yafaray_paramsSetInt(yi, "height", height);
+	yafaray_paramsSetInt(yi, "AA_minsamples", 4);
+	yafaray_paramsSetInt(yi, "AA_passes", 1);
+	yafaray_paramsSetInt(yi, "threads", 1);
+	yafaray_setupRender(yi);
+	yafaray_paramsClearAll(yi);
+
+	/* Creating image output */
+	yafaray_paramsSetString(yi, "image_path", output_path);
+	yafaray_createOutput(yi, "output1_tga");
+	yafaray_paramsClearAll(yi);
+
+	/* Rendering */
+	render_start = clock();
+	yafaray_render(yi, NULL, NULL, YAFARAY_DISPLAY_CONSOLE_NORMAL);
+	render_seconds = (double) (clock() - render_start) / CLOCKS_PER_SEC;
+
+	/* Destroying YafaRay interface. Scene and all objects inside are automatically destroyed */
+	yafaray_destroyInterface(yi);
+	return render_seconds;
+}
+
+int main()
+{
+	double seconds_without_differentials, seconds_with_differentials;
+
+	printf("***** Test client 'test06' for libYafaRay *****\n");
+	printf("Using libYafaRay version (%d.%d.%d)\n", yafaray_getVersionMajor(), yafaray_getVersionMinor(), yafaray_getVersionPatch());
+
+	seconds_without_differentials = renderScene("bilinear", "./test06-output-bilinear.tga");
+	seconds_with_differentials = renderScene("mipmap_trilinear", "./test06-output-trilinear.tga");
+
+	printf("Render time without ray differentials (bilinear texture): %.3f s\n", seconds_without_differentials);
+	printf("Render time with ray differentials (trilinear texture): %.3f s\n", seconds_with_differentials);
+	printf("Ray differentials overhead: %.1f%%\n", 100.0 * (seconds_with_differentials - seconds_without_differentials) / seconds_without_differentials);
+	return 0;
+}
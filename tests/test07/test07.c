@@ -0,0 +1,196 @@
+/****************************************************************************
+ *      This is part of the libYafaRay package
+ *
+ *      test07.c : motion blur instances check, rendering a cube instance
+ *      moving and rotating during the frame with two level instances,
+ *      recording the accelerator queries and checking with the accelerator
+ *      benchmark that the closest hits on the moving instance are at the
+ *      same position where the shadow rays find them
+ *      Should work even with a "barebones" libYafaRay built without
+ *      any dependencies
+ *
+ *      This library is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU Lesser General Public
+ *      License as published by the Free Software Foundation; either
+ *      version 2.1 of the License, or (at your option) any later version.
+ *
+ *      This library is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *      Lesser General Public License for more details.
+ *
+ *      You should have received a copy of the GNU Lesser General Public
+ *      License along with this library; if not, write to the Free Software
+ *      Foundation,Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include "yafaray_c_api.h"
+#include <stdio.h>
+#include <string.h>
+
+/* Transformation matrix rotating around the Z axis by the given cosine and sine, and then translating */
+static void setMatrix(float matrix[4][4], float cos_angle, float sin_angle, float x, float y, float z)
+{
+	memset(matrix, 0, 16 * sizeof(float));
+	matrix[0][0] = cos_angle;
+	matrix[0][1] = -sin_angle;
+	matrix[1][0] = sin_angle;
+	matrix[1][1] = cos_angle;
+	matrix[2][2] = 1.f;
+	matrix[0][3] = x;
+	matrix[1][3] = y;
+	matrix[2][3] = z;
+	matrix[3][3] = 1.f;
+}
+
+int main()
+{
+	const int width = 240;
+	const int height = 160;
+	const char *ray_dump_path = "./test07-rays.bin";
+	float obj_to_world_time_steps[2][4][4];
+	int result = 0;
+
+	printf("***** Test client 'test07' for libYafaRay *****\n");
+	printf("Using libYafaRay version (%d.%d.%d)\n", yafaray_getVersionMajor(), yafaray_getVersionMinor(), yafaray_getVersionPatch());
+
+	/* YafaRay standard rendering interface */
+	yafaray_Interface_t *yi = yafaray_createInterface(YAFARAY_INTERFACE_FOR_RENDERING, "test07.xml", NULL, NULL, YAFARAY_DISPLAY_CONSOLE_NORMAL);
+	yafaray_setConsoleLogColorsEnabled(yi, YAFARAY_BOOL_TRUE);
+	yafaray_setConsoleVerbosityLevel(yi, YAFARAY_LOG_LEVEL_INFO);
+
+	/* Creating scene */
+	yafaray_createScene(yi);
+	yafaray_paramsClearAll(yi);
+
+	/* Creating materials */
+	yafaray_paramsSetString(yi, "type", "shinydiffusemat");
+	yafaray_paramsSetColor(yi, "color", 0.8f, 0.8f, 0.8f, 1.f);
+	yafaray_createMaterial(yi, "MaterialFloor");
+	yafaray_paramsClearAll(yi);
+
+	yafaray_paramsSetString(yi, "type", "shinydiffusemat");
+	yafaray_paramsSetColor(yi, "color", 0.8f, 0.3f, 0.2f, 1.f);
+	yafaray_createMaterial(yi, "MaterialCube");
+	yafaray_paramsClearAll(yi);
+
+	/* Creating geometric objects in the scene */
+	yafaray_startGeometry(yi);
+
+	/* Floor */
+	yafaray_paramsSetString(yi, "type", "mesh");
+	yafaray_createObject(yi, "Floor");
+	yafaray_paramsClearAll(yi);
+	yafaray_setCurrentMaterial(yi, "MaterialFloor");
+	yafaray_addVertex(yi, -10.f, -10.f, 0.f);
+	yafaray_addVertex(yi, 10.f, -10.f, 0.f);
+	yafaray_addVertex(yi, 10.f, 10.f, 0.f);
+	yafaray_addVertex(yi, -10.f, 10.f, 0.f);
+	yafaray_addTriangle(yi, 0, 1, 2);
+	yafaray_addTriangle(yi, 0, 2, 3);
+	yafaray_endObject(yi);
+
+	/* Base cube for the moving instance, not rendered by itself */
+	yafaray_paramsSetString(yi, "type", "mesh");
+	yafaray_paramsSetBool(yi, "is_base_object", YAFARAY_BOOL_TRUE);
+	yafaray_createObject(yi, "Cube");
+	yafaray_paramsClearAll(yi);
+	yafaray_setCurrentMaterial(yi, "MaterialCube");
+	yafaray_addVertex(yi, -1.f, -1.f, -1.f);
+	yafaray_addVertex(yi, 1.f, -1.f, -1.f);
+	yafaray_addVertex(yi, 1.f, 1.f, -1.f);
+	yafaray_addVertex(yi, -1.f, 1.f, -1.f);
+	yafaray_addVertex(yi, -1.f, -1.f, 1.f);
+	yafaray_addVertex(yi, 1.f, -1.f, 1.f);
+	yafaray_addVertex(yi, 1.f, 1.f, 1.f);
+	yafaray_addVertex(yi, -1.f, 1.f, 1.f);
+	yafaray_addTriangle(yi, 0, 2, 1);
+	yafaray_addTriangle(yi, 0, 3, 2);
+	yafaray_addTriangle(yi, 4, 5, 6);
+	yafaray_addTriangle(yi, 4, 6, 7);
+	yafaray_addTriangle(yi, 0, 1, 5);
+	yafaray_addTriangle(yi, 0, 5, 4);
+	yafaray_addTriangle(yi, 1, 2, 6);
+	yafaray_addTriangle(yi, 1, 6, 5);
+	yafaray_addTriangle(yi, 2, 3, 7);
+	yafaray_addTriangle(yi, 2, 7, 6);
+	yafaray_addTriangle(yi, 3, 0, 4);
+	yafaray_addTriangle(yi, 3, 4, 7);
+	yafaray_endObject(yi);
+
+	/* Cube instance moving to the right and rotating 45 degrees during the frame */
+	setMatrix(obj_to_world_time_steps[0], 1.f, 0.f, -2.f, 0.f, 1.f);
+	setMatrix(obj_to_world_time_steps[1], 0.7071f, 0.7071f, 2.f, 0.f, 1.f);
+	yafaray_addInstanceTimeSteps(yi, "Cube", (const float (*)[4][4]) obj_to_world_time_steps, 2);
+
+	/* Ending definition of geometric objects */
+	yafaray_endGeometry(yi);
+
+	/* Creating light/lamp */
+	yafaray_paramsSetString(yi, "type", "pointlight");
+	yafaray_paramsSetColor(yi, "color", 1.f, 1.f, 1.f, 1.f);
+	yafaray_paramsSetVector(yi, "from", 3.f, -4.f, 8.f);
+	yafaray_paramsSetFloat(yi, "power", 100.f);
+	yafaray_createLight(yi, "light_1");
+	yafaray_paramsClearAll(yi);
+
+	/* Creating scene background */
+	yafaray_paramsSetString(yi, "type", "constant");
+	yafaray_paramsSetColor(yi, "color", 0.5f, 0.6f, 0.8f, 1.f);
+	yafaray_createBackground(yi, "world_background");
+	yafaray_paramsClearAll(yi);
+
+	/* Creating camera */
+	yafaray_paramsSetString(yi, "type", "perspective");
+	yafaray_paramsSetInt(yi, "resx", width);
+	yafaray_paramsSetInt(yi, "resy", height);
+	yafaray_paramsSetFloat(yi, "focal", 1.1f);
+	yafaray_paramsSetVector(yi, "from", 0.f, -10.f, 5.f);
+	yafaray_paramsSetVector(yi, "to", 0.f, -9.1f, 4.6f);
+	yafaray_paramsSetVector(yi, "up", 0.f, -9.6f, 5.9f);
+	yafaray_createCamera(yi, "cam_1");
+	yafaray_paramsClearAll(yi);
+
+	/* Creating scene view */
+	yafaray_paramsSetString(yi, "camera_name", "cam_1");
+	yafaray_createRenderView(yi, "view_1");
+	yafaray_paramsClearAll(yi);
+
+	/* Creating surface integrator */
+	yafaray_paramsSetString(yi, "type", "directlighting");
+	yafaray_createIntegrator(yi, "surfintegr");
+	yafaray_paramsClearAll(yi);
+
+	/* Setting up render parameters. The instance gets its own accelerator and the accelerator queries of the render are recorded into the ray dump file */
+	yafaray_paramsSetString(yi, "integrator_name", "surfintegr");
+	yafaray_paramsSetString(yi, "scene_accelerator", "yafaray-bvh");
+	yafaray_paramsSetBool(yi, "accelerator_two_level_instances", YAFARAY_BOOL_TRUE);
+	yafaray_paramsSetString(yi, "accelerator_ray_dump_path", ray_dump_path);
+	yafaray_paramsSetString(yi, "background_name", "world_background");
+	yafaray_paramsSetInt(yi, "width", width);
+	yafaray_paramsSetInt(yi, "height", height);
+	yafaray_paramsSetInt(yi, "AA_minsamples", 4);
+	yafaray_paramsSetInt(yi, "AA_passes", 1);
+	yafaray_paramsSetInt(yi, "threads", -1);
+	yafaray_setupRender(yi);
+	yafaray_paramsClearAll(yi);
+
+	/* Creating image output */
+	yafaray_paramsSetString(yi, "image_path", "./test07-output1.tga");
+	yafaray_createOutput(yi, "output1_tga");
+	yafaray_paramsClearAll(yi);
+
+	/* Rendering */
+	yafaray_render(yi, NULL, NULL, YAFARAY_DISPLAY_CONSOLE_NORMAL);
+
+	/* Replaying the recorded queries, checking the closest hits on the moving instance against the shadow rays */
+	if(!yafaray_benchmarkAccelerators(yi, ray_dump_path))
+	{
+		printf("Error: the closest hits on the moving instance are not consistent with the shadow rays, or the accelerator benchmark could not be run\n");
+		result = 1;
+	}
+
+	/* Destroying YafaRay interface. Scene and all objects inside are automatically destroyed */
+	yafaray_destroyInterface(yi);
+	return result;
+}